@@ -0,0 +1,471 @@
+/* fceux-bench - times the emulator core headless, with and without debugging aids
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "debug.h"
+#include "cart.h"
+#include "reversedebug.h"
+#include "fceulua.h"
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+//each scenario loads the game afresh, sets up its debugging aids and runs the same frames;
+//the game gets no input, so every run executes the same instructions.
+struct Scenario
+{
+	const char *name;
+	const char *description;
+	int watchpoints;       //read/write watchpoints on RAM the game doesn't touch
+	int breakpoints;       //execute breakpoints on code the game doesn't run
+	int conditions;        //execute breakpoints over the running code, whose conditions never hold
+	const char *lua;       //script to run alongside the game
+	bool cdl;              //Code/Data Logger running
+};
+
+static const Scenario scenarios[] =
+{
+	{ "plain", "no debugging aids", 0, 0, 0, NULL },
+	{ "wp1", "1 read/write watchpoint", 1, 0, 0, NULL },
+	{ "wp50", "50 read/write watchpoints", 50, 0, 0, NULL },
+	{ "bp50", "50 execute breakpoints elsewhere", 0, 50, 0, NULL },
+	{ "cond1", "1 conditional execute breakpoint", 0, 0, 1, NULL },
+	{ "cond10", "10 conditional execute breakpoints", 0, 0, 10, NULL },
+	{ "lua", "a Lua script without memory hooks", 0, 0, 0,
+		"emu.registerafter(function() end)\n" },
+	{ "luawrite", "a Lua write hook", 0, 0, 0,
+		"memory.registerwrite(0x07FF, function() end)\n" },
+	{ "luaexec", "a Lua execute hook", 0, 0, 0,
+		"memory.registerexec(0xFFF0, function() end)\n" },
+	{ "cdl", "the Code/Data Logger", 0, 0, 0, NULL, true },
+};
+
+static int frames = 600;
+
+static void CheckBreak();
+
+//the driver functions the core calls. the benchmark has no window, sound or input,
+//so most of them do nothing.
+static uint8 palette[256][3];
+
+FILE *FCEUD_UTF8fopen(const char *fn, const char *mode) { return fopen(fn, mode); }
+EMUFILE_FILE* FCEUD_UTF8_fstream(const char *n, const char *m) { return new EMUFILE_FILE(n, m); }
+FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord&, std::string&, int, int*) { return NULL; }
+FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord&, std::string&, std::string*, int*) { return NULL; }
+ArchiveScanRecord FCEUD_ScanArchive(std::string) { return ArchiveScanRecord(); }
+void FCEUD_SetPalette(uint8 i, uint8 r, uint8 g, uint8 b) { palette[i][0] = r; palette[i][1] = g; palette[i][2] = b; }
+void FCEUD_GetPalette(uint8 i, uint8 *r, uint8 *g, uint8 *b) { *r = palette[i][0]; *g = palette[i][1]; *b = palette[i][2]; }
+const char *FCEUD_GetCompilerString() { return __VERSION__; }
+void FCEUD_PrintError(const char *s) { fprintf(stderr, "%s\n", s); }
+void FCEUD_Message(const char *s) { }
+int FCEUD_SendData(void *data, uint32 len) { return 0; }
+int FCEUD_RecvData(void *data, uint32 len) { return 0; }
+void FCEUD_NetplayText(uint8 *text) { }
+void FCEUD_NetworkClose(void) { }
+void FCEUI_UseInputPreset(int preset) { }
+void FCEUD_SetInput(bool fourscore, bool microphone, ESI port0, ESI port1, ESIFC fcexp) { }
+void FCEUI_AviVideoUpdate(const unsigned char* buffer) { }
+bool FCEUI_AviIsRecording() { return false; }
+bool FCEUI_AviEnableHUDrecording() { return false; }
+bool FCEUI_AviDisableMovieMessages() { return false; }
+bool FCEUD_ShouldDrawInputAids() { return false; }
+bool FCEUD_PauseAfterPlayback() { return false; }
+void FCEUD_DebugBreakpoint(int bp_num) { CheckBreak(); }
+uint64 FCEUD_GetTime() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+uint64 FCEUD_GetTimeFreq() { return 1000000; }
+void FCEUD_SetEmulationSpeed(int cmd) { }
+int FCEUD_GetEmulationSpeed() { return 0; }
+void FCEUD_TurboOn() { }
+void FCEUD_TurboOff() { }
+void FCEUD_TurboToggle() { }
+void FCEUD_AviRecordTo() { }
+void FCEUD_AviStop() { }
+void FCEUD_HideMenuToggle() { }
+void FCEUD_LoadStateFrom() { }
+void FCEUD_SaveStateAs() { }
+void FCEUD_MovieRecordTo() { }
+void FCEUD_MovieReplayFrom() { }
+int FCEUD_ShowStatusIcon() { return 0; }
+void FCEUD_ToggleStatusIcon() { }
+void FCEUD_SoundToggle() { }
+void FCEUD_SoundVolumeAdjust(int n) { }
+void FCEUD_VideoChanged() { }
+void RefreshThrottleFPS() { }
+unsigned int *GetKeyboard(void) { static unsigned int keys[256]; return keys; }
+void GetMouseData(uint32 (&md)[3]) { md[0] = md[1] = md[2] = 0; }
+int KillFCEUXonFrame = 0;
+int closeFinishedMovie = 0;
+int dendy = 0;
+int pal_emulation = 0;
+bool swapDuty = false;
+bool turbo = false;
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] [scenario...]\n\n"
+		"  --rom file        run this game instead of the built-in loop\n"
+		"  --frames n        run n frames per scenario (default %d)\n"
+		"  --check           check that stepping back in the debugger replays exactly\n\n"
+		"Scenarios (default: all):\n",
+		prog, frames);
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+		fprintf(stderr, "  %-17s %s\n", scenarios[i].name, scenarios[i].description);
+}
+
+//writes a 16KB NROM image with the code at $C000, whose last byte is where NMIs and IRQs go.
+//tile 0 of the CHR ROM is solid, and so is the background when it's all tile 0.
+static bool WriteNROM(const char *fn, const uint8 *code, size_t size)
+{
+	static uint8 image[16 + 0x4000 + 0x2000];
+	memset(image, 0, sizeof(image));
+	memcpy(image, "NES\x1a\x01\x01", 6);
+	memcpy(image + 16, code, size);
+	uint8 *vectors = image + 16 + 0x3FFA;
+	vectors[0] = vectors[4] = size - 1;         //NMI and IRQ go to the last byte
+	vectors[1] = vectors[5] = 0xC0;
+	vectors[2] = 0x00;                          //reset goes to $C000
+	vectors[3] = 0xC0;
+	memset(image + 16 + 0x4000, 0xFF, 8);
+
+	FILE *fp = fopen(fn, "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(image, sizeof(image), 1, fp) == 1;
+	return !fclose(fp) && ok;
+}
+
+//without a game, the benchmark runs a 16KB NROM image which copies $0200-$02FF to $0300-$03FF over
+//and over with rendering and NMIs off, so nearly every instruction is a RAM read or write.
+static bool WriteLoopROM(const char *fn)
+{
+	static const uint8 code[] =
+	{
+		0x78,             //      SEI
+		0xD8,             //      CLD
+		0xA2, 0xFF,       //      LDX #$FF
+		0x9A,             //      TXS
+		0xA2, 0x00,       // loop LDX #$00
+		0xBD, 0x00, 0x02, // copy LDA $0200,X
+		0x9D, 0x00, 0x03, //      STA $0300,X
+		0xE8,             //      INX
+		0xD0, 0xF7,       //      BNE copy
+		0xE6, 0x00,       //      INC $00
+		0x4C, 0x05, 0xC0, //      JMP loop
+		0x40              // irq  RTI
+	};
+	return WriteNROM(fn, code, sizeof(code));
+}
+
+//the check runs a program which waits for the sprite 0 hit every frame and counts how long it took,
+//so that how many instructions a frame takes depends on when the hit comes.
+static bool WriteSprite0ROM(const char *fn)
+{
+	static const uint8 code[] =
+	{
+		0x78,             //      SEI
+		0xD8,             //      CLD
+		0xA2, 0xFF,       //      LDX #$FF
+		0x9A,             //      TXS
+		0x2C, 0x02, 0x20, // vbl1 BIT $2002
+		0x10, 0xFB,       //      BPL vbl1
+		0x2C, 0x02, 0x20, // vbl2 BIT $2002
+		0x10, 0xFB,       //      BPL vbl2
+		0xA9, 0x20,       //      LDA #$20
+		0x8D, 0x06, 0x20, //      STA $2006
+		0xA9, 0x00,       //      LDA #$00
+		0x8D, 0x06, 0x20, //      STA $2006
+		0xA0, 0x04,       //      LDY #$04
+		0xA2, 0x00,       //      LDX #$00
+		0x8D, 0x07, 0x20, // fill STA $2007
+		0xE8,             //      INX
+		0xD0, 0xFA,       //      BNE fill
+		0x88,             //      DEY
+		0xD0, 0xF7,       //      BNE fill
+		0xA9, 0x00,       //      LDA #$00
+		0x8D, 0x03, 0x20, //      STA $2003
+		0xA9, 0x64,       //      LDA #100
+		0x8D, 0x04, 0x20, //      STA $2004      sprite 0 at 100,100
+		0xA9, 0x00,       //      LDA #$00
+		0x8D, 0x04, 0x20, //      STA $2004      tile 0
+		0x8D, 0x04, 0x20, //      STA $2004
+		0xA9, 0x64,       //      LDA #100
+		0x8D, 0x04, 0x20, //      STA $2004
+		0xA9, 0x00,       //      LDA #$00
+		0x8D, 0x05, 0x20, //      STA $2005
+		0x8D, 0x05, 0x20, //      STA $2005
+		0x8D, 0x00, 0x20, //      STA $2000
+		0xA9, 0x18,       //      LDA #$18
+		0x8D, 0x01, 0x20, //      STA $2001      background and sprites on
+		0x2C, 0x02, 0x20, // clr  BIT $2002
+		0x70, 0xFB,       //      BVS clr
+		0xA2, 0x00,       //      LDX #$00
+		0xE8,             // hit  INX
+		0x2C, 0x02, 0x20, //      BIT $2002
+		0x50, 0xFA,       //      BVC hit
+		0x86, 0x01,       //      STX $01
+		0xE6, 0x00,       //      INC $00
+		0x4C, 0x4D, 0xC0, //      JMP clr
+		0x40              // irq  RTI
+	};
+	return WriteNROM(fn, code, sizeof(code));
+}
+
+//the logger's buffers, set up the way the drivers do it. they are freed before the game is
+//closed, so that trees which free them on close and trees which don't are timed alike.
+extern unsigned char *cdloggervdata;
+extern unsigned int cdloggerVideoDataSize;
+
+static void StartCDL()
+{
+	cdloggerdataSize = PRGsize[0];
+	cdloggerdata = (unsigned char*)calloc(cdloggerdataSize, 1);
+	cdloggerVideoDataSize = (!CHRram[0] || CHRptr[0] == PRGptr[0]) ? CHRsize[0] : 0;
+	cdloggervdata = (unsigned char*)calloc(cdloggerVideoDataSize ? cdloggerVideoDataSize : 8192, 1);
+	codecount = datacount = 0;
+	undefinedcount = cdloggerdataSize;
+	FCEUI_SetLoggingCD(1);
+}
+
+static void StopCDL()
+{
+	FCEUI_SetLoggingCD(0);
+	free(cdloggerdata);
+	free(cdloggervdata);
+	cdloggerdata = cdloggervdata = NULL;
+	cdloggerdataSize = cdloggerVideoDataSize = 0;
+}
+
+static bool SetUp(const Scenario &s, std::string &luaFile)
+{
+	for (int i = 0; i < s.watchpoints; i++)
+	{
+		//$0700-$07FF is the end of RAM, which the built-in loop leaves alone
+		NewBreak("", 0x0700 + i, -1, WP_R | WP_W, "", i, true);
+	}
+	int num = s.watchpoints;
+	for (int i = 0; i < s.breakpoints; i++, num++)
+	{
+		//the built-in loop runs from $C000 and $C100-$F2FF is empty
+		NewBreak("", 0xC100 + (i << 8), 0xC1FF + (i << 8), WP_X, "", num, true);
+	}
+	for (int i = 0; i < s.conditions; i++, num++)
+		NewBreak("", 0x8000, 0xFFFF, WP_X, "A == #FF && X == #FF && Y == #FF", num, true);
+	numWPs = num;
+
+	if (s.cdl)
+		StartCDL();
+
+	if (s.lua)
+	{
+		char name[] = "/tmp/fceux-bench-XXXXXX";
+		int fd = mkstemp(name);
+		if (fd == -1)
+			return false;
+		bool ok = write(fd, s.lua, strlen(s.lua)) == (ssize_t)strlen(s.lua);
+		close(fd);
+		luaFile = name;
+		if (!ok || !FCEU_LoadLuaCode(name))
+			return false;
+	}
+	return true;
+}
+
+static void TearDown(std::string &luaFile)
+{
+	if (!luaFile.empty())
+	{
+		FCEU_LuaStop();
+		unlink(luaFile.c_str());
+		luaFile.clear();
+	}
+	if (cdloggerdata)
+		StopCDL();
+	numWPs = 0;
+}
+
+//the check of the reverse debugger. a driver falling behind skips frames, and a skipped frame fakes
+//the sprite 0 hit, so a replay that doesn't skip the same frames takes a different number of instructions.
+extern uint8 *RAM;
+static const int checkFrames = 2400;
+static int checkStage = 0;
+static uint64 checkFrom;
+static uint8 checkRAM[0x800];
+static bool checkOK;
+
+//the debugger stops first at the instruction stepped back to, then one step later at the instruction
+//the step back was asked at, where the RAM has to be what it was then
+static void CheckBreak()
+{
+	if (checkStage == 1)
+	{
+		checkOK = total_instructions == checkFrom - 1;
+		FCEUI_Debugger().step = true;
+	} else if (checkStage == 2)
+		checkOK = checkOK && total_instructions == checkFrom && !memcmp(RAM, checkRAM, sizeof(checkRAM));
+	else
+		return;
+	checkStage++;
+	FCEUI_SetEmulationPaused(0);
+}
+
+static bool CheckReverse(const char *rom)
+{
+	if (!FCEUI_LoadGame(rom, 1, true))
+	{
+		fprintf(stderr, "Can't load %s\n", rom);
+		return false;
+	}
+
+	//little enough memory for the snapshots to thin out, so that stepping back replays frames
+	FCEUI_SetReverseDebugging(true);
+	FCEUI_SetReverseDebuggingMemory(1);
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+	for (int i = 0; i < checkFrames; i++)
+		FCEUI_Emulate(&gfx, &sound, &ssize, i % 3 == 1);
+
+	FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED);
+	checkFrom = total_instructions;
+	memcpy(checkRAM, RAM, sizeof(checkRAM));
+	checkStage = 1;
+	checkOK = false;
+	bool ok = FCEUI_ReverseDebug(REVERSE_OP_STEP);
+	if (ok)
+	{
+		FCEUI_SetEmulationPaused(0);
+		for (int i = 0; i < 2; i++)
+			FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		ok = checkStage == 3 && checkOK;
+	}
+	checkStage = 0;
+	printf("%-10s %s\n", "reverse", ok ? "ok" : "FAILED");
+
+	FCEUI_SetReverseDebugging(false);
+	FCEUI_CloseGame();
+	return ok;
+}
+
+static bool Run(const char *rom, const Scenario &s)
+{
+	if (!FCEUI_LoadGame(rom, 1, true))
+	{
+		fprintf(stderr, "Can't load %s\n", rom);
+		return false;
+	}
+
+	std::string luaFile;
+	bool ok = SetUp(s, luaFile);
+	if (ok)
+	{
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+		//a second of warm-up, so that the caches and the branch predictor are past the game's start
+		for (int i = 0; i < 60; i++)
+			FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; i++)
+			FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+		printf("%-10s %8.1f us/frame  (%s)\n", s.name, took.count() / frames, s.description);
+	} else
+		fprintf(stderr, "Can't set up %s\n", s.name);
+
+	TearDown(luaFile);
+	FCEUI_CloseGame();
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *rom = NULL;
+	const int count = sizeof(scenarios) / sizeof(scenarios[0]);
+	bool wanted[count], all = true, check = false;
+	memset(wanted, 0, sizeof(wanted));
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *param = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = true;
+		if (!strcmp(arg, "--rom") && param)
+			rom = argv[++i];
+		else if (!strcmp(arg, "--frames") && param)
+			ok = (frames = atoi(argv[++i])) > 0;
+		else if (!strcmp(arg, "--check"))
+			check = true;
+		else
+		{
+			ok = false;
+			for (int j = 0; j < count; j++)
+			{
+				if (!strcmp(arg, scenarios[j].name))
+					ok = wanted[j] = true;
+			}
+			all = false;
+		}
+		if (!ok)
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	char loopROM[] = "/tmp/fceux-bench-XXXXXX";
+	if (!rom || check)
+	{
+		int fd = mkstemp(loopROM);
+		if (fd == -1 || close(fd) || !(check ? WriteSprite0ROM(loopROM) : WriteLoopROM(loopROM)))
+		{
+			fprintf(stderr, "Can't write the test program to %s\n", loopROM);
+			return 1;
+		}
+		rom = loopROM;
+	}
+
+	int result = 0;
+	if (!FCEUI_Initialize())
+	{
+		fprintf(stderr, "Can't initialize the emulator\n");
+		result = 1;
+	} else
+	{
+		FCEUI_Sound(0);
+		if (check)
+			result = !CheckReverse(rom);
+		else
+		{
+			for (int i = 0; i < count; i++)
+			{
+				if ((all || wanted[i]) && !Run(rom, scenarios[i]))
+					result = 1;
+			}
+		}
+		FCEUI_Kill();
+	}
+
+	if (rom == loopROM)
+		unlink(loopROM);
+	return result;
+}
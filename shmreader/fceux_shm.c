@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "fceux_shm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct fceux_shm
+{
+    void *mem;
+    size_t size;
+    const struct FCEUShmHeader *header;
+    const struct FCEUShmFrame *slots;
+};
+
+fceux_shm *fceux_shm_open(const char *name)
+{
+    struct stat st;
+    fceux_shm *shm;
+    void *mem;
+    const struct FCEUShmHeader *h;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct FCEUShmHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return NULL;
+
+    h = (const struct FCEUShmHeader *)mem;
+    if (memcmp(h->magic, FCEU_SHM_MAGIC, sizeof(h->magic)) != 0
+        || h->version != FCEU_SHM_VERSION
+        || h->slotSize != sizeof(struct FCEUShmFrame)
+        || h->slots != FCEU_SHM_SLOTS
+        || (size_t)h->headerSize + (size_t)h->slots * h->slotSize > (size_t)st.st_size)
+    {
+        munmap(mem, st.st_size);
+        return NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    shm = (fceux_shm *)malloc(sizeof(*shm));
+    if (!shm)
+    {
+        munmap(mem, st.st_size);
+        return NULL;
+    }
+    shm->mem = mem;
+    shm->size = st.st_size;
+    shm->header = h;
+    shm->slots = (const struct FCEUShmFrame *)((const char *)mem + h->headerSize);
+    return shm;
+}
+
+void fceux_shm_close(fceux_shm *shm)
+{
+    if (!shm)
+        return;
+    munmap(shm->mem, shm->size);
+    free(shm);
+}
+
+const struct FCEUShmFrame *fceux_shm_latest(fceux_shm *shm, uint32_t *seq)
+{
+    for (;;)
+    {
+        const struct FCEUShmFrame *f;
+        uint32_t s;
+        if (!__atomic_load_n(&shm->header->published, __ATOMIC_ACQUIRE))
+            return NULL;
+        f = &shm->slots[__atomic_load_n(&shm->header->latest, __ATOMIC_ACQUIRE) % FCEU_SHM_SLOTS];
+        s = __atomic_load_n(&f->seq, __ATOMIC_ACQUIRE);
+        /* odd: the emulator got around to this slot again and is writing it */
+        if (!(s & 1))
+        {
+            *seq = s;
+            return f;
+        }
+    }
+}
+
+int fceux_shm_valid(const struct FCEUShmFrame *frame, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&frame->seq, __ATOMIC_RELAXED) == seq;
+}
+
+int fceux_shm_copy(fceux_shm *shm, struct FCEUShmFrame *dest)
+{
+    for (;;)
+    {
+        uint32_t seq;
+        const struct FCEUShmFrame *f = fceux_shm_latest(shm, &seq);
+        if (!f)
+            return 0;
+        memcpy(dest, (const void *)f, sizeof(*dest));
+        if (fceux_shm_valid(f, seq))
+            return 1;
+    }
+}
+
+uint32_t fceux_shm_published(fceux_shm *shm)
+{
+    return __atomic_load_n(&shm->header->published, __ATOMIC_ACQUIRE);
+}
+
+int fceux_shm_closed(fceux_shm *shm)
+{
+    return __atomic_load_n(&shm->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FCEUX_SHM_H
+#define FCEUX_SHM_H
+
+/* Reader of the game state FCEUX publishes in shared memory (--shmexport).
+ * The frames are read where the emulator writes them: take the latest one,
+ * read from it what you need, then check that it's still valid. The
+ * emulator writes the other slot in the meantime, so a reader that takes
+ * less than a frame to look at one practically never has to retry. */
+
+#include <stdint.h>
+#include "../src/shmexport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fceux_shm fceux_shm;
+
+/* Maps the shared memory object; NULL if there is none or it isn't an
+ * export of this version */
+fceux_shm *fceux_shm_open(const char *name);
+void fceux_shm_close(fceux_shm *shm);
+
+/* The frame published last and its sequence number, or NULL before the
+ * first one */
+const struct FCEUShmFrame *fceux_shm_latest(fceux_shm *shm, uint32_t *seq);
+/* Whether what was read from the frame since fceux_shm_latest() is
+ * consistent, i.e. the frame wasn't written in the meantime */
+int fceux_shm_valid(const struct FCEUShmFrame *frame, uint32_t seq);
+/* Copies the latest frame; 0 when there is none yet */
+int fceux_shm_copy(fceux_shm *shm, struct FCEUShmFrame *dest);
+
+/* Goes up with each frame published; poll it to wait for a new one */
+uint32_t fceux_shm_published(fceux_shm *shm);
+/* Whether the emulator stopped exporting */
+int fceux_shm_closed(fceux_shm *shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
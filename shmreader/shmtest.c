@@ -0,0 +1,134 @@
+/* Test reader: follows the frames FCEUX exports and prints a line for each,
+ * with the frame counter, the PPU scroll and the first bytes of RAM. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "fceux_shm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Nap(void)
+{
+    struct timespec ts = { 0, 500000 };
+    nanosleep(&ts, NULL);
+}
+
+/* The picture as a PPM with the exported palette */
+static int WritePPM(const char *fn, const struct FCEUShmFrame *f)
+{
+    FILE *fp = fopen(fn, "wb");
+    unsigned y, x;
+    if (!fp)
+        return 0;
+    fprintf(fp, "P6\n256 %u\n255\n", f->lastLine - f->firstLine + 1);
+    for (y = f->firstLine; y <= f->lastLine; y++)
+        for (x = 0; x < 256; x++)
+        {
+            uint32_t c = f->palette[(f->deemph[y][x] & 7) << 8 | f->pixels[y][x]];
+            unsigned char rgb[3] = { (unsigned char)(c >> 16), (unsigned char)(c >> 8), (unsigned char)c };
+            fwrite(rgb, 1, 3, fp);
+        }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = NULL, *ppm = NULL;
+    long frames = 0, seen = 0, missed = 0, retries = 0;
+    double readtime = 0;
+    uint32_t last = 0;
+    fceux_shm *shm;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            frames = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-ppm") && i + 1 < argc)
+            ppm = argv[++i];
+        else if (argv[i][0] != '-' && !name)
+            name = argv[i];
+        else
+        {
+            name = NULL;
+            break;
+        }
+    }
+    if (!name)
+    {
+        fprintf(stderr, "usage: %s [-n frames] [-ppm file] name\n"
+                        "  -n frames   stop after that many frames\n"
+                        "  -ppm file   write the last picture to file\n", argv[0]);
+        return 1;
+    }
+
+    shm = fceux_shm_open(name);
+    if (!shm)
+    {
+        fprintf(stderr, "%s: no FCEUX export there\n", name);
+        return 1;
+    }
+
+    while (!frames || seen < frames)
+    {
+        uint32_t published = fceux_shm_published(shm), seq;
+        const struct FCEUShmFrame *f;
+        double t0;
+        unsigned frame, v, ctrl, fineX;
+        unsigned char ram[16];
+
+        if (published == last)
+        {
+            if (fceux_shm_closed(shm))
+                break;
+            Nap();
+            continue;
+        }
+        if (last && published - last > 1)
+            missed += published - last - 1;
+        last = published;
+
+        /* read in place, then check */
+        t0 = Now();
+        for (;;)
+        {
+            f = fceux_shm_latest(shm, &seq);
+            frame = f->frame;
+            v = f->ppuV;
+            ctrl = f->ppuCtrl;
+            fineX = f->fineX;
+            memcpy(ram, f->ram, sizeof(ram));
+            if (fceux_shm_valid(f, seq))
+                break;
+            retries++;
+        }
+        readtime += Now() - t0;
+        seen++;
+
+        printf("frame %u  ctrl %02X  v %04X  x %u  ram", frame, ctrl, v, fineX);
+        for (i = 0; i < 16; i++)
+            printf(" %02X", ram[i]);
+        printf("\n");
+    }
+
+    if (ppm)
+    {
+        static struct FCEUShmFrame copy;
+        if (!fceux_shm_copy(shm, &copy) || !WritePPM(ppm, &copy))
+            fprintf(stderr, "couldn't write %s\n", ppm);
+    }
+    fprintf(stderr, "%ld frames, %ld missed, %ld retries, %.2f us per read\n",
+        seen, missed, retries, seen ? readtime / seen * 1e6 : 0.0);
+    fceux_shm_close(shm);
+    return 0;
+}
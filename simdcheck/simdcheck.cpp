@@ -0,0 +1,302 @@
+/* fceux-simdcheck - checks the SIMD versions of the video filters against the plain code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "types.h"
+#include "git.h"
+#include "palette.h"
+#include "drivers/common/simd.h"
+#include "drivers/common/scalebit.h"
+#include "drivers/common/hq2x.h"
+#include "drivers/common/hq3x.h"
+#include "drivers/common/vidblit.h"
+#include "drivers/videolog/rgbtorgb.h"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//each test runs over the same pictures every time, and prints a checksum of what it made; whichever
+//SIMD code ran, the checksums have to be those of golden.txt, which the plain code gave
+
+//what the blitter reads of the emulator: the picture, its deemphasis and the palette
+uint8 *XBuf, *XDBuf;
+pal *palo;
+FCEUGI *GameInfo;
+
+void *FCEU_dmalloc(uint32 size)
+{
+	return calloc(size, 1);
+}
+
+static uint32 rngState;
+
+static uint32 Random()
+{
+	rngState = rngState * 1103515245 + 12345;
+	return rngState >> 8;
+}
+
+static uint32 Checksum(const std::vector<uint8> &data)
+{
+	uint32 hash = 2166136261u;   //FNV-1a
+	for (size_t i = 0; i < data.size(); i++)
+		hash = (hash ^ data[i]) * 16777619u;
+	return hash;
+}
+
+//a picture of width*height pixels of the given size, with few colors in blocks and lines, so that
+//the filters find neighbours that are equal as often as ones that aren't
+static std::vector<uint8> MakePicture(int width, int height, int pixel, uint32 seed)
+{
+	uint32 colors[6];
+	std::vector<uint8> picture(width * height * pixel);
+
+	rngState = seed;
+	for (int i = 0; i < 6; i++)
+		colors[i] = Random() * 2654435761u;
+	for (int y = 0; y < height; y++)
+	{
+		uint32 c = colors[Random() % 6];
+		for (int x = 0; x < width; x++)
+		{
+			if (Random() % 4 == 0)
+				c = colors[Random() % 6];
+			memcpy(&picture[(y * width + x) * pixel], &c, pixel);
+		}
+	}
+	return picture;
+}
+
+struct Size
+{
+	int width, height;
+};
+
+//a whole picture, one a little narrower than the vectors divide, and small ones around the
+//lengths where the filters leave the row to the plain code
+static const Size sizes[] = { { 256, 240 }, { 253, 17 }, { 37, 9 }, { 17, 5 }, { 9, 4 }, { 5, 4 } };
+//the same for the YUV converters, which take 2x2 pixels at a time
+static const Size evenSizes[] = { { 256, 240 }, { 254, 18 }, { 38, 10 }, { 18, 6 }, { 10, 4 }, { 6, 2 } };
+
+typedef void (*TestFunc)(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height);
+
+template<int Scale, int Pixel>
+static void TestScale(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * Pixel * Scale * Scale);
+	scale(Scale, &dest[0], width * Pixel * Scale, &src[0], width * Pixel, Pixel, width, height);
+}
+
+static void TestHq2x(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * 4 * 4);
+	hq2x_32((uint8 *)&src[0], &dest[0], width, height, width * 2 * 4);
+}
+
+static void TestHq3x(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * 4 * 9);
+	hq3x_32((uint8 *)&src[0], &dest[0], width, height, width * 3 * 4);
+}
+
+//the picture is pairs of the palette index and the deemphasis bits; the blitter reads them
+//from XBuf and XDBuf, with rows of 256 pixels
+template<int Bpp, int Scale>
+static void TestBlit(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	static uint8 xbuf[256 * 256], xdbuf[256 * 256];
+	static pal colors[512];
+	static int bpp;
+
+	if (bpp != Bpp)
+	{
+		uint8 palette[256 * 4];
+		rngState = 42;
+		for (int i = 0; i < 256 * 4; i++)
+			palette[i] = Random();
+		for (int i = 0; i < 512; i++)
+		{
+			colors[i].r = Random();
+			colors[i].g = Random();
+			colors[i].b = Random();
+		}
+		XBuf = xbuf;
+		XDBuf = xdbuf;
+		palo = colors;
+		if (bpp)
+			KillBlitToHigh();
+		if (Bpp == 2)
+			InitBlitToHigh(2, 0xF800, 0x7E0, 0x1F, 0, 0, 0);
+		else
+			InitBlitToHigh(Bpp, 0xFF0000, 0xFF00, 0xFF, 0, 0, 0);
+		SetPaletteBlitToHigh(palette);
+		bpp = Bpp;
+	}
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			xbuf[y * 256 + x] = src[(y * width + x) * 2];
+			xdbuf[y * 256 + x] = src[(y * width + x) * 2 + 1] & 7;
+		}
+	dest.resize(width * height * Bpp * Scale * Scale);
+	Blit8ToHigh(xbuf, &dest[0], width, height, width * Bpp * Scale, Scale, Scale);
+}
+
+static void TestRGB32To24(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * 3);
+	Convert32To24Frame(&src[0], &dest[0], width * height);
+}
+
+template<int Bpp>
+static void TestRGBToI420(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * 3 / 2);
+	if (Bpp == 4)
+		Convert32To_I420Frame(&src[0], &dest[0], width * height, width);
+	else
+		Convert24To_I420Frame(&src[0], &dest[0], width * height, width);
+}
+
+template<int Bpp>
+static void TestRGBToYUY2(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	dest.resize(width * height * 2);
+	if (Bpp == 4)
+		Convert32To_YUY2Frame(&src[0], &dest[0], width * height, width);
+	else
+		Convert24To_YUY2Frame(&src[0], &dest[0], width * height, width);
+}
+
+//pairs of the palette index and the deemphasis bits, as for the blitter
+static void TestNESToI420(const std::vector<uint8> &src, std::vector<uint8> &dest, int width, int height)
+{
+	static uint8 palette[2048 * 4];
+	const int npixels = width * height;
+	std::vector<uint8> pixels(npixels), deemph(npixels);
+
+	rngState = 7;
+	for (int i = 0; i < 2048 * 4; i++)
+		palette[i] = Random();
+	for (int i = 0; i < npixels; i++)
+	{
+		pixels[i] = src[i * 2];
+		deemph[i] = src[i * 2 + 1] & 7;
+	}
+	dest.resize(npixels * 3 / 2);
+	ConvertNESTo_I420Frame(&pixels[0], &deemph[0], palette, &dest[0], npixels, width);
+}
+
+struct Test
+{
+	const char *name;
+	int pixel;   //the size of a source pixel
+	TestFunc func;
+	bool even;   //only even sizes
+};
+
+static const Test tests[] = {
+	{ "scale2x-8", 1, TestScale<2, 1> },
+	{ "scale2x-16", 2, TestScale<2, 2> },
+	{ "scale2x-32", 4, TestScale<2, 4> },
+	{ "scale3x-8", 1, TestScale<3, 1> },
+	{ "scale3x-16", 2, TestScale<3, 2> },
+	{ "scale3x-32", 4, TestScale<3, 4> },
+	{ "scale4x-32", 4, TestScale<4, 4> },
+	{ "hq2x", 2, TestHq2x },
+	{ "hq3x", 2, TestHq3x },
+	{ "blit-16", 2, TestBlit<2, 1> },
+	{ "blit-24", 2, TestBlit<3, 1> },
+	{ "blit-32", 2, TestBlit<4, 1> },
+	{ "blit-32x2", 2, TestBlit<4, 2> },
+	{ "rgb32-24", 4, TestRGB32To24 },
+	{ "rgb32-i420", 4, TestRGBToI420<4>, true },
+	{ "rgb24-i420", 3, TestRGBToI420<3>, true },
+	{ "rgb32-yuy2", 4, TestRGBToYUY2<4>, true },
+	{ "rgb24-yuy2", 3, TestRGBToYUY2<3>, true },
+	{ "nes-i420", 2, TestNESToI420, true },
+};
+
+static const char *simdNames[] = { "none", "sse2", "sse4.1", "avx2" };
+
+static void ShowUsage()
+{
+	printf("usage: fceux-simdcheck [--bench [name]]\n"
+		"  prints the checksums of what the filters make of the test pictures, or with --bench\n"
+		"  the time they take on a 256x240 picture; FCEUX_SIMD=none|sse2|sse4.1|avx2 caps the\n"
+		"  SIMD code they use\n");
+}
+
+int main(int argc, char *argv[])
+{
+	bool bench = false;
+	const char *only = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--bench"))
+			bench = true;
+		else if (bench && !only && argv[i][0] != '-')
+			only = argv[i];
+		else
+		{
+			ShowUsage();
+			return 1;
+		}
+	}
+
+	hq2x_InitLUTs();
+	hq3x_InitLUTs();
+
+	std::vector<uint8> dest;
+	if (bench)
+	{
+		printf("SIMD: %s\n", simdNames[SimdLevel()]);
+		for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++)
+		{
+			if (only && strcmp(only, tests[t].name))
+				continue;
+			std::vector<uint8> src = MakePicture(256, 240, tests[t].pixel, 1);
+			const int runs = 200;
+			tests[t].func(src, dest, 256, 240);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int run = 0; run < runs; run++)
+				tests[t].func(src, dest, 256, 240);
+			std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+			printf("%-12s %8.1f us\n", tests[t].name, took.count() / runs);
+		}
+		return 0;
+	}
+
+	for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++)
+	{
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+		{
+			const Size &size = tests[t].even ? evenSizes[s] : sizes[s];
+			std::vector<uint8> src = MakePicture(size.width, size.height, tests[t].pixel, (uint32)(t * 100 + s));
+			tests[t].func(src, dest, size.width, size.height);
+			printf("%s %dx%d %08X\n", tests[t].name, size.width, size.height, Checksum(dest));
+		}
+	}
+
+	hq2x_Kill();
+	hq3x_Kill();
+	return 0;
+}
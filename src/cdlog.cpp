@@ -0,0 +1,283 @@
+/// \file
+/// \brief Code/Data Logger buffers, statistics and files
+///
+/// Long logging sessions save their .cdl as they go: every so often the emulation thread copies
+/// the log, and a writer thread writes just the blocks that changed since the last time.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "cart.h"
+#include "debug.h"
+#include "cdlog.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CDLOG_WRITE_BLOCK 4096 //granularity of the incremental writes
+
+uint32 *cdlogBankCode = NULL, *cdlogBankData = NULL;
+int cdlogBanks = 0;
+
+static FILE *autosaveFile = NULL;
+static int autosaveInterval;    //frames
+static int autosaveCountdown;
+static std::thread autosaveWriter;
+static std::mutex autosaveMutex;
+static std::condition_variable autosaveWake;
+static std::vector<uint8> autosaveStaging;  //copy of the log for the writer; guarded by autosaveMutex
+static bool autosavePending = false;         //guarded by autosaveMutex
+static bool autosaveStop = false;            //guarded by autosaveMutex
+static std::vector<uint8> autosaveWritten;  //what the file holds; owned by the writer while it runs
+static bool autosaveWriteFailed;
+
+//recounts the bank statistics from the log
+static void CountBanks()
+{
+	for (int i = 0; i < cdlogBanks; i++)
+		cdlogBankCode[i] = cdlogBankData[i] = 0;
+	for (unsigned int i = 0; i < cdloggerdataSize; i++)
+	{
+		if (cdloggerdata[i] & 1)
+			cdlogBankCode[i >> CDLOG_BANK_SHIFT]++;
+		if (cdloggerdata[i] & 2)
+			cdlogBankData[i >> CDLOG_BANK_SHIFT]++;
+	}
+}
+
+void FCEU_CDLogInit()
+{
+	FCEU_CDLogFree();
+
+	cdloggerdataSize = PRGsize[0];
+	cdloggerdata = (unsigned char*)malloc(cdloggerdataSize);
+	if(!CHRram[0] || (CHRptr[0] == PRGptr[0])) {	// Some kind of workaround for my OneBus VRAM hack, will remove it if I find another solution for that
+		cdloggerVideoDataSize = CHRsize[0];
+		cdloggervdata = (unsigned char*)malloc(cdloggerVideoDataSize);
+	} else {
+		if (GameInfo->type != GIT_NSF) {
+			cdloggerVideoDataSize = 0;
+			cdloggervdata = (unsigned char*)malloc(8192);
+		}
+	}
+
+	cdlogBanks = (cdloggerdataSize + (1 << CDLOG_BANK_SHIFT) - 1) >> CDLOG_BANK_SHIFT;
+	cdlogBankCode = (uint32*)malloc(cdlogBanks * sizeof(uint32));
+	cdlogBankData = (uint32*)malloc(cdlogBanks * sizeof(uint32));
+}
+
+void FCEU_CDLogFree()
+{
+	FCEUI_CDLogEndAutoSave();
+
+	if (cdloggerdata)
+	{
+		free(cdloggerdata);
+		cdloggerdata = NULL;
+		cdloggerdataSize = 0;
+	}
+	if (cdloggervdata)
+	{
+		free(cdloggervdata);
+		cdloggervdata = NULL;
+		cdloggerVideoDataSize = 0;
+	}
+	if (cdlogBanks)
+	{
+		free(cdlogBankCode);
+		free(cdlogBankData);
+		cdlogBankCode = cdlogBankData = NULL;
+		cdlogBanks = 0;
+	}
+}
+
+void FCEU_CDLogReset()
+{
+	codecount = datacount = rendercount = vromreadcount = 0;
+	undefinedcount = cdloggerdataSize;
+	memset(cdloggerdata, 0, cdloggerdataSize);
+	if(cdloggerVideoDataSize != 0) {
+		undefinedvromcount = cdloggerVideoDataSize;
+		memset(cdloggervdata, 0, cdloggerVideoDataSize);
+	} else {
+		if (GameInfo->type != GIT_NSF) {
+			undefinedvromcount = 8192;
+			memset(cdloggervdata, 0, 8192);
+		}
+	}
+	CountBanks();
+}
+
+bool FCEU_CDLogLoad(const char *fn)
+{
+	FILE *FP;
+	int i,j;
+
+	FP = fopen(fn, "rb");
+	if (FP == NULL)
+		return false;
+
+	for(i = 0;i < (int)cdloggerdataSize;i++)
+	{
+		j = fgetc(FP);
+		if (j == EOF)
+			break;
+		if ((j & 1) && !(cdloggerdata[i] & 1))
+			codecount++; //if the new byte has something logged and
+		if ((j & 2) && !(cdloggerdata[i] & 2))
+			datacount++; //and the old one doesn't. Then increment
+		if ((j & 3) && !(cdloggerdata[i] & 3))
+			undefinedcount--; //the appropriate counter.
+		cdloggerdata[i] |= j;
+	}
+
+	if(cdloggerVideoDataSize != 0)
+	{
+		for(i = 0;i < (int)cdloggerVideoDataSize;i++)
+		{
+			j = fgetc(FP);
+			if(j == EOF)break;
+			if((j & 1) && !(cdloggervdata[i] & 1))rendercount++; //if the new byte has something logged and
+			if((j & 2) && !(cdloggervdata[i] & 2))vromreadcount++; //if the new byte has something logged and
+			if((j & 3) && !(cdloggervdata[i] & 3))undefinedvromcount--; //the appropriate counter.
+			cdloggervdata[i] |= j;
+		}
+	}
+
+	fclose(FP);
+	CountBanks();
+	return true;
+}
+
+bool FCEU_CDLogSave(const char *fn)
+{
+	FILE *FP;
+	FP = fopen(fn, "wb");
+	if (FP == NULL)
+		return false;
+	bool ok = fwrite(cdloggerdata, cdloggerdataSize, 1, FP) == 1;
+	if(cdloggerVideoDataSize != 0)
+		ok = ok && fwrite(cdloggervdata, cdloggerVideoDataSize, 1, FP) == 1;
+	return (fclose(FP) == 0) && ok;
+}
+
+int FCEUI_CDLogBankCount()
+{
+	return cdlogBanks;
+}
+
+void FCEUI_CDLogGetBank(int bank, uint32 *code, uint32 *data)
+{
+	*code = cdlogBankCode[bank];
+	*data = cdlogBankData[bank];
+}
+
+//the log as it is laid out in a .cdl file
+static void CopyLog(std::vector<uint8> &dst)
+{
+	dst.resize(cdloggerdataSize + cdloggerVideoDataSize);
+	memcpy(&dst[0], cdloggerdata, cdloggerdataSize);
+	if (cdloggerVideoDataSize)
+		memcpy(&dst[cdloggerdataSize], cdloggervdata, cdloggerVideoDataSize);
+}
+
+static void WriteChangedBlocks(const std::vector<uint8> &log)
+{
+	bool wrote = false;
+	for (size_t pos = 0; pos < log.size(); pos += CDLOG_WRITE_BLOCK)
+	{
+		const size_t len = (log.size() - pos < CDLOG_WRITE_BLOCK) ? log.size() - pos : CDLOG_WRITE_BLOCK;
+		if (!memcmp(&log[pos], &autosaveWritten[pos], len))
+			continue;
+		if (fseek(autosaveFile, pos, SEEK_SET) != 0 || fwrite(&log[pos], 1, len, autosaveFile) != len)
+			autosaveWriteFailed = true;
+		memcpy(&autosaveWritten[pos], &log[pos], len);
+		wrote = true;
+	}
+	if (wrote && fflush(autosaveFile) != 0)
+		autosaveWriteFailed = true;
+}
+
+static void AutoSaveWriterProc()
+{
+	std::vector<uint8> log;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(autosaveMutex);
+			while (!autosavePending && !autosaveStop)
+				autosaveWake.wait(lock);
+			if (!autosavePending)
+				break;
+			log.swap(autosaveStaging);
+			autosavePending = false;
+		}
+		WriteChangedBlocks(log);
+	}
+}
+
+//hands a copy of the log to the writer, unless it hasn't picked up the previous one yet
+static void QueueAutoSave(bool stop)
+{
+	std::lock_guard<std::mutex> lock(autosaveMutex);
+	if (!autosavePending || stop)
+	{
+		CopyLog(autosaveStaging);
+		autosavePending = true;
+	}
+	autosaveStop = stop;
+	autosaveWake.notify_one();
+}
+
+void FCEU_CDLogFrame()
+{
+	if (!autosaveFile || --autosaveCountdown > 0)
+		return;
+	autosaveCountdown = autosaveInterval;
+	QueueAutoSave(false);
+}
+
+bool FCEUI_CDLogBeginAutoSave(const char *fn, int seconds)
+{
+	FCEUI_CDLogEndAutoSave();
+	if (!cdloggerdata)
+		return false;
+
+	autosaveFile = fopen(fn, "wb");
+	if (!autosaveFile)
+		return false;
+
+	//the whole log is written right away, the file has everything from then on
+	CopyLog(autosaveWritten);
+	autosaveWriteFailed = fwrite(&autosaveWritten[0], 1, autosaveWritten.size(), autosaveFile) != autosaveWritten.size()
+		|| fflush(autosaveFile) != 0;
+
+	autosaveInterval = autosaveCountdown = seconds * (FCEUI_GetDesiredFPS() >> 24);
+	autosavePending = autosaveStop = false;
+	autosaveWriter = std::thread(AutoSaveWriterProc);
+	return true;
+}
+
+void FCEUI_CDLogEndAutoSave()
+{
+	if (!autosaveFile)
+		return;
+
+	//the writer saves what changed since its last write before it exits
+	QueueAutoSave(true);
+	autosaveWriter.join();
+
+	if (fclose(autosaveFile) != 0)
+		autosaveWriteFailed = true;
+	autosaveFile = NULL;
+	std::vector<uint8>().swap(autosaveWritten);
+	std::vector<uint8>().swap(autosaveStaging);
+
+	if (autosaveWriteFailed)
+		FCEU_PrintError("Error writing the code/data log; the file is incomplete.");
+}
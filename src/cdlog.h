@@ -0,0 +1,46 @@
+#ifndef _CDLOG_H_
+#define _CDLOG_H_
+
+#include "types.h"
+
+//Code/Data Logger buffers and files. The logging itself is done by the debugger (LogCDData),
+//the PPU and the DPCM channel; this keeps the log, its statistics and the .cdl file.
+
+#define CDLOG_BANK_SHIFT 14 //coverage is counted per 16KB of PRG, the chunks getBank() reports
+
+extern volatile int rendercount, vromreadcount, undefinedvromcount;
+extern unsigned char *cdloggervdata;
+extern unsigned int cdloggerVideoDataSize;
+
+extern uint32 *cdlogBankCode, *cdlogBankData;
+extern int cdlogBanks;
+
+//called when a PRG byte is logged as code or as data for the first time
+static INLINE void FCEU_CDLogCountCode(int prgAddress)
+{
+	if ((prgAddress >> CDLOG_BANK_SHIFT) < cdlogBanks)
+		cdlogBankCode[prgAddress >> CDLOG_BANK_SHIFT]++;
+}
+static INLINE void FCEU_CDLogCountData(int prgAddress)
+{
+	if ((prgAddress >> CDLOG_BANK_SHIFT) < cdlogBanks)
+		cdlogBankData[prgAddress >> CDLOG_BANK_SHIFT]++;
+}
+
+void FCEU_CDLogInit();
+void FCEU_CDLogFree();
+void FCEU_CDLogReset();
+//merges a .cdl file into the log
+bool FCEU_CDLogLoad(const char *fn);
+bool FCEU_CDLogSave(const char *fn);
+//called once per frame
+void FCEU_CDLogFrame();
+
+int FCEUI_CDLogBankCount();
+void FCEUI_CDLogGetBank(int bank, uint32 *code, uint32 *data);
+
+//writes the log to fn now, then every so many seconds of emulation, only the parts that changed
+bool FCEUI_CDLogBeginAutoSave(const char *fn, int seconds);
+void FCEUI_CDLogEndAutoSave();
+
+#endif
@@ -33,10 +33,12 @@
 #include <cstring>
 #include <cstdio>
 #include <cctype>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
-static uint8 *CheatRPtrs[64];
+uint8 *CheatRPtrs[64];
 
 vector<uint16> FrozenAddresses;			//List of addresses that are currently frozen
 unsigned int FrozenAddressCount = 0;		//Keeps up with the Frozen address count, necessary for using in other dialogs (such as hex editor)
@@ -59,88 +61,121 @@ void FCEU_CheatAddRAM(int s, uint32 A, uint8 *p)
 }
 
 
-CHEATF_SUBFAST SubCheats[256] = { 0 };
-uint32 numsubcheats = 0;
+//the active cheats, sorted by address, spliced in under the watchpoints and Lua hooks.
+//freezes ("replace" cheats) are substitutions too, so that the game never sees anything else,
+//and are also written to RAM every frame for everything that reads it directly
+static vector<CHEATF_SUBFAST> SubCheats;
 int globalCheatDisabled = 0;
 int disableAutoLSCheats = 0;
 static _8BYTECHEATMAP* cheatMap = NULL;
 struct CHEATF *cheats = 0, *cheatsl = 0;
 
-
-#define CHEATC_NONE     0x8000
-#define CHEATC_EXCLUDED 0x4000
-#define CHEATC_NOSHOW   0xC000
-
-static uint16 *CheatComp = 0;
 int savecheats = 0;
 
+static bool SubCheatLess(const CHEATF_SUBFAST &a, const CHEATF_SUBFAST &b)
+{
+	return a.addr < b.addr;
+}
+
 static DECLFR(SubCheatsRead)
 {
-	CHEATF_SUBFAST *s = SubCheats;
-	int x=numsubcheats;
+	size_t lo = 0, hi = SubCheats.size();
+	while(lo < hi)
+	{
+		size_t mid = (lo + hi) >> 1;
+		if(SubCheats[mid].addr < A)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if(lo == SubCheats.size() || SubCheats[lo].addr != A)
+		return(0);	/* We should never get here. */
 
-	do
+	const CHEATF_SUBFAST *s = &SubCheats[lo];
+	if(s->freeze && geniestage == 1)
+		return(FCEU_SpliceReadNext(SPLICE_CHEAT, A));	/* Freezes were never applied on the Game Genie screen. */
+	if(s->compare>=0)
 	{
-		if(s->addr==A)
-		{
-			if(s->compare>=0)
-			{
-				uint8 pv=s->PrevRead(A);
+		uint8 pv=FCEU_SpliceReadNext(SPLICE_CHEAT, A);
 
-				if(pv==s->compare)
-					return(s->val);
-				else return(pv);
-			}
-			else return(s->val);
-		}
-		s++;
-	} while(--x);
-	return(0);	/* We should never get here. */
+		if(pv==s->compare)
+			return(s->val);
+		else return(pv);
+	}
+	else return(s->val);
+}
+
+//takes the cheats out without leaving anything behind in RAM, for when the cheat list is replaced
+static void RemoveSubCheats(void)
+{
+	for (size_t x = 0; x < SubCheats.size(); x++)
+		FCEU_SpliceRead(SPLICE_CHEAT, SubCheats[x].addr, NULL);
+	SubCheats.clear();
+	if (cheatMap)
+		FCEUI_RefreshCheatMap();
 }
 
 void RebuildSubCheats(void)
 {
-	uint32 x;
 	struct CHEATF *c = cheats;
-	for (x = 0; x < numsubcheats; x++)
+	for (size_t x = 0; x < SubCheats.size(); x++)
 	{
-		SetReadHandler(SubCheats[x].addr, SubCheats[x].addr, SubCheats[x].PrevRead);
+		const CHEATF_SUBFAST &s = SubCheats[x];
+		FCEU_SpliceRead(SPLICE_CHEAT, s.addr, NULL);
+		//a game carries on from the frozen value when the freeze is lifted
+		if (s.freeze && CheatRPtrs[s.addr >> 10])
+			CheatRPtrs[s.addr >> 10][s.addr] = s.val;
 		if (cheatMap)
-			FCEUI_SetCheatMapByte(SubCheats[x].addr, false);
+			FCEUI_SetCheatMapByte(s.addr, false);
 	}
 
-	numsubcheats = 0;
+	SubCheats.clear();
 
 	if (!globalCheatDisabled)
 	{
 		while(c)
 		{
-			if(c->type == 1 && c->status && GetReadHandler(c->addr) != SubCheatsRead)
+			//freezes only ever applied to the RAM registered with FCEU_CheatAddRAM
+			const bool freeze = (c->type == 0);
+			if(c->status && (!freeze || CheatRPtrs[c->addr >> 10]) && !FCEU_IsSplicedRead(SPLICE_CHEAT, c->addr))
 			{
-				SubCheats[numsubcheats].PrevRead = GetReadHandler(c->addr);
-				SubCheats[numsubcheats].addr = c->addr;
-				SubCheats[numsubcheats].val = c->val;
-				SubCheats[numsubcheats].compare = c->compare;
-				SetReadHandler(c->addr, c->addr, SubCheatsRead);
+				CHEATF_SUBFAST s;
+				s.addr = c->addr;
+				s.val = c->val;
+				s.compare = freeze ? -1 : c->compare;
+				s.freeze = freeze;
+				FCEU_SpliceRead(SPLICE_CHEAT, c->addr, SubCheatsRead);
+				if (freeze && geniestage != 1)
+					CheatRPtrs[c->addr >> 10][c->addr] = c->val;
 				if (cheatMap)
-					FCEUI_SetCheatMapByte(SubCheats[numsubcheats].addr, true);
-				numsubcheats++;
+					FCEUI_SetCheatMapByte(s.addr, true);
+				SubCheats.push_back(s);
 			}
 			c = c->next;
 		}
+		sort(SubCheats.begin(), SubCheats.end(), SubCheatLess);
 	}
-	FrozenAddressCount = numsubcheats;		//Update the frozen address list
+	FrozenAddressCount = SubCheats.size();		//Update the frozen address list
 
 }
 
 void FCEU_PowerCheats()
 {
-	numsubcheats = 0;	/* Quick hack to prevent setting of ancient read addresses. */
-	if (cheatMap)
-		FCEUI_RefreshCheatMap();
 	RebuildSubCheats();
 }
 
+//writes the frozen values to RAM before each frame, so that the memory viewers, RAM search,
+//savestates and movies see what the game sees
+void FCEU_ApplyPeriodicCheats(void)
+{
+	for (size_t x = 0; x < SubCheats.size(); x++)
+	{
+		const CHEATF_SUBFAST &s = SubCheats[x];
+		if (s.freeze)
+			CheatRPtrs[s.addr >> 10][s.addr] = s.val;
+	}
+}
+
 int FCEU_CalcCheatAffectedBytes(uint32 address, uint32 size) {
 
 	uint32 count = 0;
@@ -207,11 +242,7 @@ void FCEU_LoadGameCheats(FILE *override, int override_existing)
 	char *fn;
 
 	if (override_existing)
-	{
-		numsubcheats = 0;
-		if (cheatMap)
-			FCEUI_RefreshCheatMap();
-	}
+		RemoveSubCheats();
 
 	if(override)
 		fp = override;
@@ -318,11 +349,7 @@ void FCEU_SaveGameCheats(FILE* fp, int release)
 
 void FCEU_FlushGameCheats(FILE *override, int nosave)
 {
-	if(CheatComp)
-	{
-		free(CheatComp);
-		CheatComp=0;
-	}
+	FCEU_CheatSearchFree();
 	if((!savecheats || nosave) && !override)	/* Always save cheats if we're being overridden. */
 	{
 		if(cheats)
@@ -432,24 +459,6 @@ int FCEUI_DelCheat(uint32 which)
 	return(1);
 }
 
-void FCEU_ApplyPeriodicCheats(void)
-{
-	struct CHEATF *cur=cheats;
-	if(!cur) return;
-
-	for(;;)
-	{
-		if(cur->status && !(cur->type))
-			if(CheatRPtrs[cur->addr>>10])
-				CheatRPtrs[cur->addr>>10][cur->addr]=cur->val;
-		if(cur->next)
-			cur=cur->next;
-		else
-			break;
-	}
-}
-
-
 void FCEUI_ListCheats(int (*callb)(char *name, uint32 a, uint8 v, int compare, int s, int type, void *data), void *data)
 {
 	struct CHEATF *next=cheats;
@@ -661,207 +670,10 @@ int FCEUI_ToggleCheat(uint32 which)
 
 int FCEUI_GlobalToggleCheat(int global_enabled)
 {
-	int _numsubcheats = numsubcheats;
+	size_t _numsubcheats = SubCheats.size();
 	globalCheatDisabled = !global_enabled;
 	RebuildSubCheats();
-	return _numsubcheats != numsubcheats;
-}
-
-static int InitCheatComp(void)
-{
-	uint32 x;
-
-	CheatComp=(uint16*)FCEU_dmalloc(65536*sizeof(uint16));
-	if(!CheatComp)
-	{
-		CheatMemErr();
-		return(0);
-	}
-	for(x=0;x<65536;x++)
-		CheatComp[x]=CHEATC_NONE;
-
-	return(1);
-}
-
-void FCEUI_CheatSearchSetCurrentAsOriginal(void)
-{
-	uint32 x;
-
-	if(!CheatComp)
-	{
-		if(InitCheatComp())
-		{
-			CheatMemErr();
-			return;
-		}
-	}
-	for(x=0x000;x<0x10000;x++)
-		if(!(CheatComp[x]&CHEATC_NOSHOW))
-		{
-			if(CheatRPtrs[x>>10])
-				CheatComp[x]=CheatRPtrs[x>>10][x];
-			else
-				CheatComp[x]|=CHEATC_NONE;
-		}
-}
-
-void FCEUI_CheatSearchShowExcluded(void)
-{
-	uint32 x;
-
-	for(x=0x000;x<0x10000;x++)
-		CheatComp[x]&=~CHEATC_EXCLUDED;
-}
-
-
-int32 FCEUI_CheatSearchGetCount(void)
-{
-	uint32 x,c=0;
-
-	if(CheatComp)
-	{
-		for(x=0x0000;x<0x10000;x++)
-			if(!(CheatComp[x]&CHEATC_NOSHOW) && CheatRPtrs[x>>10])
-				c++;
-	}
-
-	return c;
-}
-/* This function will give the initial value of the search and the current value at a location. */
-
-void FCEUI_CheatSearchGet(int (*callb)(uint32 a, uint8 last, uint8 current, void *data),void *data)
-{
-	uint32 x;
-
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-			CheatMemErr();
-		return;
-	}
-
-	for(x=0;x<0x10000;x++)
-		if(!(CheatComp[x]&CHEATC_NOSHOW) && CheatRPtrs[x>>10])
-			if(!callb(x,CheatComp[x],CheatRPtrs[x>>10][x],data))
-				break;
-}
-
-void FCEUI_CheatSearchGetRange(uint32 first, uint32 last, int (*callb)(uint32 a, uint8 last, uint8 current))
-{
-	uint32 x;
-	uint32 in = 0;
-
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-			CheatMemErr();
-		return;
-	}
-
-	for(x = 0; x < 0x10000; x++)
-		if(!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10])
-		{
-			if(in >= first)
-				if(!callb(x, CheatComp[x], CheatRPtrs[x >> 10][x]))
-					break;
-			in++;
-			if(in > last)
-				return;
-		}
-}
-
-void FCEUI_CheatSearchBegin(void)
-{
-	uint32 x;
-
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-		{
-			CheatMemErr();
-			return;
-		}
-	}
-	for(x=0;x<0x10000;x++)
-	{
-		if(CheatRPtrs[x>>10])
-			CheatComp[x]=CheatRPtrs[x>>10][x];
-		else
-			CheatComp[x]=CHEATC_NONE;
-	}
-}
-
-
-static int INLINE CAbs(int x)
-{
-	if(x<0)
-		return(0-x);
-	return x;
-}
-
-void FCEUI_CheatSearchEnd(int type, uint8 v1, uint8 v2)
-{
-	uint32 x;
-
-	if(!CheatComp)
-	{
-		if(!InitCheatComp())
-		{
-			CheatMemErr();
-			return;
-		}
-	}
-
-	switch (type)
-	{
-		default:
-		case FCEU_SEARCH_SPECIFIC_CHANGE: // Change to a specific value
-			for (x = 0; x < 0x10000; ++x)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] != v1 || CheatRPtrs[x >> 10][x] != v2))
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_RELATIVE_CHANGE: // Search for relative change (between values).
-			for (x = 0; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] != v1 || CAbs(CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2))
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_PUERLY_RELATIVE_CHANGE: // Purely relative change.
-			for (x = 0x000; x<0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CAbs(CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_ANY_CHANGE: // Any change.
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] == CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_NEWVAL_KNOWN: // new value = known
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10][x] != v1)
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_NEWVAL_GT: // new value greater than
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] >= CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_NEWVAL_LT: // new value less than
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatComp[x] <= CheatRPtrs[x >> 10][x])
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_NEWVAL_GT_KNOWN: // new value greater than by known value
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && CheatRPtrs[x >> 10][x] - CheatComp[x] != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-		case FCEU_SEARCH_NEWVAL_LT_KNOWN: // new value less than by known value
-			for (x = 0x000; x < 0x10000; x++)
-				if (!(CheatComp[x] & CHEATC_NOSHOW) && (CheatComp[x] - CheatRPtrs[x >> 10][x]) != v2)
-					CheatComp[x] |= CHEATC_EXCLUDED;
-			break;
-	}
-
+	return _numsubcheats != SubCheats.size();
 }
 
 int FCEU_CheatGetByte(uint32 A)
@@ -921,7 +733,7 @@ inline void FCEUI_CreateCheatMap()
 inline void FCEUI_RefreshCheatMap()
 {
 	memset(cheatMap, 0, CHEATMAP_SIZE);
-	for (int i = 0; i < numsubcheats; ++i)
+	for (size_t i = 0; i < SubCheats.size(); ++i)
 		FCEUI_SetCheatMapByte(SubCheats[i].addr, true);
 }
 
@@ -2,6 +2,8 @@
 #define CHEAT_H
 void FCEU_CheatResetRAM(void);
 void FCEU_CheatAddRAM(int s, uint32 A, uint8 *p);
+// the RAM added with FCEU_CheatAddRAM, by 1KB page, offset so that it's indexed with the address
+extern uint8 *CheatRPtrs[64];
 
 void FCEU_LoadGameCheats(FILE *override, int override_existing = 1);
 void FCEU_FlushGameCheats(FILE *override, int nosave);
@@ -35,7 +37,7 @@ typedef struct {
 	uint16 addr;
 	uint8 val;
 	int compare;
-	readfunc PrevRead;
+	bool freeze;	/* a replace cheat, applied the same way */
 } CHEATF_SUBFAST;
 
 struct CHEATF {
@@ -65,4 +67,24 @@ struct SEARCHPOSSIBLE {
 #define FCEU_SEARCH_NEWVAL_GT_KNOWN         7
 #define FCEU_SEARCH_NEWVAL_LT_KNOWN         8
 
+// comparisons for FCEUI_CheatSearchFilter
+#define FCEU_SEARCH_OP_EQ  0
+#define FCEU_SEARCH_OP_NE  1
+#define FCEU_SEARCH_OP_LT  2
+#define FCEU_SEARCH_OP_GT  3
+#define FCEU_SEARCH_OP_LE  4
+#define FCEU_SEARCH_OP_GE  5
+
+// what FCEUI_CheatSearchFilter compares
+#define FCEU_SEARCH_VS_VALUE           0 // current value op value
+#define FCEU_SEARCH_VS_PREVIOUS        1 // current value op previous value
+#define FCEU_SEARCH_VS_DIFFERENCE      2 // (current - previous) op value
+#define FCEU_SEARCH_VS_ABS_DIFFERENCE  3 // |current - previous| op value
+#define FCEU_SEARCH_PREVIOUS_VS_VALUE  4 // previous value op value
+#define FCEU_SEARCH_VS_CHANGES         5 // number of changes op value
+#define FCEU_SEARCH_VS_ADDRESS         6 // current value op current value at address value
+
+void FCEU_CheatSearchFree(void);
+void FCEU_CheatSearchFrame(void);
+
 #endif
\ No newline at end of file
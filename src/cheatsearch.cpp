@@ -0,0 +1,692 @@
+/// \file
+/// \brief Cheat search engine
+///
+/// The searchable memory (the RAM and WRAM pages registered with FCEU_CheatAddRAM) is copied into
+/// one contiguous snapshot, so that a comparison runs over plain arrays 16 addresses at a time.
+/// Candidates are kept as a bitset over the snapshot, a bit per address; a search step only ever
+/// clears bits, and the sets before the last steps are kept, compressed, to undo them.
+///
+/// While a RAM search window is open, the values are also compared from frame to frame to count how
+/// often each one changes, and a search can be repeated every frame. That work is done on the
+/// snapshots allocated when the search began, nothing is allocated per frame.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "cheat.h"
+
+#include "zlib.h"
+
+#include <deque>
+#include <vector>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHEATSEARCH_SSE2
+#include <emmintrin.h>
+#endif
+
+#define CHEATSEARCH_BLOCK 16      //addresses per candidate word
+#define CHEATSEARCH_UNDO_MAX 32   //search steps that can be undone
+
+struct CheatSearchRegion
+{
+	uint32 address;
+	uint32 offset;   //in the snapshots
+	uint32 size;
+};
+
+static std::vector<CheatSearchRegion> regions;
+static std::vector<uint8> previous;       //the values searches compare against
+static std::vector<uint8> current;        //scratch, refreshed for each search
+static std::vector<uint16> candidates;    //a bit per address of the snapshots
+static std::deque< std::vector<uint8> > undoHistory;  //compressed candidate sets, newest last
+static std::vector<uint8> lastFrame;      //the values at the end of the previous frame, for counting changes
+static std::vector<uint16> changes;       //per address, how often the value changed from a frame to the next
+static uint32 snapshotSize = 0;
+static int valueSize = 1;
+static bool valueSigned = false;
+static bool countChanges = false;
+static bool autoSearch = false;
+static int autoOp, autoOperand;
+static uint32 autoValue;
+
+static void BuildRegions()
+{
+	regions.clear();
+	snapshotSize = 0;
+	for (int page = 0; page < 64; page++)
+	{
+		if (!CheatRPtrs[page])
+			continue;
+		if (regions.empty() || regions.back().address + regions.back().size != (uint32)page << 10)
+		{
+			CheatSearchRegion region = { (uint32)page << 10, snapshotSize, 0 };
+			regions.push_back(region);
+		}
+		regions.back().size += 1024;
+		snapshotSize += 1024;
+	}
+	//the padding lets multibyte values be read past the last address
+	previous.assign(snapshotSize + CHEATSEARCH_BLOCK, 0);
+	current.assign(snapshotSize + CHEATSEARCH_BLOCK, 0);
+	lastFrame.assign(snapshotSize + CHEATSEARCH_BLOCK, 0);
+	changes.assign(snapshotSize, 0);
+	candidates.assign(snapshotSize / CHEATSEARCH_BLOCK, 0);
+}
+
+//the offset of an address in the snapshots, or -1
+static int FindOffset(uint32 A)
+{
+	for (size_t i = 0; i < regions.size(); i++)
+		if (A >= regions[i].address && A < regions[i].address + regions[i].size)
+			return regions[i].offset + A - regions[i].address;
+	return -1;
+}
+
+static void ReadMemory(std::vector<uint8> &dst)
+{
+	for (size_t i = 0; i < regions.size(); i++)
+		for (uint32 pos = 0; pos < regions[i].size; pos += 1024)
+		{
+			const uint32 A = regions[i].address + pos;
+			memcpy(&dst[regions[i].offset + pos], CheatRPtrs[A >> 10] + A, 1024);
+		}
+}
+
+//multibyte values can't run past the end of a region
+static void ExcludeRegionEnds()
+{
+	for (size_t i = 0; i < regions.size(); i++)
+		for (int k = 1; k < valueSize; k++)
+		{
+			const uint32 offset = regions[i].offset + regions[i].size - k;
+			candidates[offset / CHEATSEARCH_BLOCK] &= ~(1 << (offset % CHEATSEARCH_BLOCK));
+		}
+}
+
+static void IncludeAll()
+{
+	for (size_t i = 0; i < candidates.size(); i++)
+		candidates[i] = 0xFFFF;
+	ExcludeRegionEnds();
+}
+
+static void PushUndo()
+{
+	if (candidates.empty())
+		return;
+	uLongf size = compressBound(candidates.size() * sizeof(uint16));
+	std::vector<uint8> packed(size);
+	if (compress2(&packed[0], &size, (const Bytef*)&candidates[0], candidates.size() * sizeof(uint16), Z_BEST_SPEED) != Z_OK)
+		return;
+	packed.resize(size);
+	undoHistory.push_back(std::vector<uint8>());
+	undoHistory.back().swap(packed);
+	if (undoHistory.size() > CHEATSEARCH_UNDO_MAX)
+		undoHistory.pop_front();
+}
+
+static inline int CountBits(uint32 x)
+{
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+template<int SIZE> static inline uint32 ReadValue(const uint8 *p)
+{
+	uint32 v = p[0];
+	if (SIZE >= 2)
+		v |= p[1] << 8;
+	if (SIZE == 4)
+		v |= (p[2] << 16) | ((uint32)p[3] << 24);
+	return v;
+}
+
+#ifdef CHEATSEARCH_SSE2
+
+//SSE2 has no unsigned compares; flipping the sign bit of both sides turns them into signed ones
+template<int SIZE> struct CheatSearchLanes;
+template<> struct CheatSearchLanes<1>
+{
+	static __m128i set1(uint32 v) { return _mm_set1_epi8((char)v); }
+	static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi8(a, b); }
+	static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+	static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi8(a, b); }
+	static __m128i bias() { return _mm_set1_epi8((char)0x80); }
+	//the values at the 16 addresses from p
+	static void load(const uint8 *p, __m128i *v) { v[0] = _mm_loadu_si128((const __m128i*)p); }
+	static int mask(const __m128i *m) { return _mm_movemask_epi8(m[0]); }
+};
+template<> struct CheatSearchLanes<2>
+{
+	static __m128i set1(uint32 v) { return _mm_set1_epi16((short)v); }
+	static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+	static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+	static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi16(a, b); }
+	static __m128i bias() { return _mm_set1_epi16((short)0x8000); }
+	static void load(const uint8 *p, __m128i *v)
+	{
+		const __m128i l0 = _mm_loadu_si128((const __m128i*)p);
+		const __m128i l1 = _mm_loadu_si128((const __m128i*)(p + 1));
+		v[0] = _mm_unpacklo_epi8(l0, l1);
+		v[1] = _mm_unpackhi_epi8(l0, l1);
+	}
+	static int mask(const __m128i *m) { return _mm_movemask_epi8(_mm_packs_epi16(m[0], m[1])); }
+};
+template<> struct CheatSearchLanes<4>
+{
+	static __m128i set1(uint32 v) { return _mm_set1_epi32((int)v); }
+	static __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+	static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+	static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi32(a, b); }
+	static __m128i bias() { return _mm_set1_epi32((int)0x80000000); }
+	static void load(const uint8 *p, __m128i *v)
+	{
+		//the words at p and at p+2 interleaved make up the doublewords at p
+		const __m128i l0 = _mm_loadu_si128((const __m128i*)p);
+		const __m128i l1 = _mm_loadu_si128((const __m128i*)(p + 1));
+		const __m128i l2 = _mm_loadu_si128((const __m128i*)(p + 2));
+		const __m128i l3 = _mm_loadu_si128((const __m128i*)(p + 3));
+		const __m128i a0 = _mm_unpacklo_epi8(l0, l1), a1 = _mm_unpackhi_epi8(l0, l1);
+		const __m128i b0 = _mm_unpacklo_epi8(l2, l3), b1 = _mm_unpackhi_epi8(l2, l3);
+		v[0] = _mm_unpacklo_epi16(a0, b0);
+		v[1] = _mm_unpackhi_epi16(a0, b0);
+		v[2] = _mm_unpacklo_epi16(a1, b1);
+		v[3] = _mm_unpackhi_epi16(a1, b1);
+	}
+	static int mask(const __m128i *m)
+	{
+		return _mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3])));
+	}
+};
+
+template<int SIZE> static inline __m128i Compare(__m128i x, __m128i y, int op, bool sgn)
+{
+	typedef CheatSearchLanes<SIZE> L;
+	if (!sgn)
+	{
+		x = _mm_xor_si128(x, L::bias());
+		y = _mm_xor_si128(y, L::bias());
+	}
+	const __m128i ones = _mm_set1_epi32(-1);
+	switch (op)
+	{
+		default:
+		case FCEU_SEARCH_OP_EQ: return L::eq(x, y);
+		case FCEU_SEARCH_OP_NE: return _mm_xor_si128(L::eq(x, y), ones);
+		case FCEU_SEARCH_OP_LT: return L::gt(y, x);
+		case FCEU_SEARCH_OP_GT: return L::gt(x, y);
+		case FCEU_SEARCH_OP_LE: return _mm_xor_si128(L::gt(x, y), ones);
+		case FCEU_SEARCH_OP_GE: return _mm_xor_si128(L::gt(y, x), ones);
+	}
+}
+
+static void FilterChanges(int op, uint32 value)
+{
+	const __m128i constant = _mm_set1_epi16((short)(value > 0xFFFF ? 0xFFFF : value));
+	for (size_t b = 0; b < candidates.size(); b++)
+	{
+		if (!candidates[b])
+			continue;
+		__m128i m[2];
+		m[0] = Compare<2>(_mm_loadu_si128((const __m128i*)&changes[b * CHEATSEARCH_BLOCK]), constant, op, false);
+		m[1] = Compare<2>(_mm_loadu_si128((const __m128i*)&changes[b * CHEATSEARCH_BLOCK + 8]), constant, op, false);
+		candidates[b] &= CheatSearchLanes<2>::mask(m);
+	}
+}
+
+template<int SIZE> static void CountChanges()
+{
+	typedef CheatSearchLanes<SIZE> L;
+	for (size_t b = 0; b < candidates.size(); b++)
+	{
+		__m128i cur[SIZE], last[SIZE], m[SIZE];
+		L::load(&current[b * CHEATSEARCH_BLOCK], cur);
+		L::load(&lastFrame[b * CHEATSEARCH_BLOCK], last);
+		for (int i = 0; i < SIZE; i++)
+			m[i] = L::eq(cur[i], last[i]);
+		//most values don't change in a frame
+		int changed = ~L::mask(m) & 0xFFFF;
+		for (uint16 *count = &changes[b * CHEATSEARCH_BLOCK]; changed; changed >>= 1, count++)
+			if ((changed & 1) && *count != 0xFFFF)
+				(*count)++;
+	}
+}
+
+template<int SIZE> static void Filter(int op, int operand, uint32 value)
+{
+	typedef CheatSearchLanes<SIZE> L;
+	const __m128i constant = L::set1(value);
+	const __m128i bias = valueSigned ? _mm_setzero_si128() : L::bias();
+	for (size_t b = 0; b < candidates.size(); b++)
+	{
+		if (!candidates[b])
+			continue;
+		__m128i cur[SIZE], prev[SIZE], m[SIZE];
+		L::load(&current[b * CHEATSEARCH_BLOCK], cur);
+		L::load(&previous[b * CHEATSEARCH_BLOCK], prev);
+		for (int i = 0; i < SIZE; i++)
+		{
+			switch (operand)
+			{
+				default:
+				case FCEU_SEARCH_VS_VALUE: m[i] = Compare<SIZE>(cur[i], constant, op, valueSigned); break;
+				case FCEU_SEARCH_VS_PREVIOUS: m[i] = Compare<SIZE>(cur[i], prev[i], op, valueSigned); break;
+				case FCEU_SEARCH_VS_DIFFERENCE: m[i] = Compare<SIZE>(L::sub(cur[i], prev[i]), constant, op, valueSigned); break;
+				case FCEU_SEARCH_VS_ABS_DIFFERENCE:
+				{
+					const __m128i greater = L::gt(_mm_xor_si128(cur[i], bias), _mm_xor_si128(prev[i], bias));
+					const __m128i diff = _mm_or_si128(_mm_and_si128(greater, L::sub(cur[i], prev[i])),
+						_mm_andnot_si128(greater, L::sub(prev[i], cur[i])));
+					m[i] = Compare<SIZE>(diff, constant, op, false);
+					break;
+				}
+				case FCEU_SEARCH_PREVIOUS_VS_VALUE: m[i] = Compare<SIZE>(prev[i], constant, op, valueSigned); break;
+			}
+		}
+		candidates[b] &= L::mask(m);
+	}
+}
+
+#else
+
+template<int SIZE> static inline int64 Extend(uint32 v, bool sgn)
+{
+	v &= 0xFFFFFFFF >> (32 - SIZE * 8);
+	if (sgn && (v & (1u << (SIZE * 8 - 1))))
+		return (int64)v - ((int64)1 << (SIZE * 8));
+	return v;
+}
+
+static inline bool Compare(int64 x, int64 y, int op)
+{
+	switch (op)
+	{
+		default:
+		case FCEU_SEARCH_OP_EQ: return x == y;
+		case FCEU_SEARCH_OP_NE: return x != y;
+		case FCEU_SEARCH_OP_LT: return x < y;
+		case FCEU_SEARCH_OP_GT: return x > y;
+		case FCEU_SEARCH_OP_LE: return x <= y;
+		case FCEU_SEARCH_OP_GE: return x >= y;
+	}
+}
+
+static void FilterChanges(int op, uint32 value)
+{
+	for (size_t b = 0; b < candidates.size(); b++)
+	{
+		if (!candidates[b])
+			continue;
+		int mask = 0;
+		for (int i = 0; i < CHEATSEARCH_BLOCK; i++)
+			if (Compare(changes[b * CHEATSEARCH_BLOCK + i], value, op))
+				mask |= 1 << i;
+		candidates[b] &= mask;
+	}
+}
+
+template<int SIZE> static void CountChanges()
+{
+	for (uint32 offset = 0; offset < snapshotSize; offset++)
+		if (ReadValue<SIZE>(&current[offset]) != ReadValue<SIZE>(&lastFrame[offset]) && changes[offset] != 0xFFFF)
+			changes[offset]++;
+}
+
+template<int SIZE> static void Filter(int op, int operand, uint32 value)
+{
+	for (size_t b = 0; b < candidates.size(); b++)
+	{
+		if (!candidates[b])
+			continue;
+		int mask = 0;
+		for (int i = 0; i < CHEATSEARCH_BLOCK; i++)
+		{
+			const uint32 offset = b * CHEATSEARCH_BLOCK + i;
+			const uint32 cur = ReadValue<SIZE>(&current[offset]), prev = ReadValue<SIZE>(&previous[offset]);
+			bool match;
+			switch (operand)
+			{
+				default:
+				case FCEU_SEARCH_VS_VALUE: match = Compare(Extend<SIZE>(cur, valueSigned), Extend<SIZE>(value, valueSigned), op); break;
+				case FCEU_SEARCH_VS_PREVIOUS: match = Compare(Extend<SIZE>(cur, valueSigned), Extend<SIZE>(prev, valueSigned), op); break;
+				case FCEU_SEARCH_VS_DIFFERENCE: match = Compare(Extend<SIZE>(cur - prev, valueSigned), Extend<SIZE>(value, valueSigned), op); break;
+				case FCEU_SEARCH_VS_ABS_DIFFERENCE:
+				{
+					const bool greater = Extend<SIZE>(cur, valueSigned) > Extend<SIZE>(prev, valueSigned);
+					match = Compare(Extend<SIZE>(greater ? cur - prev : prev - cur, false), Extend<SIZE>(value, false), op);
+					break;
+				}
+				case FCEU_SEARCH_PREVIOUS_VS_VALUE: match = Compare(Extend<SIZE>(prev, valueSigned), Extend<SIZE>(value, valueSigned), op); break;
+			}
+			if (match)
+				mask |= 1 << i;
+		}
+		candidates[b] &= mask;
+	}
+}
+
+#endif
+
+static void ApplyFilter(int op, int operand, uint32 value)
+{
+	if (operand == FCEU_SEARCH_VS_CHANGES)
+	{
+		FilterChanges(op, value);
+		return;
+	}
+	if (operand == FCEU_SEARCH_VS_ADDRESS)
+	{
+		//compares with the value at that address
+		const int offset = FindOffset(value);
+		if (offset < 0 || offset + valueSize > (int)snapshotSize)
+		{
+			memset(&candidates[0], 0, candidates.size() * sizeof(uint16));
+			return;
+		}
+		operand = FCEU_SEARCH_VS_VALUE;
+		switch (valueSize)
+		{
+			default:
+			case 1: value = ReadValue<1>(&current[offset]); break;
+			case 2: value = ReadValue<2>(&current[offset]); break;
+			case 4: value = ReadValue<4>(&current[offset]); break;
+		}
+	}
+	switch (valueSize)
+	{
+		default:
+		case 1: Filter<1>(op, operand, value); break;
+		case 2: Filter<2>(op, operand, value); break;
+		case 4: Filter<4>(op, operand, value); break;
+	}
+}
+
+void FCEU_CheatSearchFree(void)
+{
+	regions.clear();
+	std::vector<uint8>().swap(previous);
+	std::vector<uint8>().swap(current);
+	std::vector<uint16>().swap(candidates);
+	std::vector<uint8>().swap(lastFrame);
+	std::vector<uint16>().swap(changes);
+	undoHistory.clear();
+	snapshotSize = 0;
+	autoSearch = false;
+}
+
+void FCEU_CheatSearchFrame(void)
+{
+	if (!snapshotSize || (!countChanges && !autoSearch))
+		return;
+
+	ReadMemory(current);
+	if (countChanges)
+	{
+		switch (valueSize)
+		{
+			default:
+			case 1: CountChanges<1>(); break;
+			case 2: CountChanges<2>(); break;
+			case 4: CountChanges<4>(); break;
+		}
+	}
+	if (autoSearch)
+	{
+		//an automatic search compares with the previous frame
+		ApplyFilter(autoOp, autoOperand, autoValue);
+		memcpy(&previous[0], &current[0], snapshotSize);
+	}
+	lastFrame.swap(current);
+}
+
+void FCEUI_CheatSearchBegin(void)
+{
+	BuildRegions();
+	ReadMemory(previous);
+	memcpy(&lastFrame[0], &previous[0], snapshotSize);
+	IncludeAll();
+	undoHistory.clear();
+	autoSearch = false;
+}
+
+void FCEUI_CheatSearchSetCurrentAsOriginal(void)
+{
+	if (snapshotSize)
+		ReadMemory(previous);
+}
+
+void FCEUI_CheatSearchShowExcluded(void)
+{
+	PushUndo();
+	IncludeAll();
+}
+
+void FCEUI_CheatSearchSetFormat(int size, bool isSigned)
+{
+	valueSize = (size == 2 || size == 4) ? size : 1;
+	valueSigned = isSigned;
+	ExcludeRegionEnds();
+	FCEUI_CheatSearchResetChangeCounts();
+}
+
+void FCEUI_CheatSearchSetChangeCounting(bool enabled)
+{
+	if (enabled && !countChanges && snapshotSize)
+		ReadMemory(lastFrame);
+	countChanges = enabled;
+}
+
+void FCEUI_CheatSearchResetChangeCounts(void)
+{
+	if (!changes.empty())
+		memset(&changes[0], 0, changes.size() * sizeof(uint16));
+}
+
+int FCEUI_CheatSearchGetChangeCount(uint32 a)
+{
+	const int offset = FindOffset(a);
+	return offset < 0 ? 0 : changes[offset];
+}
+
+void FCEUI_CheatSearchSetAuto(bool enabled, int op, int operand, uint32 value)
+{
+	autoSearch = enabled && snapshotSize;
+	autoOp = op;
+	autoOperand = operand;
+	autoValue = value;
+	if (autoSearch)
+	{
+		//from here on, the candidates can only be taken back to the way they were before
+		PushUndo();
+		ReadMemory(previous);
+	}
+}
+
+bool FCEUI_CheatSearchGetAuto(void)
+{
+	return autoSearch;
+}
+
+void FCEUI_CheatSearchGetFormat(int *size, bool *isSigned)
+{
+	*size = valueSize;
+	*isSigned = valueSigned;
+}
+
+void FCEUI_CheatSearchFilter(int op, int operand, uint32 value)
+{
+	if (!snapshotSize)
+		return;
+	PushUndo();
+	ReadMemory(current);
+	ApplyFilter(op, operand, value);
+}
+
+//the classic search types compare unsigned bytes, as they always did, whatever format is set for
+//FCEUI_CheatSearchFilter. a signed or wider format would change what v1 and v2 mean to their callers.
+void FCEUI_CheatSearchEnd(int type, uint8 v1, uint8 v2)
+{
+	if (!snapshotSize)
+		return;
+	PushUndo();
+	ReadMemory(current);
+
+	const int size = valueSize;
+	const bool isSigned = valueSigned;
+	valueSize = 1;
+	valueSigned = false;
+	switch (type)
+	{
+		default:
+		case FCEU_SEARCH_SPECIFIC_CHANGE: // Change to a specific value
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_PREVIOUS_VS_VALUE, v1);
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_VALUE, v2);
+			break;
+		case FCEU_SEARCH_RELATIVE_CHANGE: // Search for relative change (between values).
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_PREVIOUS_VS_VALUE, v1);
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_ABS_DIFFERENCE, v2);
+			break;
+		case FCEU_SEARCH_PUERLY_RELATIVE_CHANGE: // Purely relative change.
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_ABS_DIFFERENCE, v2);
+			break;
+		case FCEU_SEARCH_ANY_CHANGE: // Any change.
+			ApplyFilter(FCEU_SEARCH_OP_NE, FCEU_SEARCH_VS_PREVIOUS, 0);
+			break;
+		case FCEU_SEARCH_NEWVAL_KNOWN: // new value = known
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_VALUE, v1);
+			break;
+		case FCEU_SEARCH_NEWVAL_GT: // new value greater than
+			ApplyFilter(FCEU_SEARCH_OP_GT, FCEU_SEARCH_VS_PREVIOUS, 0);
+			break;
+		case FCEU_SEARCH_NEWVAL_LT: // new value less than
+			ApplyFilter(FCEU_SEARCH_OP_LT, FCEU_SEARCH_VS_PREVIOUS, 0);
+			break;
+		case FCEU_SEARCH_NEWVAL_GT_KNOWN: // new value greater than by known value
+			if (v2)
+				ApplyFilter(FCEU_SEARCH_OP_GT, FCEU_SEARCH_VS_PREVIOUS, 0);
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_DIFFERENCE, v2);
+			break;
+		case FCEU_SEARCH_NEWVAL_LT_KNOWN: // new value less than by known value
+			if (v2)
+				ApplyFilter(FCEU_SEARCH_OP_LT, FCEU_SEARCH_VS_PREVIOUS, 0);
+			ApplyFilter(FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_DIFFERENCE, (uint32)-(int32)v2);
+			break;
+	}
+	valueSize = size;
+	valueSigned = isSigned;
+}
+
+bool FCEUI_CheatSearchUndo(void)
+{
+	if (undoHistory.empty())
+		return false;
+	uLongf size = candidates.size() * sizeof(uint16);
+	const std::vector<uint8> &packed = undoHistory.back();
+	const bool ok = uncompress((Bytef*)&candidates[0], &size, &packed[0], packed.size()) == Z_OK;
+	undoHistory.pop_back();
+	if (!ok)
+	{
+		//can't happen short of running out of memory; better a full list than a wrong one
+		IncludeAll();
+		undoHistory.clear();
+	}
+	return ok;
+}
+
+int FCEUI_CheatSearchUndoCount(void)
+{
+	return undoHistory.size();
+}
+
+int32 FCEUI_CheatSearchGetCount(void)
+{
+	int32 count = 0;
+	for (size_t b = 0; b < candidates.size(); b++)
+		count += CountBits(candidates[b]);
+	return count;
+}
+
+//calls back with the candidates first to last, counting from 0; the callback returns 0 to stop
+template<typename F> static void ForEachCandidate(uint32 first, uint32 last, F callb)
+{
+	uint32 index = 0;
+	size_t region = 0;
+	for (size_t b = 0; b < candidates.size() && index <= last; b++)
+	{
+		int bits = candidates[b];
+		if (!bits)
+			continue;
+		const int n = CountBits(bits);
+		if (index + n <= first)
+		{
+			index += n;
+			continue;
+		}
+		const uint32 blockOffset = b * CHEATSEARCH_BLOCK;
+		while (regions[region].offset + regions[region].size <= blockOffset)
+			region++;
+		for (int i = 0; bits && index <= last; i++, bits >>= 1)
+		{
+			if (!(bits & 1))
+				continue;
+			if (index++ < first)
+				continue;
+			const uint32 offset = blockOffset + i;
+			if (!callb(regions[region].address + offset - regions[region].offset, offset))
+				return;
+		}
+	}
+}
+
+struct CheatSearchByteCallback
+{
+	int (*callb)(uint32 a, uint8 last, uint8 current);
+	int operator()(uint32 A, uint32 offset) const { return callb(A, previous[offset], CheatRPtrs[A >> 10][A]); }
+};
+
+struct CheatSearchByteDataCallback
+{
+	int (*callb)(uint32 a, uint8 last, uint8 current, void *data);
+	void *data;
+	int operator()(uint32 A, uint32 offset) const { return callb(A, previous[offset], CheatRPtrs[A >> 10][A], data); }
+};
+
+struct CheatSearchValueCallback
+{
+	int (*callb)(uint32 a, uint32 last, uint32 current, void *data);
+	void *data;
+	int operator()(uint32 A, uint32 offset) const
+	{
+		uint8 bytes[4];
+		for (int i = 0; i < valueSize; i++)
+			bytes[i] = CheatRPtrs[(A + i) >> 10][A + i];
+		switch (valueSize)
+		{
+			default:
+			case 1: return callb(A, ReadValue<1>(&previous[offset]), ReadValue<1>(bytes), data);
+			case 2: return callb(A, ReadValue<2>(&previous[offset]), ReadValue<2>(bytes), data);
+			case 4: return callb(A, ReadValue<4>(&previous[offset]), ReadValue<4>(bytes), data);
+		}
+	}
+};
+
+void FCEUI_CheatSearchGet(int (*callb)(uint32 a, uint8 last, uint8 current, void *data), void *data)
+{
+	CheatSearchByteDataCallback f = { callb, data };
+	ForEachCandidate(0, 0xFFFFFFFF, f);
+}
+
+void FCEUI_CheatSearchGetRange(uint32 first, uint32 last, int (*callb)(uint32 a, uint8 last, uint8 current))
+{
+	CheatSearchByteCallback f = { callb };
+	ForEachCandidate(first, last, f);
+}
+
+void FCEUI_CheatSearchGetValues(uint32 first, uint32 last, int (*callb)(uint32 a, uint32 last, uint32 current, void *data), void *data)
+{
+	CheatSearchValueCallback f = { callb, data };
+	ForEachCandidate(first, last, f);
+}
@@ -42,6 +42,7 @@
 */
 
 #include "types.h"
+#include "x6502.h"
 #include "conddebug.h"
 #include "utils/memory.h"
 
@@ -76,6 +77,7 @@ void freeTree(Condition* c)
 {
 	if (c->lhs) freeTree(c->lhs);
 	if (c->rhs) freeTree(c->rhs);
+	if (c->code) free(c->code);
 
 	free(c);
 }
@@ -510,6 +512,105 @@ Condition* Connect(const char** str)
 	return InfixOperator(str, Compare, ConnectOperators);
 }
 
+// Counts the instructions needed for one operand of a tree node
+static unsigned int operandSize(Condition* sub, unsigned int type)
+{
+	switch (type)
+	{
+		case TYPE_PC_BANK:
+		case TYPE_DATA_BANK:
+		case TYPE_VALUE_READ:
+		case TYPE_VALUE_WRITE: return 1;
+	}
+	unsigned int size = 1;
+	if (sub)
+	{
+		size = operandSize(sub->lhs, sub->type1);
+		if (sub->op)
+			size += operandSize(sub->rhs, sub->type2) + 1;
+	}
+	return size + (type == TYPE_ADDR ? 1 : 0);
+}
+
+// Emits the instructions for one operand of a tree node.
+// Mirrors the tree walk that evaluated conditions before they were compiled:
+// the operand is either a subtree or a leaf of the given type, and the type is applied afterwards.
+static void compileOperand(CondInstruction*& out, unsigned int& depth, unsigned int& maxDepth, Condition* sub, unsigned int type, unsigned int value)
+{
+	switch (type)
+	{
+		case TYPE_PC_BANK: out->code = CODE_PC_BANK; break;
+		case TYPE_DATA_BANK: out->code = CODE_DATA_BANK; break;
+		case TYPE_VALUE_READ: out->code = CODE_VALUE_READ; break;
+		case TYPE_VALUE_WRITE: out->code = CODE_VALUE_WRITE; break;
+		default:
+			if (sub)
+			{
+				compileOperand(out, depth, maxDepth, sub->lhs, sub->type1, sub->value1);
+				if (sub->op)
+				{
+					compileOperand(out, depth, maxDepth, sub->rhs, sub->type2, sub->value2);
+					out->code = CODE_OP;
+					out->value = sub->op;
+					out++;
+					depth--;
+				}
+			}
+			else
+			{
+				out->value = 0;
+				switch (type == TYPE_REG || type == TYPE_FLAG ? value : 0)
+				{
+					case 'A': out->code = CODE_A; break;
+					case 'X': out->code = CODE_X; break;
+					case 'Y': out->code = CODE_Y; break;
+					case 'S': out->code = CODE_S; break;
+					case 'P': out->code = CODE_PC; break;
+					case 'N': out->code = CODE_FLAG; out->value = N_FLAG; break;
+					case 'V': out->code = CODE_FLAG; out->value = V_FLAG; break;
+					case 'U': out->code = CODE_FLAG; out->value = U_FLAG; break;
+					case 'B': out->code = CODE_FLAG; out->value = B_FLAG; break;
+					case 'D': out->code = CODE_FLAG; out->value = D_FLAG; break;
+					case 'I': out->code = CODE_FLAG; out->value = I_FLAG; break;
+					case 'Z': out->code = CODE_FLAG; out->value = Z_FLAG; break;
+					case 'C': out->code = CODE_FLAG; out->value = C_FLAG; break;
+					default:
+						out->code = CODE_NUM;
+						out->value = (type == TYPE_ADDR || type == TYPE_NUM) ? value : 0;
+						break;
+				}
+				out++;
+				if (++depth > maxDepth)
+					maxDepth = depth;
+			}
+			if (type == TYPE_ADDR)
+			{
+				out->code = CODE_MEM;
+				out++;
+			}
+			return;
+	}
+	out->value = 0;
+	out++;
+	if (++depth > maxDepth)
+		maxDepth = depth;
+}
+
+// Compiles a condition tree into a flat program stored in its root
+static void compileCondition(Condition* c)
+{
+	unsigned int size = operandSize(c, TYPE_NO) + 1;
+	CondInstruction* out = (CondInstruction*)FCEU_dmalloc(size * sizeof(CondInstruction));
+	if (!out)
+		return;
+
+	c->code = out;
+	unsigned int depth = 0;
+	c->codeDepth = 0;
+	compileOperand(out, depth, c->codeDepth, c, TYPE_NO, 0);
+	out->code = CODE_END;
+}
+
 /* Root of the parser generator */
 Condition* generateCondition(const char* str)
 {
@@ -519,5 +620,7 @@ Condition* generateCondition(const char* str)
 	c = Connect(&str);
 
 	if (!c || next != 0) return 0;
-	else return c;
+
+	compileCondition(c);
+	return c;
 }
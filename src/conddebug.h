@@ -45,9 +45,32 @@
 #define OP_OR 11
 #define OP_AND 12
 
+// Instructions of the flat postfix program a condition tree is compiled into,
+// so that evaluating a condition doesn't have to walk the tree for every instruction
+#define CODE_END 0
+#define CODE_NUM 1         // push value
+#define CODE_A 2           // push register
+#define CODE_X 3
+#define CODE_Y 4
+#define CODE_S 5
+#define CODE_PC 6
+#define CODE_FLAG 7        // push 1 if the flag with mask value is set, 0 otherwise
+#define CODE_MEM 8         // replace top with the byte at that address
+#define CODE_PC_BANK 9     // push
+#define CODE_DATA_BANK 10
+#define CODE_VALUE_READ 11
+#define CODE_VALUE_WRITE 12
+#define CODE_OP 13         // pop two, push the result of operator OP_xx in value
+
 extern uint16 debugLastAddress;
 extern uint8 debugLastOpcode;
 
+struct CondInstruction
+{
+	uint8 code;
+	uint32 value;
+};
+
 //mbg merge 7/18/06 turned into sane c++
 struct Condition
 {
@@ -61,6 +84,11 @@ struct Condition
 
 	unsigned int type2;
 	unsigned int value2;
+
+	// compiled program, only set on the root of a tree made by generateCondition
+	CondInstruction* code;
+	// stack depth the program needs
+	unsigned int codeDepth;
 };
 
 void freeTree(Condition* c);
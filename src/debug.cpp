@@ -8,12 +8,19 @@
 #include "debug.h"
 #include "driver.h"
 #include "ppu.h"
+#include "tracelog.h"
+#include "reversedebug.h"
+#include "cdlog.h"
 
 #include "x6502abbrev.h"
 
 #include <cstdlib>
 #include <cstring>
 
+#ifdef WIN32
+extern volatile int logging; //the trace logger of the windows port
+#endif
+
 unsigned int debuggerPageSize = 14;
 int vblankScanLines = 0;	//Used to calculate scanlines 240-261 (vblank)
 int vblankPixel = 0;		//Used to calculate the pixels in vblank
@@ -310,8 +317,14 @@ uint8 GetPPUMem(uint8 A) {
 
 //---------------------
 
+static int wpTrapValue = -1; //value being written by a write breakpoint's trapping handler
+
 uint8 evaluateWrite(uint8 opcode, uint16 address)
 {
+	//the trapped write already knows the value
+	if (wpTrapValue != -1)
+		return wpTrapValue;
+
 	// predicts value written by this opcode
 	switch (opwrite[opcode])
 	{
@@ -336,9 +349,63 @@ uint8 evaluateWrite(uint8 opcode, uint16 address)
 	return 0;
 }
 
-// Evaluates a condition
+// Runs the program compiled from a condition tree
+static int execute(const CondInstruction* code, int* stack)
+{
+	int* top = stack - 1;
+	for (;; code++)
+	{
+		switch (code->code)
+		{
+			case CODE_END: return *top;
+			case CODE_NUM: *++top = code->value; break;
+			case CODE_A: *++top = _A; break;
+			case CODE_X: *++top = _X; break;
+			case CODE_Y: *++top = _Y; break;
+			case CODE_S: *++top = _S; break;
+			case CODE_PC: *++top = _PC; break;
+			case CODE_FLAG: *++top = (_P & code->value) ? 1 : 0; break;
+			case CODE_MEM: *top = GetMem(*top); break;
+			case CODE_PC_BANK: *++top = getBank(_PC); break;
+			case CODE_DATA_BANK: *++top = getBank(debugLastAddress); break;
+			case CODE_VALUE_READ: *++top = GetMem(debugLastAddress); break;
+			case CODE_VALUE_WRITE: *++top = evaluateWrite(debugLastOpcode, debugLastAddress); break;
+			case CODE_OP:
+			{
+				int value2 = *top--;
+				int value1 = *top;
+				int f = value1;
+				switch (code->value)
+				{
+					case OP_EQ: f = value1 == value2; break;
+					case OP_NE: f = value1 != value2; break;
+					case OP_GE: f = value1 >= value2; break;
+					case OP_LE: f = value1 <= value2; break;
+					case OP_G: f = value1 > value2; break;
+					case OP_L: f = value1 < value2; break;
+					case OP_MULT: f = value1 * value2; break;
+					case OP_DIV: f = (value2==0) ? 0 : (value1 / value2); break;
+					case OP_PLUS: f = value1 + value2; break;
+					case OP_MINUS: f = value1 - value2; break;
+					case OP_OR: f = value1 || value2; break;
+					case OP_AND: f = value1 && value2; break;
+				}
+				*top = f;
+				break;
+			}
+		}
+	}
+}
+
+// Evaluates a condition.
+// A register or flag on the right of an operator is read like one on the left.
 int evaluate(Condition* c)
 {
+	// very deeply nested conditions fall back to walking the tree
+	int stack[64];
+	if (c->code && c->codeDepth <= 64)
+		return execute(c->code, stack);
+
 	int f = 0;
 
 	int value1, value2;
@@ -380,7 +447,7 @@ int evaluate(Condition* c)
 			{
 				case TYPE_ADDR: // This is intended to not break, and use the TYPE_NUM code
 				case TYPE_NUM: value2 = c->value2; break;
-				default: value2 = getValue(c->type2); break;
+				default: value2 = getValue(c->value2); break;
 			}
 		}
 
@@ -437,6 +504,7 @@ void LogCDVectors(int which){
 	if(!(cdloggerdata[j] & 2)){
 		cdloggerdata[j] |= 0x0E; // we're in the last bank and recording it as data so 0x1110 or 0xE should be what we need
 		datacount++;
+		FCEU_CDLogCountData(j);
 		if(!(cdloggerdata[j] & 1))undefinedcount--;
 	}
 	j++;
@@ -444,6 +512,7 @@ void LogCDVectors(int which){
 	if(!(cdloggerdata[j] & 2)){
 		cdloggerdata[j] |= 0x0E;
 		datacount++;
+		FCEU_CDLogCountData(j);
 		if(!(cdloggerdata[j] & 1))undefinedcount--;
 	}
 }
@@ -460,6 +529,7 @@ void LogCDData(uint8 *opcode, uint16 A, int size) {
 			cdloggerdata[j+i] |= ((_PC & 0x8000) >> 8) ^ 0x80;	// 19/07/14 used last reserved bit, if bit 7 is 1, then code is running from lowe area (6000)
 			if(indirectnext)cdloggerdata[j+i] |= 0x10;
 			codecount++;
+			FCEU_CDLogCountCode(j+i);
 			if(!(cdloggerdata[j+i] & 2))undefinedcount--;
 		}
 
@@ -480,6 +550,7 @@ void LogCDData(uint8 *opcode, uint16 A, int size) {
 			cdloggerdata[j] |=(A>>11)&0x0c;
 			cdloggerdata[j] |= memop;
 			datacount++;
+			FCEU_CDLogCountData(j);
 			if(!(cdloggerdata[j] & 1))undefinedcount--;
 		}
 	}
@@ -521,6 +592,8 @@ void ResetCyclesCounter()
 void ResetInstructionsCounter()
 {
 	total_instructions = delta_instructions = 0;
+	//the reverse debugger tells instructions apart by this counter
+	FCEU_ReverseClear();
 }
 void ResetDebugStatisticsDeltaCounters()
 {
@@ -533,6 +606,225 @@ void IncrementInstructionsCounters()
 	delta_instructions++;
 }
 
+//Execute breakpoints are checked for every instruction, so they are indexed by the pages their range
+//covers, one bit per watchpoint; breakpoint() then only looks at the few covering the current PC.
+//Read and write breakpoints (CPU, PPU and sprite) cost nothing per instruction: trapping handlers are
+//spliced into ARead/BWrite for the addresses they watch only, and every other address keeps its
+//original handler. The debugger windows edit watchpoint[] directly, so all of this is checked
+//against a shadow copy of the list once per frame and after every break.
+static uint64 wpExecPages[256];    //CPU breakpoints with WP_X, by page of the address range
+static uint64 wpTrapMask;          //read/write breakpoints, handled by the trapping handlers
+static uint64 wpForbidMask;        //forbid zones
+static int wpIndexNum = -1;
+static struct { uint16 address, endaddress; uint8 flags; } wpIndexShadow[64];
+
+uint32 watchpointTrapBits[2][0x10000 >> 5]; //addresses routed through the trapping handlers, [0] reads, [1] writes
+static bool wpExecCheck;           //whether breakpoint() has anything to look at for every instruction
+static int wpTrapHit = -1;         //breakpoint hit by a trapped access, taken before the next instruction
+static uint16 wpInstructionPC;     //address of the instruction being executed, for the trapped accesses
+static uint16 wpTrapPC;            //address of the instruction whose access hit wpTrapHit
+int debugBreakAccessPC = -1;
+
+static INLINE bool IsTrapped(int type, uint32 A)
+{
+	return (watchpointTrapBits[type][A >> 5] & (1u << (A & 31))) != 0;
+}
+
+static INLINE void SetTrapped(int type, uint32 A)
+{
+	watchpointTrapBits[type][A >> 5] |= 1u << (A & 31);
+}
+
+//the PPU registers are mirrored every 8 bytes up to $3FFF
+static void SetTrappedPPURegister(int type, uint32 reg)
+{
+	for (uint32 A = 0x2000 | reg; A < 0x4000; A += 8)
+		SetTrapped(type, A);
+}
+
+static void WatchpointTrap(uint32 A, uint8 type)
+{
+	if (fceuindbg || wpTrapHit != -1)
+		return;
+
+	//the conditions and forbid zones are evaluated as if at the start of the instruction,
+	//like the execute breakpoints, but on the address that was actually accessed
+	const uint16 pc = _PC;
+	_PC = wpInstructionPC;
+	debugLastAddress = A;
+
+	uint64 traps = wpTrapMask;
+	for (int i = 0; traps; traps >>= 1, i++)
+	{
+		const watchpointinfo& wp = watchpoint[i];
+		if (!(traps & 1) || !(wp.flags & type))
+			continue;
+
+		uint32 addr = A;
+		if (wp.flags & BT_P)
+		{
+			if (A < 0x2000 || A >= 0x4000 || (A & 7) != 7)
+				continue;
+			addr = FCEUPPU_PeekAddress();
+		} else if (wp.flags & BT_S)
+		{
+			if (A == 0x4014)
+			{
+				// Sprite DMA! :P
+				if (CondForbidTest(i))
+				{
+					wpTrapHit = i;
+					wpTrapPC = wpInstructionPC;
+					break;
+				}
+				continue;
+			}
+			if (A < 0x2000 || A >= 0x4000 || (A & 7) != 4)
+				continue;
+			addr = PPU[3];
+		}
+
+		if ((wp.endaddress ? (wp.address <= addr && wp.endaddress >= addr) : wp.address == addr) && CondForbidTest(i))
+		{
+			wpTrapHit = i;
+			wpTrapPC = wpInstructionPC;
+			break;
+		}
+	}
+
+	_PC = pc;
+}
+
+static DECLFR(WatchpointReadTrap)
+{
+	if (IsTrapped(0, A))
+		WatchpointTrap(A, WP_R);
+	return FCEU_SpliceReadNext(SPLICE_WATCHPOINT, A);
+}
+
+static DECLFW(WatchpointWriteTrap)
+{
+	if (IsTrapped(1, A))
+	{
+		wpTrapValue = V;
+		WatchpointTrap(A, WP_W);
+		wpTrapValue = -1;
+	}
+	FCEU_SpliceWriteNext(SPLICE_WATCHPOINT, A, V);
+}
+
+//zero page and stack writes bypass BWrite, so the CPU core calls this for them instead
+void WatchpointRAMWrite(uint32 A, uint8 V)
+{
+	wpTrapValue = V;
+	WatchpointTrap(A, WP_W);
+	wpTrapValue = -1;
+}
+
+//routes every trapped address through the trapping handlers, and takes them out of every address
+//which is no longer trapped. the lua memory hooks and cheats splice theirs in the same way.
+static void SpliceWatchpointHandlers()
+{
+	if (!GameInfo)
+		return;
+
+	for (int page = 0; page < 0x100; page++)
+	{
+		bool trapped = false;
+		for (int i = 0; i < 8; i++)
+			trapped |= (watchpointTrapBits[0][(page << 3) + i] | watchpointTrapBits[1][(page << 3) + i]) != 0;
+		if (!trapped && !FCEU_IsSplicePage(page))
+			continue;
+
+		for (int a = page << 8; a != (page + 1) << 8; a++)
+		{
+			if (IsTrapped(0, a) != FCEU_IsSplicedRead(SPLICE_WATCHPOINT, a))
+				FCEU_SpliceRead(SPLICE_WATCHPOINT, a, IsTrapped(0, a) ? WatchpointReadTrap : NULL);
+			if (IsTrapped(1, a) != FCEU_IsSplicedWrite(SPLICE_WATCHPOINT, a))
+				FCEU_SpliceWrite(SPLICE_WATCHPOINT, a, IsTrapped(1, a) ? WatchpointWriteTrap : NULL);
+		}
+	}
+}
+
+static void RebuildWatchpointIndex()
+{
+	memset(wpExecPages, 0, sizeof(wpExecPages));
+	memset(watchpointTrapBits, 0, sizeof(watchpointTrapBits));
+	wpTrapMask = wpForbidMask = 0;
+	wpExecCheck = false;
+	wpTrapHit = -1;
+
+	wpIndexNum = numWPs;
+	for (int i = 0; i < numWPs; i++)
+	{
+		const watchpointinfo& wp = watchpoint[i];
+		wpIndexShadow[i].address = wp.address;
+		wpIndexShadow[i].endaddress = wp.endaddress;
+		wpIndexShadow[i].flags = wp.flags;
+
+		if (!(wp.flags & WP_E))
+			continue;
+
+		const uint64 bit = (uint64)1 << i;
+		if (wp.flags & WP_F)
+			wpForbidMask |= bit;
+
+		if (wp.flags & (BT_P | BT_S))
+		{
+			//PPU and sprite memory is only reachable through the PPU registers
+			wpTrapMask |= bit;
+			for (int type = 0; type < 2; type++)
+			{
+				if (!(wp.flags & (type ? WP_W : WP_R)))
+					continue;
+				SetTrappedPPURegister(type, (wp.flags & BT_P) ? 7 : 4);
+				if ((wp.flags & BT_S) && type)
+					SetTrapped(type, 0x4014);
+			}
+			continue;
+		}
+
+		//an inverted range never matches anything
+		if (wp.endaddress && wp.endaddress < wp.address)
+			continue;
+		const int last = wp.endaddress ? wp.endaddress : wp.address;
+		if (wp.flags & WP_X)
+		{
+			for (int page = wp.address >> 8; page <= (last >> 8); page++)
+				wpExecPages[page] |= bit;
+			wpExecCheck = true;
+		}
+		if (wp.flags & (WP_R | WP_W))
+		{
+			wpTrapMask |= bit;
+			for (int A = wp.address; A <= last; A++)
+			{
+				if (wp.flags & WP_R)
+					SetTrapped(0, A);
+				if (wp.flags & WP_W)
+					SetTrapped(1, A);
+			}
+		}
+	}
+
+	SpliceWatchpointHandlers();
+}
+
+void UpdateWatchpointIndex(bool handlersReset)
+{
+	bool valid = (wpIndexNum == numWPs);
+	for (int i = 0; valid && i < numWPs; i++)
+	{
+		valid = wpIndexShadow[i].address == watchpoint[i].address
+			&& wpIndexShadow[i].endaddress == watchpoint[i].endaddress
+			&& wpIndexShadow[i].flags == watchpoint[i].flags;
+	}
+	if (!valid)
+		RebuildWatchpointIndex();
+	else if (handlersReset)
+		SpliceWatchpointHandlers();
+}
+
 bool CondForbidTest(int bp_num) {
 	if (bp_num >= 0 && !condition(&watchpoint[bp_num]))
 	{
@@ -540,12 +832,13 @@ bool CondForbidTest(int bp_num) {
 	}
 
 	//check to see whether we fall in any forbid zone
-	for (int i = 0; i < numWPs; i++)
+	uint64 forbid = wpForbidMask;
+	for (int i = 0; forbid; forbid >>= 1, i++)
 	{
-		watchpointinfo& wp = watchpoint[i];
-		if (!(wp.flags & WP_F) || !(wp.flags & WP_E))
+		if (!(forbid & 1))
 			continue;
 
+		watchpointinfo& wp = watchpoint[i];
 		if (condition(&wp))
 		{
 			if (wp.endaddress) {
@@ -563,22 +856,26 @@ bool CondForbidTest(int bp_num) {
 
 void BreakHit(int bp_num)
 {
+	if (reverseMode == REVERSE_SCAN)
+	{
+		//the reverse debugger is looking for the previous hit; don't stop
+		FCEU_ReverseScanBreak(bp_num);
+		return;
+	}
+
 	FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED); //mbg merge 7/19/06 changed to use EmulationPaused()
 
 //#ifdef WIN32
 	FCEUD_DebugBreakpoint(bp_num);
 //#endif
-}
 
-int StackAddrBackup;
-uint16 StackNextIgnorePC = 0xFFFF;
+	//the watchpoints may have been edited while we were stopped
+	UpdateWatchpointIndex(false);
+}
 
 ///fires a breakpoint
 static void breakpoint(uint8 *opcode, uint16 A, int size) {
-	int i, j;
-	uint8 brk_type;
-	uint8 stackop=0;
-	uint8 stackopstartaddr,stackopendaddr;
+	int i;
 
 	debugLastAddress = A;
 	debugLastOpcode = opcode[0];
@@ -612,6 +909,17 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		}
 	}
 
+	//a read or write breakpoint was hit by the previous instruction; stopping here also completes a step
+	if (wpTrapHit != -1) {
+		const int hit = wpTrapHit;
+		wpTrapHit = -1;
+		dbgstate.step = false;
+		debugBreakAccessPC = wpTrapPC;
+		BreakHit(hit);
+		debugBreakAccessPC = -1;
+		return;
+	}
+
 	//if we're stepping, then we'll always want to break
 	if (dbgstate.step) {
 		dbgstate.step = false;
@@ -640,204 +948,64 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		return;
 	}
 
-	brk_type = opbrktype[opcode[0]] | WP_X;
-
-	switch (opcode[0]) {
-		//Push Ops
-		case 0x08: //Fall to next
-		case 0x48: debugLastAddress=stackopstartaddr=stackopendaddr=X.S-1; stackop=WP_W; StackAddrBackup = X.S; StackNextIgnorePC=_PC+1; break;
-		//Pull Ops
-		case 0x28: //Fall to next
-		case 0x68: debugLastAddress=stackopstartaddr=stackopendaddr=X.S+1; stackop=WP_R; StackAddrBackup = X.S; StackNextIgnorePC=_PC+1; break;
-		//JSR (Includes return address - 1)
-		case 0x20: stackopstartaddr=stackopendaddr=X.S-1; stackop=WP_W; StackAddrBackup = X.S; StackNextIgnorePC=(opcode[1]|opcode[2]<<8); break;
-		//RTI (Includes processor status, and exact return address)
-		case 0x40: stackopstartaddr=X.S+1; stackopendaddr=X.S+3; stackop=WP_R; StackAddrBackup = X.S; StackNextIgnorePC=(GetMem(X.S+2|0x0100)|GetMem(X.S+3|0x0100)<<8); break;
-		//RTS (Includes return address - 1)
-		case 0x60: stackopstartaddr=X.S+1; stackopendaddr=X.S+2; stackop=WP_R; StackAddrBackup = X.S; StackNextIgnorePC=(GetMem(stackopstartaddr|0x0100)|GetMem(stackopendaddr|0x0100)<<8)+1; break;
-		default: break;
-	}
-
-#define BREAKHIT(x) { if (CondForbidTest(x)) { breakHit = (x); goto STOPCHECKING; } }
+	//only the execute breakpoints covering the page of PC can match
 	int breakHit = -1;
-	for (i = 0; i < numWPs; i++)
+	uint64 candidates = wpExecPages[_PC >> 8];
+	for (i = 0; candidates; candidates >>= 1, i++)
 	{
-		if ((watchpoint[i].flags & WP_E))
+		if (!(candidates & 1))
+			continue;
+
+		if (watchpoint[i].endaddress)
 		{
-			if (watchpoint[i].flags & BT_P)
-			{
-				// PPU Mem breaks
-				if ((watchpoint[i].flags & brk_type) && ((A >= 0x2000) && (A < 0x4000)) && ((A&7) == 7))
-				{
-					const uint32 PPUAddr = FCEUPPU_PeekAddress();
-					if (watchpoint[i].endaddress)
-					{
-						if ((watchpoint[i].address <= PPUAddr) && (watchpoint[i].endaddress >= PPUAddr))
-							BREAKHIT(i);
-					} else
-					{
-						if (watchpoint[i].address == PPUAddr)
-							BREAKHIT(i);
-					}
-				}
-			} else if (watchpoint[i].flags & BT_S)
+			if ((watchpoint[i].address <= _PC) && (watchpoint[i].endaddress >= _PC) && CondForbidTest(i))
 			{
-				// Sprite Mem breaks
-				if ((watchpoint[i].flags & brk_type) && ((A >= 0x2000) && (A < 0x4000)) && ((A&7) == 4))
-				{
-					if (watchpoint[i].endaddress)
-					{
-						if ((watchpoint[i].address <= PPU[3]) && (watchpoint[i].endaddress >= PPU[3]))
-							BREAKHIT(i);
-					} else
-					{
-						if (watchpoint[i].address == PPU[3])
-						BREAKHIT(i);
-					}
-				} else if ((watchpoint[i].flags & WP_W) && (A == 0x4014))
-				{
-					// Sprite DMA! :P
-					BREAKHIT(i);
-				}
-			} else
+				breakHit = i;
+				break;
+			}
+		} else
+		{
+			if ((watchpoint[i].address == _PC) && CondForbidTest(i))
 			{
-				// CPU mem breaks
-				if ((watchpoint[i].flags & brk_type))
-				{
-					if (watchpoint[i].endaddress)
-					{
-						if (((watchpoint[i].flags & (WP_R | WP_W)) && (watchpoint[i].address <= A) && (watchpoint[i].endaddress >= A)) ||
-							((watchpoint[i].flags & WP_X) && (watchpoint[i].address <= _PC) && (watchpoint[i].endaddress >= _PC)))
-							BREAKHIT(i);
-					} else
-					{
-						if (((watchpoint[i].flags & (WP_R | WP_W)) && (watchpoint[i].address == A)) ||
-							((watchpoint[i].flags & WP_X) && (watchpoint[i].address == _PC)))
-							BREAKHIT(i);
-					}
-				} else
-				{
-					// brk_type independant coding
-					if (stackop > 0)
-					{
-						// Announced stack mem breaks
-						// PHA, PLA, PHP, and PLP affect the stack data.
-						// TXS and TSX only deal with the pointer.
-						if (watchpoint[i].flags & stackop)
-						{
-							for (j = (stackopstartaddr|0x0100); j <= (stackopendaddr|0x0100); j++)
-							{
-								if (watchpoint[i].endaddress)
-								{
-									if ((watchpoint[i].address <= j) && (watchpoint[i].endaddress >= j))
-										BREAKHIT(i);
-								} else
-								{
-									if (watchpoint[i].address == j)
-										BREAKHIT(i);
-								}
-							}
-						}
-					}
-					if (StackNextIgnorePC == _PC)
-					{
-						// Used to make it ignore the unannounced stack code one time
-						StackNextIgnorePC = 0xFFFF;
-					} else
-					{
-						if (StackAddrBackup != -1 && (X.S < StackAddrBackup) && (stackop==0))
-						{
-							// Unannounced stack mem breaks
-							// Pushes to stack
-							if (watchpoint[i].flags & WP_W)
-							{
-								for (j = (X.S|0x0100); j < (StackAddrBackup|0x0100); j++)
-								{
-									if (watchpoint[i].endaddress)
-									{
-										if ((watchpoint[i].address <= j) && (watchpoint[i].endaddress >= j))
-											BREAKHIT(i);
-									} else
-									{
-										if (watchpoint[i].address == j)
-											BREAKHIT(i);
-									}
-								}
-							}
-						} else if (StackAddrBackup != -1 && (StackAddrBackup < X.S) && (stackop==0))
-						{
-							// Pulls from stack
-							if (watchpoint[i].flags & WP_R)
-							{
-								for (j = (StackAddrBackup|0x0100); j < (X.S|0x0100); j++)
-								{
-									if (watchpoint[i].endaddress)
-									{
-										if ((watchpoint[i].address <= j) && (watchpoint[i].endaddress >= j))
-											BREAKHIT(i);
-									} else
-									{
-										if (watchpoint[i].address == j)
-											BREAKHIT(i);
-									}
-								}
-							}
-						}
-					}
-
-				}
+				breakHit = i;
+				break;
 			}
 		}
-	} //loop across all breakpoints
-
-STOPCHECKING:
-	
-	//Update the stack address with the current one, now that changes have registered.
-	//ZEROMUS THINKS IT MAKES MORE SENSE HERE
-	StackAddrBackup = X.S;
+	}
 
 	if(breakHit != -1)
-		BreakHit(i);
-
-	////Update the stack address with the current one, now that changes have registered.
-	//StackAddrBackup = X.S;
+		BreakHit(breakHit);
 }
 //bbit edited: this is the end of the inserted code
 
-void DebugCycle()
+//reads what the debugger needs to decode an instruction. from PRG, the code is read straight from
+//the mapped banks and the pointers straight from zero page rather than through the read handlers
+template<bool fromPRG>
+static INLINE uint8 DebugPeek(uint16 A)
 {
-	uint8 opcode[3] = {0};
-	uint16 A = 0, tmp;
-	int size;
-
-	if (scanline == 240)
-	{
-		vblankScanLines = (PAL?int((double)timestamp / ((double)341 / (double)3.2)):timestamp / 114);	//114 approximates the number of timestamps per scanline during vblank.  Approx 2508. NTSC: (341 / 3.0) PAL: (341 / 3.2). Uses (3.? * cpu_cycles) / 341.0, and assumes 1 cpu cycle.
-		if (vblankScanLines) vblankPixel = 341 / vblankScanLines;	//341 pixels per scanline
-		//FCEUI_printf("vbPixel = %d",vblankPixel);					     //Debug
-		//FCEUI_printf("ts: %d line: %d\n", timestamp, vblankScanLines); //Debug
-	}
-	else
-		vblankScanLines = 0;
-
-	if (GameInfo->type==GIT_NSF)
-	{
-		if ((_PC >= 0x3801) && (_PC <= 0x3824)) return;
-	}
+	if (fromPRG)
+		return (A < 0x100) ? RAM[A] : Page[A >> 11][A];
+	return GetMem(A);
+}
 
-	opcode[0] = GetMem(_PC);
-	size = opsize[opcode[0]];
+//fetches the instruction at PC and the effective address of its operand
+template<bool fromPRG>
+static int DecodeInstruction(uint8 *opcode, uint16 &A)
+{
+	uint16 tmp;
+	opcode[0] = DebugPeek<fromPRG>(_PC);
+	const int size = opsize[opcode[0]];
 	switch (size)
 	{
 		default:
 		case 1: break;
 		case 2:
-			opcode[1] = GetMem(_PC + 1);
+			opcode[1] = DebugPeek<fromPRG>(_PC + 1);
 			break;
 		case 0: // illegal instructions may have operands
 		case 3:
-			opcode[1] = GetMem(_PC + 1);
-			opcode[2] = GetMem(_PC + 2);
+			opcode[1] = DebugPeek<fromPRG>(_PC + 1);
+			opcode[2] = DebugPeek<fromPRG>(_PC + 2);
 			break;
 	}
 
@@ -846,25 +1014,102 @@ void DebugCycle()
 		case 0: break;
 		case 1:
 			tmp = (opcode[1] + _X) & 0xFF;
-			A = GetMem(tmp);
+			A = DebugPeek<fromPRG>(tmp);
 			tmp = (opcode[1] + _X + 1) & 0xFF;
-			A |= (GetMem(tmp) << 8);
+			A |= (DebugPeek<fromPRG>(tmp) << 8);
 			break;
 		case 2: A = opcode[1]; break;
 		case 3: A = opcode[1] | (opcode[2] << 8); break;
-		case 4: A = (GetMem(opcode[1]) | (GetMem((opcode[1] + 1) & 0xFF) << 8)) + _Y; break;
+		case 4: A = (DebugPeek<fromPRG>(opcode[1]) | (DebugPeek<fromPRG>((opcode[1] + 1) & 0xFF) << 8)) + _Y; break;
 		case 5: A = opcode[1] + _X; break;
 		case 6: A = (opcode[1] | (opcode[2] << 8)) + _Y; break;
 		case 7: A = (opcode[1] | (opcode[2] << 8)) + _X; break;
 		case 8: A = opcode[1] + _Y; break;
 	}
+	return size;
+}
+
+//the CDL on its own: code in a bank read by CartBR (the usual case) is decoded without GetMem
+static void LogCDInstruction()
+{
+	uint8 opcode[3] = {0};
+	uint16 A = 0;
+	int size;
+	if (_PC >= 0x6000 && _PC < 0xFFFE && ARead[_PC] == CartBR && ARead[_PC + 2] == CartBR)
+		size = DecodeInstruction<true>(opcode, A);
+	else
+		size = DecodeInstruction<false>(opcode, A);
+	LogCDData(opcode, A, size);
+}
+
+void DebugCycle()
+{
+	uint8 opcode[3] = {0};
+	uint16 A = 0;
+	int size;
+
+	if (scanline == 240)
+	{
+		vblankScanLines = (PAL?int((double)timestamp / ((double)341 / (double)3.2)):timestamp / 114);	//114 approximates the number of timestamps per scanline during vblank.  Approx 2508. NTSC: (341 / 3.0) PAL: (341 / 3.2). Uses (3.? * cpu_cycles) / 341.0, and assumes 1 cpu cycle.
+		if (vblankScanLines) vblankPixel = 341 / vblankScanLines;	//341 pixels per scanline
+		//FCEUI_printf("vbPixel = %d",vblankPixel);					     //Debug
+		//FCEUI_printf("ts: %d line: %d\n", timestamp, vblankScanLines); //Debug
+	}
+	else
+		vblankScanLines = 0;
+
+	if (GameInfo->type==GIT_NSF)
+	{
+		if ((_PC >= 0x3801) && (_PC <= 0x3824)) return;
+	}
 
-	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap)
+	//while the reverse debugger throws frames away or replays them, only its target instruction matters
+	if (reverseMode == REVERSE_DISCARD || (reverseMode == REVERSE_SEEK && total_instructions != reverseTarget))
+		return;
+
+	wpInstructionPC = _PC;
+
+	const bool checkBreakpoints = wpExecCheck || wpTrapHit != -1 || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap;
+	if (!checkBreakpoints && reverseMode == REVERSE_OFF && !traceLogRecording
+#ifdef WIN32
+		&& !logging
+#endif
+		)
+	{
+		//nothing but the CDL looks at this instruction, if even that
+		if (debug_loggingCD)
+			LogCDInstruction();
+		return;
+	}
+
+	size = DecodeInstruction<false>(opcode, A);
+
+	if (reverseMode == REVERSE_SEEK)
+	{
+		reverseMode = REVERSE_OFF;
+		wpTrapHit = -1; //left over from the replay
+		debugLastAddress = A;
+		debugLastOpcode = opcode[0];
+		BreakHit(reverseTargetBreak);
+		return;
+	}
+	if (reverseMode == REVERSE_SCAN)
+	{
+		FCEU_ReverseScanInstruction(opcode[0]);
+		if (wpExecCheck || wpTrapHit != -1)
+			breakpoint(opcode, A, size);
+		return;
+	}
+
+	if (checkBreakpoints)
 		breakpoint(opcode, A, size);
 
 	if(debug_loggingCD)
 		LogCDData(opcode, A, size);
 
+	if(traceLogRecording)
+		FCEU_TraceLogInstruction(opcode, A, size);
+
 #ifdef WIN32
 	//This needs to be windows only or else the linux build system will fail since logging is declared in a
 	//windows source file
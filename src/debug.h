@@ -110,6 +110,15 @@ extern void ResetCyclesCounter();
 extern void ResetInstructionsCounter();
 extern void ResetDebugStatisticsDeltaCounters();
 extern void IncrementInstructionsCounters();
+
+//read and write breakpoints are implemented by trapping handlers spliced into ARead/BWrite.
+//this has to be redone whenever the emulator reinstalls the handler tables (power, reset).
+void UpdateWatchpointIndex(bool handlersReset);
+extern uint32 watchpointTrapBits[2][0x10000 >> 5];
+void WatchpointRAMWrite(uint32 A, uint8 V);
+//they stop after the instruction that made the access; while such a break is reported, this is
+//the address of that instruction, otherwise -1
+extern int debugBreakAccessPC;
 //-------------
 
 //internal variables that debuggers will want access to
@@ -205,6 +205,23 @@ int FCEUI_SetCheat(uint32 which, const char *name, int32 a, int32 v, int compare
 
 void FCEUI_CheatSearchShowExcluded(void);
 void FCEUI_CheatSearchSetCurrentAsOriginal(void);
+//values searched for are 1, 2 or 4 bytes, little endian
+void FCEUI_CheatSearchSetFormat(int size, bool isSigned);
+void FCEUI_CheatSearchGetFormat(int *size, bool *isSigned);
+//keeps the candidates for which the comparison holds. op is one of FCEU_SEARCH_OP_*, operand one of FCEU_SEARCH_VS_*
+void FCEUI_CheatSearchFilter(int op, int operand, uint32 value);
+//goes back to the candidates before the last search step
+bool FCEUI_CheatSearchUndo(void);
+int FCEUI_CheatSearchUndoCount(void);
+//like FCEUI_CheatSearchGetRange, with values of the size set by FCEUI_CheatSearchSetFormat
+void FCEUI_CheatSearchGetValues(uint32 first, uint32 last, int (*callb)(uint32 a, uint32 last, uint32 current, void *data), void *data);
+//counts how often each value changes from a frame to the next, for FCEU_SEARCH_VS_CHANGES
+void FCEUI_CheatSearchSetChangeCounting(bool enabled);
+void FCEUI_CheatSearchResetChangeCounts(void);
+int FCEUI_CheatSearchGetChangeCount(uint32 a);
+//repeats a search at the end of every frame, comparing with the frame before
+void FCEUI_CheatSearchSetAuto(bool enabled, int op, int operand, uint32 value);
+bool FCEUI_CheatSearchGetAuto(void);
 
 //.rom
 #define FCEUIOD_ROMS    0	//Roms
@@ -23,6 +23,15 @@
 
 #include "hq2x.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HQ_SSE2
+#include <emmintrin.h>
+#endif
+#include "simd.h"
+#ifdef SIMD_DISPATCH
+#define HQ_AVX2
+#endif
+
 static int *LUT16to32=NULL;
 static int *RGBtoYUV=NULL;
 static const int   Ymask = 0x00FF0000;
@@ -149,12 +158,152 @@ static inline int Diff(unsigned int w1, unsigned int w2)
 
 }
 
+// YUV of a row of 16 bit pixels, for hq_RowPatterns: yuv[1..Xres], with the edge pixels
+// repeated in yuv[0] and yuv[Xres+1], like the filters do with the pixels past the edges
+void hq_RowYUV( const int * RGBtoYUV, const unsigned char * pIn, int Xres, int * yuv )
+{
+  const unsigned short *p = (const unsigned short*)pIn;
+  int i;
+
+  for (i=0; i<Xres; i++)
+    yuv[i+1] = RGBtoYUV[p[i]];
+  yuv[0] = yuv[1];
+  yuv[Xres+1] = yuv[Xres];
+}
+
+#ifdef HQ_SSE2
+static inline __m128i YUVDiff( __m128i yuv1, __m128i yuv2, __m128i mask, __m128i tr, __m128i ntr )
+{
+  __m128i d = _mm_sub_epi32(_mm_and_si128(yuv1, mask), _mm_and_si128(yuv2, mask));
+  return _mm_or_si128(_mm_cmpgt_epi32(d, tr), _mm_cmplt_epi32(d, ntr));
+}
+
+// the pattern bits of 4 pixels
+static inline __m128i PatternSSE2( const int * prev, const int * cur, const int * next )
+{
+  const __m128i ym = _mm_set1_epi32(Ymask), um = _mm_set1_epi32(Umask), vm = _mm_set1_epi32(Vmask);
+  const __m128i ty = _mm_set1_epi32(trY), tu = _mm_set1_epi32(trU), tv = _mm_set1_epi32(trV);
+  const __m128i nty = _mm_set1_epi32(-trY), ntu = _mm_set1_epi32(-trU), ntv = _mm_set1_epi32(-trV);
+  const int *w[8] = { prev-1, prev, prev+1, cur-1, cur+1, next-1, next, next+1 };
+  __m128i yuv1 = _mm_loadu_si128((const __m128i*)cur);
+  __m128i pattern = _mm_setzero_si128();
+  int k;
+
+  for (k=0; k<8; k++)
+  {
+    __m128i yuv2 = _mm_loadu_si128((const __m128i*)w[k]);
+    __m128i diff = _mm_or_si128(_mm_or_si128(YUVDiff(yuv1, yuv2, ym, ty, nty), YUVDiff(yuv1, yuv2, um, tu, ntu)),
+                                YUVDiff(yuv1, yuv2, vm, tv, ntv));
+    pattern = _mm_or_si128(pattern, _mm_and_si128(diff, _mm_set1_epi32(1<<k)));
+  }
+  return pattern;
+}
+#endif
+
+#ifdef HQ_AVX2
+__attribute__((target("avx2")))
+static inline __m256i YUVDiffAVX2( __m256i yuv1, __m256i yuv2, __m256i mask, __m256i tr )
+{
+  __m256i d = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_and_si256(yuv1, mask), _mm256_and_si256(yuv2, mask)));
+  return _mm256_cmpgt_epi32(d, tr);
+}
+
+// the pattern bits of 8 pixels
+__attribute__((target("avx2")))
+static inline __m256i PatternAVX2( const int * prev, const int * cur, const int * next )
+{
+  const __m256i ym = _mm256_set1_epi32(Ymask), um = _mm256_set1_epi32(Umask), vm = _mm256_set1_epi32(Vmask);
+  const __m256i ty = _mm256_set1_epi32(trY), tu = _mm256_set1_epi32(trU), tv = _mm256_set1_epi32(trV);
+  const int *w[8] = { prev-1, prev, prev+1, cur-1, cur+1, next-1, next, next+1 };
+  __m256i yuv1 = _mm256_loadu_si256((const __m256i*)cur);
+  __m256i pattern = _mm256_setzero_si256();
+  int k;
+
+  for (k=0; k<8; k++)
+  {
+    __m256i yuv2 = _mm256_loadu_si256((const __m256i*)w[k]);
+    __m256i diff = _mm256_or_si256(_mm256_or_si256(YUVDiffAVX2(yuv1, yuv2, ym, ty), YUVDiffAVX2(yuv1, yuv2, um, tu)),
+                                   YUVDiffAVX2(yuv1, yuv2, vm, tv));
+    pattern = _mm256_or_si256(pattern, _mm256_and_si256(diff, _mm256_set1_epi32(1<<k)));
+  }
+  return pattern;
+}
+
+// the patterns of the pixels of a row 8 at a time; returns how many were done
+__attribute__((target("avx2")))
+static int RowPatternsAVX2( const int * prev, const int * cur, const int * next, int Xres, unsigned char * pattern )
+{
+  int i;
+
+  for (i=0; i+8<=Xres; i+=8)
+  {
+    __m256i p = PatternAVX2(prev+i, cur+i, next+i);
+    __m128i p16 = _mm_packs_epi32(_mm256_castsi256_si128(p), _mm256_extracti128_si256(p, 1));
+    _mm_storel_epi64((__m128i*)(pattern+i), _mm_packus_epi16(p16, p16));
+  }
+  return i;
+}
+#endif
+
+// the pattern the hq filters switch on, for every pixel of a row: bit k-1 (k-2 past w5) is set
+// when w[k] is too far from w5 in YUV. prev, cur and next are rows from hq_RowYUV
+void hq_RowPatterns( const int * prev, const int * cur, const int * next, int Xres, unsigned char * pattern )
+{
+  int i = 0;
+
+  // skip the repeated edge pixel; the neighbours are at -1 and +1
+  prev++;
+  cur++;
+  next++;
+
+#ifdef HQ_AVX2
+  if (SimdLevel() >= SIMD_AVX2)
+    i = RowPatternsAVX2(prev, cur, next, Xres, pattern);
+#endif
+#ifdef HQ_SSE2
+  if (SimdLevel() >= SIMD_SSE2)
+  {
+    for (; i+4<=Xres; i+=4)
+    {
+      __m128i p = PatternSSE2(prev+i, cur+i, next+i);
+      p = _mm_packs_epi32(p, p);
+      int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+      memcpy(pattern+i, &bytes, 4);
+    }
+  }
+#endif
+  for (; i<Xres; i++)
+  {
+    const int *w[8] = { prev+i-1, prev+i, prev+i+1, cur+i-1, cur+i+1, next+i-1, next+i, next+i+1 };
+    int YUV1 = cur[i];
+    int k;
+
+    pattern[i] = 0;
+    for (k=0; k<8; k++)
+    {
+      int YUV2 = *w[k];
+      if ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
+           ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
+           ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) )
+        pattern[i] |= 1<<k;
+    }
+  }
+}
+
 void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL )
+{
+  hq2x_32_rows(pIn, pOut, Xres, Yres, BpL, 0, Yres);
+}
+
+// filters input rows first to last-1 only; the rows around them are read, but not written
+void hq2x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last )
 {
   int  i, j, k;
   int  prevline, nextline;
   int  w[10];
   int  c[10];
+  int  *yuvbuf, *yuvprev, *yuvcur, *yuvnext, *yuvtmp;
+  unsigned char *patterns;
 
   //   +----+----+----+
   //   |    |    |    |
@@ -167,16 +316,45 @@ void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  yuvbuf = (int*)malloc(3*(Xres+2)*sizeof(int));
+  patterns = (unsigned char*)malloc(Xres);
+  if (!yuvbuf || !patterns)
+  {
+    free(yuvbuf);
+    free(patterns);
+    return;
+  }
+  yuvprev = yuvbuf;
+  yuvcur = yuvprev + Xres+2;
+  yuvnext = yuvcur + Xres+2;
+
+  pIn += first*Xres*2;
+  pOut += first*2*BpL;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
 
+    // the patterns of the whole row are worked out first; the YUV rows move down with j
+    if (j==first)
+    {
+      hq_RowYUV(RGBtoYUV, pIn + prevline, Xres, yuvprev);
+      hq_RowYUV(RGBtoYUV, pIn, Xres, yuvcur);
+    }
+    else
+    {
+      yuvtmp = yuvprev;
+      yuvprev = yuvcur;
+      yuvcur = yuvnext;
+      yuvnext = yuvtmp;
+    }
+    hq_RowYUV(RGBtoYUV, pIn + nextline, Xres, yuvnext);
+    hq_RowPatterns(yuvprev, yuvcur, yuvnext, Xres, patterns);
+
     for (i=0; i<Xres; i++)
     {
       int pattern;
-      int flag;
-      int YUV1Y,YUV1U,YUV1V;
 
       w[2] = *((unsigned short*)(pIn + prevline));
       w[5] = *((unsigned short*)pIn);
@@ -208,37 +386,7 @@ void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
         w[9] = w[8];
       }
 
-      pattern = 0;
-      flag = 1;
-
-      YUV1Y = YUV1U = YUV1V = RGBtoYUV[w[5]];
-
-      YUV1Y &= Ymask;
-      YUV1U &= Umask;
-      YUV1V &= Vmask;
-
-      for (k=1; k<=9; k++)
-      {
-        if (k==5) continue;
-
-        if ( w[k] != w[5] )
-        {
-          int YUV2 = RGBtoYUV[w[k]];
-	  //int tmp;
-	  //tmp = 
-	  //((unsigned int)(0-abs(YUV1Y - (YUV2 & Ymask)))>>31) |
-	  //((unsigned int)(0-abs(YUV1U - (YUV2 & Umask)))>>31) |
-	  //((unsigned int)(0-abs(YUV1V - (YUV2 & Vmask)))>>31);
-
-	  //pattern|=tmp*flag;
-
-          if ( ( abs(YUV1Y - (YUV2 & Ymask)) > trY ) ||
-               ( abs(YUV1U - (YUV2 & Umask)) > trU ) ||
-               ( abs(YUV1V - (YUV2 & Vmask)) > trV ) )
-            pattern |= flag;
-        }
-        flag <<= 1;
-      }
+      pattern = patterns[i];
 
       for (k=1; k<=9; k++)
         c[k] = LUT16to32[w[k]];
@@ -2890,6 +3038,9 @@ void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
     }
     pOut+=BpL+(BpL-Xres*2*4);
   }
+
+  free(yuvbuf);
+  free(patterns);
 }
 
 int hq2x_InitLUTs(void)
@@ -1,4 +1,8 @@
 void hq2x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL);
+void hq2x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last);
+// used by hq2x and hq3x both, to find the pattern of every pixel of a row at once
+void hq_RowYUV( const int * RGBtoYUV, const unsigned char * pIn, int Xres, int * yuv );
+void hq_RowPatterns( const int * prev, const int * cur, const int * next, int Xres, unsigned char * pattern );
 int hq2x_InitLUTs(void);
 void hq2x_Kill(void);
 
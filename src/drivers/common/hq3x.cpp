@@ -22,10 +22,10 @@
 #include <stdlib.h>
 
 #include "hq3x.h"
+#include "hq2x.h"
 
 static int   *LUT16to32 = NULL;
 static int   *RGBtoYUV = NULL;
-static int   YUV1, YUV2;
 static const  int   Ymask = 0x00FF0000;
 static const  int   Umask = 0x0000FF00;
 static const  int   Vmask = 0x000000FF;
@@ -120,19 +120,27 @@ inline void Interp5(unsigned char * pc, int c1, int c2)
 
 static inline int Diff(unsigned int w1, unsigned int w2)
 {
-  YUV1 = RGBtoYUV[w1];
-  YUV2 = RGBtoYUV[w2];
+  int YUV1 = RGBtoYUV[w1];
+  int YUV2 = RGBtoYUV[w2];
   return ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
            ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
            ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) );
 }
 
 void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL )
+{
+  hq3x_32_rows(pIn, pOut, Xres, Yres, BpL, 0, Yres);
+}
+
+// filters input rows first to last-1 only; the rows around them are read, but not written
+void hq3x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last )
 {
   int  i, j, k;
   int  prevline, nextline;
   int  w[10];
   int  c[10];
+  int  *yuvbuf, *yuvprev, *yuvcur, *yuvnext, *yuvtmp;
+  unsigned char *patterns;
 
   //   +----+----+----+
   //   |    |    |    |
@@ -145,15 +153,45 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  yuvbuf = (int*)malloc(3*(Xres+2)*sizeof(int));
+  patterns = (unsigned char*)malloc(Xres);
+  if (!yuvbuf || !patterns)
+  {
+    free(yuvbuf);
+    free(patterns);
+    return;
+  }
+  yuvprev = yuvbuf;
+  yuvcur = yuvprev + Xres+2;
+  yuvnext = yuvcur + Xres+2;
+
+  pIn += first*Xres*2;
+  pOut += first*3*BpL;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
 
+    // the patterns of the whole row are worked out first; the YUV rows move down with j
+    if (j==first)
+    {
+      hq_RowYUV(RGBtoYUV, pIn + prevline, Xres, yuvprev);
+      hq_RowYUV(RGBtoYUV, pIn, Xres, yuvcur);
+    }
+    else
+    {
+      yuvtmp = yuvprev;
+      yuvprev = yuvcur;
+      yuvcur = yuvnext;
+      yuvnext = yuvtmp;
+    }
+    hq_RowYUV(RGBtoYUV, pIn + nextline, Xres, yuvnext);
+    hq_RowPatterns(yuvprev, yuvcur, yuvnext, Xres, patterns);
+
     for (i=0; i<Xres; i++)
     {
       int pattern;
-      int flag;
 
       w[2] = *((unsigned short*)(pIn + prevline));
       w[5] = *((unsigned short*)pIn);
@@ -185,25 +223,7 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
         w[9] = w[8];
       }
 
-      pattern = 0;
-      flag = 1;
-
-      YUV1 = RGBtoYUV[w[5]];
-
-      for (k=1; k<=9; k++)
-      {
-        if (k==5) continue;
-
-        if ( w[k] != w[5] )
-        {
-          YUV2 = RGBtoYUV[w[k]];
-          if ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
-               ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
-               ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) )
-            pattern |= flag;
-        }
-        flag <<= 1;
-      }
+      pattern = patterns[i];
 
       for (k=1; k<=9; k++)
         c[k] = LUT16to32[w[k]];
@@ -3830,6 +3850,9 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
     pOut+=BpL;
     pOut+=BpL;
   }
+
+  free(yuvbuf);
+  free(patterns);
 }
 
 int hq3x_InitLUTs(void)
@@ -1,4 +1,5 @@
 void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL);
+void hq3x_32_rows( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, int first, int last);
 int hq3x_InitLUTs(void);
 void hq3x_Kill(void);
 
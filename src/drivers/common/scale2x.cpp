@@ -37,6 +37,14 @@
 
 #include <assert.h>
 
+#if defined(SCALE2X_SSE2)
+#include <emmintrin.h>
+#endif
+#include "simd.h"
+#if defined(SCALE2X_SSE2) && defined(SIMD_DISPATCH)
+#define SCALE2X_AVX2
+#endif
+
 /***************************************************************************/
 /* Scale2x C implementation */
 
@@ -922,3 +930,223 @@ void scale2x_32_mmx(scale2x_uint32* dst0, scale2x_uint32* dst1, const scale2x_ui
 
 #endif
 
+/***************************************************************************/
+/* Scale2x SSE2 implementation */
+
+#if defined(SCALE2X_SSE2)
+
+/*
+ * The SSE2 implementation computes the central pixels of a row a vector at a
+ * time, with the same rules as the C implementation:
+ *
+ *      E0 = (B != H && D != F && D == B) ? D : E
+ *      E1 = (B != H && D != F && F == B) ? F : E
+ *
+ * D and F are read with unaligned loads one pixel to the left and to the right
+ * of E. When the central pixels aren't a multiple of the vector length the last
+ * vector overlaps the one before it; both write the same values.
+ * The border pixels are computed like in the C implementation.
+ * When the CPU has AVX2, 32 bytes are computed at a time, and the rest of
+ * the row with 16 bytes vectors.
+ */
+
+static inline void scale2x_sse2_select(__m128i* e0, __m128i* e1, __m128i B, __m128i E, __m128i DB, __m128i FB, __m128i BH, __m128i DF)
+{
+	__m128i keep = _mm_or_si128(BH, DF);
+	__m128i change = _mm_xor_si128(E, B);
+
+	*e0 = _mm_xor_si128(E, _mm_and_si128(change, _mm_andnot_si128(keep, DB)));
+	*e1 = _mm_xor_si128(E, _mm_and_si128(change, _mm_andnot_si128(keep, FB)));
+}
+
+#define SCALE2X_SSE2_BLOCK(name, type, cmpeq, unpacklo, unpackhi) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2) \
+{ \
+	__m128i B = _mm_loadu_si128((const __m128i*)src0); \
+	__m128i D = _mm_loadu_si128((const __m128i*)(src1 - 1)); \
+	__m128i E = _mm_loadu_si128((const __m128i*)src1); \
+	__m128i F = _mm_loadu_si128((const __m128i*)(src1 + 1)); \
+	__m128i H = _mm_loadu_si128((const __m128i*)src2); \
+	__m128i e0, e1; \
+	scale2x_sse2_select(&e0, &e1, B, E, cmpeq(D, B), cmpeq(F, B), cmpeq(B, H), cmpeq(D, F)); \
+	_mm_storeu_si128((__m128i*)dst, unpacklo(e0, e1)); \
+	_mm_storeu_si128((__m128i*)dst + 1, unpackhi(e0, e1)); \
+}
+
+SCALE2X_SSE2_BLOCK(scale2x_8_sse2_block, scale2x_uint8, _mm_cmpeq_epi8, _mm_unpacklo_epi8, _mm_unpackhi_epi8)
+SCALE2X_SSE2_BLOCK(scale2x_16_sse2_block, scale2x_uint16, _mm_cmpeq_epi16, _mm_unpacklo_epi16, _mm_unpackhi_epi16)
+SCALE2X_SSE2_BLOCK(scale2x_32_sse2_block, scale2x_uint32, _mm_cmpeq_epi32, _mm_unpacklo_epi32, _mm_unpackhi_epi32)
+
+#ifdef SCALE2X_AVX2
+
+__attribute__((target("avx2")))
+static inline void scale2x_avx2_select(__m256i* e0, __m256i* e1, __m256i B, __m256i E, __m256i DB, __m256i FB, __m256i BH, __m256i DF)
+{
+	__m256i keep = _mm256_or_si256(BH, DF);
+	__m256i change = _mm256_xor_si256(E, B);
+
+	*e0 = _mm256_xor_si256(E, _mm256_and_si256(change, _mm256_andnot_si256(keep, DB)));
+	*e1 = _mm256_xor_si256(E, _mm256_and_si256(change, _mm256_andnot_si256(keep, FB)));
+}
+
+/* the unpacks interleave each 128 bits lane on its own; the permutes put the lanes back in order */
+#define SCALE2X_AVX2_BLOCK(name, type, cmpeq, unpacklo, unpackhi) \
+__attribute__((target("avx2"))) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2) \
+{ \
+	__m256i B = _mm256_loadu_si256((const __m256i*)src0); \
+	__m256i D = _mm256_loadu_si256((const __m256i*)(src1 - 1)); \
+	__m256i E = _mm256_loadu_si256((const __m256i*)src1); \
+	__m256i F = _mm256_loadu_si256((const __m256i*)(src1 + 1)); \
+	__m256i H = _mm256_loadu_si256((const __m256i*)src2); \
+	__m256i e0, e1, lo, hi; \
+	scale2x_avx2_select(&e0, &e1, B, E, cmpeq(D, B), cmpeq(F, B), cmpeq(B, H), cmpeq(D, F)); \
+	lo = unpacklo(e0, e1); \
+	hi = unpackhi(e0, e1); \
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(lo, hi, 0x20)); \
+	_mm256_storeu_si256((__m256i*)dst + 1, _mm256_permute2x128_si256(lo, hi, 0x31)); \
+}
+
+SCALE2X_AVX2_BLOCK(scale2x_8_avx2_block, scale2x_uint8, _mm256_cmpeq_epi8, _mm256_unpacklo_epi8, _mm256_unpackhi_epi8)
+SCALE2X_AVX2_BLOCK(scale2x_16_avx2_block, scale2x_uint16, _mm256_cmpeq_epi16, _mm256_unpacklo_epi16, _mm256_unpackhi_epi16)
+SCALE2X_AVX2_BLOCK(scale2x_32_avx2_block, scale2x_uint32, _mm256_cmpeq_epi32, _mm256_unpacklo_epi32, _mm256_unpackhi_epi32)
+
+#endif
+
+/*
+ * Apply the Scale2x effect at a single row.
+ * This function must be called only by the other scale2x functions.
+ * The row must have at least 2 + 16 / sizeof(type) pixels.
+ */
+#define SCALE2X_SSE2_SINGLE(name, type, sse2_block, attr, avx2_loop) \
+attr static inline void name(type* dst, const type* src0, const type* src1, const type* src2, unsigned count) \
+{ \
+	const unsigned per_sse2 = 16 / sizeof(type); \
+	unsigned i = 1; \
+\
+	assert(count >= 2 + per_sse2); \
+\
+	/* first pixel */ \
+	dst[0] = src1[0]; \
+	if (src1[1] == src0[0] && src2[0] != src0[0]) \
+		dst[1] = src0[0]; \
+	else \
+		dst[1] = src1[0]; \
+\
+	/* central pixels */ \
+	avx2_loop \
+	for (; i + per_sse2 < count; i += per_sse2) \
+		sse2_block(dst + 2 * i, src0 + i, src1 + i, src2 + i); \
+	if (i < count - 1) { \
+		i = count - 1 - per_sse2; \
+		sse2_block(dst + 2 * i, src0 + i, src1 + i, src2 + i); \
+	} \
+\
+	/* last pixel */ \
+	i = count - 1; \
+	if (src1[i - 1] == src0[i] && src2[i] != src0[i]) \
+		dst[2 * i] = src0[i]; \
+	else \
+		dst[2 * i] = src1[i]; \
+	dst[2 * i + 1] = src1[i]; \
+}
+
+SCALE2X_SSE2_SINGLE(scale2x_8_sse2_single, scale2x_uint8, scale2x_8_sse2_block, , )
+SCALE2X_SSE2_SINGLE(scale2x_16_sse2_single, scale2x_uint16, scale2x_16_sse2_block, , )
+SCALE2X_SSE2_SINGLE(scale2x_32_sse2_single, scale2x_uint32, scale2x_32_sse2_block, , )
+
+#ifdef SCALE2X_AVX2
+/* the same, with the central pixels done 32 bytes at a time first */
+#define SCALE2X_AVX2_CENTRAL(avx2_block, per_avx2) \
+	for (; i + per_avx2 < count; i += per_avx2) \
+		avx2_block(dst + 2 * i, src0 + i, src1 + i, src2 + i);
+
+SCALE2X_SSE2_SINGLE(scale2x_8_avx2_single, scale2x_uint8, scale2x_8_sse2_block, __attribute__((target("avx2"))), SCALE2X_AVX2_CENTRAL(scale2x_8_avx2_block, 32))
+SCALE2X_SSE2_SINGLE(scale2x_16_avx2_single, scale2x_uint16, scale2x_16_sse2_block, __attribute__((target("avx2"))), SCALE2X_AVX2_CENTRAL(scale2x_16_avx2_block, 16))
+SCALE2X_SSE2_SINGLE(scale2x_32_avx2_single, scale2x_uint32, scale2x_32_sse2_block, __attribute__((target("avx2"))), SCALE2X_AVX2_CENTRAL(scale2x_32_avx2_block, 8))
+#endif
+
+/**
+ * Scale by a factor of 2 a row of pixels of 8 bits.
+ * This is a very fast SSE2 implementation, with the same output as
+ * scale2x_8_def(). Rows shorter than 18 pixels are left to scale2x_8_def().
+ * The pixels over the left and right borders are assumed of the same color of
+ * the pixels on the border.
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, double length in pixels.
+ * \param dst1 Second destination row, double length in pixels.
+ */
+void scale2x_8_sse2(scale2x_uint8* dst0, scale2x_uint8* dst1, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned count)
+{
+	if (count < 18 || SimdLevel() < SIMD_SSE2) {
+		scale2x_8_def(dst0, dst1, src0, src1, src2, count);
+#ifdef SCALE2X_AVX2
+	} else if (SimdLevel() >= SIMD_AVX2) {
+		scale2x_8_avx2_single(dst0, src0, src1, src2, count);
+		scale2x_8_avx2_single(dst1, src2, src1, src0, count);
+#endif
+	} else {
+		scale2x_8_sse2_single(dst0, src0, src1, src2, count);
+		scale2x_8_sse2_single(dst1, src2, src1, src0, count);
+	}
+}
+
+/**
+ * Scale by a factor of 2 a row of pixels of 16 bits.
+ * This function operates like scale2x_8_sse2() but for 16 bits pixels.
+ * Rows shorter than 10 pixels are left to scale2x_16_def().
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, double length in pixels.
+ * \param dst1 Second destination row, double length in pixels.
+ */
+void scale2x_16_sse2(scale2x_uint16* dst0, scale2x_uint16* dst1, const scale2x_uint16* src0, const scale2x_uint16* src1, const scale2x_uint16* src2, unsigned count)
+{
+	if (count < 10 || SimdLevel() < SIMD_SSE2) {
+		scale2x_16_def(dst0, dst1, src0, src1, src2, count);
+#ifdef SCALE2X_AVX2
+	} else if (SimdLevel() >= SIMD_AVX2) {
+		scale2x_16_avx2_single(dst0, src0, src1, src2, count);
+		scale2x_16_avx2_single(dst1, src2, src1, src0, count);
+#endif
+	} else {
+		scale2x_16_sse2_single(dst0, src0, src1, src2, count);
+		scale2x_16_sse2_single(dst1, src2, src1, src0, count);
+	}
+}
+
+/**
+ * Scale by a factor of 2 a row of pixels of 32 bits.
+ * This function operates like scale2x_8_sse2() but for 32 bits pixels.
+ * Rows shorter than 6 pixels are left to scale2x_32_def().
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, double length in pixels.
+ * \param dst1 Second destination row, double length in pixels.
+ */
+void scale2x_32_sse2(scale2x_uint32* dst0, scale2x_uint32* dst1, const scale2x_uint32* src0, const scale2x_uint32* src1, const scale2x_uint32* src2, unsigned count)
+{
+	if (count < 6 || SimdLevel() < SIMD_SSE2) {
+		scale2x_32_def(dst0, dst1, src0, src1, src2, count);
+#ifdef SCALE2X_AVX2
+	} else if (SimdLevel() >= SIMD_AVX2) {
+		scale2x_32_avx2_single(dst0, src0, src1, src2, count);
+		scale2x_32_avx2_single(dst1, src2, src1, src0, count);
+#endif
+	} else {
+		scale2x_32_sse2_single(dst0, src0, src1, src2, count);
+		scale2x_32_sse2_single(dst1, src2, src1, src0, count);
+	}
+}
+
+#endif
@@ -37,6 +37,11 @@
 
 #include <assert.h>
 
+#if defined(SCALE3X_SSE2)
+#include <emmintrin.h>
+#endif
+#include "simd.h"
+
 /***************************************************************************/
 /* Scale3x C implementation */
 
@@ -381,3 +386,245 @@ void scale3x_32_def(scale3x_uint32* dst0, scale3x_uint32* dst1, scale3x_uint32*
 	scale3x_32_def_border(dst2, src2, src1, src0, count);
 }
 
+/***************************************************************************/
+/* Scale3x SSE2 implementation */
+
+#if defined(SCALE3X_SSE2)
+
+/*
+ * The SSE2 implementation selects the central pixels of a row a vector at a
+ * time, with the same rules as the C implementation, and then interleaves the
+ * three selections into the destination row.
+ * Considering the pixel map :
+ *
+ *      ABC (src0)
+ *      DEF (src1)
+ *      GHI (src2)
+ *
+ * all the pixels are read with unaligned loads around E. When the central
+ * pixels aren't a multiple of the vector length the last vector overlaps the
+ * one before it; both write the same values.
+ * The border pixels are computed like in the C implementation.
+ */
+
+static inline __m128i scale3x_sse2_pick(__m128i E, __m128i X, __m128i mask)
+{
+	return _mm_xor_si128(E, _mm_and_si128(_mm_xor_si128(E, X), mask));
+}
+
+/* the first and the third destination rows */
+#define SCALE3X_SSE2_BORDER_BLOCK(name, type, cmpeq) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2) \
+{ \
+	enum { per = 16 / sizeof(type) }; \
+	__m128i A = _mm_loadu_si128((const __m128i*)(src0 - 1)); \
+	__m128i B = _mm_loadu_si128((const __m128i*)src0); \
+	__m128i C = _mm_loadu_si128((const __m128i*)(src0 + 1)); \
+	__m128i D = _mm_loadu_si128((const __m128i*)(src1 - 1)); \
+	__m128i E = _mm_loadu_si128((const __m128i*)src1); \
+	__m128i F = _mm_loadu_si128((const __m128i*)(src1 + 1)); \
+	__m128i H = _mm_loadu_si128((const __m128i*)src2); \
+	__m128i keep = _mm_or_si128(cmpeq(B, H), cmpeq(D, F)); \
+	__m128i DB = _mm_andnot_si128(keep, cmpeq(D, B)); \
+	__m128i FB = _mm_andnot_si128(keep, cmpeq(F, B)); \
+	__m128i mid = _mm_or_si128(_mm_andnot_si128(cmpeq(E, C), DB), _mm_andnot_si128(cmpeq(E, A), FB)); \
+	type e[3][per]; \
+	unsigned k; \
+	_mm_storeu_si128((__m128i*)e[0], scale3x_sse2_pick(E, B, DB)); \
+	_mm_storeu_si128((__m128i*)e[1], scale3x_sse2_pick(E, B, mid)); \
+	_mm_storeu_si128((__m128i*)e[2], scale3x_sse2_pick(E, B, FB)); \
+	for (k = 0; k < per; ++k) { \
+		dst[0] = e[0][k]; \
+		dst[1] = e[1][k]; \
+		dst[2] = e[2][k]; \
+		dst += 3; \
+	} \
+}
+
+/* the second destination row */
+#define SCALE3X_SSE2_CENTER_BLOCK(name, type, cmpeq) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2) \
+{ \
+	enum { per = 16 / sizeof(type) }; \
+	__m128i A = _mm_loadu_si128((const __m128i*)(src0 - 1)); \
+	__m128i B = _mm_loadu_si128((const __m128i*)src0); \
+	__m128i C = _mm_loadu_si128((const __m128i*)(src0 + 1)); \
+	__m128i D = _mm_loadu_si128((const __m128i*)(src1 - 1)); \
+	__m128i E = _mm_loadu_si128((const __m128i*)src1); \
+	__m128i F = _mm_loadu_si128((const __m128i*)(src1 + 1)); \
+	__m128i G = _mm_loadu_si128((const __m128i*)(src2 - 1)); \
+	__m128i H = _mm_loadu_si128((const __m128i*)src2); \
+	__m128i I = _mm_loadu_si128((const __m128i*)(src2 + 1)); \
+	__m128i keep = _mm_or_si128(cmpeq(B, H), cmpeq(D, F)); \
+	__m128i left = _mm_or_si128(_mm_andnot_si128(cmpeq(E, G), cmpeq(D, B)), _mm_andnot_si128(cmpeq(E, A), cmpeq(D, H))); \
+	__m128i right = _mm_or_si128(_mm_andnot_si128(cmpeq(E, I), cmpeq(F, B)), _mm_andnot_si128(cmpeq(E, C), cmpeq(F, H))); \
+	type e[2][per]; \
+	unsigned k; \
+	_mm_storeu_si128((__m128i*)e[0], scale3x_sse2_pick(E, D, _mm_andnot_si128(keep, left))); \
+	_mm_storeu_si128((__m128i*)e[1], scale3x_sse2_pick(E, F, _mm_andnot_si128(keep, right))); \
+	for (k = 0; k < per; ++k) { \
+		dst[0] = e[0][k]; \
+		dst[1] = src1[k]; \
+		dst[2] = e[1][k]; \
+		dst += 3; \
+	} \
+}
+
+SCALE3X_SSE2_BORDER_BLOCK(scale3x_8_sse2_border_block, scale3x_uint8, _mm_cmpeq_epi8)
+SCALE3X_SSE2_BORDER_BLOCK(scale3x_16_sse2_border_block, scale3x_uint16, _mm_cmpeq_epi16)
+SCALE3X_SSE2_BORDER_BLOCK(scale3x_32_sse2_border_block, scale3x_uint32, _mm_cmpeq_epi32)
+SCALE3X_SSE2_CENTER_BLOCK(scale3x_8_sse2_center_block, scale3x_uint8, _mm_cmpeq_epi8)
+SCALE3X_SSE2_CENTER_BLOCK(scale3x_16_sse2_center_block, scale3x_uint16, _mm_cmpeq_epi16)
+SCALE3X_SSE2_CENTER_BLOCK(scale3x_32_sse2_center_block, scale3x_uint32, _mm_cmpeq_epi32)
+
+/* the central pixels of a row, a vector at a time; the row must have at least 2 + 16 / sizeof(type) pixels */
+#define SCALE3X_SSE2_CENTRAL(block, type) \
+	{ \
+		const unsigned per = 16 / sizeof(type); \
+		unsigned i; \
+		for (i = 1; i + per < count; i += per) \
+			block(dst + 3 * i, src0 + i, src1 + i, src2 + i); \
+		if (i < count - 1) { \
+			i = count - 1 - per; \
+			block(dst + 3 * i, src0 + i, src1 + i, src2 + i); \
+		} \
+	}
+
+#define SCALE3X_SSE2_BORDER(name, type, block) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2, unsigned count) \
+{ \
+	/* first pixel */ \
+	dst[0] = src1[0]; \
+	dst[1] = src1[0]; \
+	if (src1[1] == src0[0] && src2[0] != src0[0]) \
+		dst[2] = src0[0]; \
+	else \
+		dst[2] = src1[0]; \
+\
+	/* central pixels */ \
+	SCALE3X_SSE2_CENTRAL(block, type) \
+\
+	/* last pixel */ \
+	dst += 3 * (count - 1); \
+	src0 += count - 1; \
+	src1 += count - 1; \
+	src2 += count - 1; \
+	if (src1[-1] == src0[0] && src2[0] != src0[0]) \
+		dst[0] = src0[0]; \
+	else \
+		dst[0] = src1[0]; \
+	dst[1] = src1[0]; \
+	dst[2] = src1[0]; \
+}
+
+#define SCALE3X_SSE2_CENTER(name, type, block) \
+static inline void name(type* dst, const type* src0, const type* src1, const type* src2, unsigned count) \
+{ \
+	/* first pixel */ \
+	dst[0] = src1[0]; \
+	dst[1] = src1[0]; \
+	if (src0[0] != src2[0]) { \
+		dst[2] = (src1[1] == src0[0] && src1[0] != src2[1]) || (src1[1] == src2[0] && src1[0] != src0[1]) ? src1[1] : src1[0]; \
+	} else { \
+		dst[2] = src1[0]; \
+	} \
+\
+	/* central pixels */ \
+	SCALE3X_SSE2_CENTRAL(block, type) \
+\
+	/* last pixel */ \
+	dst += 3 * (count - 1); \
+	src0 += count - 1; \
+	src1 += count - 1; \
+	src2 += count - 1; \
+	if (src0[0] != src2[0]) { \
+		dst[0] = (src1[-1] == src0[0] && src1[0] != src2[-1]) || (src1[-1] == src2[0] && src1[0] != src0[-1]) ? src1[-1] : src1[0]; \
+	} else { \
+		dst[0] = src1[0]; \
+	} \
+	dst[1] = src1[0]; \
+	dst[2] = src1[0]; \
+}
+
+SCALE3X_SSE2_BORDER(scale3x_8_sse2_border, scale3x_uint8, scale3x_8_sse2_border_block)
+SCALE3X_SSE2_BORDER(scale3x_16_sse2_border, scale3x_uint16, scale3x_16_sse2_border_block)
+SCALE3X_SSE2_BORDER(scale3x_32_sse2_border, scale3x_uint32, scale3x_32_sse2_border_block)
+SCALE3X_SSE2_CENTER(scale3x_8_sse2_center, scale3x_uint8, scale3x_8_sse2_center_block)
+SCALE3X_SSE2_CENTER(scale3x_16_sse2_center, scale3x_uint16, scale3x_16_sse2_center_block)
+SCALE3X_SSE2_CENTER(scale3x_32_sse2_center, scale3x_uint32, scale3x_32_sse2_center_block)
+
+/**
+ * Scale by a factor of 3 a row of pixels of 8 bits.
+ * This is a SSE2 implementation, with the same output as scale3x_8_def().
+ * Rows shorter than 18 pixels are left to scale3x_8_def().
+ * The pixels over the left and right borders are assumed of the same color of
+ * the pixels on the border.
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, triple length in pixels.
+ * \param dst1 Second destination row, triple length in pixels.
+ * \param dst2 Third destination row, triple length in pixels.
+ */
+void scale3x_8_sse2(scale3x_uint8* dst0, scale3x_uint8* dst1, scale3x_uint8* dst2, const scale3x_uint8* src0, const scale3x_uint8* src1, const scale3x_uint8* src2, unsigned count)
+{
+	if (count < 18 || SimdLevel() < SIMD_SSE2) {
+		scale3x_8_def(dst0, dst1, dst2, src0, src1, src2, count);
+	} else {
+		scale3x_8_sse2_border(dst0, src0, src1, src2, count);
+		scale3x_8_sse2_center(dst1, src0, src1, src2, count);
+		scale3x_8_sse2_border(dst2, src2, src1, src0, count);
+	}
+}
+
+/**
+ * Scale by a factor of 3 a row of pixels of 16 bits.
+ * This function operates like scale3x_8_sse2() but for 16 bits pixels.
+ * Rows shorter than 10 pixels are left to scale3x_16_def().
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, triple length in pixels.
+ * \param dst1 Second destination row, triple length in pixels.
+ * \param dst2 Third destination row, triple length in pixels.
+ */
+void scale3x_16_sse2(scale3x_uint16* dst0, scale3x_uint16* dst1, scale3x_uint16* dst2, const scale3x_uint16* src0, const scale3x_uint16* src1, const scale3x_uint16* src2, unsigned count)
+{
+	if (count < 10 || SimdLevel() < SIMD_SSE2) {
+		scale3x_16_def(dst0, dst1, dst2, src0, src1, src2, count);
+	} else {
+		scale3x_16_sse2_border(dst0, src0, src1, src2, count);
+		scale3x_16_sse2_center(dst1, src0, src1, src2, count);
+		scale3x_16_sse2_border(dst2, src2, src1, src0, count);
+	}
+}
+
+/**
+ * Scale by a factor of 3 a row of pixels of 32 bits.
+ * This function operates like scale3x_8_sse2() but for 32 bits pixels.
+ * Rows shorter than 6 pixels are left to scale3x_32_def().
+ * \param src0 Pointer at the first pixel of the previous row.
+ * \param src1 Pointer at the first pixel of the current row.
+ * \param src2 Pointer at the first pixel of the next row.
+ * \param count Length in pixels of the src0, src1 and src2 rows.
+ * It must be at least 2.
+ * \param dst0 First destination row, triple length in pixels.
+ * \param dst1 Second destination row, triple length in pixels.
+ * \param dst2 Third destination row, triple length in pixels.
+ */
+void scale3x_32_sse2(scale3x_uint32* dst0, scale3x_uint32* dst1, scale3x_uint32* dst2, const scale3x_uint32* src0, const scale3x_uint32* src1, const scale3x_uint32* src2, unsigned count)
+{
+	if (count < 6 || SimdLevel() < SIMD_SSE2) {
+		scale3x_32_def(dst0, dst1, dst2, src0, src1, src2, count);
+	} else {
+		scale3x_32_sse2_border(dst0, src0, src1, src2, count);
+		scale3x_32_sse2_center(dst1, src0, src1, src2, count);
+		scale3x_32_sse2_border(dst2, src2, src1, src0, count);
+	}
+}
+
+#endif
@@ -54,7 +54,11 @@
 static inline void stage_scale2x(void* dst0, void* dst1, const void* src0, const void* src1, const void* src2, unsigned pixel, unsigned pixel_per_row)
 {
 	switch (pixel) {
-#if defined(__GNUC__) && defined(__i386__)
+#if defined(SCALE2X_SSE2)
+		case 1 : scale2x_8_sse2((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
+		case 2 : scale2x_16_sse2((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
+		case 4 : scale2x_32_sse2((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
+#elif defined(__GNUC__) && defined(__i386__)
 		case 1 : scale2x_8_mmx((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
 		case 2 : scale2x_16_mmx((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
 		case 4 : scale2x_32_mmx((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
@@ -73,9 +77,15 @@ static inline void stage_scale2x(void* dst0, void* dst1, const void* src0, const
 static inline void stage_scale3x(void* dst0, void* dst1, void* dst2, const void* src0, const void* src1, const void* src2, unsigned pixel, unsigned pixel_per_row)
 {
 	switch (pixel) {
+#if defined(SCALE3X_SSE2)
+		case 1 : scale3x_8_sse2((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)dst2, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
+		case 2 : scale3x_16_sse2((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)dst2, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
+		case 4 : scale3x_32_sse2((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)dst2, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
+#else
 		case 1 : scale3x_8_def((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)dst2, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
 		case 2 : scale3x_16_def((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)dst2, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
 		case 4 : scale3x_32_def((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)dst2, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
+#endif
 	}
 }
 
@@ -385,3 +395,36 @@ void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_
 	}
 }
 
+/**
+ * Apply the Scale2x or Scale3x effect on a band of rows of a bitmap.
+ * Does what ::scale() does to the source rows first to last-1, reading the rows around
+ * them as neighbours, so that the bands of a bitmap can be scaled independently.
+ * \param scale Scale factor. 2 or 3.
+ * \param first First source row of the band.
+ * \param last Source row after the band.
+ * The other parameters are those of ::scale(), for the whole bitmap.
+ */
+void scale_rows(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height, unsigned first, unsigned last)
+{
+	unsigned char* dst = (unsigned char*)void_dst + first * scale * dst_slice;
+	const unsigned char* src = (unsigned char*)void_src + first * src_slice;
+	unsigned y;
+
+	for (y = first; y < last; ++y) {
+		const unsigned char* above = y > 0 ? src - src_slice : src;
+		const unsigned char* below = y < height - 1 ? src + src_slice : src;
+
+		if (scale == 2)
+			stage_scale2x(SCDST(0), SCDST(1), above, src, below, pixel, width);
+		else
+			stage_scale3x(SCDST(0), SCDST(1), SCDST(2), above, src, below, pixel, width);
+
+		dst = SCDST(scale);
+		src = SCSRC(1);
+	}
+
+#if defined(__GNUC__) && defined(__i386__)
+	scale2x_mmx_emms();
+#endif
+}
+
@@ -0,0 +1,62 @@
+#ifndef __FCEU_SIMD_H
+#define __FCEU_SIMD_H
+
+// The SIMD code the filters and converters run is picked once, at run time, so that a build for
+// any x86 runs the best code the CPU has. Each version gives the same bytes as the plain code.
+// FCEUX_SIMD=none, sse2, sse4.1 or avx2 in the environment caps it, to compare the versions.
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { SIMD_NONE, SIMD_SSE2, SIMD_SSE41, SIMD_AVX2 };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// the functions using more than the build's instruction set are marked with __attribute__((target))
+#define SIMD_DISPATCH
+#include <immintrin.h>
+
+static inline int SimdDetect()
+{
+	static const char *names[] = { "none", "sse2", "sse4.1", "avx2" };
+	const char *cap = getenv("FCEUX_SIMD");
+	int level;
+
+	__builtin_cpu_init();
+	level = __builtin_cpu_supports("avx2")   ? SIMD_AVX2
+	      : __builtin_cpu_supports("sse4.1") ? SIMD_SSE41
+	      : __builtin_cpu_supports("sse2")   ? SIMD_SSE2
+	      : SIMD_NONE;
+	for(int i = 0; cap && i < level; i++)
+		if(!strcmp(cap, names[i]))
+			level = i;
+	return level;
+}
+
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+static inline int SimdDetect()
+{
+	const char *cap = getenv("FCEUX_SIMD");
+	return cap && !strcmp(cap, "none") ? SIMD_NONE : SIMD_SSE2;
+}
+
+#else
+
+static inline int SimdDetect()
+{
+	return SIMD_NONE;
+}
+
+#endif
+
+// one answer for the whole program, since the function isn't static
+inline int SimdLevel()
+{
+	static const int level = SimdDetect();
+	return level;
+}
+
+#endif
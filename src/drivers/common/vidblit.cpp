@@ -19,6 +19,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "scalebit.h"
 #include "hq2x.h"
@@ -30,6 +31,16 @@
 #include "../../utils/memory.h"
 #include "nes_ntsc.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIDBLIT_SSE2
+#include <emmintrin.h>
+#endif
+#include "simd.h"
+
 extern u8 *XBuf;
 extern u8 *XBackBuf;
 extern u8 *XDBuf;
@@ -43,6 +54,35 @@ uint8 burst_phase = 0;
 
 static uint32 CBM[3];
 static uint32 *palettetranslate=0;
+static uint32 *deemphtranslate=0;	// palettetranslate by (deemph<<8)|pixel, without the branch between the two halves
+static uint32 blitline[256*3];		// a scanline at 1x, before it's scaled or converted
+
+// The filters only look at the lines next to the one they work on, so they run in horizontal
+// bands on a pool of threads. The caller does a band too and returns when all of them are done.
+#define BLIT_MAX_THREADS 8
+#define BLIT_MIN_BAND 16			// lines; less isn't worth handing to another thread
+
+typedef void (*BLITBAND)(int first, int last);
+
+static std::thread blitThreads[BLIT_MAX_THREADS-1];
+static int blitThreadCount = 0;
+static std::mutex blitMutex;
+static std::condition_variable blitWake, blitDone;
+static BLITBAND blitBand;			// guarded by blitMutex, as are the others
+static int blitFirst, blitLines, blitBands, blitNextBand, blitPendingBands;
+static bool blitStop = false;
+
+// what the bands of the frame being blitted work on
+static struct
+{
+	uint8 *src;		// first pixel in XBuf
+	uint8 *dest;
+	int xr, yr;		// of the NES picture
+	int pitch;
+	int mult;		// of the filter
+	int xscale;
+	bool scale;
+} blitJob;
 static int backBpp, backshiftr[3], backshiftl[3];
 static int silt;
 static int Bpp;	// BYTES per pixel
@@ -55,6 +95,17 @@ static uint8  *specbuf8bpp = NULL;	// For 2xscale, 3xscale.
 static uint8  *ntscblit    = NULL;	// For nes_ntsc
 static uint32 *prescalebuf = NULL;	// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
 
+// Blit8ToHighChanged compares the picture with what it blitted the last time, the pixels and their
+// deemphasis, and only redoes the lines that changed
+static uint8 *blitShadow = NULL;	// per line: xr pixels, then xr deemphasis bits
+static int blitShadowSize = 0;
+static bool blitShadowValid = false;
+static struct
+{
+	uint8 *src, *dest;
+	int xr, yr, pitch, xscale, yscale;
+} blitShadowOf;
+
 //////////////////////
 // PAL filter start //
 //////////////////////
@@ -105,10 +156,90 @@ static void CalculateShift(uint32 *CBM, int *cshiftr, int *cshiftl)
 }
 
 
+static void RunBands(std::unique_lock<std::mutex> &lock)
+{
+	while(blitNextBand < blitBands)
+	{
+		const int band = blitNextBand++;
+		lock.unlock();
+		blitBand(blitFirst + band*blitLines/blitBands, blitFirst + (band+1)*blitLines/blitBands);
+		lock.lock();
+		if(!--blitPendingBands)
+			blitDone.notify_all();
+	}
+}
+
+static void BlitThreadProc()
+{
+	std::unique_lock<std::mutex> lock(blitMutex);
+	for(;;)
+	{
+		while(!blitStop && blitNextBand >= blitBands)
+			blitWake.wait(lock);
+		if(blitStop)
+			break;
+		RunBands(lock);
+	}
+}
+
+static void StartBlitThreads()
+{
+	if(blitThreadCount)
+		return;
+	int threads = (int)std::thread::hardware_concurrency() - 1;
+	if(threads > BLIT_MAX_THREADS-1)
+		threads = BLIT_MAX_THREADS-1;
+	blitStop = false;
+	blitBands = blitNextBand = 0;
+	for(blitThreadCount = 0; blitThreadCount < threads; blitThreadCount++)
+		blitThreads[blitThreadCount] = std::thread(BlitThreadProc);
+}
+
+static void StopBlitThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(blitMutex);
+		blitStop = true;
+		blitWake.notify_all();
+	}
+	for(int i = 0; i < blitThreadCount; i++)
+		blitThreads[i].join();
+	blitThreadCount = 0;
+}
+
+// calls band() for all of lines first to last-1, split among the threads
+static void RunInBands(BLITBAND band, int first, int last)
+{
+	const int lines = last - first;
+	int bands = lines / BLIT_MIN_BAND;
+	if(bands > blitThreadCount + 1)
+		bands = blitThreadCount + 1;
+	if(bands <= 1)
+	{
+		if(lines > 0)
+			band(first, last);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(blitMutex);
+	blitBand = band;
+	blitFirst = first;
+	blitLines = lines;
+	blitBands = bands;
+	blitNextBand = 0;
+	blitPendingBands = bands;
+	blitWake.notify_all();
+	RunBands(lock);
+	while(blitPendingBands)
+		blitDone.wait(lock);
+}
+
 int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int specfilt, int specfilteropt)
 {
 	//paldeemphswap = 0; // determine this in FCEUPPU_SetVideoSystem() instead
 
+	blitShadowValid = false;
+
 	// -Video Modes Tag-
 	if(specfilt == 3) // NTSC 2x
 	{
@@ -213,6 +344,10 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	silt = specfilt;	
 	Bpp=b;	
 	highefx=efx;
+
+	// -Video Modes Tag-
+	if(silt >= 1 && silt <= 5)
+		StartBlitThreads();
 	
 	if(Bpp<=1 || Bpp>4)
 		return(0);
@@ -227,6 +362,16 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 	
 	if(!palettetranslate)
 		return(0);
+
+	if ( deemphtranslate )
+	{
+		free(deemphtranslate);
+		deemphtranslate=NULL;
+	}
+	deemphtranslate=(uint32*)FCEU_dmalloc(8*256*4);
+
+	if(!deemphtranslate)
+		return(0);
 	
 	
 	CBM[0]=rmask;
@@ -237,11 +382,26 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 
 void KillBlitToHigh(void)
 {
+	StopBlitThreads();
+
+	if(blitShadow)
+	{
+		free(blitShadow);
+		blitShadow=NULL;
+		blitShadowSize = 0;
+	}
+	blitShadowValid = false;
+
 	if(palettetranslate)
 	{
 		free(palettetranslate);
 		palettetranslate=NULL;
 	}
+	if(deemphtranslate)
+	{
+		free(deemphtranslate);
+		deemphtranslate=NULL;
+	}
 	
 	if(specbuf8bpp)
 	{
@@ -347,6 +507,18 @@ void SetPaletteBlitToHigh(uint8 *src)
 
 		break;
 	}
+
+	//without deemphasis the whole pixel value is looked up, with it only the NES color
+	for(int deemph=0;deemph<8;deemph++)
+		for(int x=0;x<256;x++)
+			deemphtranslate[(deemph<<8)|x] = deemph ? palettetranslate[256+(x&0x3F)+deemph*64] : palettetranslate[x];
+
+	blitShadowValid = false;
+}
+
+void InvalidateBlitToHigh(void)
+{
+	blitShadowValid = false;
 }
 
 void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch)
@@ -366,7 +538,7 @@ void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch)
 			dest++;
 			src++;
 		}
-		dest += dpitch / 3 - xr;
+		dest += dpitch - xr * 3;
 	}
 }
 
@@ -468,11 +640,6 @@ void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, in
 //takes a pointer to XBuf and applies fully modern deemph palettizing
 u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int xscale, int yscale)
 {
-	u8 pixel = *src;
-	
-	//look up the legacy translation
-	u32 color = palettetranslate[pixel];
-
 	int ofs = src-srcbuf;
 	int xofs = ofs&255;
 	int yofs = ofs>>8;
@@ -481,21 +648,230 @@ u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int xscale, int yscale)
 	ofs = xofs+yofs*256;
 
 	//find out which deemph bitplane value we're on
-	uint8 deemph = XDBuf[ofs];
+	return deemphtranslate[(XDBuf[ofs]<<8)|*src];
+}
 
-	//if it was a deemph'd value, grab it from the deemph palette
-	if(deemph != 0)
-		color = palettetranslate[256+(pixel&0x3F)+deemph*64];
+#ifdef SIMD_DISPATCH
+//the colors of 8 pixels at a time are gathered from the table; returns how many were done
+__attribute__((target("avx2")))
+static int DeemphLineAVX2(const uint8 *src, const uint8 *deemph, uint32 *dest, int xr)
+{
+	int x = 0;
+	for(;x+8<=xr;x+=8)
+	{
+		__m256i pixel = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+x)));
+		__m256i plane = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(deemph+x)));
+		__m256i index = _mm256_or_si256(pixel, _mm256_slli_epi32(plane, 8));
+		_mm256_storeu_si256((__m256i*)(dest+x), _mm256_i32gather_epi32((const int*)deemphtranslate, index, 4));
+	}
+	return x;
+}
+#endif
 
-	return color;
+//palettizes xr pixels of a scanline, each with the deemphasis in the same place of XDBuf
+static void DeemphLine(const uint8 *src, const uint8 *deemph, uint32 *dest, int xr)
+{
+	int x = 0;
+#ifdef SIMD_DISPATCH
+	if(SimdLevel() >= SIMD_AVX2)
+		x = DeemphLineAVX2(src, deemph, dest, xr);
+#endif
+	for(;x+4<=xr;x+=4)
+	{
+		dest[x]   = deemphtranslate[(deemph[x]<<8)|src[x]];
+		dest[x+1] = deemphtranslate[(deemph[x+1]<<8)|src[x+1]];
+		dest[x+2] = deemphtranslate[(deemph[x+2]<<8)|src[x+2]];
+		dest[x+3] = deemphtranslate[(deemph[x+3]<<8)|src[x+3]];
+	}
+	for(;x<xr;x++)
+		dest[x] = deemphtranslate[(deemph[x]<<8)|src[x]];
 }
 
-void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+//writes each of the xr colors xscale times
+static void ScaleLine32(const uint32 *src, uint32 *dest, int xr, int xscale)
+{
+	int x = 0;
+	switch(xscale)
+	{
+	case 1:
+		memcpy(dest, src, xr*sizeof(uint32));
+		break;
+	case 2:
+#ifdef VIDBLIT_SSE2
+		if(SimdLevel() >= SIMD_SSE2)
+		{
+			for(;x+4<=xr;x+=4,dest+=8)
+			{
+				__m128i c = _mm_loadu_si128((const __m128i*)(src+x));
+				_mm_storeu_si128((__m128i*)dest, _mm_unpacklo_epi32(c, c));
+				_mm_storeu_si128((__m128i*)(dest+4), _mm_unpackhi_epi32(c, c));
+			}
+		}
+#endif
+		for(;x<xr;x++,dest+=2)
+			dest[0] = dest[1] = src[x];
+		break;
+	case 3:
+		for(;x<xr;x++,dest+=3)
+			dest[0] = dest[1] = dest[2] = src[x];
+		break;
+	default:
+		for(;x<xr;x++)
+			for(int too=xscale;too;too--)
+				*dest++ = src[x];
+		break;
+	}
+}
+
+static void ScaleLine24(const uint32 *src, uint8 *dest, int xr, int xscale)
+{
+	for(int x=0;x<xr;x++)
+	{
+		uint32 tmp=src[x];
+		for(int too=xscale;too;too--,dest+=3)
+		{
+			dest[0]=tmp;
+			dest[1]=tmp>>8;
+			dest[2]=tmp>>16;
+		}
+	}
+}
+
+static void ScaleBand(int first, int last)
+{
+	const int mult = blitJob.mult;
+	const int xr = blitJob.xr*mult;
+	uint32 line[256*3];
+	uint8 lineD[256*3];
+
+	if(blitJob.scale)
+		scale_rows(mult, specbuf8bpp, 256*mult, blitJob.src, 256, 1, blitJob.xr, blitJob.yr, first, last);
+
+	//the deemphasis of the scaled pixels is that of the pixel they came from
+	for(int y=first*mult;y<last*mult;y++)
+	{
+		const uint8 *src = specbuf8bpp + y*256*mult;
+		uint8 *dest = blitJob.dest + y*blitJob.pitch;
+		if(y%mult == 0)
+		{
+			const uint8 *srcD = XDBuf + (blitJob.src-XBuf) + (y/mult)*256;
+			for(int x=0;x<xr;x++)
+				lineD[x] = srcD[x/mult];
+		}
+		if(Bpp == 4)
+			DeemphLine(src, lineD, (uint32 *)dest, xr);
+		else
+		{
+			DeemphLine(src, lineD, line, xr);
+			ScaleLine24(line, dest, xr, 1);
+		}
+	}
+}
+
+// -Video Modes Tag-
+#define NTSC_OUTXR 301
+//if(xr == 282) outxr = 282; //hack for windows
+
+static void NTSCBand(int first, int last)
+{
+	const int in_stride = Bpp * NTSC_OUTXR * 2;
+	nes_ntsc_blit( nes_ntsc, blitJob.src + first*blitJob.xr, XDBuf + (blitJob.src-XBuf) + first*blitJob.xr, blitJob.xr,
+		(burst_phase + first) % nes_ntsc_burst_count, blitJob.xr, last-first, ntscblit + first*in_stride, in_stride );
+}
+
+//a line of ntscblit runs a little into the next one, so this waits for all of them
+static void NTSCCopyBand(int first, int last)
+{
+	const int in_stride = Bpp * NTSC_OUTXR * 2;
+	const uint8 *in = ntscblit + (Bpp * blitJob.xscale) + first*in_stride;
+	uint8 *out = blitJob.dest + first*2*blitJob.pitch;
+	for( int y = first; y < last; y++, in += in_stride, out += 2*blitJob.pitch ) {
+		memcpy(out, in, Bpp * NTSC_OUTXR * blitJob.xscale);
+		memcpy(out + blitJob.pitch, in, Bpp * NTSC_OUTXR * blitJob.xscale);
+	}
+}
+
+//the 16bpp input of hq2x/hq3x
+static void HQInputBand(int first, int last)
+{
+	uint32 line[256];
+	for(int y=first;y<last;y++)
+	{
+		DeemphLine(blitJob.src + y*256, XDBuf + (blitJob.src-XBuf) + y*256, line, blitJob.xr);
+		uint16 *dest = specbuf + y*blitJob.xr;
+		for(int x=0;x<blitJob.xr;x++)
+			dest[x] = line[x];
+	}
+}
+
+static void HQBand(int first, int last)
+{
+	const int mult = blitJob.mult;
+	const int xr = blitJob.xr;
+	if(specbuf32bpp)
+	{
+		uint32 *out = specbuf32bpp + first*mult*xr*mult;
+		uint8 *dest = blitJob.dest + first*mult*blitJob.pitch;
+		// -Video Modes Tag-
+		if(mult == 3)
+			hq3x_32_rows((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,blitJob.yr,xr*3*sizeof(uint32),first,last);
+		else
+			hq2x_32_rows((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,blitJob.yr,xr*2*sizeof(uint32),first,last);
+		
+		if(backBpp == 2)
+			Blit32to16(out, (uint16*)dest, xr*mult, (last-first)*mult, blitJob.pitch, backshiftr,backshiftl);
+		else // == 3
+			Blit32to24(out, dest, xr*mult, (last-first)*mult, blitJob.pitch);
+	}
+	else
+	{
+		// -Video Modes Tag-
+		if(mult == 3)
+			hq3x_32_rows((uint8 *)specbuf,blitJob.dest,xr,blitJob.yr,blitJob.pitch,first,last);
+		else
+			hq2x_32_rows((uint8 *)specbuf,blitJob.dest,xr,blitJob.yr,blitJob.pitch,first,last);
+	}
+}
+
+//whether the blit redoes the whole picture every frame, changed or not: NTSC alternates the phase of
+//the color burst between frames
+static bool BlitEveryFrame(int xscale, int yscale)
+{
+	return !specbuf8bpp && !prescalebuf && !palrgb && !specbuf && (xscale!=1 || yscale!=1) && Bpp == 4
+		&& nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF;
+}
+
+bool Blit8ToHighIsLookup(int xscale, int yscale)
+{
+	return !specbuf8bpp && !prescalebuf && !palrgb && !specbuf && xscale==1 && yscale==1 && Bpp == 4;
+}
+
+void GetBlitColors(uint32 *dest)
+{
+	memcpy(dest, deemphtranslate, 8*256*4);
+}
+
+void Blit8ToIndexed(uint8 *src, uint8 *dest, int xr, int yr)
+{
+	const uint8 *srcD = XDBuf + (src-XBuf);
+	for(int y=0;y<yr;y++,dest+=xr)
+		memcpy(dest, src + y*256, xr);
+	for(int y=0;y<yr;y++,dest+=xr)
+		memcpy(dest, srcD + y*256, xr);
+	GetBlitColors((uint32 *)dest);
+}
+
+//blits the lines *first to *last-1 of the picture, which are those that changed, and sets *first and *last
+//to the lines it redid: the filters read the lines around those they work on, so these are redone too, and
+//some paths only do whole pictures. the lines of dest outside of them are left alone
+static void BlitLines(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int *first, int *last)
 {
 	int x,y;
 	int pinc;
 	uint8 *destbackup = NULL;	/* For hq2x */
-	int pitchbackup = 0;
+	const int changedFirst = *first, changedLast = *last;
+	const int reachFirst = changedFirst > 0 ? changedFirst-1 : 0;		// with the lines the filters read
+	const int reachLast = changedLast < yr ? changedLast+1 : yr;
 
 	
 	//static int google=0;
@@ -503,116 +879,55 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 	
 	if(specbuf8bpp)                  // 2xscale/3xscale
 	{
-		int mult; 
-		int base;
-		
+		//*(uint32 *)dest=palettetranslate[*(uint16 *)src]; //16bpp is doomed
+		if(Bpp == 2)
+			return;
+
 		// -Video Modes Tag-
-		if(silt == 2) mult = 2;
-		else mult = 3;
-		
-		Blit8To8(src, specbuf8bpp, xr, yr, 256*mult, xscale, yscale, 0, silt);
-		int mdcmxs = xscale*mult;
-		int mdcmys = yscale*mult;
-		
-		xr *= mult;
-		yr *= mult;
-		xscale=yscale=1;
-		src = specbuf8bpp;
-		base = 256*mult;
-		
-		switch(Bpp)
-		{
-		case 4:
-			pinc=pitch-(xr<<2);
-			for(y=yr;y;y--,src+=base-xr)
-			{
-				for(x=xr;x;x--)
-				{
-				 *(uint32 *)dest=ModernDeemphColorMap(src,specbuf8bpp,mdcmxs, mdcmys);
-				 dest+=4;
-				 src++;
-				}
-				dest+=pinc;
-			}
-			break;
-		case 3:
-			pinc=pitch-(xr+xr+xr);
-			for(y=yr;y;y--,src+=base-xr)
-			{
-				for(x=xr;x;x--)
-				{
-					uint32 tmp=ModernDeemphColorMap(src,specbuf8bpp,mdcmxs, mdcmys);
-					*(uint8 *)dest=tmp;
-					*((uint8 *)dest+1)=tmp>>8;
-					*((uint8 *)dest+2)=tmp>>16;
-					dest+=3;
-					src++;
-					src++;
-				}
-				dest+=pinc;
-			}
-			break; 
-		case 2:
-			pinc=pitch-(xr<<1);
-			
-			for(y=yr;y;y--,src+=base-xr)
-			{
-				for(x=xr>>1;x;x--)
-				{
-					//*(uint32 *)dest=palettetranslate[*(uint16 *)src]; //16bpp is doomed
-					dest+=4;
-					src+=2;
-				}
-				dest+=pinc;
-			}
-			break;
-		}
+		blitJob.mult = (silt == 2) ? 2 : 3;
+		//as Blit8To8 would, which only does the scale of the filter
+		blitJob.scale = (xscale == blitJob.mult && yscale == blitJob.mult);
+		blitJob.src = src;
+		blitJob.dest = dest;
+		blitJob.xr = xr;
+		blitJob.yr = yr;
+		blitJob.pitch = pitch;
+		*first = blitJob.scale ? reachFirst : changedFirst;
+		*last = blitJob.scale ? reachLast : changedLast;
+		RunInBands(ScaleBand, *first, *last);
 		return;
 	}
 	else if(prescalebuf)             // bare prescale
 	{
 		destbackup = dest;
-		dest = (uint8 *)prescalebuf;
-		pitchbackup = pitch;		
+		dest = (uint8 *)prescalebuf + changedFirst*xr*sizeof(uint32);
 		pitch = xr*sizeof(uint32);
-		pinc = pitch-(xr<<2);
+		src += changedFirst*256;
+		const uint8 *srcD = XDBuf + (src-XBuf);
 
-		for(y=yr; y; y--, src+=256-xr)
-		{
-			for(x=xr; x; x--)
-			{
-				*(uint32 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
-				dest += 4;
-				src++;
-			}
-			dest += pinc;
-		}
+		for(y=changedFirst; y<changedLast; y++, src+=256, srcD+=256, dest+=pitch)
+			DeemphLine(src, srcD, (uint32 *)dest, xr);
 
 		if (Bpp == 4) // are other modes really needed?
 		{
-			uint32 *s = prescalebuf;
-			uint32 *d = (uint32 *)destbackup; // use 32-bit pointers ftw
-			int subpixel;
+			uint32 *s = prescalebuf + changedFirst*xr;
+			uint32 *d = (uint32 *)destbackup + changedFirst*xr*xscale*yscale; // use 32-bit pointers ftw
 
-			for (y=0; y<yr*yscale; y++)
+			// the output is packed, every copy of a scanline follows the previous one
+			for (y=changedFirst; y<changedLast; y++, s+=xr)
 			{
-				int back = xr*(y%yscale>0); // bool as multiplier
-				for (x=0; x<xr; x++)
-				{
-					for (subpixel=0; subpixel<xscale; subpixel++)
-					{
-						*d++ = *(s-back);
-					}
-					s++;
-				}
-				if (back)
-					s -= xr;
+				ScaleLine32(s, d, xr, xscale);
+				for (int doo=1; doo<yscale; doo++)
+					memcpy(d + xr*xscale*doo, d, xr*xscale*sizeof(uint32));
+				d += xr*xscale*yscale;
 			}
 		}
 		return;
 	}
 	else if (palrgb)                 // pal moire
 	{
+		*first = 0;
+		*last = yr;
 		// skip usual palette translation, fill lookup array of RGB+moire values per palette update, and send directly to DX dest
 		// written by feos in 2015, credits to HardWareMan and r57shell
 		if (palupdate)
@@ -797,13 +1112,20 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 	}
 	else if(specbuf)                 // hq2x/hq3x
 	{
-		destbackup=dest;
-		dest=(uint8 *)specbuf;
-		pitchbackup=pitch;
-		
-		pitch=xr*sizeof(uint16);
-		xscale=1;
-		yscale=1;
+		// -Video Modes Tag-
+		blitJob.mult = (silt == 4) ? 3 : 2;
+		blitJob.src = src;
+		blitJob.dest = dest;
+		blitJob.xr = xr;
+		blitJob.yr = yr;
+		blitJob.pitch = pitch;
+		//every band of the filter reads the lines around it, so the input is made first.
+		//the input of the lines that didn't change is still there from the last time
+		RunInBands(HQInputBand, changedFirst, changedLast);
+		*first = reachFirst;
+		*last = reachLast;
+		RunInBands(HQBand, *first, *last);
+		return;
 	}
 	
 	{
@@ -813,77 +1135,53 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 			{
 			case 4:
 				if ( nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF) {
-					int outxr = 301;
-					//if(xr == 282) outxr = 282; //hack for windows
 					burst_phase ^= 1;
 
-					u8* srcD = XDBuf + (src-XBuf); // get deemphasis buffer
-					nes_ntsc_blit( nes_ntsc, (unsigned char*)src, (unsigned char*)srcD, xr, burst_phase, xr, yr, ntscblit, (2*outxr) * Bpp );
-
-					const uint8 *in = ntscblit + (Bpp * xscale);
-					uint8 *out = dest;
-					const int in_stride = Bpp * outxr * 2;
-					const int out_stride = pitch;
-					for( int y = 0; y < yr; y++, in += in_stride, out += 2*out_stride ) {
-						memcpy(out, in, Bpp * outxr * xscale);
-						memcpy(out + out_stride, in, Bpp * outxr * xscale);
-					}
+					blitJob.src = src;
+					blitJob.dest = dest;
+					blitJob.xr = xr;
+					blitJob.yr = yr;
+					blitJob.pitch = pitch;
+					blitJob.xscale = xscale;
+					*first = 0;
+					*last = yr;
+					RunInBands(NTSCBand, 0, yr);
+					RunInBands(NTSCCopyBand, 0, yr);
 				} else {
-					pinc=pitch-((xr*xscale)<<2);
-					for(y=yr;y;y--,src+=256-xr)
+					// one lookup per NES pixel, then the scanline is widened and repeated
+					src += changedFirst*256;
+					dest += changedFirst*pitch*yscale;
+					const uint8 *srcD = XDBuf + (src-XBuf);
+					for(y=changedLast-changedFirst;y;y--,src+=256,srcD+=256)
 					{
-						int doo=yscale;
-						        
-						do
-						{
-							for(x=xr;x;x--,src++)
-							{
-								int too=xscale;
-								do
-								{
-									*(uint32 *)dest=palettetranslate[*src];
-									dest+=4;
-								} while(--too);
-							}
-							src-=xr;
-							dest+=pinc;
-						} while(--doo);
-						src+=xr;
+						DeemphLine(src, srcD, blitline, xr);
+						ScaleLine32(blitline, (uint32 *)dest, xr, xscale);
+						for(int doo=1;doo<yscale;doo++)
+							memcpy(dest+pitch*doo, dest, (xr*xscale)<<2);
+						dest+=pitch*yscale;
 					}
 				}
 				break;
 			
 			case 3:
-				pinc=pitch-((xr*xscale)*3);
-				for(y=yr;y;y--,src+=256-xr)
-				{  
-					int doo=yscale;
-					 
-					do
+				{
+					src += changedFirst*256;
+					dest += changedFirst*pitch*yscale;
+					const uint8 *srcD = XDBuf + (src-XBuf);
+					for(y=changedLast-changedFirst;y;y--,src+=256,srcD+=256)
 					{
-						for(x=xr;x;x--,src++)
-						{    
-							int too=xscale;
-							do
-							{
-								uint32 tmp=palettetranslate[(uint32)*src];
-								*(uint8 *)dest=tmp;
-								*((uint8 *)dest+1)=tmp>>8;
-								*((uint8 *)dest+2)=tmp>>16;
-								dest+=3;
-								
-								//*(uint32 *)dest=palettetranslate[*src];
-								//dest+=4;
-							} while(--too);
-						}
-						src-=xr;
-						dest+=pinc;
-					} while(--doo);
-					src+=xr;
+						DeemphLine(src, srcD, blitline, xr);
+						ScaleLine24(blitline, dest, xr, xscale);
+						for(int doo=1;doo<yscale;doo++)
+							memcpy(dest+pitch*doo, dest, xr*xscale*3);
+						dest+=pitch*yscale;
+					}
 				}
 				break;
 						
 			case 2:
+				*first = 0;
+				*last = yr;
 				pinc=pitch-((xr*xscale)<<1);
 				   
 				for(y=yr;y;y--,src+=256-xr)
@@ -910,78 +1208,106 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 			}
 		}
 		else
+		{
+			src += changedFirst*256;
+			dest += changedFirst*pitch;
 			switch(Bpp)
 			{
 			case 4:
-				pinc=pitch-(xr<<2);
-				for(y=yr;y;y--,src+=256-xr)
 				{
-					for(x=xr;x;x--)
-					{
-						//THE MAIN BLITTING CODEPATH (there may be others that are important)
-						*(uint32 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
-						dest+=4;
-						src++;
-					}
-					dest+=pinc;
+					//THE MAIN BLITTING CODEPATH (there may be others that are important)
+					const uint8 *srcD = XDBuf + (src-XBuf);
+					for(y=changedLast-changedFirst;y;y--,src+=256,srcD+=256,dest+=pitch)
+						DeemphLine(src, srcD, (uint32 *)dest, xr);
 				}
 				break;
 			case 3:
-				pinc=pitch-(xr+xr+xr);
-				for(y=yr;y;y--,src+=256-xr)
 				{
-					for(x=xr;x;x--)
-					{     
-						uint32 tmp = ModernDeemphColorMap(src,XBuf,1,1);
-						*(uint8 *)dest=tmp;
-						*((uint8 *)dest+1)=tmp>>8;
-						*((uint8 *)dest+2)=tmp>>16;
-						dest+=3;
-						src++;
+					const uint8 *srcD = XDBuf + (src-XBuf);
+					for(y=changedLast-changedFirst;y;y--,src+=256,srcD+=256,dest+=pitch)
+					{
+						DeemphLine(src, srcD, blitline, xr);
+						ScaleLine24(blitline, dest, xr, 1);
 					}
-					dest+=pinc;
 				}
 				break;
 			case 2:
-				pinc=pitch-(xr<<1);
-				for(y=yr;y;y--,src+=256-xr)
 				{
-					for(x=xr;x;x--)
+					const uint8 *srcD = XDBuf + (src-XBuf);
+					for(y=changedLast-changedFirst;y;y--,src+=256,srcD+=256,dest+=pitch)
 					{
-						*(uint16 *)dest = ModernDeemphColorMap(src,XBuf,1,1);
-						dest+=2;
-						src++;
+						DeemphLine(src, srcD, blitline, xr);
+						for(x=0;x<xr;x++)
+							((uint16 *)dest)[x] = blitline[x];
 					}
-					dest+=pinc;
 				}
 				break;
 			}
+		}
 	}
-	
-	if(specbuf)
+}
+
+void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+{
+	int first = 0, last = yr;
+	BlitLines(src, dest, xr, yr, pitch, xscale, yscale, &first, &last);
+}
+
+static bool SameLine(const uint8 *src, const uint8 *srcD, const uint8 *shadow, int xr)
+{
+	return !memcmp(src, shadow, xr) && !memcmp(srcD, shadow + xr, xr);
+}
+
+bool Blit8ToHighChanged(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int *first, int *last)
+{
+	const uint8 *srcD = XDBuf + (src-XBuf);
+	int f = 0, l = yr;
+
+	if(blitShadowValid && blitShadowOf.src == src && blitShadowOf.dest == dest && blitShadowOf.xr == xr && blitShadowOf.yr == yr
+		&& blitShadowOf.pitch == pitch && blitShadowOf.xscale == xscale && blitShadowOf.yscale == yscale
+		&& !BlitEveryFrame(xscale, yscale))
 	{
-		if(specbuf32bpp)
-		{
-			// -Video Modes Tag-
-			int mult = (silt == 4)?3:2;
-			
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*3*sizeof(uint32));
-			else
-				hq2x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*2*sizeof(uint32));
-			
-			if(backBpp == 2)
-				Blit32to16(specbuf32bpp, (uint16*)destbackup, xr*mult, yr*mult, pitchbackup, backshiftr,backshiftl);
-			else // == 3
-				Blit32to24(specbuf32bpp, (uint8*)destbackup, xr*mult, yr*mult, pitchbackup);
-		}
-		else
+		while(f < yr && SameLine(src + f*256, srcD + f*256, blitShadow + f*xr*2, xr))
+			f++;
+		if(f == yr)
+			return false;
+		while(SameLine(src + (l-1)*256, srcD + (l-1)*256, blitShadow + (l-1)*xr*2, xr))
+			l--;
+	}
+	else
+	{
+		if(blitShadowSize < xr*yr*2)
 		{
-			// -Video Modes Tag-
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
-			else
-				hq2x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
+			free(blitShadow);
+			blitShadowSize = 0;
+			blitShadow = (uint8 *)FCEU_dmalloc(xr*yr*2);
+			if(!blitShadow)
+			{
+				Blit8ToHigh(src, dest, xr, yr, pitch, xscale, yscale);
+				*first = 0;
+				*last = yr;
+				return true;
+			}
+			blitShadowSize = xr*yr*2;
 		}
+		blitShadowOf.src = src;
+		blitShadowOf.dest = dest;
+		blitShadowOf.xr = xr;
+		blitShadowOf.yr = yr;
+		blitShadowOf.pitch = pitch;
+		blitShadowOf.xscale = xscale;
+		blitShadowOf.yscale = yscale;
+		blitShadowValid = true;
 	}
+
+	for(int y=f;y<l;y++)
+	{
+		memcpy(blitShadow + y*xr*2, src + y*256, xr);
+		memcpy(blitShadow + y*xr*2 + xr, srcD + y*256, xr);
+	}
+
+	*first = f;
+	*last = l;
+	BlitLines(src, dest, xr, yr, pitch, xscale, yscale, first, last);
+	return true;
 }
@@ -22,7 +22,21 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int eefx, in
 void SetPaletteBlitToHigh(uint8 *src);
 void KillBlitToHigh(void);
 void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale);
+//like Blit8ToHigh, but only redoes the lines that changed since the last call with the same arguments; dest
+//has to hold what was blitted to it then. false when nothing changed, otherwise *first and *last are the
+//lines of the picture that were redone (before they are scaled)
+bool Blit8ToHighChanged(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int *first, int *last);
+//makes the next Blit8ToHighChanged redo the whole picture, when dest lost what was blitted to it
+void InvalidateBlitToHigh(void);
 void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special);
+//whether Blit8ToHigh at this scale only looks up the color of each pixel, so that Blit8ToIndexed gives the same
+//picture
+bool Blit8ToHighIsLookup(int xscale, int yscale);
+//copies the xr*yr palette indices, then the deemphasis bits of each, then the 2048 colors of the blit by
+//(deemph<<8)|index, in the format of Blit8ToHigh
+void Blit8ToIndexed(uint8 *src, uint8 *dest, int xr, int yr);
+//the 2048 colors of the blit by (deemph<<8)|index
+void GetBlitColors(uint32 *dest);
 
 void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch);
 void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch,
@@ -48,6 +48,7 @@ class cheat_win_t
 	int cheat_search_neq_value;
 	int cheat_search_gt_value;
 	int cheat_search_lt_value;
+	uint32 cheat_search_cmp_value;
 	int new_cheat_addr;
 	int new_cheat_val;
 	int new_cheat_cmp;
@@ -73,6 +74,11 @@ class cheat_win_t
 	GtkWidget *cheat_search_neq_btn;
 	GtkWidget *cheat_search_gr_btn;
 	GtkWidget *cheat_search_lt_btn;
+	GtkWidget *cheat_search_undo_btn;
+	GtkWidget *cheat_search_cmp_btn;
+	GtkWidget *search_op_combo;
+	GtkWidget *search_operand_combo;
+	GtkWidget *auto_search_chkbox;
 
 	  cheat_win_t (void)
 	{
@@ -83,6 +89,7 @@ class cheat_win_t
 		cheat_search_neq_value = 0;
 		cheat_search_gt_value = 0;
 		cheat_search_lt_value = 0;
+		cheat_search_cmp_value = 0;
 		new_cheat_addr = -1;
 		new_cheat_val = -1;
 		new_cheat_cmp = -1;
@@ -105,6 +112,11 @@ class cheat_win_t
 		cheat_search_neq_btn = NULL;
 		cheat_search_gr_btn = NULL;
 		cheat_search_lt_btn = NULL;
+		cheat_search_undo_btn = NULL;
+		cheat_search_cmp_btn = NULL;
+		search_op_combo = NULL;
+		search_operand_combo = NULL;
+		auto_search_chkbox = NULL;
 	}
 
 	void showActiveCheatList (bool reset);
@@ -114,23 +126,51 @@ class cheat_win_t
 
 static cheat_win_t *curr_cw = NULL;
 static std::list < cheat_win_t * >cheatWinList;
+static gint cheatSearchEvntSrcID = 0;
+
+// what the "Compare To" choices stand for
+static const int searchOperands[] = {
+	FCEU_SEARCH_VS_PREVIOUS,
+	FCEU_SEARCH_VS_VALUE,
+	FCEU_SEARCH_VS_ADDRESS,
+	FCEU_SEARCH_VS_CHANGES
+};
 
 //*******************************************************************************************************
 // Cheat Window
 //*******************************************************************************************************
 
-static int ShowCheatSearchResultsCallB (uint32 a, uint8 last, uint8 current)
+static void formatSearchValue (char *str, uint32 v)
 {
-	char addrStr[32], lastStr[32], curStr[32];
+	int size;
+	bool isSigned;
+
+	FCEUI_CheatSearchGetFormat (&size, &isSigned);
+
+	if (isSigned)
+	{
+		int32 sv = size == 1 ? (int8) v : size == 2 ? (int16) v : (int32) v;
+		sprintf (str, " %i ", sv);
+	}
+	else
+	{
+		sprintf (str, " 0x%0*X ", size * 2, v);
+	}
+}
+
+static int ShowCheatSearchResultsCallB (uint32 a, uint32 last, uint32 current, void *data)
+{
+	char addrStr[32], lastStr[32], curStr[32], chgStr[32];
 
 	sprintf (addrStr, "0x%04X ", a);
-	sprintf (lastStr, " 0x%02X ", last);
-	sprintf (curStr, " 0x%02X ", current);
+	formatSearchValue (lastStr, last);
+	formatSearchValue (curStr, current);
+	sprintf (chgStr, " %i ", FCEUI_CheatSearchGetChangeCount (a));
 
 	gtk_tree_store_append (curr_cw->ram_match_store, &curr_cw->ram_match_iter, NULL);	// aquire iter
 
 	gtk_tree_store_set (curr_cw->ram_match_store, &curr_cw->ram_match_iter,
-			    0, addrStr, 1, lastStr, 2, curStr, -1);
+			    0, addrStr, 1, lastStr, 2, curStr, 3, chgStr, -1);
 
 	return 1;
 }
@@ -147,8 +187,14 @@ void cheat_win_t::showCheatSearchResults (void)
 
 	//printf("Cheat Search Matches: %i \n", total_matches );
 
-	FCEUI_CheatSearchGetRange (0, total_matches,
-				   ShowCheatSearchResultsCallB);
+	FCEUI_CheatSearchGetValues (0, total_matches,
+				    ShowCheatSearchResultsCallB, NULL);
+
+	if (cheat_search_undo_btn)
+	{
+		gtk_widget_set_sensitive (cheat_search_undo_btn,
+					  FCEUI_CheatSearchUndoCount () > 0);
+	}
 }
 
 static void cheatSearchReset (GtkButton * button, cheat_win_t * cw)
@@ -165,18 +211,120 @@ static void cheatSearchReset (GtkButton * button, cheat_win_t * cw)
 	gtk_widget_set_sensitive( cw->cheat_search_neq_btn   , TRUE );
 	gtk_widget_set_sensitive( cw->cheat_search_gr_btn    , TRUE );
 	gtk_widget_set_sensitive( cw->cheat_search_lt_btn    , TRUE );
+	gtk_widget_set_sensitive( cw->cheat_search_cmp_btn   , TRUE );
+	gtk_widget_set_sensitive( cw->auto_search_chkbox     , TRUE );
 
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (cw->auto_search_chkbox), FALSE);
 	FCEUI_CheatSearchBegin ();
 	cw->showCheatSearchResults ();
 	// Enable Cheat Search Buttons - Change Sensitivity
 }
 
+static void cheatSearchUndo (GtkButton * button, cheat_win_t * cw)
+{
+	FCEUI_CheatSearchUndo ();
+	cw->showCheatSearchResults ();
+}
+
+static void cheatSearchCompare (GtkButton * button, cheat_win_t * cw)
+{
+	int op = gtk_combo_box_get_active (GTK_COMBO_BOX (cw->search_op_combo));
+	int operand = searchOperands[gtk_combo_box_get_active
+				     (GTK_COMBO_BOX (cw->search_operand_combo))];
+
+	FCEUI_CheatSearchFilter (op, operand, cw->cheat_search_cmp_value);
+	cw->showCheatSearchResults ();
+}
+
+static void cheatSearchAutoChanged (GtkWidget * widget, cheat_win_t * cw)
+{
+	int op = gtk_combo_box_get_active (GTK_COMBO_BOX (cw->search_op_combo));
+	int operand = searchOperands[gtk_combo_box_get_active
+				     (GTK_COMBO_BOX (cw->search_operand_combo))];
+	int enable = gtk_toggle_button_get_active
+		(GTK_TOGGLE_BUTTON (cw->auto_search_chkbox));
+
+	// changing the comparison while searching automatically applies it from then on
+	if (enable || FCEUI_CheatSearchGetAuto ())
+	{
+		FCEUI_CheatSearchSetAuto (enable, op, operand,
+					  cw->cheat_search_cmp_value);
+	}
+	if (widget == cw->auto_search_chkbox)
+	{
+		gtk_widget_set_sensitive (cw->cheat_search_cmp_btn, !enable);
+	}
+}
+
+static void cheatSearchClearChanges (GtkButton * button, cheat_win_t * cw)
+{
+	FCEUI_CheatSearchResetChangeCounts ();
+	cw->showCheatSearchResults ();
+}
+
+static void cheatSearchCmpValueEntryCB (GtkWidget * widget, cheat_win_t * cw)
+{
+	const gchar *entry_text;
+	entry_text = gtk_entry_get_text (GTK_ENTRY (widget));
+
+	cw->cheat_search_cmp_value = strtoul (entry_text, NULL, 16);
+
+	if (FCEUI_CheatSearchGetAuto ())
+	{
+		cheatSearchAutoChanged (widget, cw);
+	}
+}
+
+// keeps the results current while the game runs
+static gint updateCheatSearchResults (void *userData)
+{
+	std::list < cheat_win_t * >::iterator it;
+
+	if (cheatWinList.empty ())
+	{
+		cheatSearchEvntSrcID = 0;
+		return FALSE;
+	}
+	if (EmulationPaused)
+	{
+		return TRUE;
+	}
+	for (it = cheatWinList.begin (); it != cheatWinList.end (); it++)
+	{
+		// a long list is too slow to rebuild several times a second
+		if (FCEUI_CheatSearchGetCount () <= 256)
+		{
+			(*it)->showCheatSearchResults ();
+		}
+	}
+	return TRUE;
+}
+
+static void cheatSearchFormatChanged (GtkWidget * widget, cheat_win_t * cw)
+{
+	int size;
+	bool isSigned;
+
+	FCEUI_CheatSearchGetFormat (&size, &isSigned);
+
+	if (GTK_IS_COMBO_BOX (widget))
+	{
+		size = 1 << gtk_combo_box_get_active (GTK_COMBO_BOX (widget));
+	}
+	else
+	{
+		isSigned = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (widget));
+	}
+	FCEUI_CheatSearchSetFormat (size, isSigned);
+	cw->showCheatSearchResults ();
+}
+
 static void cheatSearchKnown (GtkButton * button, cheat_win_t * cw)
 {
 	//printf("Cheat Search Known!\n");
 
-	FCEUI_CheatSearchEnd (FCEU_SEARCH_NEWVAL_KNOWN,
-			      cw->cheat_search_known_value, 0);
+	FCEUI_CheatSearchFilter (FCEU_SEARCH_OP_EQ, FCEU_SEARCH_VS_VALUE,
+				 cw->cheat_search_known_value);
 	cw->showCheatSearchResults ();
 }
 
@@ -275,11 +423,11 @@ static void pauseDuringCheatWinActvCB (GtkToggleButton * button,
 
 static void cheatSearchValueEntryCB1 (GtkWidget * widget, cheat_win_t * cw)
 {
-	long value;
+	unsigned long value;
 	const gchar *entry_text;
 	entry_text = gtk_entry_get_text (GTK_ENTRY (widget));
 
-	value = strtol (entry_text, NULL, 16);
+	value = strtoul (entry_text, NULL, 16);
 
 	cw->cheat_search_known_value = value;
 
@@ -928,6 +1076,12 @@ static void closeCheatDialog (GtkWidget * w, GdkEvent * e, gpointer p)
 	}
 	//printf("Number of Cheat Windows Still Open: %zi\n", cheatWinList.size() );
 
+	if (cheatWinList.empty ())
+	{
+		FCEUI_CheatSearchSetAuto (false, 0, 0, 0);
+		FCEUI_CheatSearchSetChangeCounting (false);
+	}
+
 	delete cw;
 
 	gtk_widget_destroy (w);
@@ -942,6 +1096,9 @@ void openCheatsWindow (void)
 	GtkWidget *vbox, *prev_cmp_vbox;
 	GtkWidget *frame;
 	GtkWidget *label, *txt_entry;
+	GtkWidget *combo;
+	int search_size;
+	bool search_signed;
 	GtkWidget *button;
 	GtkWidget *scroll;
 
@@ -1145,6 +1302,33 @@ void openCheatsWindow (void)
 	g_signal_connect (button, "clicked",
 			  G_CALLBACK (cheatSearchReset), (gpointer) cw);
 	gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 5);
+	button = gtk_button_new_with_label ("Undo");
+	cw->cheat_search_undo_btn = button;
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (cheatSearchUndo), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 5);
+
+	gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 5);
+
+	FCEUI_CheatSearchGetFormat (&search_size, &search_signed);
+
+	hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 3);
+	label = gtk_label_new ("Size:");
+	gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 5);
+	combo = gtk_combo_box_text_new ();
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "1 byte");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "2 bytes");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "4 bytes");
+	gtk_combo_box_set_active (GTK_COMBO_BOX (combo),
+				  search_size == 4 ? 2 : search_size == 2 ? 1 : 0);
+	g_signal_connect (combo, "changed",
+			  G_CALLBACK (cheatSearchFormatChanged), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), combo, FALSE, FALSE, 5);
+	button = gtk_check_button_new_with_label ("Signed");
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (button), search_signed);
+	g_signal_connect (button, "toggled",
+			  G_CALLBACK (cheatSearchFormatChanged), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 5);
 
 	gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 5);
 
@@ -1156,8 +1340,8 @@ void openCheatsWindow (void)
 	gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 5);
 	label = gtk_label_new ("0x");
 	txt_entry = gtk_entry_new ();
-	gtk_entry_set_max_length (GTK_ENTRY (txt_entry), 2);
-	gtk_entry_set_width_chars (GTK_ENTRY (txt_entry), 2);
+	gtk_entry_set_max_length (GTK_ENTRY (txt_entry), 8);
+	gtk_entry_set_width_chars (GTK_ENTRY (txt_entry), 8);
 
 	g_signal_connect (txt_entry, "activate",
 			  G_CALLBACK (cheatSearchValueEntryCB1), (void *) cw);
@@ -1168,6 +1352,65 @@ void openCheatsWindow (void)
 
 	gtk_box_pack_start (GTK_BOX (vbox), hbox, FALSE, FALSE, 5);
 
+	frame = gtk_frame_new ("Compare");
+	gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, FALSE, 5);
+	prev_cmp_vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+	gtk_container_add (GTK_CONTAINER (frame), prev_cmp_vbox);
+
+	hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 3);
+	combo = gtk_combo_box_text_new ();
+	cw->search_op_combo = combo;
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Equal To");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Not Equal To");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Less Than");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Greater Than");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Less Than or Equal To");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Greater Than or Equal To");
+	gtk_combo_box_set_active (GTK_COMBO_BOX (combo), 0);
+	g_signal_connect (combo, "changed",
+			  G_CALLBACK (cheatSearchAutoChanged), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), combo, TRUE, TRUE, 5);
+	gtk_box_pack_start (GTK_BOX (prev_cmp_vbox), hbox, FALSE, FALSE, 1);
+
+	hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 3);
+	combo = gtk_combo_box_text_new ();
+	cw->search_operand_combo = combo;
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Previous Value");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Specific Value");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Specific Address");
+	gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), "Number of Changes");
+	gtk_combo_box_set_active (GTK_COMBO_BOX (combo), 0);
+	g_signal_connect (combo, "changed",
+			  G_CALLBACK (cheatSearchAutoChanged), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), combo, TRUE, TRUE, 5);
+	label = gtk_label_new ("0x");
+	gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 1);
+	txt_entry = gtk_entry_new ();
+	gtk_entry_set_max_length (GTK_ENTRY (txt_entry), 8);
+	gtk_entry_set_width_chars (GTK_ENTRY (txt_entry), 8);
+	g_signal_connect (txt_entry, "activate",
+			  G_CALLBACK (cheatSearchCmpValueEntryCB), (void *) cw);
+	g_signal_connect (txt_entry, "changed",
+			  G_CALLBACK (cheatSearchCmpValueEntryCB), (void *) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), txt_entry, FALSE, FALSE, 5);
+	gtk_box_pack_start (GTK_BOX (prev_cmp_vbox), hbox, FALSE, FALSE, 1);
+
+	hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 3);
+	button = gtk_button_new_with_label ("Search");
+	cw->cheat_search_cmp_btn = button;
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (cheatSearchCompare), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), button, TRUE, TRUE, 5);
+	cw->auto_search_chkbox = gtk_check_button_new_with_label ("Auto-search");
+	g_signal_connect (cw->auto_search_chkbox, "toggled",
+			  G_CALLBACK (cheatSearchAutoChanged), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), cw->auto_search_chkbox, FALSE, FALSE, 5);
+	button = gtk_button_new_with_label ("Clear Change Counts");
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (cheatSearchClearChanges), (gpointer) cw);
+	gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 5);
+	gtk_box_pack_start (GTK_BOX (prev_cmp_vbox), hbox, FALSE, FALSE, 1);
+
 	frame = gtk_frame_new ("Previous Compare");
 	gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, FALSE, 5);
 	button = gtk_check_button_new_with_label
@@ -1264,6 +1507,9 @@ void openCheatsWindow (void)
 	gtk_widget_set_sensitive( cw->cheat_search_neq_btn   , FALSE );
 	gtk_widget_set_sensitive( cw->cheat_search_gr_btn    , FALSE );
 	gtk_widget_set_sensitive( cw->cheat_search_lt_btn    , FALSE );
+	gtk_widget_set_sensitive( cw->cheat_search_undo_btn  , FALSE );
+	gtk_widget_set_sensitive( cw->cheat_search_cmp_btn   , FALSE );
+	gtk_widget_set_sensitive( cw->auto_search_chkbox     , FALSE );
 
 	frame = gtk_frame_new ("Cheat Search");
 	gtk_container_add (GTK_CONTAINER (frame), hbox);
@@ -1273,8 +1519,8 @@ void openCheatsWindow (void)
 	//hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 1);
 
 	cw->ram_match_store =
-		gtk_tree_store_new (3, G_TYPE_STRING, G_TYPE_STRING,
-				    G_TYPE_STRING);
+		gtk_tree_store_new (4, G_TYPE_STRING, G_TYPE_STRING,
+				    G_TYPE_STRING, G_TYPE_STRING);
 
 	cw->search_cheat_tree =
 		gtk_tree_view_new_with_model (GTK_TREE_MODEL
@@ -1297,6 +1543,10 @@ void openCheatsWindow (void)
 							   "text", 2, NULL);
 	gtk_tree_view_append_column (GTK_TREE_VIEW (cw->search_cheat_tree),
 				     column);
+	column = gtk_tree_view_column_new_with_attributes ("Changes", renderer,
+							   "text", 3, NULL);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (cw->search_cheat_tree),
+				     column);
 
 	scroll = gtk_scrolled_window_new (NULL, NULL);
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroll),
@@ -1317,6 +1567,13 @@ void openCheatsWindow (void)
 			  cw);
 	g_signal_connect (win, "response", G_CALLBACK (closeCheatDialog), cw);
 
+	FCEUI_CheatSearchSetChangeCounting (true);
+	if (cheatSearchEvntSrcID == 0)
+	{
+		cheatSearchEvntSrcID =
+			g_timeout_add (100, updateCheatSearchResults, NULL);
+	}
+
 	gtk_widget_show_all (win);
 
 	//printf("Added Cheat Window %p. Number of Cheat Windows Open: %zi\n", cw, cheatWinList.size() );
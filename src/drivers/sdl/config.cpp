@@ -178,10 +178,13 @@ InitConfig()
 	config->addOption("soundq", "SDL.Sound.Quality", 1);
 	config->addOption("soundrecord", "SDL.Sound.RecordFile", "");
 	config->addOption("soundbufsize", "SDL.Sound.BufSize", 128);
+	config->addOption("audiosync", "SDL.AudioSync", 1);
 	config->addOption("lowpass", "SDL.Sound.LowPass", 0);
     
 	config->addOption('g', "gamegenie", "SDL.GameGenie", 0);
 	config->addOption("pal", "SDL.PAL", 0);
+	config->addOption("runahead", "SDL.RunAhead", 0);
+	config->addOption("runaheadaudio", "SDL.RunAheadAudio", 0);
 	config->addOption("frameskip", "SDL.Frameskip", 0);
 	config->addOption("clipsides", "SDL.ClipSides", 0);
 	config->addOption("nospritelim", "SDL.DisableSpriteLimit", 1);
@@ -216,6 +219,7 @@ InitConfig()
 	config->addOption("noframe", "SDL.NoFrame", 0);
 	config->addOption("special", "SDL.SpecialFilter", 0);
 	config->addOption("showfps", "SDL.ShowFPS", 0);
+	config->addOption("showpacing", "SDL.ShowPacing", 0);
 	config->addOption("togglemenu", "SDL.ToggleMenu", 0);
 
 	// OpenGL options
@@ -273,6 +277,25 @@ InitConfig()
 	config->addOption("loadlua", "SDL.LuaScript", "");
     #endif
     
+	// binary instruction trace
+	config->addOption("tracelog", "SDL.TraceLog", "");
+
+	// frames to write to png files, "first..last"
+	config->addOption("dumpframes", "SDL.DumpFrames", "");
+
+	// shared memory object to export the game state to
+	config->addOption("shmexport", "SDL.ShmExport", "");
+
+	// file to write the frame timing histograms to
+	config->addOption("pacingcsv", "SDL.PacingCSV", "");
+
+	// code/data log
+	config->addOption("cdl", "SDL.CDLog", "");
+	config->addOption("SDL.CDLogSaveInterval", 60);
+
+	// memory the debugger may use for its reverse execution history, in megabytes
+	config->addOption("SDL.ReverseDebugMemory", 64);
+
     #ifdef CREATE_AVI
 	config->addOption("videolog",  "SDL.VideoLog",  "");
 	config->addOption("mute", "SDL.MuteCapture", 0);
@@ -301,6 +324,11 @@ InitConfig()
     
 	// fm2 -> srt conversion
 	config->addOption("ripsubs", "SDL.RipSubs", "");
+
+	// ROM library index
+	config->addOption("romscan", "SDL.RomScan", "");
+	config->addOption("romindex", "SDL.RomIndex", "");
+	config->addOption("scanthreads", "SDL.ScanThreads", 0);
 	
 	// enable new PPU core
 	config->addOption("newppu", "SDL.NewPPU", 0);
@@ -29,6 +29,7 @@
 #include "../../asm.h"
 #include "../../ppu.h"
 #include "../../x6502.h"
+#include "../../reversedebug.h"
 #include "../common/configSys.h"
 
 #include "sdl.h"
@@ -733,12 +734,12 @@ void  debuggerWin_t::updateAssemblyView(void)
 			} 
 			else
 			{
-				line.assign(" ");
+				line.assign( addr == debugBreakAccessPC ? "*" : " " );
 			}
 		}
 		else 
 		{
-			line.assign(" ");
+			line.assign( addr == debugBreakAccessPC ? "*" : " " );
 		}
 		a->addr = addr;
 
@@ -1373,6 +1374,35 @@ static void debugStepOverCB (GtkButton * button, debuggerWin_t * dw)
 		FCEUI_SetEmulationPaused(0);
 	}
 }
+static void debugReverse (int op)
+{
+	if (!FCEUI_EmulationPaused())
+	{
+		return;
+	}
+	if (!FCEUI_ReverseDebug(op))
+	{
+		printf("There is no history to go back into.\n");
+		return;
+	}
+	FCEUI_SetEmulationPaused(0);
+}
+
+static void debugStepBackCB (GtkButton * button, debuggerWin_t * dw)
+{
+	debugReverse( REVERSE_OP_STEP );
+}
+
+static void debugBackOverCB (GtkButton * button, debuggerWin_t * dw)
+{
+	debugReverse( REVERSE_OP_STEPOVER );
+}
+
+static void debugReverseRunCB (GtkButton * button, debuggerWin_t * dw)
+{
+	debugReverse( REVERSE_OP_CONTINUE );
+}
+
 static void debugRunLineCB (GtkButton * button, debuggerWin_t * dw)
 {
 	if (FCEUI_EmulationPaused())
@@ -1724,6 +1754,11 @@ static void closeDebuggerWindow (GtkWidget * w, GdkEvent * e, debuggerWin_t * dw
 
 	delete dw;
 
+	if (debuggerWinList.empty())
+	{
+		FCEUI_SetReverseDebugging(false);
+	}
+
 	gtk_widget_destroy (w);
 }
 
@@ -1749,6 +1784,13 @@ void openDebuggerWindow (void)
 
 	debuggerWinList.push_back (dw);
 
+	{
+		int megabytes;
+		g_config->getOption ("SDL.ReverseDebugMemory", &megabytes);
+		FCEUI_SetReverseDebuggingMemory (megabytes);
+		FCEUI_SetReverseDebugging (true);
+	}
+
 	dw->win = gtk_dialog_new_with_buttons ("6502 Debugger",
 						GTK_WINDOW (MainWindow),
 						(GtkDialogFlags)
@@ -1902,6 +1944,28 @@ void openDebuggerWindow (void)
 
 	gtk_grid_attach( GTK_GRID(grid), button, 1, 4, 1, 1 );
 
+	//     Reverse execution
+	button = gtk_button_new_with_label ("Step Back");
+
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (debugStepBackCB), (gpointer) dw);
+
+	gtk_grid_attach( GTK_GRID(grid), button, 0, 5, 1, 1 );
+
+	button = gtk_button_new_with_label ("Back Over");
+
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (debugBackOverCB), (gpointer) dw);
+
+	gtk_grid_attach( GTK_GRID(grid), button, 1, 5, 1, 1 );
+
+	button = gtk_button_new_with_label ("Reverse Run");
+
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (debugReverseRunCB), (gpointer) dw);
+
+	gtk_grid_attach( GTK_GRID(grid), button, 0, 6, 1, 1 );
+
 	//     Row 6
 	grid = gtk_grid_new();
 
@@ -13,6 +13,8 @@ void WriteSound(int32 *Buffer, int Count);
 int KillSound(void);
 uint32 GetMaxSound(void);
 uint32 GetWriteSound(void);
+uint32 GetQueuedSound(void);
+uint32 GetSoundUnderruns(void);
 
 void SilenceSound(int s); /* DOS and SDL */
 
@@ -35,6 +35,7 @@ static XEvent                  xev;
 static GLint  double_buffer_ena = 1;
 
 static GLuint gltexture = 0;
+static int    gltexture_loaded = 0;
 static int    spawn_new_window = 0;
 
 glxwin_shm_t *glx_shm = NULL;
@@ -81,6 +82,8 @@ static glxwin_shm_t *open_shm(void)
 	vaddr->nrow  = 256;
 	vaddr->pitch = 256 * 4;
 
+	vaddr->mark_dirty( 0, GLX_NES_HEIGHT );
+
 	return vaddr;
 }
 //************************************************************************
@@ -115,6 +118,7 @@ static void genTextures( int ipolate )
 	printf("Linear Interpolation on GL Texture: %s \n", ipolate ? "Enabled" : "Disabled");
 
 	glBindTexture(GL_TEXTURE_2D, gltexture);
+	gltexture_loaded = 0;
 
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,ipolate?GL_LINEAR:GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,ipolate?GL_LINEAR:GL_NEAREST);
@@ -257,8 +261,21 @@ static void render_image(void)
 	glBindTexture(GL_TEXTURE_2D, gltexture);
 
 	//print_pixbuf();
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0,
-					GL_RGBA, GL_UNSIGNED_BYTE, glx_shm->pixbuf );
+	// The texture keeps the last frame, only the rows that changed since are uploaded
+	int first, last;
+	int dirty = glx_shm->take_dirty( &first, &last );
+
+	if ( !gltexture_loaded )
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0,
+						GL_RGBA, GL_UNSIGNED_BYTE, glx_shm->pixbuf );
+		gltexture_loaded = 1;
+	}
+	else if ( dirty )
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 256, last - first,
+						GL_RGBA, GL_UNSIGNED_BYTE, glx_shm->pixbuf + first * GLX_NES_WIDTH );
+	}
 
 	glBegin(GL_QUADS);
 	glTexCoord2f(1.0f*l/256, 1.0f*b/256); // Bottom left of picture.
@@ -482,6 +499,7 @@ int destroy_gtk3_GLXContext(void)
 		printf("Destroying GLX Texture\n");
 		glDeleteTextures(1, &gltexture);
 		gltexture=0;
+		gltexture_loaded = 0;
 	}
 	if ( glc != NULL )
 	{
@@ -34,6 +34,12 @@ struct  glxwin_shm_t
 	int   nrow;
 	int   pitch;
 
+	// Rows of pixbuf that changed since it was last drawn, as
+	// first << 16 | last, 0 when none did. The GLX window draws from
+	// another process, so the range is only touched atomically: the
+	// emulator widens it, whoever draws takes and clears it in one swap.
+	uint32_t  dirty;
+
 	// Pass Key Events back to GTK Gui
 	struct 
 	{
@@ -69,6 +75,42 @@ struct  glxwin_shm_t
 	void clear_pixbuf(void)
 	{
 		memset( pixbuf, 0, sizeof(pixbuf) );
+
+		mark_dirty( 0, GLX_NES_HEIGHT );
+	}
+
+	// Call after the rows are written to pixbuf
+	void mark_dirty( int first, int last )
+	{
+		uint32_t cur = __atomic_load_n( &dirty, __ATOMIC_RELAXED ), range;
+		do
+		{
+			int f = cur >> 16, l = cur & 0xffff;
+
+			if ( f >= l )
+			{
+				f = first;
+				l = last;
+			}
+			else
+			{
+				if ( first < f ) f = first;
+				if ( last  > l ) l = last;
+			}
+			range = (f << 16) | l;
+		}
+		while ( !__atomic_compare_exchange_n( &dirty, &cur, range, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) );
+	}
+
+	// Returns 0 if no row changed
+	int take_dirty( int *first, int *last )
+	{
+		uint32_t range = __atomic_exchange_n( &dirty, 0, __ATOMIC_ACQUIRE );
+
+		*first = range >> 16;
+		*last  = range & 0xffff;
+
+		return *first < *last;
 	}
 };
 
@@ -3103,6 +3103,7 @@ static void transferPix2CairoSurface(void)
 	union cairo_pixel_t *p;
 	union cairo_pixel_t *g;
 	int x, y, i,j, w, h;
+	int first, last, full;
 
 	if ( cairo_surface == NULL )
 	{
@@ -3111,10 +3112,21 @@ static void transferPix2CairoSurface(void)
 	//printf("Cairo Pixel ReMap\n");
 	cairo_surface_flush( cairo_surface );
 
+	glx_shm->take_dirty( &first, &last );
+
 	if ( numRendLines != glx_shm->nrow )
 	{
 		cairo_recalc_mapper();
+
+		first = 0;
+		last  = GLX_NES_HEIGHT;
+	}
+
+	if ( (first >= last) || (cairo_pix_remapper == NULL) )
+	{
+		return;
 	}
+	full = (first == 0) && (last >= GLX_NES_HEIGHT);
 
 	w  = cairo_image_surface_get_width (cairo_surface);
 	h  = cairo_image_surface_get_height (cairo_surface);
@@ -3125,6 +3137,18 @@ static void transferPix2CairoSurface(void)
 	i=0;
 	for (y=0; y<h; y++)
 	{
+		// A row of the surface shows a single row of pixbuf, or none in the borders.
+		// The rows that show rows that didn't change are left as they are.
+		if ( !full )
+		{
+			j = cairo_pix_remapper[i + w/2];
+
+			if ( (j < 0) || (j / GLX_NES_WIDTH < first) || (j / GLX_NES_WIDTH >= last) )
+			{
+				i += w;
+				continue;
+			}
+		}
 		for (x=0; x<w; x++)
 		{
 			j = cairo_pix_remapper[i];
@@ -3415,6 +3439,8 @@ static void cairo_handle_resize(void)
 
 	guiClearSurface();
 
+	glx_shm->mark_dirty( 0, GLX_NES_HEIGHT );
+
 	transferPix2CairoSurface();
 
 	//cairo_surface_mark_dirty( cairo_surface );
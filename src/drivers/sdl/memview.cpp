@@ -25,6 +25,7 @@
 #include "../../fds.h"
 #include "../../cart.h"
 #include "../../ines.h"
+#include "../../memsnapshot.h"
 #include "../common/configSys.h"
 
 #include "sdl.h"
@@ -147,6 +148,8 @@ struct memViewWin_t
 	bool actv_color_reverse_video;
    int (*memAccessFunc)( unsigned int offset);
 	uint64 total_instructions_lp;
+	uint32 snapshotSerial;
+	bool pageActv[MEMSNAPSHOT_PAGES];
 
 	GdkRGBA  bgColor;
 	GdkRGBA  fgColor;
@@ -183,6 +186,7 @@ struct memViewWin_t
 		memAccessFunc = getRAM;
 		useActivityColors = 1;
 		total_instructions_lp = 0;
+		snapshotSerial = 0;
 		cssProvider = NULL;
 		actv_color_reverse_video = 1;
 
@@ -298,6 +302,7 @@ struct memViewWin_t
 	int  calcVisibleRange( int *start_out, int *end_out, int *center_out );
 	int  getAddrFromCursor( int CursorTextOffset = -1 );
 	int  checkMemActivity(void);
+	int  checkRamActivity(void);
 	void initMem(void);
 	int  upDateTextViewStyle(void);
 	void initColors(void);
@@ -329,6 +334,11 @@ void memViewWin_t::initMem(void)
 		mbuf[i].actv  = 0;
 		mbuf[i].draw  = 1;
 	}
+	for (int i=0; i<MEMSNAPSHOT_PAGES; i++)
+	{
+		pageActv[i] = false;
+	}
+	snapshotSerial = FCEUI_MemSnapshotSerial();
 }
 
 int memViewWin_t::checkMemActivity(void)
@@ -339,8 +349,15 @@ int memViewWin_t::checkMemActivity(void)
 	// 1. In ROM View Mode
 	// 2. The simulation is not cycling (paused)
 
-	if ( ( mode == MODE_NES_ROM ) ||
-	      ( total_instructions_lp == total_instructions ) )
+	if ( mode == MODE_NES_ROM )
+	{
+		return -1;
+	}
+	if ( mode == MODE_NES_RAM )
+	{
+		return checkRamActivity();
+	}
+	if ( total_instructions_lp == total_instructions )
 	{
 		return -1;
 	}
@@ -369,6 +386,83 @@ int memViewWin_t::checkMemActivity(void)
    return 0;
 }
 
+// CPU memory comes from the core's per-frame snapshot: only the pages that changed
+// are compared, and only the pages with active bytes are faded out.
+int memViewWin_t::checkRamActivity(void)
+{
+	int row_start, row_end;
+	uint8 dirty[MEMSNAPSHOT_PAGES/8];
+	bool running;
+
+	if ( GameInfo == NULL )
+	{
+		return -1;
+	}
+	running = ( total_instructions_lp != total_instructions );
+
+	calcVisibleRange( &row_start, &row_end, NULL );
+
+	if ( row_end > row_start )
+	{
+		FCEUI_MemSnapshotWatch( row_start*16, row_end*16 - 1 );
+	}
+
+	if ( running )
+	{
+		for (int page=0; page<MEMSNAPSHOT_PAGES; page++)
+		{
+			if ( !pageActv[page] )
+			{
+				continue;
+			}
+			pageActv[page] = false;
+
+			for (int i=page<<MEMSNAPSHOT_PAGE_SHIFT; i<(page+1)<<MEMSNAPSHOT_PAGE_SHIFT; i++)
+			{
+				if ( mbuf[i].actv > 0 )
+				{
+					mbuf[i].draw = 1;
+					mbuf[i].actv--;
+					pageActv[page] |= (mbuf[i].actv > 0);
+				}
+			}
+		}
+		total_instructions_lp = total_instructions;
+	}
+
+	if ( snapshotSerial == FCEUI_MemSnapshotSerial() )
+	{
+		return 0;
+	}
+	FCEUI_MemSnapshotGetDirty( snapshotSerial, dirty );
+	snapshotSerial = FCEUI_MemSnapshotSerial();
+
+	const uint8 *data = FCEUI_MemSnapshotData();
+
+	for (int page=0; page<MEMSNAPSHOT_PAGES; page++)
+	{
+		if ( !(dirty[page>>3] & (1<<(page&7))) )
+		{
+			continue;
+		}
+		for (int i=page<<MEMSNAPSHOT_PAGE_SHIFT; i<(page+1)<<MEMSNAPSHOT_PAGE_SHIFT; i++)
+		{
+			if ( data[i] != mbuf[i].data )
+			{
+				// Pages brought in by scrolling while paused are just redrawn
+				if ( running )
+				{
+					mbuf[i].actv  = 15;
+					pageActv[page] = true;
+				}
+				mbuf[i].data  = data[i];
+				mbuf[i].draw  = 1;
+			}
+		}
+	}
+   return 0;
+}
+
 int memViewWin_t::getAddrFromCursor( int CursorTextOffset )
 {
 	int line, offs, byte0, byte, bcol, addr = -1;
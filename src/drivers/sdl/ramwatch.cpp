@@ -3,6 +3,7 @@
 #include <string.h>
 #include <string>
 #include <list>
+#include <vector>
 
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
@@ -23,6 +24,7 @@
 #include "../../movie.h"
 #include "../../palette.h"
 #include "../../fds.h"
+#include "../../memsnapshot.h"
 #include "../common/configSys.h"
 
 #include "sdl.h"
@@ -75,6 +77,33 @@ struct ramWatch_t
 			val.u8 = GetMem (addr);
 		}
 	}
+
+	// Same as above, from the core's per-frame memory snapshot
+	void updateMem (const uint8 *snapshot)
+	{
+		if (size == 2)
+		{
+			val.u16 = snapshot[addr & 0xFFFF] | (snapshot[(addr + 1) & 0xFFFF] << 8);
+		}
+		else
+		{
+			val.u8 = snapshot[addr & 0xFFFF];
+		}
+	}
+
+	void watchMem (void)
+	{
+		FCEUI_MemSnapshotWatch (addr & 0xFFFF, addr & 0xFFFF);
+		if (size == 2)
+		{
+			FCEUI_MemSnapshotWatch ((addr + 1) & 0xFFFF, (addr + 1) & 0xFFFF);
+		}
+	}
+
+	int shownValue (void)
+	{
+		return (size == 2) ? val.u16 : val.u8;
+	}
 };
 
 struct ramWatchList_t
@@ -202,6 +231,8 @@ struct ramWatchWin_t
 	bool ramWatchWinOpen;
 	int ramWatchEditRowIdx;
 	int ramWatchEditColIdx;
+	std::vector < int > shownVal;	// value displayed in each row, -1 when unknown
+	uint32 snapshotSerial;
 
 	  ramWatchWin_t (void)
 	{
@@ -211,13 +242,43 @@ struct ramWatchWin_t
 		ramWatchWinOpen = false;
 		ramWatchEditRowIdx = -1;
 		ramWatchEditColIdx = -1;
+		snapshotSerial = 0;
 	}
 
 	void showRamWatchResults (int reset);
+	void updateRamWatchResults (void);
 };
 
 static gint ramWatchEvntSrcID = 0;
 
+static void formatRamWatchValue (ramWatch_t * rw, char *valStr1, char *valStr2)
+{
+	if (rw->size == 2)
+	{
+		if (rw->type)
+		{
+			sprintf (valStr1, "%6u", rw->val.u16);
+		}
+		else
+		{
+			sprintf (valStr1, "%6i", rw->val.i16);
+		}
+		sprintf (valStr2, "0x%04X", rw->val.u16);
+	}
+	else
+	{
+		if (rw->type)
+		{
+			sprintf (valStr1, "%6u", rw->val.u8);
+		}
+		else
+		{
+			sprintf (valStr1, "%6i", rw->val.i8);
+		}
+		sprintf (valStr2, "0x%02X", rw->val.u8);
+	}
+}
+
 void ramWatchWin_t::showRamWatchResults (int reset)
 {
 	int row = 0;
@@ -226,6 +287,8 @@ void ramWatchWin_t::showRamWatchResults (int reset)
 	char addrStr[32], valStr1[16], valStr2[16];
 	ramWatch_t *rw;
 
+	shownVal.assign (ramWatchList.size (), -1);
+
 	//if ( !reset )
 	//{
 	//   if ( gtk_tree_model_get_iter_first( GTK_TREE_MODEL(ram_watch_store), &iter ) )
@@ -269,36 +332,14 @@ void ramWatchWin_t::showRamWatchResults (int reset)
 
 		rw->updateMem ();
 
-		if (rw->size == 2)
-		{
-			if (rw->type)
-			{
-				sprintf (valStr1, "%6u", rw->val.u16);
-			}
-			else
-			{
-				sprintf (valStr1, "%6i", rw->val.i16);
-			}
-			sprintf (valStr2, "0x%04X", rw->val.u16);
-		}
-		else
-		{
-			if (rw->type)
-			{
-				sprintf (valStr1, "%6u", rw->val.u8);
-			}
-			else
-			{
-				sprintf (valStr1, "%6i", rw->val.i8);
-			}
-			sprintf (valStr2, "0x%02X", rw->val.u8);
-		}
+		formatRamWatchValue (rw, valStr1, valStr2);
 
 		if (row != ramWatchEditRowIdx)
 		{
 			gtk_tree_store_set (ram_watch_store, &iter,
 					    0, addrStr, 1, valStr1, 2, valStr2,
 					    3, rw->name.c_str (), -1);
+			shownVal[row] = rw->shownValue ();
 		}
 		else
 		{
@@ -335,6 +376,74 @@ void ramWatchWin_t::showRamWatchResults (int reset)
 	}
 }
 
+// Periodic refresh: only the rows whose value changed are touched, and nothing at all
+// is done while running if none of the watched memory changed since the last time.
+// While paused, memory is read directly so that edits from the other tools show up.
+void ramWatchWin_t::updateRamWatchResults (void)
+{
+	int row = 0;
+	std::list < ramWatch_t * >::iterator it;
+	GtkTreeIter iter;
+	char valStr1[16], valStr2[16];
+	ramWatch_t *rw;
+	const uint8 *snapshot = NULL;
+	bool direct = (GameInfo == NULL) || FCEUI_EmulationPaused ();
+
+	if (shownVal.size () != ramWatchList.size ())
+	{
+		showRamWatchResults (0);
+		return;
+	}
+
+	if (!direct)
+	{
+		for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
+		{
+			(*it)->watchMem ();
+		}
+		if (snapshotSerial == FCEUI_MemSnapshotSerial ())
+		{
+			return;
+		}
+		snapshotSerial = FCEUI_MemSnapshotSerial ();
+		snapshot = FCEUI_MemSnapshotData ();
+	}
+
+	if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (ram_watch_store), &iter))
+	{
+		return;
+	}
+
+	for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
+	{
+		rw = *it;
+
+		if (direct)
+		{
+			rw->updateMem ();
+		}
+		else
+		{
+			rw->updateMem (snapshot);
+		}
+
+		if ((row != ramWatchEditRowIdx) && (rw->shownValue () != shownVal[row]))
+		{
+			formatRamWatchValue (rw, valStr1, valStr2);
+
+			gtk_tree_store_set (ram_watch_store, &iter,
+					    1, valStr1, 2, valStr2, -1);
+			shownVal[row] = rw->shownValue ();
+		}
+
+		if (!gtk_tree_model_iter_next (GTK_TREE_MODEL (ram_watch_store), &iter))
+		{
+			break;
+		}
+		row++;
+	}
+}
+
 static std::list < ramWatchWin_t * >ramWatchWinList;
 
 void showAllRamWatchResults (int reset)
@@ -921,7 +1030,12 @@ static gint updateRamWatchTree (void *userData)
 {
 	//static uint32_t c = 0;
 	//printf("RamWatch: %u\n", c++ );
-	showAllRamWatchResults (0);
+	std::list < ramWatchWin_t * >::iterator it;
+
+	for (it = ramWatchWinList.begin (); it != ramWatchWinList.end (); it++)
+	{
+		(*it)->updateRamWatchResults ();
+	}
 	return 1;
 }
 
@@ -26,6 +26,7 @@
 #include "../common/configSys.h"
 #include "../../utils/memory.h"
 
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
@@ -37,6 +38,13 @@ static unsigned int s_BufferSize;
 static unsigned int s_BufferRead;
 static unsigned int s_BufferWrite;
 static volatile unsigned int s_BufferIn;
+static unsigned int s_Rate;
+
+// when the SDL last took a block of samples and how many, to tell how much of
+// it is still playing
+static std::chrono::steady_clock::time_point s_BlockTime;
+static unsigned int s_BlockSize;
+static unsigned int s_Underruns;
 
 static int s_mute = 0;
 
@@ -51,6 +59,10 @@ fillaudio(void *udata,
 {
 	int16 *tmps = (int16*)stream;
 	len >>= 1;
+	s_BlockTime = std::chrono::steady_clock::now();
+	s_BlockSize = len;
+	if(s_BufferIn && s_BufferIn < (unsigned int)len)
+		s_Underruns++;
 	while(len) {
 		int16 sample = 0;
 		if(s_BufferIn) {
@@ -124,6 +136,9 @@ InitSound()
 		return 0;
 	}
 	s_BufferRead = s_BufferWrite = s_BufferIn = 0;
+	s_Rate = soundrate;
+	s_BlockSize = 0;
+	s_Underruns = 0;
 
 	if (SDL_OpenAudio(&spec, 0) < 0)
 	{
@@ -170,6 +185,35 @@ GetWriteSound(void)
 	return(s_BufferSize - s_BufferIn);
 }
 
+/**
+ * Returns the number of samples still to be played: those in the buffer,
+ * and the part of the block the SDL last took that hasn't played yet.
+ */
+uint32
+GetQueuedSound(void)
+{
+	SDL_LockAudio();
+	unsigned int in = s_BufferIn, block = s_BlockSize;
+	std::chrono::steady_clock::time_point blockTime = s_BlockTime;
+	SDL_UnlockAudio();
+
+	if(block) {
+		double played = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockTime).count() * s_Rate;
+		if(played < block)
+			in += block - (unsigned int)played;
+	}
+	return in;
+}
+
+/**
+ * Returns how many times the audio buffer ran dry while playing.
+ */
+uint32
+GetSoundUnderruns(void)
+{
+	return s_Underruns;
+}
+
 /**
  * Send a sound clip to the audio subsystem.
  */
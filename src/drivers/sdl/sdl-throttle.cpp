@@ -1,19 +1,62 @@
 /// \file
-/// \brief Handles emulation speed throttling using the SDL timing functions.
+/// \brief Handles emulation speed throttling and frame pacing.
+///
+/// Each frame waits for its deadline on a monotonic clock: SDL_Delay sleeps
+/// through most of the wait, and the last stretch, which SDL_Delay may
+/// oversleep, is spent spinning on the clock. The deadline is one frame after
+/// the last one; with sound and audio sync, it is also steered towards the
+/// moment the sound device has played the buffer down to half full, so the
+/// frames follow the sound card and the buffer neither runs dry nor overflows.
+///
+/// How long every frame spends emulating, blitting, presenting and waiting is
+/// counted in histograms, shown on the HUD with --showpacing and written out
+/// with --pacingcsv.
 
 #include "sdl.h"
 #include "throttle.h"
+#include "../../fceu.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
 
 static const double Slowest = 0.015625; // 1/64x speed (around 1 fps on NTSC)
 static const double Fastest = 32;       // 32x speed   (around 1920 fps on NTSC)
 static const double Normal  = 1.0;      // 1x speed    (around 60 fps on NTSC)
 
-static uint64 Lasttime, Nexttime;
-static long double desired_frametime;
+typedef std::chrono::steady_clock PacingClock;
+
+static PacingClock::time_point Nexttime; // deadline of the frame being waited for
+static double desired_frametime;         // in seconds
+static bool Resync = true;               // the next deadline is counted from now
 static int InFrame;
+static bool Behind;                      // the frame waited for is more than a frame late
+static bool FrameLate;                   // Behind, for the frame being timed
+static int Skipped;                      // blits skipped in a row
+static bool AudioSync = true;
+static bool AudioClocked;                // the last frame was paced by the sound
 double g_fpsScale = Normal; // used by sdl.cpp
 bool MaxSpeed = false;
 
+// How late SDL_Delay wakes up. It jumps to the worst oversleep seen and decays
+// slowly, and the wait spins for that long plus a little before the deadline.
+static double Oversleep = 0.001;
+#define SPIN_MIN 0.0005
+#define SPIN_MAX 0.004
+
+// frames a wall clock deadline may be missed by before it is counted from now again
+#define RESYNC_FRAMES 4
+// Paced by the sound, the frames still go a frame apart on the clock, and each
+// deadline moves this part of the way towards when the sound wants the frame.
+// The sound tells the time only as often as the SDL takes a block, and going by
+// it directly would make the frames as uneven as that.
+#define AUDIO_STEER 0.0625
+// how far the deadline may be from the sound's before it jumps there
+#define AUDIO_RESYNC_FRAMES 2
+// blits skipped in a row at most, so a slow machine still shows something
+#define MAX_SKIPPED 3
+
 /* LOGMUL = exp(log(2) / 3)
  *
  * This gives us a value such that if we do x*=LOGMUL three times,
@@ -24,6 +67,16 @@ bool MaxSpeed = false;
  */
 #define LOGMUL 1.259921049894873
 
+static double Seconds(PacingClock::duration d)
+{
+	return std::chrono::duration<double>(d).count();
+}
+
+static PacingClock::duration Duration(double seconds)
+{
+	return std::chrono::duration_cast<PacingClock::duration>(std::chrono::duration<double>(seconds));
+}
+
 /**
  * Refreshes the FPS throttling variables.
  */
@@ -31,64 +84,130 @@ void
 RefreshThrottleFPS()
 {
 	uint64 fps = FCEUI_GetDesiredFPS(); // Do >> 24 to get in Hz
-	desired_frametime = 16777216.0l / (fps * g_fpsScale);
+	desired_frametime = 16777216.0 / (fps * g_fpsScale);
 
-	Lasttime=0;   
-	Nexttime=0;
-	InFrame=0;
+	Resync = true;
+	InFrame = 0;
 }
 
 /**
- * Perform FPS speed throttling by delaying until the next time slot.
+ * Sleeps until shortly before the deadline, then spins until it.
+ */
+static void
+WaitUntil(PacingClock::time_point deadline)
+{
+	for(;;)
+	{
+		PacingClock::time_point now = PacingClock::now();
+		double margin = Oversleep + 0.00025;
+		if(margin < SPIN_MIN) margin = SPIN_MIN;
+		if(margin > SPIN_MAX) margin = SPIN_MAX;
+
+		int ms = (int)((Seconds(deadline - now) - margin) * 1000);
+		if(ms < 1)
+			break;
+		SDL_Delay(ms);
+
+		double over = Seconds(PacingClock::now() - now) - ms / 1000.0;
+		Oversleep = over > Oversleep * 0.98 ? over : Oversleep * 0.98;
+	}
+	while(PacingClock::now() < deadline)
+		;
+}
+
+/**
+ * The deadline when the frames go by the sound: the moment the device will
+ * have played the buffer down to where the frame's sound can go in and
+ * leave it half full.
+ */
+static PacingClock::time_point
+AudioDeadline(PacingClock::time_point now, int samples)
+{
+	int target = GetMaxSound() / 2;
+	if(target > (int)GetMaxSound() - samples)
+		target = GetMaxSound() - samples;
+	if(target < 0)
+		target = 0;
+
+	int queued = GetQueuedSound();
+	// the sound runs dry before the next frame is ready
+	Behind = queued < samples;
+	if(queued <= target)
+		return now;
+	return now + Duration((double)(queued - target) / FSettings.SndRate);
+}
+
+/**
+ * Waits until the next frame is due. samples is the size of the frame's sound
+ * if it goes to the sound device, or 0. Returns 1 when there's more to wait,
+ * so that the caller can poll the input in the meantime.
  */
 int
-SpeedThrottle()
+SpeedThrottle(int samples)
 {
 	if(g_fpsScale >= 32)
 	{
 		return 0; /* Done waiting */
 	}
-	uint64 time_left;
-	uint64 cur_time;
-    
-	if(!Lasttime)
-		Lasttime = SDL_GetTicks();
-    
+	PacingClock::time_point now = PacingClock::now();
+
 	if(!InFrame)
 	{
 		InFrame = 1;
-		Nexttime = Lasttime + desired_frametime * 1000;
-	}
-    
-	cur_time  = SDL_GetTicks();
-	if(cur_time >= Nexttime)
-		time_left = 0;
-	else
-		time_left = Nexttime - cur_time;
-    
-	if(time_left > 50)
-	{
-		time_left = 50;
-		/* In order to keep input responsive, don't wait too long at once */
-		/* 50 ms wait gives us a 20 Hz responsetime which is nice. */
+		bool wasAudioClocked = AudioClocked;
+		AudioClocked = AudioSync && samples > 0 && g_fpsScale == Normal;
+		if(AudioClocked)
+		{
+			PacingClock::time_point deadline = AudioDeadline(now, samples);
+			Nexttime += Duration(desired_frametime);
+
+			double error = Seconds(deadline - Nexttime);
+			if(Resync || !wasAudioClocked || fabs(error) > desired_frametime * AUDIO_RESYNC_FRAMES)
+				Nexttime = deadline;
+			else
+				Nexttime += Duration(error * AUDIO_STEER);
+		}
+		else
+		{
+			if(Resync)
+				Nexttime = now;
+			Nexttime += Duration(desired_frametime);
+
+			double late = Seconds(now - Nexttime);
+			Behind = late > desired_frametime;
+			if(late > desired_frametime * RESYNC_FRAMES)
+				Nexttime = now;
+		}
+		Resync = false;
 	}
-	else
-		InFrame = 0;
-    
-	//fprintf(stderr, "attempting to sleep %Ld ms, frame complete=%s\n",
-	//	time_left, InFrame?"no":"yes");
 
-	if ( time_left > 0 )
+	/* In order to keep input responsive, don't wait too long at once */
+	/* 50 ms wait gives us a 20 Hz responsetime which is nice. */
+	if(Nexttime - now > std::chrono::milliseconds(50 + 1))
 	{
-		SDL_Delay(time_left);
+		SDL_Delay(50);
+		return 1; /* Must still wait some more */
 	}
-    
-	if(!InFrame)
+
+	WaitUntil(Nexttime);
+	InFrame = 0;
+	return 0; /* Done waiting */
+}
+
+/**
+ * Whether the frame just waited for should go without a blit to catch up.
+ */
+bool
+ThrottleSkipBlit()
+{
+	FrameLate = Behind;
+	if(Behind && Skipped < MAX_SKIPPED)
 	{
-		Lasttime = SDL_GetTicks();
-		return 0; /* Done waiting */
+		Skipped++;
+		return true;
 	}
-	return 1; /* Must still wait some more */
+	Skipped = 0;
+	return false;
 }
 
 /**
@@ -97,11 +216,11 @@ SpeedThrottle()
 void IncreaseEmulationSpeed(void)
 {
 	g_fpsScale *= LOGMUL;
-    
+
 	if(g_fpsScale > Fastest) g_fpsScale = Fastest;
 
 	RefreshThrottleFPS();
-     
+
 	FCEU_DispMessage("Emulation speed %.1f%%",0, g_fpsScale*100.0);
 }
 
@@ -126,7 +245,7 @@ void
 FCEUD_SetEmulationSpeed(int cmd)
 {
 	MaxSpeed = false;
-    
+
 	switch(cmd) {
 	case EMUSPEED_SLOWEST:
 		g_fpsScale = Slowest;
@@ -152,3 +271,221 @@ FCEUD_SetEmulationSpeed(int cmd)
 
 	FCEU_DispMessage("Emulation speed %.1f%%",0, g_fpsScale*100.0);
 }
+
+// Frame timing. The histograms count every frame since the game was loaded;
+// the HUD shows the last second.
+
+#define PACING_BUCKETS   200   // histogram buckets
+#define PACING_BUCKET_MS 0.25  // each this wide; the last also holds everything slower
+#define HUD_BINS         32    // bars of the frame time graph on the HUD
+#define HUD_BIN_MS       0.5   // each this wide, centered on the frame time at the speed set
+
+static const char *PhaseNames[PACE_FRAME + 1] = { "emulate", "blit", "present", "wait", "frame" };
+
+static bool ShowHUD = false;
+static uint32 Histogram[PACE_FRAME + 1][PACING_BUCKETS];
+static uint32 Frames, Late, Skips;
+static double Times[PACE_FRAME];    // the frame being timed, in seconds
+static PacingClock::time_point LastMark;
+static bool Marked;                 // LastMark is set
+static bool Started;                // a whole frame has been timed
+
+// the second being counted, and the last one, shown on the HUD
+static int PeriodFrames;
+static double PeriodSum[PACE_FRAME + 1], PeriodMax[PACE_FRAME + 1], PeriodSquares;
+static uint32 PeriodBins[HUD_BINS], PeriodLate, PeriodSkips;
+static double HUDAverage[PACE_FRAME + 1], HUDMax[PACE_FRAME + 1], HUDJitter;
+static uint32 HUDBins[HUD_BINS], HUDFrames, HUDLate, HUDSkips;
+
+static void
+ResetPeriod()
+{
+	PeriodFrames = 0;
+	memset(PeriodSum, 0, sizeof(PeriodSum));
+	memset(PeriodMax, 0, sizeof(PeriodMax));
+	PeriodSquares = 0;
+	memset(PeriodBins, 0, sizeof(PeriodBins));
+	PeriodLate = PeriodSkips = 0;
+}
+
+/**
+ * Sets how the frames are paced and starts counting anew.
+ */
+void
+SetPacing(bool audioSync, bool showHUD)
+{
+	AudioSync = audioSync;
+	ShowHUD = showHUD;
+
+	memset(Histogram, 0, sizeof(Histogram));
+	Frames = Late = Skips = 0;
+	memset(Times, 0, sizeof(Times));
+	Marked = Started = false;
+	ResetPeriod();
+	HUDFrames = 0;
+}
+
+/**
+ * Ends a phase of the frame; the time since the last mark goes to it.
+ */
+void
+PacingMark(int phase)
+{
+	PacingClock::time_point now = PacingClock::now();
+	if(Marked)
+		Times[phase] += Seconds(now - LastMark);
+	LastMark = now;
+	Marked = true;
+}
+
+static void
+CountTime(int phase, double seconds)
+{
+	int bucket = (int)(seconds * 1000 / PACING_BUCKET_MS);
+	if(bucket >= PACING_BUCKETS)
+		bucket = PACING_BUCKETS - 1;
+	Histogram[phase][bucket]++;
+
+	PeriodSum[phase] += seconds;
+	if(seconds > PeriodMax[phase])
+		PeriodMax[phase] = seconds;
+}
+
+/**
+ * Ends the frame: its phases go into the histograms.
+ */
+void
+PacingFrameDone(bool skipped)
+{
+	double frame = 0;
+	for(int i = 0; i < PACE_FRAME; i++)
+		frame += Times[i];
+
+	// the first frame was only partly timed
+	if(!Started)
+	{
+		Started = true;
+		memset(Times, 0, sizeof(Times));
+		return;
+	}
+
+	for(int i = 0; i < PACE_FRAME; i++)
+		CountTime(i, Times[i]);
+	CountTime(PACE_FRAME, frame);
+	memset(Times, 0, sizeof(Times));
+
+	Frames++;
+	PeriodFrames++;
+	PeriodSquares += frame * frame;
+	if(FrameLate)
+	{
+		Late++;
+		PeriodLate++;
+	}
+	FrameLate = false;
+	if(skipped)
+	{
+		Skips++;
+		PeriodSkips++;
+	}
+
+	int bin = (int)floor((frame - desired_frametime) * 1000 / HUD_BIN_MS) + HUD_BINS / 2;
+	if(bin < 0) bin = 0;
+	if(bin >= HUD_BINS) bin = HUD_BINS - 1;
+	PeriodBins[bin]++;
+
+	if(PeriodFrames < (int)(FCEUI_GetDesiredFPS() >> 24))
+		return;
+
+	for(int i = 0; i <= PACE_FRAME; i++)
+	{
+		HUDAverage[i] = PeriodSum[i] / PeriodFrames * 1000;
+		HUDMax[i] = PeriodMax[i] * 1000;
+	}
+	double mean = PeriodSum[PACE_FRAME] / PeriodFrames;
+	double variance = PeriodSquares / PeriodFrames - mean * mean;
+	HUDJitter = variance > 0 ? sqrt(variance) * 1000 : 0;
+	memcpy(HUDBins, PeriodBins, sizeof(HUDBins));
+	HUDFrames = PeriodFrames;
+	HUDLate = PeriodLate;
+	HUDSkips = PeriodSkips;
+	ResetPeriod();
+}
+
+/**
+ * Draws the timing of the last second over the picture, if it's asked for.
+ */
+void
+PacingDrawHUD(uint8 *XBuf)
+{
+	if(!ShowHUD || !HUDFrames)
+		return;
+
+	char line[4][48];
+	sprintf(line[0], "frame %.2f jitter %.2f max %.2f", HUDAverage[PACE_FRAME], HUDJitter, HUDMax[PACE_FRAME]);
+	sprintf(line[1], "emulate %.2f/%.2f blit %.2f/%.2f",
+		HUDAverage[PACE_EMULATE], HUDMax[PACE_EMULATE], HUDAverage[PACE_BLIT], HUDMax[PACE_BLIT]);
+	sprintf(line[2], "present %.2f/%.2f wait %.2f/%.2f",
+		HUDAverage[PACE_PRESENT], HUDMax[PACE_PRESENT], HUDAverage[PACE_WAIT], HUDMax[PACE_WAIT]);
+	sprintf(line[3], "%s late %u skip %u dry %u", AudioClocked ? "audio" : "wall",
+		HUDLate, HUDSkips, GetSoundUnderruns());
+
+	int y = FSettings.FirstSLine + 4;
+	for(int i = 0; i < 4; i++, y += 9)
+		DrawTextTrans(XBuf + 8 + y * 256, 256, (uint8*)line[i], 0xA0);
+
+	// how the frame times spread around the frame time at the speed set; the
+	// tick under the graph marks it
+	y += 17;
+	if(y + 2 > FSettings.LastSLine)
+		return;
+	for(int i = 0; i < HUD_BINS; i++)
+	{
+		int h = HUDBins[i] ? 1 + HUDBins[i] * 15 / HUDFrames : 0;
+		for(int j = 0; j < 16; j++)
+		{
+			uint8 *p = XBuf + (y - j) * 256 + 10 + i * 4;
+			p[0] = p[1] = p[2] = j < h ? 0xA0 : 0xC1;
+			p[3] = 0xC1;
+		}
+	}
+	XBuf[(y + 1) * 256 + 10 + HUD_BINS / 2 * 4] = 0xA0;
+	XBuf[(y + 2) * 256 + 10 + HUD_BINS / 2 * 4] = 0xA0;
+}
+
+/**
+ * Writes the histograms to a CSV file: a row per bucket, with its lower end
+ * in milliseconds and the number of frames that spent that long in each
+ * phase. The last bucket also counts everything slower.
+ */
+bool
+PacingWriteCSV(const char *fn)
+{
+	FILE *fp = fopen(fn, "w");
+	if(!fp)
+		return false;
+
+	fprintf(fp, "ms");
+	for(int i = 0; i <= PACE_FRAME; i++)
+		fprintf(fp, ",%s", PhaseNames[i]);
+	fprintf(fp, "\n");
+	for(int b = 0; b < PACING_BUCKETS; b++)
+	{
+		fprintf(fp, "%.2f", b * PACING_BUCKET_MS);
+		for(int i = 0; i <= PACE_FRAME; i++)
+			fprintf(fp, ",%u", Histogram[i][b]);
+		fprintf(fp, "\n");
+	}
+	return fclose(fp) == 0;
+}
+
+/**
+ * Frames timed, missed deadlines and skipped blits since the game was loaded.
+ */
+void
+GetPacingCounts(uint32 *frames, uint32 *late, uint32 *skips)
+{
+	*frames = Frames;
+	*late = Late;
+	*skips = Skips;
+}
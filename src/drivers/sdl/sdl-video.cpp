@@ -35,6 +35,7 @@
 
 #include "../common/configSys.h"
 #include "sdl-video.h"
+#include "throttle.h"
 
 #ifdef CREATE_AVI
 #include "../videolog/nesvideos-piece.h"
@@ -98,6 +99,7 @@ KillVideo()
 	if ( glx_shm != NULL )
 	{
 		glx_shm->clear_pixbuf();
+		InvalidateBlitToHigh();
 	}
 
 	destroy_gui_video();
@@ -338,6 +340,7 @@ BlitScreen(uint8 *XBuf)
 {
 	uint8 *dest;
 	int w, h, pitch;
+	int first, last;
 
 	// refresh the palette if required
 	if (s_paletterefresh) 
@@ -357,40 +360,38 @@ BlitScreen(uint8 *XBuf)
 
 	if ( dest == NULL ) return;
 
-	Blit8ToHigh(XBuf + NOFFSET, dest, NWIDTH, s_tlines, pitch, 1, 1);
+	// Only the lines that changed are blitted and drawn again; a still
+	// picture (a menu, the game paused) costs little more than a compare.
+	bool changed = Blit8ToHighChanged(XBuf + NOFFSET, dest, NWIDTH, s_tlines, pitch, 1, 1, &first, &last);
+	PacingMark( PACE_BLIT );
 
-	guiPixelBufferReDraw();
+	if ( changed )
+	{
+		glx_shm->mark_dirty( first, last );
+
+		guiPixelBufferReDraw();
+	}
+	PacingMark( PACE_PRESENT );
 
 #ifdef CREATE_AVI
  { int fps = FCEUI_GetDesiredFPS();
-   static unsigned char* result = NULL;
-   static unsigned resultsize = 0;
    int width = NWIDTH, height = s_tlines;
-   if(!result || resultsize != width*height*3*2)
+   // The frame is drawn straight into the capture queue; the writer
+   // thread converts and writes it, so nothing is copied here. When the
+   // blit is only a palette lookup, the palette indices go instead and
+   // the writer makes the YUV picture from them.
+   bool indexed = Blit8ToHighIsLookup(1, 1);
+   uint8 *frame = (uint8*)NESVideoLoggingVideoBuffer(width, height, fps, indexed ? 8 : s_curbpp);
+   if ( frame != NULL )
    {
-       if(result) free(result);
-       result = (unsigned char*) FCEU_dmalloc(resultsize = width*height*3*2);
+       if ( indexed )
+           Blit8ToIndexed(XBuf + NOFFSET, frame, NWIDTH, s_tlines);
+       else
+           Blit8ToHigh(XBuf + NOFFSET, frame, NWIDTH, s_tlines, width * (s_curbpp >> 3), 1, 1);
+       NESVideoLoggingVideoCommit();
    }
-   switch(s_curbpp)
+   else
    {
-   #if 0
-     case 24: case 32: case 15: case 16:
-       /* Convert to I420 if possible, because our I420 conversion is optimized
-        * and it'll produce less network traffic, hence faster throughput than
-        * anything else. And H.264 eats only I420, so it'd be converted sooner
-        * or later anyway if we didn't do it. Win-win situation.
-        */
-       switch(s_curbpp)
-       {
-         case 32: Convert32To_I420Frame(s_screen->pixels, &result[0], width*height, width); break;
-         case 24: Convert24To_I420Frame(s_screen->pixels, &result[0], width*height, width); break;
-         case 15: Convert15To_I420Frame(s_screen->pixels, &result[0], width*height, width); break;
-         case 16: Convert16To_I420Frame(s_screen->pixels, &result[0], width*height, width); break;
-       }
-       NESVideoLoggingVideo(&result[0], width,height, fps, 12);
-       break;
-   #endif
-     default:
        NESVideoLoggingVideo( dest, width,height, fps, s_curbpp);
    }
  }
@@ -423,6 +424,8 @@ BlitScreen(uint8 *XBuf)
  }
 #endif // REALTIME_LOGGING
 
+	// the capture counts as blitting
+	PacingMark( PACE_BLIT );
 }
 
 /**
@@ -9,6 +9,14 @@
 #ifdef _S9XLUA_H
 #include "../../fceulua.h"
 #endif
+#include "../../tracelog.h"
+#include "../../pngdump.h"
+#include "../../shmexport.h"
+#include "../../runahead.h"
+#include "../../debug.h"
+#include "../../cdlog.h"
+#include "../../romscan.h"
+#include "../../file.h"
 
 #include "input.h"
 #include "dface.h"
@@ -82,6 +90,10 @@ static const char *DriverUsage=
 "Option         Value   Description\n"
 "--pal          {0|1}   Use PAL timing.\n"
 "--newppu       {0|1}   Enable the new PPU core. (WARNING: May break savestates)\n"
+"--runahead     n       Shows each frame n frames early, hiding that much of the\n"
+"                       game's input lag. (0-8, costs n extra frames each frame)\n"
+"--runaheadaudio {0|1}  Play the sound of the real frames instead of the frames\n"
+"                       shown, so it doesn't skip when the input changes.\n"
 "--inputcfg     d       Configures input device d on startup.\n"
 "--input(1,2)   d       Set which input device to emulate for input 1 or 2.\n"
 "                         Devices:  gamepad zapper powerpad.0 powerpad.1\n"
@@ -104,6 +116,7 @@ static const char *DriverUsage=
 "--opengl       {0|1}   Enable OpenGL support.\n"
 "--fullscreen   {0|1}   Enable full screen mode.\n"
 "--noframe      {0|1}   Hide title bar and window decorations.\n"
+"--showpacing   {0|1}   Show how long each frame takes on the screen.\n"
 "--special      {1-4}   Use special video scaling filters\n"
 "                         (1 = hq2x; 2 = Scale2x; 3 = NTSC 2x; 4 = hq3x;\n"
 "                         5 = Scale3x; 6 = Prescale2x; 7 = Prescale3x; 8=Precale4x; 9=PAL)\n"
@@ -112,12 +125,16 @@ static const char *DriverUsage=
 "--soundrate    x       Set sound playback rate to x Hz.\n"
 "--soundq      {0|1|2}  Set sound quality. (0 = Low 1 = High 2 = Very High)\n"
 "--soundbufsize x       Set sound buffer size to x ms.\n"
+"--audiosync    {0|1}   Pace the frames by the sound played rather than the clock.\n"
 "--volume      {0-256}  Set volume to x.\n"
 "--soundrecord  f       Record sound to file f.\n"
 "--playmov      f       Play back a recorded FCM/FM2/FM3 movie from filename f.\n"
 "--pauseframe   x       Pause movie playback at frame x.\n"
 "--fcmconvert   f       Convert fcm movie file f to fm2.\n"
 "--ripsubs      f       Convert movie's subtitles to srt\n"
+"--romscan      d       Scan directory d for games into the ROM index.\n"
+"--romindex     f       Use f as the ROM index file.\n"
+"--scanthreads  x       Scan with x threads (0 = one per CPU).\n"
 "--subtitles    {0|1}   Enable subtitle display\n"
 "--fourscore    {0|1}   Enable fourscore emulation\n"
 "--no-config    {0|1}   Use default config file and do not save\n"
@@ -166,9 +183,14 @@ static void ShowUsage(char *prog)
 #ifdef _S9XLUA_H
 	puts ("--loadlua      f       Loads lua script from filename f.");
 #endif
+	puts ("--tracelog     f       Records a binary instruction trace of the game to\n                         filename f. Decode it with fceux-tracedump.");
+	puts ("--dumpframes   n..m    Writes frames n to m of the game to PNG files in the\n                         snapshot directory.");
+	puts ("--shmexport    name    Publishes the picture, RAM and PPU state of every frame\n                         in the shared memory object name, e.g. /fceux.");
+	puts ("--pacingcsv    f       Writes how long the frames took emulating, blitting,\n                         presenting and waiting to the CSV file f when the\n                         game is closed.");
+	puts ("--cdl          f       Logs the code and data the game uses to the .cdl file f,\n                         adding to what it already holds. The file is updated as\n                         the game runs.");
 #ifdef CREATE_AVI
-	puts ("--videolog     c       Calls mencoder to grab the video and audio streams to\n                         encode them. Check the documentation for more on this.");
-	puts ("--mute        {0|1}    Mutes FCEUX while still passing the audio stream to\n                         mencoder during avi creation.");
+	puts ("--videolog     c       Records the video and audio of a movie to c: an .avi,\n                         a .y4m with a .wav, a .wav, or \"|command\" to pipe\n                         YUV4MPEG2 video into a command.");
+	puts ("--mute        {0|1}    Mutes FCEUX while still recording the audio stream.");
 #endif
 	puts("");
 	printf("Compiled with SDL version %d.%d.%d\n", SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL );
@@ -182,6 +204,29 @@ static void ShowUsage(char *prog)
 	
 }
 
+// the --cdl log, kept so that it picks up again when the same game is reloaded
+static std::string cdlogFile;
+static MD5DATA cdlogGame;
+
+/**
+ * Starts logging code and data to cdlogFile, once the loaded game's
+ * PRG and CHR sizes are known.
+ */
+static void
+StartCDLog()
+{
+	int interval;
+	g_config->getOption("SDL.CDLogSaveInterval", &interval);
+	FCEU_CDLogInit();
+	FCEU_CDLogReset();
+	FCEU_CDLogLoad(cdlogFile.c_str());
+	FCEUI_SetLoggingCD(1);
+	if (!FCEUI_CDLogBeginAutoSave(cdlogFile.c_str(), interval))
+	{
+		FCEUD_PrintError("Couldn't create the code/data log file.");
+	}
+}
+
 /**
  * Loads a game, given a full path/filename.  The driver code must be
  * initialized after the game is loaded, because the emulator code
@@ -218,6 +263,20 @@ int LoadGame(const char *path)
 
 	g_config->getOption("SDL.SwapDuty", &id);
 	swapDuty = id;
+
+	// the log belongs to one game; closing it stopped the logging
+	if (cdlogFile.size() && GameInfo->MD5 == cdlogGame)
+		StartCDLog();
+
+	g_config->getOption("SDL.RunAhead", &id);
+	FCEUI_SetRunAhead(id);
+	g_config->getOption("SDL.RunAheadAudio", &id);
+	FCEUI_SetRunAheadAudio(id ? RUNAHEAD_AUDIO_REAL : RUNAHEAD_AUDIO_AHEAD);
+
+	int showPacing;
+	g_config->getOption("SDL.AudioSync", &id);
+	g_config->getOption("SDL.ShowPacing", &showPacing);
+	SetPacing(id != 0, showPacing != 0);
 	
 	std::string filename;
 	g_config->getOption("SDL.Sound.RecordFile", &filename);
@@ -250,6 +309,27 @@ CloseGame()
         FCEUI_SelectState(state_to_save, 0);
         FCEUI_SaveState(NULL, false);
     }
+
+	RunAheadStats stats;
+	FCEUI_GetRunAheadStats(&stats);
+	if (stats.budgetMs > 0)
+	{
+		printf("Run-ahead of %d frames: %.2f ms a frame over the last second (%.2f ms emulating, %.2f ms saving, %.2f ms loading),"
+			" %u of %u frames over %.2f ms; up to %d frames would fit.\n",
+			stats.frames, stats.totalMs, stats.emulateMs, stats.saveMs, stats.loadMs,
+			stats.overBudget, stats.shown, stats.budgetMs, stats.sustainable);
+	}
+
+	g_config->getOption("SDL.PacingCSV", &filename);
+	if(filename.size()) {
+		uint32 frames, late, skips;
+		GetPacingCounts(&frames, &late, &skips);
+		if(PacingWriteCSV(filename.c_str()))
+			printf("Frame timing of %u frames written to %s: %u late, %u not shown, the sound ran dry %u times.\n",
+				frames, filename.c_str(), late, skips, GetSoundUnderruns());
+		else
+			printf("Couldn't write the frame timing to %s.\n", filename.c_str());
+	}
 	FCEUI_CloseGame();
 
 	DriverKill();
@@ -337,6 +417,12 @@ DriverKill()
 	if(inited&1)
 		KillSound();
 	inited=0;
+
+	#ifdef CREATE_AVI
+	// writes out what the capture still has queued and finishes its files
+	if(LoggingEnabled == 2)
+		NESVideoNextAVI();
+	#endif
 }
 
 /**
@@ -348,13 +434,15 @@ FCEUD_Update(uint8 *XBuf,
 			 int32 *Buffer,
 			 int Count)
 {
-	extern int FCEUDnetplay;
+	PacingMark(PACE_EMULATE);
 
 	#ifdef CREATE_AVI
 	if(LoggingEnabled == 2 || (eoptions&EO_NOTHROTTLE))
 	{
 	  if(LoggingEnabled == 2)
 	  {
+		// only read when a capture starts; one started with the sound off has no audio
+		NESVideoSetAudioFormat(FSettings.SndRate, 16, 1);
 		int16* MonoBuf = new int16[Count];
 		int n;
 		for(n=0; n<Count; ++n)
@@ -377,6 +465,7 @@ FCEUD_Update(uint8 *XBuf,
 	  if(inited & 2)
 		FCEUD_UpdateInput();
 	  if(XBuf && (inited & 4)) BlitScreen(XBuf);
+	  PacingFrameDone(false);
 	  
 	  //SpeedThrottle();
 		return;
@@ -386,81 +475,41 @@ FCEUD_Update(uint8 *XBuf,
 	int ocount = Count;
 	// apply frame scaling to Count
 	Count = (int)(Count / g_fpsScale);
-	if(Count) {
-		int32 can=GetWriteSound();
-		static int uflow=0;
-		int32 tmpcan;
-
-		// don't underflow when scaling fps
-		if(can >= GetMaxSound() && g_fpsScale==1.0) uflow=1;	/* Go into massive underflow mode. */
-
-		if(can > Count) can=Count;
-		else uflow=0;
-
-		#ifdef CREATE_AVI
-		if (!mutecapture)
-		#endif
-		  WriteSound(Buffer,can);
-
-		//if(uflow) puts("Underflow");
-		tmpcan = GetWriteSound();
-		// don't underflow when scaling fps
-		if(g_fpsScale>1.0 || ((tmpcan < Count*0.90) && !uflow)) {
-			if(XBuf && (inited&4) && !(NoWaiting & 2))
-				BlitScreen(XBuf);
-			Buffer+=can;
-			Count-=can;
-			if(Count) {
-				if(NoWaiting) {
-					can=GetWriteSound();
-					if(Count>can) Count=can;
-					#ifdef CREATE_AVI
-					if (!mutecapture)
-					#endif
-					  WriteSound(Buffer,Count);
-				} else {
-					while(Count>0) {
-						#ifdef CREATE_AVI
-						if (!mutecapture)
-						#endif
-						  WriteSound(Buffer,(Count<ocount) ? Count : ocount);
-						Count -= ocount;
-					}
-				}
-			}
-		} //else puts("Skipped");
-		else if(!NoWaiting && FCEUDnetplay && (uflow || tmpcan >= (Count * 1.8))) {
-			if(Count > tmpcan) Count=tmpcan;
-			while(tmpcan > 0) {
-				//	printf("Overwrite: %d\n", (Count <= tmpcan)?Count : tmpcan);
-				#ifdef CREATE_AVI
-				if (!mutecapture)
-				#endif
-				  WriteSound(Buffer, (Count <= tmpcan)?Count : tmpcan);
-				tmpcan -= Count;
-			}
-		}
+	if(!(inited & 1))
+		Count = 0;
+	#ifdef CREATE_AVI
+	if(mutecapture)
+		Count = 0;
+	#endif
 
-	} else {
-		if(!NoWaiting && (!(eoptions&EO_NOTHROTTLE) || FCEUI_EmulationPaused()))
-		while (SpeedThrottle())
+	bool skip = false;
+	if(!NoWaiting && (!(eoptions&EO_NOTHROTTLE) || FCEUI_EmulationPaused())) {
+		while (SpeedThrottle(Count))
 		{
 			FCEUD_UpdateInput();
 		}
-		if(XBuf && (inited&4)) {
-			BlitScreen(XBuf);
-		}
+		skip = ThrottleSkipBlit();
+	}
+
+	// the sound is written without waiting; what doesn't fit is dropped.
+	// when running slower than normal, the frame's sound is repeated
+	int can = GetWriteSound();
+	while(Count > 0 && can > 0) {
+		int n = (Count < ocount) ? Count : ocount;
+		if(n > can) n = can;
+		WriteSound(Buffer, n);
+		Count -= n;
+		can -= n;
+	}
+	PacingMark(PACE_WAIT);
+
+	if(XBuf && (inited&4) && !(NoWaiting & 2) && !skip) {
+		PacingDrawHUD(XBuf);
+		BlitScreen(XBuf);
 	}
+	PacingFrameDone(skip);
+
 	FCEUD_UpdateInput();
-	//if(!Count && !NoWaiting && !(eoptions&EO_NOTHROTTLE))
-	// SpeedThrottle();
-	//if(XBuf && (inited&4))
-	//{
-	// BlitScreen(XBuf);
-	//}
-	//if(Count)
-	// WriteSound(Buffer,Count,NoWaiting);
-	//FCEUD_UpdateInput();
 }
 
 /**
@@ -672,6 +721,32 @@ int main(int argc, char *argv[])
 	  return 0;
 	}
 
+	// scan a directory into the ROM index
+	g_config->getOption("SDL.RomScan", &s);
+	g_config->setOption("SDL.RomScan", "");
+	if (!s.empty())
+	{
+		std::string indexfn;
+		int threads;
+		g_config->getOption("SDL.RomIndex", &indexfn);
+		g_config->getOption("SDL.ScanThreads", &threads);
+		if (indexfn.empty())
+			indexfn = FCEU_MakeFName(FCEUMKF_ROMINDEX, 0, 0);
+
+		ROMSCANSTATS stats;
+		if (FCEUI_RomScan(std::vector<std::string>(1, s), indexfn.c_str(), threads, &stats))
+			printf("%d games in %s (%d files, %d new or changed).\n", stats.games, indexfn.c_str(), stats.files, stats.hashed);
+		else
+			FCEUD_Message("Couldn't write the ROM index...\n");
+
+		// don't scan again on the next start
+		if (!noconfig)
+			g_config->save();
+		DriverKill();
+		SDL_Quit();
+		return 0;
+	}
+
 	// If x/y res set to 0, store current display res in SDL.LastX/YRes
 	int yres, xres;
 	g_config->getOption("SDL.XResolution", &xres);
@@ -895,6 +970,47 @@ int main(int argc, char *argv[])
 		FCEU_LoadLuaCode(s.c_str());
 	}
 #endif
+
+	// start the binary trace if option passed
+	g_config->getOption("SDL.TraceLog", &s);
+	g_config->setOption("SDL.TraceLog", "");
+	if (s != "" && !FCEUI_BeginTraceLog(s.c_str()))
+	{
+		FCEUD_PrintError("Couldn't create the trace log file.");
+	}
+
+	// dump a range of frames to png files if option passed
+	g_config->getOption("SDL.DumpFrames", &s);
+	g_config->setOption("SDL.DumpFrames", "");
+	if (s != "")
+	{
+		int first, last;
+		int n = sscanf(s.c_str(), "%d..%d", &first, &last);
+		if (n == 1)
+			last = first;
+		if (n < 1 || last < first)
+			FCEUD_PrintError("--dumpframes takes the frames as first..last.");
+		else
+			FCEUI_DumpFrames(first, last);
+	}
+
+	// export the game state to shared memory if option passed
+	g_config->getOption("SDL.ShmExport", &s);
+	g_config->setOption("SDL.ShmExport", "");
+	if (s != "" && !FCEUI_ShmExportBegin(s.c_str()))
+	{
+		FCEUD_PrintError("Couldn't create the shared memory object.");
+	}
+
+	// log code and data to a .cdl file, saving it as it goes, if option passed
+	g_config->getOption("SDL.CDLog", &s);
+	g_config->setOption("SDL.CDLog", "");
+	if (s != "" && GameInfo)
+	{
+		cdlogFile = s;
+		cdlogGame = GameInfo->MD5;
+		StartCDLog();
+	}
 	
 	{
 		int id;
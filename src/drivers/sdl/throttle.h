@@ -1,2 +1,20 @@
+// the phases of a frame, as timed by PacingMark
+enum
+{
+	PACE_EMULATE,   // from the end of the last frame to FCEUD_Update
+	PACE_BLIT,      // converting the picture, drawing the HUD, capturing
+	PACE_PRESENT,   // handing the picture to the window
+	PACE_WAIT,      // throttling and writing the sound
+	PACE_FRAME      // the number of phases; in the histograms, the whole frame
+};
+
 void RefreshThrottleFPS();
-int SpeedThrottle(void);
+int SpeedThrottle(int samples);
+bool ThrottleSkipBlit();
+
+void SetPacing(bool audioSync, bool showHUD);
+void PacingMark(int phase);
+void PacingFrameDone(bool skipped);
+void PacingDrawHUD(uint8 *XBuf);
+bool PacingWriteCSV(const char *fn);
+void GetPacingCounts(uint32 *frames, uint32 *late, uint32 *skips);
@@ -0,0 +1,707 @@
+/* Built-in video and audio capture: a bounded frame queue and the writer
+ * thread that empties it into AVI, YUV4MPEG2, raw and WAV files or a pipe.
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>   // getcwd
+#include <stdio.h>
+#include <stdlib.h>   // setenv
+#include <string.h>
+#include <signal.h>   // pthread_sigmask
+#include <sys/types.h>
+
+#include "capture.h"
+#include "rgbtorgb.h"
+
+static const unsigned FPS_SCALE = 0x1000000;
+
+/* An AVI goes on in a new _partN file when it passes 2000MB, like the ones
+ * of the Windows driver */
+static const off_t AVI_SEGMENT_SIZE = 2097152000;
+
+/* The writer thread blocks SIGPIPE, so a pipe command that quits early fails
+ * its writes with EPIPE; the handler of the rest of the process is left as
+ * it was */
+static void BlockSigpipe(bool block)
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(block ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+
+static unsigned FrameBytes(unsigned width, unsigned height, unsigned bpp)
+{
+    if(bpp == 8) return width * height * 2 + 2048 * 4;
+    if(bpp == 15 || bpp == 17) bpp = 16;
+    return width * height * bpp / 8;
+}
+
+/* The format a picture is written in: palette indices come out as RGB32 */
+static unsigned PictureBpp(unsigned bpp)
+{
+    return bpp == 8 ? 32 : bpp;
+}
+
+/* R,G,B of pixel i of a picture of palette indices */
+static const unsigned char* IndexedColour(const CaptureFrame& f, unsigned i)
+{
+    const unsigned npixels = f.width * f.height;
+    const unsigned c = (f.video[npixels + i] & 7u) << 8 | f.video[i];
+    return &f.video[npixels * 2 + c * 4];
+}
+
+static unsigned GCD(unsigned a, unsigned b)
+{
+    while(b) { unsigned t = a % b; a = b; b = t; }
+    return a;
+}
+
+static void Put16(std::vector<unsigned char>& b, unsigned n)
+{
+    b.push_back(n & 255);
+    b.push_back((n >> 8) & 255);
+}
+static void Put32(std::vector<unsigned char>& b, unsigned n)
+{
+    Put16(b, n & 0xFFFF);
+    Put16(b, n >> 16);
+}
+static void PutTag(std::vector<unsigned char>& b, const char* tag)
+{
+    b.insert(b.end(), tag, tag + 4);
+}
+static void Set32(std::vector<unsigned char>& b, size_t pos, unsigned n)
+{
+    b[pos+0] = n & 255;
+    b[pos+1] = (n >> 8) & 255;
+    b[pos+2] = (n >> 16) & 255;
+    b[pos+3] = n >> 24;
+}
+/* Starts a chunk (a LIST if type is given); returns where its size goes */
+static size_t BeginChunk(std::vector<unsigned char>& b, const char* tag, const char* type = NULL)
+{
+    PutTag(b, tag);
+    size_t at = b.size();
+    Put32(b, 0);
+    if(type) PutTag(b, type);
+    return at;
+}
+static void EndChunk(std::vector<unsigned char>& b, size_t at)
+{
+    Set32(b, at, b.size() - at - 4);
+}
+
+static bool Patch32(FILE* fp, off_t pos, unsigned n)
+{
+    std::vector<unsigned char> b;
+    Put32(b, n);
+    return fseeko(fp, pos, SEEK_SET) == 0 && fwrite(&b[0], 1, 4, fp) == 4;
+}
+
+/* 32 or 24 bit R,G,B rows or palette indices to a bottom-up BGR24 DIB */
+static void ToDIB24(const CaptureFrame& f, std::vector<unsigned char>& dib)
+{
+    const unsigned stride   = f.bpp / 8;
+    const unsigned rowbytes = (f.width * 3 + 3) & ~3u;
+    dib.assign(rowbytes * f.height, 0);
+    for(unsigned y = 0; y < f.height; ++y)
+    {
+        const unsigned char* src  = &f.video[y * f.width * stride];
+        unsigned char*       dest = &dib[(f.height - 1 - y) * rowbytes];
+        for(unsigned x = 0; x < f.width; ++x, src += stride, dest += 3)
+        {
+            if(f.bpp == 8) src = IndexedColour(f, y * f.width + x);
+            dest[0] = src[2];
+            dest[1] = src[1];
+            dest[2] = src[0];
+        }
+    }
+}
+
+class WavFile
+{
+public:
+    WavFile() : fp(NULL), bytes(0) { }
+    ~WavFile() { Close(); }
+
+    bool Open(const std::string& fn, unsigned rate, unsigned bits, unsigned chans)
+    {
+        fp = fopen(fn.c_str(), "wb");
+        if(!fp) { perror(fn.c_str()); return false; }
+
+        std::vector<unsigned char> b;
+        size_t riff = BeginChunk(b, "RIFF", "WAVE");
+        size_t fmt  = BeginChunk(b, "fmt ");
+        Put16(b, 1); /* PCM */
+        Put16(b, chans);
+        Put32(b, rate);
+        Put32(b, rate * chans * (bits / 8));
+        Put16(b, chans * (bits / 8));
+        Put16(b, bits);
+        EndChunk(b, fmt);
+        BeginChunk(b, "data");
+        Set32(b, riff, 0);
+        return fwrite(&b[0], 1, b.size(), fp) == b.size();
+    }
+    bool Write(const std::vector<unsigned char>& data)
+    {
+        if(!fp || data.empty()) return true;
+        bytes += data.size();
+        return fwrite(&data[0], 1, data.size(), fp) == data.size();
+    }
+    /* Fills in the sizes */
+    bool Close()
+    {
+        if(!fp) return true;
+        bool ok = Patch32(fp, 4, 36 + bytes) && Patch32(fp, 40, bytes);
+        ok = (fclose(fp) == 0) && ok;
+        fp = NULL;
+        return ok;
+    }
+
+private:
+    FILE* fp;
+    unsigned bytes;
+};
+
+class CaptureOutput
+{
+public:
+    CaptureOutput() : rate(0), bits(16), chans(1), opened(false), warned(false) { }
+    virtual ~CaptureOutput() { }
+
+    void SetAudio(unsigned r, unsigned b, unsigned c) { rate = r; bits = b; chans = c; }
+
+    /* Both return false when writing failed */
+    bool Write(const CaptureFrame& f)
+    {
+        if(!opened)
+        {
+            /* The picture is set up by the first frame of video */
+            if(!f.bpp) return true;
+            first = f;
+            opened = true;
+            if(!Open()) return false;
+        }
+        if(f.bpp && (f.width != first.width || f.height != first.height
+                     || PictureBpp(f.bpp) != PictureBpp(first.bpp)))
+        {
+            if(!warned)
+                fprintf(stderr, "Capture: the picture changed to %ux%u, %u bpp; those frames are left out\n",
+                    f.width, f.height, f.bpp);
+            warned = true;
+            return WriteFrame(f, false);
+        }
+        return WriteFrame(f, f.bpp != 0);
+    }
+    virtual bool Close() = 0;
+
+protected:
+    CaptureFrame first; /* the format of the capture, without the data */
+    unsigned rate, bits, chans; /* the audio format; rate 0: no audio */
+
+    virtual bool Open() = 0;
+    virtual bool WriteFrame(const CaptureFrame& f, bool video) = 0;
+
+private:
+    bool opened, warned;
+};
+
+class AviOutput: public CaptureOutput
+{
+public:
+    AviOutput(const std::string& fn) : fn(fn), segment(0), fp(NULL) { }
+    virtual ~AviOutput() { Close(); }
+
+    virtual bool Close()
+    {
+        if(!fp) return true;
+        bool ok = Finish();
+        ok = (fclose(fp) == 0) && ok;
+        fp = NULL;
+        return ok;
+    }
+
+protected:
+    virtual bool Open()
+    {
+        if(PictureBpp(first.bpp) != 32 && first.bpp != 24)
+        {
+            fprintf(stderr, "Capture: AVI files take 24 or 32 bpp pictures, not %u bpp\n", first.bpp);
+            return false;
+        }
+        std::string name = fn;
+        if(segment)
+        {
+            /* name_part2.avi, name_part3.avi... */
+            char part[32];
+            sprintf(part, "_part%u", segment + 1);
+            std::string::size_type dot = name.rfind('.');
+            name.insert(dot, part);
+        }
+        fp = fopen(name.c_str(), "wb");
+        if(!fp) { perror(name.c_str()); return false; }
+        fprintf(stderr, "Capture: writing %s\n", name.c_str());
+
+        const bool audio = rate != 0;
+        const unsigned blockalign = chans * (bits / 8);
+        const unsigned rowbytes = (first.width * 3 + 3) & ~3u;
+        const unsigned framebytes = rowbytes * first.height;
+        const unsigned g = GCD(first.fps_scaled, FPS_SCALE);
+
+        std::vector<unsigned char> b;
+        size_t riff = BeginChunk(b, "RIFF", "AVI ");
+        size_t hdrl = BeginChunk(b, "LIST", "hdrl");
+
+        size_t avih = BeginChunk(b, "avih");
+        Put32(b, (unsigned)(1000000.0 * FPS_SCALE / first.fps_scaled));
+        Put32(b, (unsigned)((double)framebytes * first.fps_scaled / FPS_SCALE) + rate * blockalign);
+        Put32(b, 0);
+        Put32(b, 0x10 | 0x100); /* AVIF_HASINDEX | AVIF_ISINTERLEAVED */
+        pos_frames = b.size(); Put32(b, 0);
+        Put32(b, 0);
+        Put32(b, audio ? 2 : 1);
+        Put32(b, framebytes);
+        Put32(b, first.width);
+        Put32(b, first.height);
+        for(int n = 0; n < 4; ++n) Put32(b, 0);
+        EndChunk(b, avih);
+
+        size_t strl = BeginChunk(b, "LIST", "strl");
+        size_t strh = BeginChunk(b, "strh");
+        PutTag(b, "vids");
+        PutTag(b, "DIB ");
+        Put32(b, 0);
+        Put32(b, 0);
+        Put32(b, 0);
+        Put32(b, FPS_SCALE / g);
+        Put32(b, first.fps_scaled / g);
+        Put32(b, 0);
+        pos_vidlength = b.size(); Put32(b, 0);
+        Put32(b, framebytes);
+        Put32(b, 0xFFFFFFFF);
+        Put32(b, 0);
+        Put16(b, 0); Put16(b, 0); Put16(b, first.width); Put16(b, first.height);
+        EndChunk(b, strh);
+        size_t strf = BeginChunk(b, "strf");
+        Put32(b, 40);
+        Put32(b, first.width);
+        Put32(b, first.height); /* bottom-up */
+        Put16(b, 1);
+        Put16(b, 24);
+        Put32(b, 0); /* BI_RGB */
+        Put32(b, framebytes);
+        for(int n = 0; n < 4; ++n) Put32(b, 0);
+        EndChunk(b, strf);
+        EndChunk(b, strl);
+
+        if(audio)
+        {
+            strl = BeginChunk(b, "LIST", "strl");
+            strh = BeginChunk(b, "strh");
+            PutTag(b, "auds");
+            Put32(b, 0);
+            Put32(b, 0);
+            Put32(b, 0);
+            Put32(b, 0);
+            Put32(b, blockalign);
+            Put32(b, rate * blockalign);
+            Put32(b, 0);
+            pos_audlength = b.size(); Put32(b, 0);
+            Put32(b, rate * blockalign);
+            Put32(b, 0xFFFFFFFF);
+            Put32(b, blockalign);
+            Put16(b, 0); Put16(b, 0); Put16(b, 0); Put16(b, 0);
+            EndChunk(b, strh);
+            strf = BeginChunk(b, "strf");
+            Put16(b, 1); /* PCM */
+            Put16(b, chans);
+            Put32(b, rate);
+            Put32(b, rate * blockalign);
+            Put16(b, blockalign);
+            Put16(b, bits);
+            Put16(b, 0);
+            EndChunk(b, strf);
+            EndChunk(b, strl);
+        }
+        EndChunk(b, hdrl);
+
+        Set32(b, riff, 0);
+        pos_movi = BeginChunk(b, "LIST", "movi");
+        movi = pos_movi + 4;
+
+        frames = 0;
+        audiobytes = 0;
+        index.clear();
+        return fwrite(&b[0], 1, b.size(), fp) == b.size();
+    }
+
+    virtual bool WriteFrame(const CaptureFrame& f, bool video)
+    {
+        if(!fp) return false;
+
+        if(rate && !f.audio.empty() && !WriteChunk("01wb", f.audio))
+            return false;
+        audiobytes += f.audio.size();
+
+        if(video)
+        {
+            ToDIB24(f, dib);
+            if(!WriteChunk("00db", dib)) return false;
+            ++frames;
+        }
+
+        /* Split between frames, before the file gets too big */
+        if(ftello(fp) > AVI_SEGMENT_SIZE)
+        {
+            bool ok = Close();
+            ++segment;
+            return Open() && ok;
+        }
+        return true;
+    }
+
+private:
+    std::string fn;
+    unsigned segment;
+    FILE* fp;
+
+    size_t pos_frames, pos_vidlength, pos_audlength, pos_movi;
+    off_t movi; /* where the "movi" list type is; index offsets are from there */
+    unsigned frames, audiobytes;
+    std::vector<unsigned char> index; /* idx1 entries */
+    std::vector<unsigned char> dib;
+
+    bool WriteChunk(const char* tag, const std::vector<unsigned char>& data)
+    {
+        off_t pos = ftello(fp);
+        PutTag(index, tag);
+        Put32(index, 0x10); /* AVIIF_KEYFRAME */
+        Put32(index, pos - movi);
+        Put32(index, data.size());
+
+        std::vector<unsigned char> hdr;
+        PutTag(hdr, tag);
+        Put32(hdr, data.size());
+        static const unsigned char pad = 0;
+        return fwrite(&hdr[0], 1, 8, fp) == 8
+            && fwrite(&data[0], 1, data.size(), fp) == data.size()
+            && ((data.size() & 1) == 0 || fwrite(&pad, 1, 1, fp) == 1);
+    }
+
+    /* Writes the index and fills in the sizes and lengths */
+    bool Finish()
+    {
+        off_t idx1 = ftello(fp);
+        std::vector<unsigned char> hdr;
+        PutTag(hdr, "idx1");
+        Put32(hdr, index.size());
+        bool ok = fwrite(&hdr[0], 1, 8, fp) == 8
+               && (index.empty() || fwrite(&index[0], 1, index.size(), fp) == index.size());
+        off_t end = ftello(fp);
+
+        const unsigned blockalign = chans * (bits / 8);
+        ok = ok && Patch32(fp, 4, end - 8)
+                && Patch32(fp, pos_movi, idx1 - movi)
+                && Patch32(fp, pos_frames, frames)
+                && Patch32(fp, pos_vidlength, frames);
+        if(rate)
+            ok = ok && Patch32(fp, pos_audlength, audiobytes / blockalign);
+        return ok;
+    }
+};
+
+class StreamOutput: public CaptureOutput
+{
+public:
+    enum VideoKind { VIDEO_NONE, VIDEO_RAW, VIDEO_Y4M };
+
+    StreamOutput(VideoKind kind, const std::string& fn, bool pipe, const std::string& wavfn)
+        : kind(kind), fn(fn), pipe(pipe), wavfn(wavfn), fp(NULL)
+    {
+    }
+    virtual ~StreamOutput() { Close(); }
+
+    virtual bool Close()
+    {
+        bool ok = wav.Close();
+        if(fp)
+        {
+            ok = (pipe ? pclose(fp) == 0 : fclose(fp) == 0) && ok;
+            fp = NULL;
+        }
+        return ok;
+    }
+
+protected:
+    virtual bool Open()
+    {
+        if(rate)
+        {
+            fprintf(stderr, "Capture: writing the audio to %s\n", wavfn.c_str());
+            if(!wav.Open(wavfn, rate, bits, chans)) return false;
+        }
+        if(kind == VIDEO_NONE) return true;
+
+        if(kind == VIDEO_Y4M)
+        {
+            if(first.bpp == 17)
+            {
+                fprintf(stderr, "Capture: YUV4MPEG2 doesn't take YUY2 pictures\n");
+                return false;
+            }
+            if((first.width | first.height) & 1)
+            {
+                fprintf(stderr, "Capture: I420 needs an even picture size, not %ux%u\n", first.width, first.height);
+                return false;
+            }
+        }
+
+        if(pipe)
+        {
+            fprintf(stderr, "Capture: launching %s\n", fn.c_str());
+            /* Note: popen does not accept b/t in mode param */
+            setenv("LD_PRELOAD", "", 1);
+            /* The command mustn't inherit the blocked SIGPIPE */
+            BlockSigpipe(false);
+            fp = popen(fn.c_str(), "w");
+            BlockSigpipe(true);
+        }
+        else
+        {
+            fprintf(stderr, "Capture: writing %s\n", fn.c_str());
+            fp = fopen(fn.c_str(), "wb");
+        }
+        if(!fp) { perror(fn.c_str()); return false; }
+
+        if(kind == VIDEO_Y4M)
+        {
+            const unsigned g = GCD(first.fps_scaled, FPS_SCALE);
+            return fprintf(fp, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n",
+                first.width, first.height, first.fps_scaled / g, FPS_SCALE / g) > 0;
+        }
+        return true;
+    }
+
+    virtual bool WriteFrame(const CaptureFrame& f, bool video)
+    {
+        if(!wav.Write(f.audio)) return false;
+        if(!video || kind == VIDEO_NONE) return true;
+        if(!fp) return false;
+
+        const unsigned npixels = f.width * f.height;
+        if(kind == VIDEO_RAW && f.bpp == 8)
+        {
+            rgb.resize(npixels * 4);
+            for(unsigned i = 0; i < npixels; ++i)
+                memcpy(&rgb[i * 4], IndexedColour(f, i), 4);
+            return fwrite(&rgb[0], 1, rgb.size(), fp) == rgb.size();
+        }
+        if(kind == VIDEO_RAW || f.bpp == 12)
+        {
+            if(kind == VIDEO_Y4M && fputs("FRAME\n", fp) == EOF) return false;
+            return fwrite(&f.video[0], 1, f.video.size(), fp) == f.video.size();
+        }
+
+        yuv.resize(npixels * 3 / 2);
+        switch(f.bpp)
+        {
+            case 8:
+                /* straight from the palette, without making the RGB picture */
+                ConvertNESTo_I420Frame(&f.video[0], &f.video[npixels], &f.video[npixels * 2],
+                                       &yuv[0], npixels, f.width);
+                break;
+            case 32: Convert32To_I420Frame(&f.video[0], &yuv[0], npixels, f.width); break;
+            case 24: Convert24To_I420Frame(&f.video[0], &yuv[0], npixels, f.width); break;
+            case 16: Convert16To_I420Frame(&f.video[0], &yuv[0], npixels, f.width); break;
+            case 15: Convert15To_I420Frame(&f.video[0], &yuv[0], npixels, f.width); break;
+        }
+        return fputs("FRAME\n", fp) != EOF
+            && fwrite(&yuv[0], 1, yuv.size(), fp) == yuv.size();
+    }
+
+private:
+    VideoKind kind;
+    std::string fn;
+    bool pipe;
+    std::string wavfn;
+    FILE* fp;
+    WavFile wav;
+    std::vector<unsigned char> yuv, rgb;
+};
+
+static CaptureOutput* OpenOutput(std::string target, unsigned number)
+{
+    char numstr[64];
+    sprintf(numstr, "%u", number);
+    for(;;)
+    {
+        std::string::size_type p = target.find("VIDEO""NUMBER");
+        if(p == target.npos) break;
+        target.replace(p, 5+6, numstr);
+    }
+
+    std::string::size_type p = target.find("NESV""SETTINGS");
+    if(p != target.npos)
+    {
+        /* An old mencoder command line; it gets the video the new way */
+        fprintf(stderr, "Capture: NESVSETTINGS is obsolete, the command gets YUV4MPEG2 video"
+                        " on its standard input and the audio goes in a WAV file\n");
+        target.replace(p, 4+8, "-demuxer y4m");
+        if(target[0] != '|') target.insert(0, "|");
+    }
+
+    if(target[0] == '|')
+    {
+        char Buf[4096];
+        if(!getcwd(Buf, sizeof(Buf))) strcpy(Buf, ".");
+        Buf[sizeof(Buf)-1] = 0;
+        return new StreamOutput(StreamOutput::VIDEO_Y4M, target.substr(1), true,
+            Buf + std::string("/capture") + numstr + ".wav");
+    }
+
+    std::string base = target, ext;
+    std::string::size_type dot = target.rfind('.');
+    if(dot != target.npos && target.find('/', dot) == target.npos)
+    {
+        base = target.substr(0, dot);
+        ext  = target.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    }
+
+    if(ext == ".avi")
+        return new AviOutput(target);
+    if(ext == ".y4m")
+        return new StreamOutput(StreamOutput::VIDEO_Y4M, target, false, base + ".wav");
+    if(ext == ".wav")
+        return new StreamOutput(StreamOutput::VIDEO_NONE, "", false, target);
+    return new StreamOutput(StreamOutput::VIDEO_RAW, target, false, base + ".wav");
+}
+
+Capture::Capture(const std::string& target, unsigned number, unsigned rate, unsigned bits, unsigned chans)
+    : head(0), count(0), stop(false), failed(false),
+      acquired(NULL), aud_rate(rate), aud_bits(bits), aud_chans(chans), aud_warned(false),
+      output(OpenOutput(target, number))
+{
+    /* Known before any frame, so a capture that starts silent keeps its audio track */
+    output->SetAudio(rate, bits, chans);
+    writer = std::thread(&Capture::WriterProc, this);
+}
+
+Capture::~Capture()
+{
+    /* The audio after the last frame */
+    if(!pendingAudio.empty() && Acquire())
+    {
+        acquired->bpp = 0;
+        Commit();
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+        filled.notify_one();
+    }
+    writer.join();
+    delete output;
+}
+
+CaptureFrame* Capture::Acquire()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    /* Backpressure: the emulation waits for the writer here */
+    while(count == QUEUE_FRAMES && !failed)
+        freed.wait(guard);
+    if(failed) return NULL;
+    acquired = &queue[(head + count) % QUEUE_FRAMES];
+    return acquired;
+}
+
+void Capture::Commit()
+{
+    /* The slot gets the audio buffer and leaves its old one for the next frame */
+    acquired->audio.swap(pendingAudio);
+    pendingAudio.clear();
+    acquired = NULL;
+
+    std::lock_guard<std::mutex> guard(lock);
+    ++count;
+    filled.notify_one();
+}
+
+unsigned char* Capture::VideoBuffer(unsigned width, unsigned height, unsigned fps_scaled, unsigned bpp)
+{
+    if(!acquired && !Acquire()) return NULL;
+
+    CaptureFrame& f = *acquired;
+    f.width      = width;
+    f.height     = height;
+    f.fps_scaled = fps_scaled;
+    f.bpp        = bpp;
+    f.video.resize(FrameBytes(width, height, bpp)); /* allocates once, the slots are reused */
+    return &f.video[0];
+}
+
+void Capture::VideoCommit()
+{
+    if(acquired) Commit();
+}
+
+void Capture::Video(unsigned width, unsigned height, unsigned fps_scaled, unsigned bpp, const unsigned char* data)
+{
+    unsigned char* dest = VideoBuffer(width, height, fps_scaled, bpp);
+    if(!dest) return;
+    memcpy(dest, data, FrameBytes(width, height, bpp));
+    VideoCommit();
+}
+
+void Capture::Audio(unsigned rate, unsigned bits, unsigned chans, const unsigned char* data, unsigned nsamples)
+{
+    if(rate != aud_rate || bits != aud_bits || chans != aud_chans)
+    {
+        if(aud_rate && !aud_warned)
+            fprintf(stderr, "Capture: the sound changed to %u Hz, %u bits, %u channels; that audio is left out\n",
+                rate, bits, chans);
+        aud_warned = true;
+        return;
+    }
+    pendingAudio.insert(pendingAudio.end(), data, data + nsamples * chans * (bits / 8));
+}
+
+void Capture::WriterProc()
+{
+    BlockSigpipe(true);
+
+    bool ok = true;
+    for(;;)
+    {
+        CaptureFrame* f;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while(!count && !stop)
+                filled.wait(guard);
+            if(!count) break;
+            f = &queue[head];
+        }
+
+        /* After a failure the frames are dropped, emulation mustn't wait on a dead writer */
+        if(ok && !output->Write(*f))
+        {
+            fprintf(stderr, "Capture: writing failed, the capture stops here\n");
+            ok = false;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        head = (head + 1) % QUEUE_FRAMES;
+        --count;
+        failed = !ok;
+        freed.notify_one();
+    }
+
+    /* Here rather than in the destructor: flushing a pipe is a write too */
+    if(!output->Close())
+        fprintf(stderr, "Capture: error finishing the files\n");
+}
@@ -0,0 +1,93 @@
+#ifndef NESVCAPTUREhh
+#define NESVCAPTUREhh
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* Built-in video and audio capture.
+ *
+ * The emulation thread draws each frame straight into a slot of a bounded
+ * queue; a writer thread converts the frames and writes them out. Emulation
+ * only waits when the writer is a whole queue behind.
+ *
+ * The target picks the output:
+ *   name.avi   uncompressed AVI with PCM audio, split in name_partN.avi
+ *              files near 2000MB
+ *   name.y4m   YUV4MPEG2 video (I420), the audio in name.wav
+ *   name.wav   the audio only
+ *   |command   YUV4MPEG2 video on the standard input of the command, the
+ *              audio in captureN.wav
+ *   other      the frames as they are drawn, the audio in name.wav
+ * VIDEONUMBER in the target is replaced by the number of the capture.
+ *
+ * Pixel formats (bpp): 32 = R,G,B,x bytes, 24 = R,G,B bytes, 16 = BGR16,
+ * 15 = BGR15, 12 = I420, 17 = YUY2. AVI takes 32 and 24, YUV4MPEG2 all but
+ * YUY2.
+ * 8 = NES palette indices: width*height indices, width*height deemphasis
+ * bits, then 2048 R,G,B,x colours by (deemph<<8)|index. They are written
+ * as 32, but go to YUV4MPEG2 without the RGB picture; a capture can switch
+ * between 8 and 32.
+ */
+
+struct CaptureFrame
+{
+    std::vector<unsigned char> video;
+    unsigned width, height, fps_scaled;
+    unsigned bpp;                       /* 0: no video, only audio */
+    std::vector<unsigned char> audio;   /* the audio that came before the frame */
+};
+
+class CaptureOutput;
+
+class Capture
+{
+public:
+    /* The audio format is the one the sound is set to when the capture
+     * starts; rate 0: the capture has no audio */
+    Capture(const std::string& target, unsigned number, unsigned rate, unsigned bits, unsigned chans);
+    /* Writes out what is queued and closes the files */
+    ~Capture();
+
+    /* Buffer to draw the next frame into, width*height*bpp/8 bytes (see
+     * above for 8). Waits while the queue is full. NULL once writing has
+     * failed. */
+    unsigned char* VideoBuffer(unsigned width, unsigned height, unsigned fps_scaled, unsigned bpp);
+    /* Queues the frame drawn into the buffer of VideoBuffer() */
+    void VideoCommit();
+
+    /* Copies a frame into the queue */
+    void Video(unsigned width, unsigned height, unsigned fps_scaled, unsigned bpp, const unsigned char* data);
+    /* Goes with the next frame; audio in another format is left out */
+    void Audio(unsigned rate, unsigned bits, unsigned chans, const unsigned char* data, unsigned nsamples);
+
+private:
+    enum { QUEUE_FRAMES = 8 };
+
+    CaptureFrame queue[QUEUE_FRAMES];
+    unsigned head, count;   /* guarded by lock */
+    bool stop, failed;      /* guarded by lock */
+    std::mutex lock;
+    std::condition_variable filled, freed;
+    std::thread writer;
+
+    /* owned by the emulation thread */
+    CaptureFrame* acquired;
+    std::vector<unsigned char> pendingAudio;
+    const unsigned aud_rate, aud_bits, aud_chans;
+    bool aud_warned;
+
+    /* owned by the writer thread */
+    CaptureOutput* output;
+
+    CaptureFrame* Acquire();
+    void Commit();
+    void WriterProc();
+
+    Capture(const Capture&);
+    Capture& operator=(const Capture&);
+};
+
+#endif
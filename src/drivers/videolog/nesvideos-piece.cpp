@@ -11,7 +11,6 @@
 #include <stdio.h>
 #include <sys/stat.h> // S_IFIFO
 #include <fcntl.h>    // fcntl
-#include <sys/poll.h> // poll
 #include <stdlib.h>   // setenv
 #include <string.h>   // strrchr
 #include <sys/file.h> // flock
@@ -22,6 +21,8 @@
 #include <gd.h>
 #endif
 
+#include "capture.h"
+
 #ifdef HAVE_X264 // don't worry, you really don't need it
 extern "C" {
 #include <x264.h>
@@ -40,15 +41,12 @@ extern "C" {
 #define LOGO_LENGTH_HEADER (0)
 
 static std::string VIDEO_CMD = "";
-/*
--rawvideo on:fps=60:format=0x42475220:w=256:h=224:size=$[1024*224]
--audiofile "+AUDIO_FN+"
-*/
-static std::string AUDIO_FN = "s.log";
 
-static bool Terminate=false;
 static unsigned videonumber = 0;
 
+/* The audio format of the next capture; rate 0: no audio */
+static unsigned audiorate = 0, audiobits = 16, audiochans = 1;
+
 #ifdef THREAD_SAFETY
 # include <pthread.h>
 static pthread_mutex_t APIlock = PTHREAD_MUTEX_INITIALIZER;
@@ -63,31 +61,6 @@ struct ScopedLock
 };
 #endif
 
-static unsigned NonblockWrite(FILE* fp, const unsigned char*buf, unsigned length)
-{
-  Retry:
-    int result = write(fileno(fp), buf, length);
-    if(result == -1 && errno==EAGAIN)
-    {
-        return 0;
-    }
-    if(result == -1 && errno==EINTR) goto Retry;
-    if(result == -1)
-    {
-        perror("write");
-        Terminate=true;
-        return 0;
-    }
-    return result;
-}
-static int WaitUntilOneIsWritable(FILE*f1, FILE*f2)
-{
-    struct pollfd po[2] = { {fileno(f1),POLLOUT,0}, {fileno(f2),POLLOUT,0} };
-    poll(po, 2, -1);
-    return ((po[0].revents & POLLOUT) ? 1 : 0)
-         | ((po[1].revents & POLLOUT) ? 2 : 0);
-}
-
 #define BGR32 0x42475220  // BGR32 fourcc
 #define BGR24 0x42475218  // BGR24 fourcc
 #define BGR16 0x42475210  // BGR16 fourcc
@@ -104,17 +77,6 @@ static unsigned INPUT_BPP  = 16;
 
 static const unsigned FPS_SCALE = 0x1000000;
 
-static struct Construct
-{
-    Construct()
-    {
-        char Buf[4096];
-        getcwd(Buf,sizeof(Buf));
-        Buf[sizeof(Buf)-1]=0;
-        AUDIO_FN = Buf + std::string("/") + AUDIO_FN;
-    }
-} Construct;
-
 class AVI
 {
 public:
@@ -128,284 +90,46 @@ public:
     virtual void Video
         (unsigned w,unsigned h,unsigned f, const unsigned char*d) = 0;
     
+    /* For drawing the frame in place; NULL if Video() has to be used */
+    virtual unsigned char* VideoBuffer
+        (unsigned w,unsigned h,unsigned f) { return NULL; }
+    virtual void VideoCommit() { }
+
     virtual void SaveState(const std::string&) { }
     virtual void LoadState(const std::string&) { }
 };
 
 class NormalAVI: public AVI
 {
-    FILE* vidfp;
-    FILE* audfp;
-    
-    bool KnowVideo;
-    unsigned vid_width;
-    unsigned vid_height;
-    unsigned vid_fps_scaled;
-    std::list<std::vector<unsigned char> > VideoBuffer;
-    unsigned VidBufSize;
-    
-    bool KnowAudio;
-    unsigned aud_rate;
-    unsigned aud_chans;
-    unsigned aud_bits;
-    std::list<std::vector<unsigned char> > AudioBuffer;
-    unsigned AudBufSize;
-    
+    Capture capture;
+
 public:
-    NormalAVI() :
-        vidfp(NULL),
-        audfp(NULL),
-        KnowVideo(false), VidBufSize(0),
-        KnowAudio(false), AudBufSize(0)
+    NormalAVI() : capture(VIDEO_CMD, videonumber, audiorate, audiobits, audiochans)
     {
     }
-    virtual ~NormalAVI()
-    {
-        while(VidBufSize && AudBufSize)
-        {
-            CheckFlushing();
-        }
-        if(audfp) fclose(audfp);
-        if(vidfp) pclose(vidfp);
-        unlink(AUDIO_FN.c_str());
-    }
-    
+
     virtual void Audio
         (unsigned r,unsigned b,unsigned c,
          const unsigned char*d, unsigned nsamples)
     {
-        if(Terminate) return;
-        if(!KnowAudio)
-        {
-            aud_rate = r;
-            aud_chans = c;
-            aud_bits = b;
-            KnowAudio = true;
-        }
-        CheckFlushing();
-        
-        unsigned bytes = nsamples * aud_chans * (aud_bits / 8);
-        
-        unsigned wrote = 0;
-        if(KnowVideo && AudioBuffer.empty())
-        {
-            //fprintf(stderr, "Writing %u of %s from %p to %p\t", bytes, "aud", (void*)d, (void*)audfp);
-            wrote = NonblockWrite(audfp, d, bytes);
-            //fprintf(stderr, "Wrote %u\n", wrote);
-        }
-        if(wrote < bytes)
-        {
-            unsigned remain = bytes-wrote;
-            //fprintf(stderr, "Buffering %u of %s (%p..%p)\n", remain, "aud", d+wrote, d+bytes);
-            AudioBuffer.push_back(std::vector<unsigned char>(d+wrote, d+bytes));
-            AudBufSize += remain;
-        }
-        CheckFlushing();
+        capture.Audio(r,b,c, d, nsamples);
     }
 
     virtual void Video
         (unsigned w,unsigned h,unsigned f, const unsigned char*d)
     {
-        if(Terminate) return;
-        if(!KnowVideo)
-        {
-            vid_width      = w;
-            vid_height     = h;
-            vid_fps_scaled = f;
-            KnowVideo = true;
-        }
-        CheckFlushing();
-        
-        unsigned bpp   = INPUT_BPP; if(bpp == 15 || bpp == 17) bpp = 16;
-        unsigned bytes = vid_width * vid_height * bpp / 8;
-        
-        //std::vector<unsigned char> tmp(bytes, 'k');
-        //d = &tmp[0];
-        
-        unsigned wrote = 0;
-        if(KnowAudio && VideoBuffer.empty())
-        {
-            CheckBegin();
-            //fprintf(stderr, "Writing %u of %s from %p to %p\t", bytes, "vid", (void*)d, (void*)vidfp);
-            wrote = NonblockWrite(vidfp, d, bytes);
-            //fprintf(stderr, "Wrote %u\n", wrote);
-        }
-        
-        if(wrote < bytes)
-        {
-            unsigned remain = bytes-wrote;
-            //fprintf(stderr, "Buffering %u of %s (%p..%p)\n", remain, "vid", d+wrote, d+bytes);
-
-            VideoBuffer.push_back(std::vector<unsigned char>(d+wrote, d+bytes));
-            VidBufSize += remain;
-        }
-        CheckFlushing();
-    }
-
-private:
-    /* fp is passed as a reference because it may be NULL
-     * prior to calling, and this function changes it. */
-    template<typename BufType>
-    void FlushBufferSome(BufType& List, unsigned& Size, FILE*& fp, const char* what)
-    {
-        what=what;
-        
-    Retry:
-        if(List.empty() || Terminate) return;
-        
-        typename BufType::iterator i = List.begin();
-        std::vector<unsigned char>& buf = *i;
-        
-        if(buf.empty())
-        {
-            List.erase(i);
-            goto Retry;
-        }
-        
-        unsigned bytes = buf.size();
-        
-        CheckBegin();
-        //fprintf(stderr, "Writing %u of %s from %p to %p\t", bytes, what, (void*)&buf[0], (void*)fp);
-        
-        unsigned ate = NonblockWrite(fp, &buf[0], bytes);
-
-        //fprintf(stderr, "Wrote %u\n", ate);
-        
-        buf.erase(buf.begin(), buf.begin()+ate);
-        
-        Size -= ate;
-        
-        if(buf.empty())
-        {
-            List.erase(i);
-        }
+        capture.Video(w,h,f, INPUT_BPP, d);
     }
 
-    void CheckFlushing()
-    {
-        //AudioBuffer.clear();
-        //VideoBuffer.clear();
-        
-        if(KnowAudio && KnowVideo && !Terminate)
-        {
-            if(!AudioBuffer.empty() && !VideoBuffer.empty())
-            {
-                do {
-                    /* vidfp = &1, audfp = &2 */
-                    int attempt = WaitUntilOneIsWritable(vidfp, audfp);
-                    
-                    if(attempt <= 0) break; /* Some kind of error can cause this */
-
-                    // Flush Video
-                    if(attempt&1) FlushBufferSome(VideoBuffer, VidBufSize, vidfp, "vid");
-                    
-                    // Flush Audio
-                    if(attempt&2) FlushBufferSome(AudioBuffer, AudBufSize, audfp, "aud");
-                } while (!AudioBuffer.empty() && !VideoBuffer.empty());
-            }
-            else
-            {
-                FlushBufferSome(VideoBuffer, VidBufSize, vidfp, "vid");
-                FlushBufferSome(AudioBuffer, AudBufSize, audfp, "aud");
-            }
-            /*
-            fprintf(stderr, "Buffer Sizes: Audio %u(%u) video %u(%u)\n",
-                (unsigned)AudioBuffer.size(), AudBufSize,
-                (unsigned)VideoBuffer.size(), VidBufSize);
-            */
-        }
-    }
-    std::string GetMEncoderRawvideoParam() const
+    virtual unsigned char* VideoBuffer
+        (unsigned w,unsigned h,unsigned f)
     {
-        char Buf[512];
-        unsigned bpp   = INPUT_BPP; if(bpp == 15 || bpp == 17) bpp = 16;
-        sprintf(Buf, "fps=%g:format=0x%04X:w=%u:h=%u:size=%u",
-            vid_fps_scaled / (double)FPS_SCALE,
-            USE_FOURCC,
-            vid_width,
-            vid_height,
-            vid_width*vid_height * bpp/8);
-        return Buf;
-    }
-    std::string GetMEncoderRawaudioParam() const
-    {
-        char Buf[512];
-        sprintf(Buf, "channels=%u:rate=%u:samplesize=%u:bitrate=%u",
-            aud_chans,
-            aud_rate,
-            aud_bits/8,
-            aud_rate*aud_chans*(aud_bits/8) );
-        return Buf;
-    }
-    std::string GetMEncoderCommand() const
-    {
-        std::string mandatory = "-audiofile " + AUDIO_FN
-                              + " -audio-demuxer rawaudio"
-                              + " -demuxer rawvideo"
-                              + " -rawvideo " + GetMEncoderRawvideoParam()
-                              + " -rawaudio " + GetMEncoderRawaudioParam()
-                              ;
-        std::string cmd = VIDEO_CMD;
-
-        std::string::size_type p = cmd.find("NESV""SETTINGS");
-        if(p != cmd.npos)
-            cmd = cmd.replace(p, 4+8, mandatory);
-        else
-            fprintf(stderr, "Warning: NESVSETTINGS not found in videocmd\n");
-        
-        char videonumstr[64];
-        sprintf(videonumstr, "%u", videonumber);
-        
-        for(;;)
-        {
-            p = cmd.find("VIDEO""NUMBER");
-            if(p == cmd.npos) break;
-            cmd = cmd.replace(p, 5+6, videonumstr);
-        }
-        
-        fprintf(stderr, "Launch: %s\n", cmd.c_str()); fflush(stderr);
-        
-        return cmd;
+        return capture.VideoBuffer(w,h,f, INPUT_BPP);
     }
 
-    void CheckBegin()
+    virtual void VideoCommit()
     {
-        if(!audfp)
-        {
-            unlink(AUDIO_FN.c_str());
-            mknod(AUDIO_FN.c_str(), S_IFIFO|0666, 0);
-        }
-        
-        if(!vidfp)
-        {
-            /* Note: popen does not accept b/t in mode param */
-            setenv("LD_PRELOAD", "", 1);
-            vidfp = popen(GetMEncoderCommand().c_str(), "w");
-            if(!vidfp)
-            {
-                perror("Launch failed");
-            }
-            else
-            {
-                fcntl(fileno(vidfp), F_SETFL, O_WRONLY | O_NONBLOCK);
-            }
-        }
-        
-        if(!audfp)
-        {
-        Retry:
-            audfp = fopen(AUDIO_FN.c_str(), "wb");
-            
-            if(!audfp)
-            {
-                perror(AUDIO_FN.c_str());
-                if(errno == ESTALE) goto Retry;
-            }
-            else
-            {
-                fcntl(fileno(audfp), F_SETFL, O_WRONLY | O_NONBLOCK);
-            }
-        }
+        capture.VideoCommit();
     }
 };
 
@@ -743,6 +467,16 @@ extern "C"
 
         VIDEO_CMD = cmd;
     }
+    void NESVideoSetAudioFormat(unsigned rate, unsigned bits, unsigned chans)
+    {
+#ifdef THREAD_SAFETY
+        ScopedLock lock;
+#endif
+
+        audiorate  = rate;
+        audiobits  = bits;
+        audiochans = chans;
+    }
     
     void NESVideoSetRerecordingMode(long FrameNumber)
     {
@@ -1199,6 +933,41 @@ extern "C"
         GetAVIptr().Video(width,height,fps_scaled,  (const unsigned char*) data);
     }
 
+    void* NESVideoLoggingVideoBuffer
+        (unsigned width,unsigned height,
+         unsigned fps_scaled,
+         unsigned bpp
+        )
+    {
+        if(LoggingEnabled < 2) return NULL;
+
+#ifdef HAVE_GD
+        /* The logo is drawn over the frames NESVideoLoggingVideo() gets */
+        return NULL;
+#endif
+
+#ifdef THREAD_SAFETY
+        ScopedLock lock;
+#endif
+
+        if(bpp) INPUT_BPP = bpp;
+
+        unsigned char* buf = GetAVIptr().VideoBuffer(width,height,fps_scaled);
+        if(buf) ++CurrentFrameNumber;
+        return buf;
+    }
+
+    void NESVideoLoggingVideoCommit()
+    {
+        if(LoggingEnabled < 2) return;
+
+#ifdef THREAD_SAFETY
+        ScopedLock lock;
+#endif
+
+        GetAVIptr().VideoCommit();
+    }
+
     void NESVideoLoggingAudio
         (const void*data,
          unsigned rate, unsigned bits, unsigned chans,
@@ -10,10 +10,14 @@ extern "C" {
 /* Is video logging enabled? 0=no, 1=yes, 2=active. Default value: 0 */ 
 extern int LoggingEnabled; 
 
-/* Get and set the video recording command (shell command) */ 
+/* Get and set where the video goes; see capture.h */ 
 extern const char* NESVideoGetVideoCmd(void); 
 extern void NESVideoSetVideoCmd(const char *cmd);
 
+/* Set the audio format the sound is in; rate 0 if the sound is off. */
+/* A capture takes the format it finds when it starts and keeps it. */
+extern void NESVideoSetAudioFormat(unsigned rate, unsigned bits, unsigned chans);
+
 /* Save 1 frame of video. (Assumed to be 16-bit RGB) */ 
 /* FPS is scaled by 24 bits (*0x1000000) */
 /* Does not do anything if LoggingEnabled<2. */ 
@@ -22,6 +26,16 @@ extern void NESVideoLoggingVideo
      unsigned fps_scaled,
      unsigned bpp); 
 
+/* Get a buffer to draw 1 frame of video into, width*height*bpp/8 bytes, */
+/* and queue it with NESVideoLoggingVideoCommit(). Saves copying the frame. */
+/* Returns NULL if the frame has to go through NESVideoLoggingVideo(), */
+/* or if LoggingEnabled<2. */
+extern void* NESVideoLoggingVideoBuffer
+    (unsigned width, unsigned height,
+     unsigned fps_scaled,
+     unsigned bpp);
+extern void NESVideoLoggingVideoCommit(void);
+
 /* Save N bytes of audio. bytes_per_second is required on the first call. */ 
 /* Does not do anything if LoggingEnabled<2. */ 
 /* The interval of calling this function is not important, as long as all the audio
@@ -12,6 +12,7 @@ typedef uint_least64_t uint64_t;
 #include "quantize.h"
 #include "rgbtorgb.h"
 #include "simd.h"
+#include "../common/simd.h"
 
 /* For BPP conversions */
 
@@ -60,6 +61,233 @@ static const int UB = 16525;   // ((int)( ( 132201 / 65536.0 ) * (1<<YUV2RGB_SHI
 
 /****************/
 
+/* SSE4.1 and AVX2 versions of the conversions, picked at run time
+ * (see drivers/common/simd.h). They give the same bytes as the plain
+ * code: the sums are the same integer sums, only done several pixels
+ * at a time. simdcheck/ tests and times them.
+ */
+
+#ifdef SIMD_DISPATCH
+#define RGBTORGB_DISPATCH
+
+/* 16 pixels: 64 bytes of RGB32 to 48 bytes of RGB24 */
+__attribute__((target("sse4.1")))
+static unsigned Convert32To24_SSE41(const unsigned char* src, unsigned char* dest, unsigned npixels)
+{
+    const __m128i pick = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    unsigned n = 0;
+    for(; n + 16 <= npixels; n += 16, src += 64, dest += 48)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src+ 0)), pick);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src+16)), pick);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src+32)), pick);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src+48)), pick);
+        _mm_storeu_si128((__m128i*)(dest+ 0), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(dest+16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(dest+32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+    return n;
+}
+
+/* 8 pixels of RGB32 or RGB24 as R,G,B,0 bytes; RGB24 reads 8 bytes past them */
+template<int PixStride>
+__attribute__((target("sse4.1")))
+static inline __m128i Load4_SSE41(const unsigned char* src)
+{
+    if(PixStride == 4)
+        return _mm_loadu_si128((const __m128i*)src);
+    const __m128i expand = _mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), expand);
+}
+
+/* coef . (R,G,B) of the 4 pixels in p, as 4 int32 */
+__attribute__((target("sse4.1")))
+static inline __m128i Dot4_SSE41(__m128i p, __m128i coef)
+{
+    __m128i lo = _mm_cvtepu8_epi16(p);
+    __m128i hi = _mm_unpackhi_epi8(p, _mm_setzero_si128());
+    return _mm_hadd_epi32(_mm_madd_epi16(lo, coef), _mm_madd_epi16(hi, coef));
+}
+
+/* Two rows into I420, 8 pixels at a time; returns how many pixels were done */
+template<int PixStride>
+__attribute__((target("sse4.1")))
+static unsigned I420Rows_SSE41(const unsigned char* src0, const unsigned char* src1,
+                               unsigned char* y0, unsigned char* y1,
+                               unsigned char* u, unsigned char* v, unsigned width)
+{
+    const __m128i cy = _mm_setr_epi16(RY,GY,BY,0, RY,GY,BY,0);
+    const __m128i cu = _mm_setr_epi16(RU,GU,BU,0, RU,GU,BU,0);
+    const __m128i cv = _mm_setr_epi16(RV,GV,BV,0, RV,GV,BV,0);
+    const __m128i yadd = _mm_set1_epi16(Y_ADD);
+    const __m128i uvadd = _mm_set1_epi32(U_ADD);
+    const unsigned slack = PixStride == 3 ? 2 : 0;
+
+    unsigned x = 0;
+    for(; x + 8 + slack <= width; x += 8)
+    {
+        __m128i usum[2], vsum[2];
+        for(int r = 0; r < 2; ++r)
+        {
+            const unsigned char* s = (r ? src1 : src0) + x*PixStride;
+            __m128i p0 = Load4_SSE41<PixStride>(s);
+            __m128i p1 = Load4_SSE41<PixStride>(s + 4*PixStride);
+
+            __m128i ya = _mm_srai_epi32(Dot4_SSE41(p0, cy), RGB2YUV_SHIFT);
+            __m128i yb = _mm_srai_epi32(Dot4_SSE41(p1, cy), RGB2YUV_SHIFT);
+            __m128i yy = _mm_add_epi16(_mm_packs_epi32(ya, yb), yadd);
+            _mm_storel_epi64((__m128i*)((r ? y1 : y0) + x), _mm_packus_epi16(yy, yy));
+
+            __m128i u0 = Dot4_SSE41(p0, cu), u1 = Dot4_SSE41(p1, cu);
+            __m128i v0 = Dot4_SSE41(p0, cv), v1 = Dot4_SSE41(p1, cv);
+            if(r == 0) { usum[0] = u0; usum[1] = u1; vsum[0] = v0; vsum[1] = v1; }
+            else
+            {
+                usum[0] = _mm_add_epi32(usum[0], u0); usum[1] = _mm_add_epi32(usum[1], u1);
+                vsum[0] = _mm_add_epi32(vsum[0], v0); vsum[1] = _mm_add_epi32(vsum[1], v1);
+            }
+        }
+        /* each 2x2 block: the two columns */
+        __m128i uu = _mm_add_epi32(_mm_srai_epi32(_mm_hadd_epi32(usum[0], usum[1]), RGB2YUV_SHIFT+2), uvadd);
+        __m128i vv = _mm_add_epi32(_mm_srai_epi32(_mm_hadd_epi32(vsum[0], vsum[1]), RGB2YUV_SHIFT+2), uvadd);
+        __m128i uv = _mm_packus_epi16(_mm_packs_epi32(uu, vv), _mm_setzero_si128());
+        *(int*)(u + x/2) = _mm_cvtsi128_si32(uv);
+        *(int*)(v + x/2) = _mm_extract_epi32(uv, 1);
+    }
+    return x;
+}
+
+/* One row into YUY2, 8 pixels at a time */
+template<int PixStride>
+__attribute__((target("sse4.1")))
+static unsigned YUY2Row_SSE41(const unsigned char* src, unsigned char* dest, unsigned width)
+{
+    const __m128i cy = _mm_setr_epi16(RY,GY,BY,0, RY,GY,BY,0);
+    const __m128i cu = _mm_setr_epi16(RU,GU,BU,0, RU,GU,BU,0);
+    const __m128i cv = _mm_setr_epi16(RV,GV,BV,0, RV,GV,BV,0);
+    const __m128i yadd = _mm_set1_epi16(Y_ADD);
+    const __m128i uvadd = _mm_set1_epi32(U_ADD);
+    const unsigned slack = PixStride == 3 ? 2 : 0;
+
+    unsigned x = 0;
+    for(; x + 8 + slack <= width; x += 8)
+    {
+        __m128i p0 = Load4_SSE41<PixStride>(src + x*PixStride);
+        __m128i p1 = Load4_SSE41<PixStride>(src + (x+4)*PixStride);
+
+        __m128i ya = _mm_srai_epi32(Dot4_SSE41(p0, cy), RGB2YUV_SHIFT);
+        __m128i yb = _mm_srai_epi32(Dot4_SSE41(p1, cy), RGB2YUV_SHIFT);
+        __m128i yy = _mm_add_epi16(_mm_packs_epi32(ya, yb), yadd);
+
+        __m128i uu = _mm_hadd_epi32(Dot4_SSE41(p0, cu), Dot4_SSE41(p1, cu));
+        __m128i vv = _mm_hadd_epi32(Dot4_SSE41(p0, cv), Dot4_SSE41(p1, cv));
+        uu = _mm_add_epi32(_mm_srai_epi32(uu, RGB2YUV_SHIFT+1), uvadd);
+        vv = _mm_add_epi32(_mm_srai_epi32(vv, RGB2YUV_SHIFT+1), uvadd);
+        /* v0,u0,v1,u1... under every other y */
+        __m128i vu = _mm_packs_epi32(vv, uu);
+        vu = _mm_unpacklo_epi16(vu, _mm_srli_si128(vu, 8));
+
+        __m128i out = _mm_or_si128(yy, _mm_slli_epi16(vu, 8));
+        _mm_storeu_si128((__m128i*)(dest + x*2), out);
+    }
+    return x;
+}
+
+/* 4 pixels as 16-bit R,G,B,0 */
+template<int PixStride>
+__attribute__((target("avx2")))
+static inline __m256i Load4_AVX2(const unsigned char* src)
+{
+    if(PixStride == 4)
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+    const __m128i expand = _mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+    return _mm256_cvtepu8_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), expand));
+}
+
+/* coef . (R,G,B) of 8 pixels, in order */
+__attribute__((target("avx2")))
+static inline __m256i Dot8_AVX2(__m256i a, __m256i b, __m256i coef)
+{
+    __m256i d = _mm256_hadd_epi32(_mm256_madd_epi16(a, coef), _mm256_madd_epi16(b, coef));
+    return _mm256_permute4x64_epi64(d, _MM_SHUFFLE(3,1,2,0));
+}
+
+/* Two rows into I420, 16 pixels at a time */
+template<int PixStride>
+__attribute__((target("avx2")))
+static unsigned I420Rows_AVX2(const unsigned char* src0, const unsigned char* src1,
+                              unsigned char* y0, unsigned char* y1,
+                              unsigned char* u, unsigned char* v, unsigned width)
+{
+    const __m256i cy = _mm256_setr_epi16(RY,GY,BY,0, RY,GY,BY,0, RY,GY,BY,0, RY,GY,BY,0);
+    const __m256i cu = _mm256_setr_epi16(RU,GU,BU,0, RU,GU,BU,0, RU,GU,BU,0, RU,GU,BU,0);
+    const __m256i cv = _mm256_setr_epi16(RV,GV,BV,0, RV,GV,BV,0, RV,GV,BV,0, RV,GV,BV,0);
+    const __m256i yadd = _mm256_set1_epi16(Y_ADD);
+    const __m256i uvadd = _mm256_set1_epi32(U_ADD);
+    const unsigned slack = PixStride == 3 ? 2 : 0;
+
+    unsigned x = 0;
+    for(; x + 16 + slack <= width; x += 16)
+    {
+        __m256i usum[2], vsum[2];
+        for(int r = 0; r < 2; ++r)
+        {
+            const unsigned char* s = (r ? src1 : src0) + x*PixStride;
+            __m256i p0 = Load4_AVX2<PixStride>(s);
+            __m256i p1 = Load4_AVX2<PixStride>(s + 4*PixStride);
+            __m256i p2 = Load4_AVX2<PixStride>(s + 8*PixStride);
+            __m256i p3 = Load4_AVX2<PixStride>(s + 12*PixStride);
+
+            __m256i ya = _mm256_srai_epi32(Dot8_AVX2(p0, p1, cy), RGB2YUV_SHIFT);
+            __m256i yb = _mm256_srai_epi32(Dot8_AVX2(p2, p3, cy), RGB2YUV_SHIFT);
+            __m256i yy = _mm256_permute4x64_epi64(_mm256_packs_epi32(ya, yb), _MM_SHUFFLE(3,1,2,0));
+            yy = _mm256_add_epi16(yy, yadd);
+            _mm_storeu_si128((__m128i*)((r ? y1 : y0) + x),
+                _mm_packus_epi16(_mm256_castsi256_si128(yy), _mm256_extracti128_si256(yy, 1)));
+
+            __m256i u0 = Dot8_AVX2(p0, p1, cu), u1 = Dot8_AVX2(p2, p3, cu);
+            __m256i v0 = Dot8_AVX2(p0, p1, cv), v1 = Dot8_AVX2(p2, p3, cv);
+            if(r == 0) { usum[0] = u0; usum[1] = u1; vsum[0] = v0; vsum[1] = v1; }
+            else
+            {
+                usum[0] = _mm256_add_epi32(usum[0], u0); usum[1] = _mm256_add_epi32(usum[1], u1);
+                vsum[0] = _mm256_add_epi32(vsum[0], v0); vsum[1] = _mm256_add_epi32(vsum[1], v1);
+            }
+        }
+        __m256i uu = _mm256_permute4x64_epi64(_mm256_hadd_epi32(usum[0], usum[1]), _MM_SHUFFLE(3,1,2,0));
+        __m256i vv = _mm256_permute4x64_epi64(_mm256_hadd_epi32(vsum[0], vsum[1]), _MM_SHUFFLE(3,1,2,0));
+        uu = _mm256_add_epi32(_mm256_srai_epi32(uu, RGB2YUV_SHIFT+2), uvadd);
+        vv = _mm256_add_epi32(_mm256_srai_epi32(vv, RGB2YUV_SHIFT+2), uvadd);
+        __m256i uv = _mm256_permute4x64_epi64(_mm256_packs_epi32(uu, vv), _MM_SHUFFLE(3,1,2,0));
+        __m128i uv8 = _mm_packus_epi16(_mm256_castsi256_si128(uv), _mm256_extracti128_si256(uv, 1));
+        _mm_storel_epi64((__m128i*)(u + x/2), uv8);
+        _mm_storel_epi64((__m128i*)(v + x/2), _mm_srli_si128(uv8, 8));
+    }
+    return x;
+}
+
+template<int PixStride>
+static unsigned I420Rows(const unsigned char* src0, const unsigned char* src1,
+                         unsigned char* y0, unsigned char* y1,
+                         unsigned char* u, unsigned char* v, unsigned width)
+{
+    switch(SimdLevel())
+    {
+        case SIMD_AVX2:  return I420Rows_AVX2<PixStride>(src0,src1, y0,y1, u,v, width);
+        case SIMD_SSE41: return I420Rows_SSE41<PixStride>(src0,src1, y0,y1, u,v, width);
+    }
+    return 0;
+}
+
+template<int PixStride>
+static unsigned YUY2Row(const unsigned char* src, unsigned char* dest, unsigned width)
+{
+    return SimdLevel() >= SIMD_SSE41 ? YUY2Row_SSE41<PixStride>(src, dest, width) : 0;
+}
+#endif /* RGBTORGB_DISPATCH */
+
+/****************/
+
 template<typename c64>
 static inline void Convert32To24_32bytes(c64 w0, c64 w1, c64 w2, c64 w3, unsigned char* dest)
 {
@@ -92,6 +320,16 @@ void Convert32To24Frame(const void* data, unsigned char* dest, unsigned npixels)
 {
     const unsigned char* src = (const unsigned char*)data;
     
+    #ifdef RGBTORGB_DISPATCH
+    if(SimdLevel() >= SIMD_SSE41)
+    {
+        unsigned done = Convert32To24_SSE41(src, dest, npixels);
+        src  += 4*done;
+        dest += 3*done;
+        npixels -= done;
+    }
+    #endif
+    
     #if defined(__x86_64) || defined(USE_MMX)
     while(npixels >= 8)
     {
@@ -579,7 +817,16 @@ void Convert_4byte_To_I420Frame(const void* data, unsigned char* dest, unsigned
     
     for(unsigned y=0; y<height; y += 2)
     {
-        for(unsigned x=0; x<width; x += 2)
+        unsigned x = 0;
+    #ifdef RGBTORGB_DISPATCH
+        x = I420Rows<PixStride>(src+pos, src+pos+stride,
+                dest+ypos, dest+ypos+width, dest+upos, dest+vpos, width);
+        pos  += x*PixStride;
+        ypos += x;
+        upos += x/2;
+        vpos += x/2;
+    #endif
+        for(; x<width; x += 2)
         {
         #ifdef __MMX__
           if(PixStride == 4)
@@ -651,7 +898,13 @@ void Convert_4byte_To_YUY2Frame(const void* data, unsigned char* dest, unsigned
     
     for(unsigned y=0; y<height; ++y)
     {
-        for(unsigned x=0; x<width; x += 2)
+        unsigned x = 0;
+    #ifdef RGBTORGB_DISPATCH
+        x = YUY2Row<PixStride>(src+pos, dest+ypos, width);
+        pos  += x*PixStride;
+        ypos += x*2;
+    #endif
+        for(; x<width; x += 2)
         {
         #ifdef __MMX__
           if(PixStride == 4)
@@ -1109,3 +1362,51 @@ void Convert16To_YUY2Frame(const void* data, unsigned char* dest, unsigned npixe
 {
     Convert_2byte_To_YUY2Frame<11,5, 5,6, 0,5>(data,dest,npixels,width);
 }
+/***/
+void ConvertNESTo_I420Frame(const unsigned char* pixels, const unsigned char* deemph,
+                            const unsigned char* palette,
+                            unsigned char* dest, unsigned npixels, unsigned width)
+{
+    /* There are only 2048 colours (512 used), so the luma and the chroma
+     * terms of each are worked out once. The chroma of a 2x2 block is the
+     * sum of the terms of its pixels, the same sum as the RGB path makes.
+     * The U and V terms share one 64-bit word, each biased to be positive
+     * so that four of them add up without carrying into the other. */
+    const int bias = 1 << 22;
+    unsigned char lutY[2048];
+    uint64_t lutUV[2048];
+    for(unsigned c=0; c<2048; ++c)
+    {
+        const unsigned char* rgb = palette + c*4;
+        lutY[c] = Y_ADD + ((RY * rgb[0] + GY * rgb[1] + BY * rgb[2]) >> RGB2YUV_SHIFT);
+        uint32_t u = bias + RU * rgb[0] + GU * rgb[1] + BU * rgb[2];
+        uint32_t v = bias + RV * rgb[0] + GV * rgb[1] + BV * rgb[2];
+        lutUV[c] = u | (uint64_t)v << 32;
+    }
+
+    unsigned height = npixels / width;
+    unsigned char* ydest = dest;
+    unsigned char* vdest = dest + npixels;
+    unsigned char* udest = vdest + npixels / 4;
+
+    for(unsigned y=0; y<height; y += 2)
+    {
+        const unsigned char* p0 = pixels + y*width, *p1 = p0 + width;
+        const unsigned char* d0 = deemph + y*width, *d1 = d0 + width;
+        unsigned char* y0 = ydest + y*width, *y1 = y0 + width;
+
+        for(unsigned x=0; x<width; x += 2)
+        {
+            unsigned c0 = (d0[x]   & 7u) << 8 | p0[x];
+            unsigned c1 = (d0[x+1] & 7u) << 8 | p0[x+1];
+            unsigned c2 = (d1[x]   & 7u) << 8 | p1[x];
+            unsigned c3 = (d1[x+1] & 7u) << 8 | p1[x+1];
+            y0[x] = lutY[c0]; y0[x+1] = lutY[c1];
+            y1[x] = lutY[c2]; y1[x+1] = lutY[c3];
+
+            uint64_t uv = lutUV[c0] + lutUV[c1] + lutUV[c2] + lutUV[c3];
+            *udest++ = U_ADD + (((int)(uint32_t)uv         - 4*bias) >> (RGB2YUV_SHIFT+2));
+            *vdest++ = V_ADD + (((int)(uint32_t)(uv >> 32) - 4*bias) >> (RGB2YUV_SHIFT+2));
+        }
+    }
+}
@@ -59,6 +59,14 @@ void Convert16To_YUY2Frame(const void* data, unsigned char* dest, unsigned npixe
 void Convert24To_YUY2Frame(const void* data, unsigned char* dest, unsigned npixels, unsigned width);
 void Convert32To_YUY2Frame(const void* data, unsigned char* dest, unsigned npixels, unsigned width);
 
+/* NES frame straight to I420. pixels and deemph are npixels bytes each
+ * (palette index and deemphasis bits); palette has 2048 R,G,B,x entries
+ * indexed by (deemph<<8)|pixel. Gives the same bytes as drawing the frame
+ * to RGB32 with the palette and using Convert32To_I420Frame. */
+void ConvertNESTo_I420Frame(const unsigned char* pixels, const unsigned char* deemph,
+                            const unsigned char* palette,
+                            unsigned char* dest, unsigned npixels, unsigned width);
+
 #ifdef __cplusplus
 }
   #undef defaulttrue
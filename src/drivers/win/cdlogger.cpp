@@ -23,6 +23,7 @@
 #include "../../cart.h" //mbg merge 7/18/06 moved beneath fceu.h
 #include "../../x6502.h"
 #include "../../debug.h"
+#include "../../cdlog.h"
 #include "debugger.h"
 #include "tracer.h"
 #include "cdlogger.h"
@@ -43,9 +44,6 @@ extern iNES_HEADER head; //defined in ines.c
 extern uint8 *trainerpoo;
 
 //---------CDLogger VROM
-extern volatile int rendercount, vromreadcount, undefinedvromcount;
-extern unsigned char *cdloggervdata;
-extern unsigned int cdloggerVideoDataSize;
 extern int newppu;
 
 extern uint8 *NSFDATA;
@@ -194,41 +192,8 @@ INT_PTR CALLBACK CDLoggerCallB(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lP
 
 bool LoadCDLog(const char* nameo)
 {
-	FILE *FP;
-	int i,j;
-
-	FP = fopen(nameo, "rb");
-	if (FP == NULL)
+	if (!FCEU_CDLogLoad(nameo))
 		return false;
-
-	for(i = 0;i < (int)cdloggerdataSize;i++)
-	{
-		j = fgetc(FP);
-		if (j == EOF)
-			break;
-		if ((j & 1) && !(cdloggerdata[i] & 1))
-			codecount++; //if the new byte has something logged and
-		if ((j & 2) && !(cdloggerdata[i] & 2))
-			datacount++; //and the old one doesn't. Then increment
-		if ((j & 3) && !(cdloggerdata[i] & 3))
-			undefinedcount--; //the appropriate counter.
-		cdloggerdata[i] |= j;
-	}
-
-	if(cdloggerVideoDataSize != 0)
-	{
-		for(i = 0;i < (int)cdloggerVideoDataSize;i++)
-		{
-			j = fgetc(FP);
-			if(j == EOF)break;
-			if((j & 1) && !(cdloggervdata[i] & 1))rendercount++; //if the new byte has something logged and
-			if((j & 2) && !(cdloggervdata[i] & 2))vromreadcount++; //if the new byte has something logged and
-			if((j & 3) && !(cdloggervdata[i] & 3))undefinedvromcount--; //the appropriate counter.
-			cdloggervdata[i] |= j;
-		}
-	}
-
-	fclose(FP);
 	RenameCDLog(nameo);
 	UpdateCDLogger();
 	return true;
@@ -284,7 +249,8 @@ void SaveCDLogFileAs()
 	SaveCDLogFile();
 }
 
-void SaveCDLogFile()
+// names the log after the ROM if it doesn't have a name yet
+static void NameCDLogFile()
 {
 	if (loadedcdfile[0] == 0)
 	{
@@ -294,18 +260,13 @@ void SaveCDLogFile()
 		strcat(nameo, ".cdl");
 		RenameCDLog(nameo);
 	}
+}
 
-	FILE *FP;
-	FP = fopen(loadedcdfile, "wb");
-	if (FP == NULL)
-	{
+void SaveCDLogFile()
+{
+	NameCDLogFile();
+	if (!FCEU_CDLogSave(loadedcdfile))
 		FCEUD_PrintError("Error Saving File");
-		return;
-	}
-	fwrite(cdloggerdata, cdloggerdataSize, 1, FP);
-	if(cdloggerVideoDataSize != 0)
-		fwrite(cdloggervdata, cdloggerVideoDataSize, 1, FP);
-	fclose(FP);
 }
 
 // returns false if refused to start
@@ -526,6 +487,7 @@ bool PauseCDLogging()
 		return false;
 	}
 	FCEUI_SetLoggingCD(0);
+	FCEUI_CDLogEndAutoSave();
 	EnableTracerMenuItems();
 	SetDlgItemText(hCDLogger, BTN_CDLOGGER_START_PAUSE, "Start");
 	return true;
@@ -534,55 +496,29 @@ bool PauseCDLogging()
 void StartCDLogging()
 {
 	FCEUI_SetLoggingCD(1);
+	// with autosave on, long sessions are also saved as they go
+	if (autosaveCDL)
+	{
+		NameCDLogFile();
+		FCEUI_CDLogBeginAutoSave(loadedcdfile, 60);
+	}
 	EnableTracerMenuItems();
 	SetDlgItemText(hCDLogger, BTN_CDLOGGER_START_PAUSE, "Pause");
 }
 
 void FreeCDLog()
 {
-	if (cdloggerdata)
-	{
-		free(cdloggerdata);
-		cdloggerdata = NULL;
-		cdloggerdataSize = 0;
-	}
-	if (cdloggervdata)
-	{
-		free(cdloggervdata);
-		cdloggervdata = NULL;
-		cdloggerVideoDataSize = 0;
-	}
+	FCEU_CDLogFree();
 }
 
 void InitCDLog()
 {
-	cdloggerdataSize = PRGsize[0];
-	cdloggerdata = (unsigned char*)malloc(cdloggerdataSize);
-	if(!CHRram[0] || (CHRptr[0] == PRGptr[0])) {	// Some kind of workaround for my OneBus VRAM hack, will remove it if I find another solution for that
-		cdloggerVideoDataSize = CHRsize[0];
-		cdloggervdata = (unsigned char*)malloc(cdloggerVideoDataSize);
-	} else {
-		if (GameInfo->type != GIT_NSF) {
-			cdloggerVideoDataSize = 0;
-			cdloggervdata = (unsigned char*)malloc(8192);
-		}
-	}
+	FCEU_CDLogInit();
 }
 
 void ResetCDLog()
 {
-	codecount = datacount = rendercount = vromreadcount = 0;
-	undefinedcount = cdloggerdataSize;
-	ZeroMemory(cdloggerdata, cdloggerdataSize);
-	if(cdloggerVideoDataSize != 0) {
-		undefinedvromcount = cdloggerVideoDataSize;
-		ZeroMemory(cdloggervdata, cdloggerVideoDataSize);
-	} else {
-		if (GameInfo->type != GIT_NSF) {
-			undefinedvromcount = 8192;
-			ZeroMemory(cdloggervdata, 8192);
-		}
-	}
+	FCEU_CDLogReset();
 }
 
 void RenameCDLog(const char* newName)
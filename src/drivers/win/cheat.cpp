@@ -265,6 +265,7 @@ void EnableCheatButtons(HWND hwndDlg, int enable)
 	EnableWindow(GetDlgItem(hwndDlg, IDC_BTN_CHEAT_LT), enable);
 	EnableWindow(GetDlgItem(hwndDlg, IDC_CHEAT_CHECK_LT_BY), enable);
 	EnableWindow(GetDlgItem(hwndDlg, IDC_CHEAT_VAL_LT_BY), enable);
+	EnableWindow(GetDlgItem(hwndDlg, IDC_BTN_CHEAT_UNDO), enable);
 
 }
 
@@ -696,6 +697,10 @@ INT_PTR CALLBACK CheatConsoleCallB(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARA
 							ShowResults(hwndDlg);
 						}
 						break;
+						case IDC_BTN_CHEAT_UNDO:
+							if (FCEUI_CheatSearchUndo())
+								ShowResults(hwndDlg);
+							break;
 						case IDC_BTN_CHEAT_EQ:
 							searchdone = 1;
 							FCEUI_CheatSearchEnd(FCEU_SEARCH_PUERLY_RELATIVE_CHANGE, 0, 0);
@@ -1033,24 +1038,7 @@ void UpdateCheatList()
 void UpdateCheatListGroupBoxUI()
 {
 	char temp[64];
-	if (FrozenAddressCount < 256)
-	{
-		sprintf(temp, "Active Cheats %u", FrozenAddressCount);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADD), TRUE);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADDFROMFILE), TRUE);
-	}
-	else if (FrozenAddressCount == 256)
-	{
-		sprintf(temp, "Active Cheats %u (Max Limit)", FrozenAddressCount);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADD), FALSE);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADDFROMFILE), FALSE);
-	}
-	else
-	{
-		sprintf(temp, "%u Error: Too many cheats loaded!", FrozenAddressCount);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADD), FALSE);
-		EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_ADDFROMFILE), FALSE);
-	}
+	sprintf(temp, "Active Cheats %u", FrozenAddressCount);
 	SetDlgItemText(hCheat, IDC_GROUPBOX_CHEATLIST, temp);
 
 	EnableWindow(GetDlgItem(hCheat, IDC_BTN_CHEAT_EXPORTTOFILE), cheats != 0);
@@ -576,6 +576,10 @@ void Disassemble(HWND hWnd, int id, int scrollid, unsigned int addr)
 			beginningOfPCPointerLine = strlen(debug_str);
 			strcat(debug_str, ">");
 			PCLine = instructions_count;
+		} else if ((int)addr == debugBreakAccessPC)
+		{
+			// the instruction whose read or write hit the breakpoint
+			strcat(debug_str, "*");
 		} else
 		{
 			strcat(debug_str, " ");
@@ -849,7 +853,10 @@ void FCEUD_DebugBreakpoint(int bp_num)
 			if (bp_num >= 0)
 			{
 				// normal breakpoint
-				sprintf(str_temp, "Breakpoint %u Hit at $%04X: ", bp_num, X.PC);
+				if (debugBreakAccessPC >= 0)
+					sprintf(str_temp, "Breakpoint %u Hit at $%04X, after the access by $%04X: ", bp_num, X.PC, debugBreakAccessPC);
+				else
+					sprintf(str_temp, "Breakpoint %u Hit at $%04X: ", bp_num, X.PC);
 				strcat(str_temp, BreakToText(bp_num));
 				//watchpoint[num].condText
 				OutputLogLine(str_temp);
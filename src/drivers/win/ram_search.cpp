@@ -57,10 +57,6 @@ bool ShowROM = false;
 // whether it's asc or desc sorting
 // static bool ramSearchSortAsc = true;
 
-// used for changing colors of cheated address.
-extern int numsubcheats;
-extern CHEATF_SUBFAST SubCheats[256];
-
 bool IsHardwareAddressValid(HWAddressType address)
 {
 	if (!GameInfo)
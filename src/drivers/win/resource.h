@@ -629,6 +629,7 @@
 #define IDC_GAME_GENIE_LABEL            1097
 #define IDC_CHEAT_GAME_GENIE_TEXT       1098
 #define IDC_CHECK2                      1099
+#define IDC_BTN_CHEAT_UNDO              1100
 #define BTN_ALLOW_LRUD                  1117
 #define IDC_PRGROM_EDIT                 1118
 #define IDC_CHRROM_EDIT                 1119
@@ -1150,7 +1151,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        305
 #define _APS_NEXT_COMMAND_VALUE         40002
-#define _APS_NEXT_CONTROL_VALUE         1100
+#define _APS_NEXT_CONTROL_VALUE         1101
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
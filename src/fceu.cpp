@@ -42,6 +42,15 @@
 #include "input.h"
 #include "file.h"
 #include "vsuni.h"
+#include "tracelog.h"
+#include "reversedebug.h"
+#include "runahead.h"
+#include "cdlog.h"
+#include "memsnapshot.h"
+#include "romdb.h"
+#include "pngdump.h"
+#include "shmexport.h"
+#include "debug.h"
 #include "ines.h"
 #ifdef WIN32
 #include "drivers/win/pref.h"
@@ -162,6 +171,8 @@ void FCEU_TogglePPU(void) {
 #endif
 }
 
+static void SpliceReset();
+
 static void FCEU_CloseGame(void)
 {
 	if (GameInfo)
@@ -202,6 +213,14 @@ static void FCEU_CloseGame(void)
 		GameInterface(GI_CLOSE);
 
 		FCEUI_StopMovie();
+		FCEUI_EndTraceLog();
+		FCEU_ReverseClear();
+		FCEUI_CDLogEndAutoSave();
+		FCEUI_SetLoggingCD(0);
+		FCEU_CDLogFree();
+		FCEUI_EndFrameDump();
+		FCEU_MemSnapshotReset();
+		FCEU_RunAheadReset();
 
 		ResetExState(0, 0);
 
@@ -211,6 +230,7 @@ static void FCEU_CloseGame(void)
 			memset(XBuf, 0, 256 * 256);
 
 		FCEU_CloseGenie();
+		SpliceReset();
 
 		delete GameInfo;
 		GameInfo = NULL;
@@ -349,6 +369,172 @@ void SetWriteHandler(int32 start, int32 end, writefunc func) {
 			BWrite[x] = func;
 }
 
+//Handler splicing. Cheats, read/write breakpoints and lua memory hooks each route some addresses
+//through a handler of their own, which passes the access on down the chain. They all splice through
+//here, so every address has a single chain in a fixed order however the layers come and go: the
+//handler the game installed, then the cheats, the breakpoints and the lua hooks, outermost last.
+struct SplicePage
+{
+	readfunc baseRead[0x100];   //the handlers underneath all of the layers
+	writefunc baseWrite[0x100];
+	uint8 readLayers[0x100];    //a bit per layer spliced in
+	uint8 writeLayers[0x100];
+};
+
+static SplicePage *splicePages[0x100];  //allocated on first use
+static readfunc spliceRead[SPLICE_LAYERS];
+static writefunc spliceWrite[SPLICE_LAYERS];
+
+static INLINE int TopLayer(uint8 layers)
+{
+	int layer = SPLICE_LAYERS - 1;
+	while (!(layers & (1 << layer)))
+		layer--;
+	return layer;
+}
+
+static bool IsLayerRead(readfunc func)
+{
+	for (int i = 0; i < SPLICE_LAYERS; i++)
+		if (spliceRead[i] && spliceRead[i] == func)
+			return true;
+	return false;
+}
+
+static bool IsLayerWrite(writefunc func)
+{
+	for (int i = 0; i < SPLICE_LAYERS; i++)
+		if (spliceWrite[i] && spliceWrite[i] == func)
+			return true;
+	return false;
+}
+
+//the handler on top isn't ours when the game has installed its handlers again (power, reset);
+//the one it put there goes underneath
+static void SpliceSyncRead(SplicePage *p, uint32 A)
+{
+	const uint8 layers = p->readLayers[A & 0xFF];
+	const readfunc cur = GetReadHandler(A);
+	if (!layers || (cur != spliceRead[TopLayer(layers)] && !IsLayerRead(cur)))
+		p->baseRead[A & 0xFF] = cur;
+}
+
+static void SpliceSyncWrite(SplicePage *p, uint32 A)
+{
+	const uint8 layers = p->writeLayers[A & 0xFF];
+	const writefunc cur = GetWriteHandler(A);
+	if (!layers || (cur != spliceWrite[TopLayer(layers)] && !IsLayerWrite(cur)))
+		p->baseWrite[A & 0xFF] = cur;
+}
+
+static SplicePage *GetSplicePage(uint32 A, bool create)
+{
+	SplicePage *&p = splicePages[A >> 8];
+	if (!p && create)
+		p = new SplicePage();
+	return p;
+}
+
+void FCEU_SpliceRead(int layer, uint32 A, readfunc func)
+{
+	SplicePage *p = GetSplicePage(A, func != NULL);
+	if (!p)
+		return;
+	SpliceSyncRead(p, A);
+	uint8 &layers = p->readLayers[A & 0xFF];
+	if (func)
+	{
+		spliceRead[layer] = func;
+		layers |= 1 << layer;
+	} else
+		layers &= ~(1 << layer);
+	SetReadHandler(A, A, layers ? spliceRead[TopLayer(layers)] : p->baseRead[A & 0xFF]);
+}
+
+void FCEU_SpliceWrite(int layer, uint32 A, writefunc func)
+{
+	SplicePage *p = GetSplicePage(A, func != NULL);
+	if (!p)
+		return;
+	SpliceSyncWrite(p, A);
+	uint8 &layers = p->writeLayers[A & 0xFF];
+	if (func)
+	{
+		spliceWrite[layer] = func;
+		layers |= 1 << layer;
+	} else
+		layers &= ~(1 << layer);
+	SetWriteHandler(A, A, layers ? spliceWrite[TopLayer(layers)] : p->baseWrite[A & 0xFF]);
+}
+
+bool FCEU_IsSplicedRead(int layer, uint32 A)
+{
+	const SplicePage *p = splicePages[A >> 8];
+	return p && (p->readLayers[A & 0xFF] & (1 << layer));
+}
+
+bool FCEU_IsSplicedWrite(int layer, uint32 A)
+{
+	const SplicePage *p = splicePages[A >> 8];
+	return p && (p->writeLayers[A & 0xFF] & (1 << layer));
+}
+
+bool FCEU_IsSplicePage(uint32 page)
+{
+	return splicePages[page & 0xFF] != NULL;
+}
+
+uint8 FCEU_SpliceReadNext(int layer, uint32 A)
+{
+	const SplicePage *p = splicePages[A >> 8];
+	const uint8 below = p->readLayers[A & 0xFF] & ((1 << layer) - 1);
+	return below ? spliceRead[TopLayer(below)](A) : p->baseRead[A & 0xFF](A);
+}
+
+void FCEU_SpliceWriteNext(int layer, uint32 A, uint8 V)
+{
+	const SplicePage *p = splicePages[A >> 8];
+	const uint8 below = p->writeLayers[A & 0xFF] & ((1 << layer) - 1);
+	if (below)
+		spliceWrite[TopLayer(below)](A, V);
+	else
+		p->baseWrite[A & 0xFF](A, V);
+}
+
+//puts every layer back on top of the handlers the game has just installed
+void FCEU_SpliceRefresh()
+{
+	for (uint32 page = 0; page < 0x100; page++)
+	{
+		SplicePage *p = splicePages[page];
+		if (!p)
+			continue;
+		for (uint32 A = page << 8; A != (page + 1) << 8; A++)
+		{
+			if (p->readLayers[A & 0xFF])
+			{
+				SpliceSyncRead(p, A);
+				SetReadHandler(A, A, spliceRead[TopLayer(p->readLayers[A & 0xFF])]);
+			}
+			if (p->writeLayers[A & 0xFF])
+			{
+				SpliceSyncWrite(p, A);
+				SetWriteHandler(A, A, spliceWrite[TopLayer(p->writeLayers[A & 0xFF])]);
+			}
+		}
+	}
+}
+
+//the handlers go with the game
+static void SpliceReset()
+{
+	for (int page = 0; page < 0x100; page++)
+	{
+		delete splicePages[page];
+		splicePages[page] = NULL;
+	}
+}
+
 uint8 *RAM;
 
 //---------
@@ -374,11 +560,11 @@ static DECLFW(BRAMH) {
 	RAM[A & 0x7FF] = V;
 }
 
-static DECLFR(ARAML) {
+DECLFR(ARAML) {
 	return RAM[A];
 }
 
-static DECLFR(ARAMH) {
+DECLFR(ARAMH) {
 	return RAM[A & 0x7FF];
 }
 
@@ -611,6 +797,9 @@ void FCEUI_Kill(void) {
 	#endif
 	FCEU_KillVirtualVideo();
 	FCEU_KillGenie();
+	FCEU_RomDBClose();
+	FCEU_PngDumpKill();
+	FCEUI_ShmExportEnd();
 	FreeBuffers();
 }
 
@@ -656,6 +845,18 @@ void AutoFire(void) {
 
 void UpdateAutosave(void);
 
+///Emulates a frame with the input already set up, leaving out sound and the lua callbacks.
+///The reverse debugger uses it to replay its history up to the frame it wants. skip has to be
+///the one the frame was first emulated with: a skipped frame fakes the sprite 0 hit.
+void FCEU_EmulateReplayFrame(int skip) {
+	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
+	FCEUPPU_Loop(skip);
+
+	timestampbase += timestamp;
+	timestamp = 0;
+	soundtimestamp = 0;
+}
+
 ///Emulates a single frame.
 
 ///Skip may be passed in, if FRAMESKIP is #defined, to cause this to emulate more than one frame
@@ -710,12 +911,23 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 
 	AutoFire();
 	UpdateAutosave();
+	FCEU_CDLogFrame();
+	FCEU_CheatSearchFrame();
+	FCEU_MemSnapshotFrame();
 
 #ifdef _S9XLUA_H
 	FCEU_LuaFrameBoundary();
 #endif
 
-	FCEU_UpdateInput();
+	//a frame being dumped is drawn
+	int ppuSkip = FCEU_FrameDumpWanted() ? 0 : skip;
+
+	//a frame replayed by the reverse debugger gets its recorded input and frame skip
+	if (!FCEU_ReverseFrameBoundary(&ppuSkip))
+	{
+		FCEU_UpdateInput();
+		FCEU_ReverseRecordFrame(ppuSkip);
+	}
 	lagFlag = 1;
 
 #ifdef _S9XLUA_H
@@ -723,9 +935,13 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 #endif
 
 	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
-	r = FCEUPPU_Loop(skip);
+	UpdateWatchpointIndex(false);
+	if (!FCEU_RunAheadFrame(skip, &ssize))
+	{
+		r = FCEUPPU_Loop(ppuSkip);
 
-	if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
+		if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
+	}
 
 #ifdef _S9XLUA_H
 	CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
@@ -801,6 +1017,12 @@ void ResetNES(void) {
 	FCEUSND_Reset();
 	FCEUPPU_Reset();
 	X6502_Reset();
+	FCEU_SpliceRefresh();
+#ifdef _S9XLUA_H
+	FCEU_LuaRebuildMemHooks();
+#endif
+	UpdateWatchpointIndex(true);
+	FCEU_fmapCheck();
 
 	// clear back baffer
 	extern uint8 *XBackBuf;
@@ -940,7 +1162,13 @@ void PowerNES(void) {
 #ifdef WIN32
 	ResetDebugStatisticsCounters();
 #endif
+	FCEU_SpliceRefresh();
 	FCEU_PowerCheats();
+#ifdef _S9XLUA_H
+	FCEU_LuaRebuildMemHooks();
+#endif
+	UpdateWatchpointIndex(true);
+	FCEU_fmapCheck();
 	LagCounterReset();
 	// clear back buffer
 	extern uint8 *XBackBuf;
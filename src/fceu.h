@@ -28,6 +28,27 @@ void SetWriteHandler(int32 start, int32 end, writefunc func);
 writefunc GetWriteHandler(int32 a);
 readfunc GetReadHandler(int32 a);
 
+//the layers spliced into the handlers, innermost first
+enum ESPLICELAYER
+{
+	SPLICE_CHEAT,
+	SPLICE_WATCHPOINT,
+	SPLICE_LUA,
+	SPLICE_LAYERS
+};
+
+//splices a layer's handler into an address, or takes it out with func NULL
+void FCEU_SpliceRead(int layer, uint32 A, readfunc func);
+void FCEU_SpliceWrite(int layer, uint32 A, writefunc func);
+bool FCEU_IsSplicedRead(int layer, uint32 A);
+bool FCEU_IsSplicedWrite(int layer, uint32 A);
+//whether anything was ever spliced into the 256 bytes from page << 8
+bool FCEU_IsSplicePage(uint32 page);
+//called by a layer's handler to pass the access on down the chain
+uint8 FCEU_SpliceReadNext(int layer, uint32 A);
+void FCEU_SpliceWriteNext(int layer, uint32 A, uint8 V);
+void FCEU_SpliceRefresh();
+
 int AllocGenieRW(void);
 void FlushGenieRW(void);
 
@@ -36,6 +57,7 @@ void FCEU_ResetVidSys(void);
 void ResetMapping(void);
 void ResetNES(void);
 void PowerNES(void);
+void FCEU_EmulateReplayFrame(int skip);
 
 void SetAutoFireOffset(int offset);
 void SetAutoFirePattern(int onframes, int offframes);
@@ -74,6 +96,9 @@ uint8 FCEU_ReadRomByte(uint32 i);
 void FCEU_WriteRomByte(uint32 i, uint8 value);
 
 extern readfunc ARead[0x10000];
+//the read handlers of the internal RAM and of its mirrors
+DECLFR(ARAML);
+DECLFR(ARAMH);
 extern writefunc BWrite[0x10000];
 
 enum GI {
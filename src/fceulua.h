@@ -27,7 +27,25 @@ enum LuaMemHookType
 
 	LUAMEMHOOK_COUNT
 };
-void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
+// one bit per byte of the 64K CPU address space, per hook type
+extern uint32 luaMemHookBits[LUAMEMHOOK_COUNT][0x10000 >> 5];
+void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
+
+// performance critical! (called on every instruction fetch)
+// unhooked addresses cost a single bit test and never leave this function.
+// read and write hooks are normally dispatched by handlers spliced into ARead/BWrite
+// (see FCEU_LuaRebuildMemHooks), so only the CPU paths bypassing those tables call this.
+static inline void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
+{
+	for(unsigned int i = address; i != address+size; i++)
+	{
+		if(i < 0x10000 && (luaMemHookBits[hookType][i >> 5] & (1u << (i & 31))))
+		{
+			CallRegisteredLuaMemHook_LuaMatch(address, size, value, hookType); // something has hooked this specific address
+			return;
+		}
+	}
+}
 
 struct LuaSaveData
 {
@@ -67,6 +85,7 @@ void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& save
 // Just forward function declarations
 
 void FCEU_LuaFrameBoundary();
+void FCEU_LuaRebuildMemHooks();
 int FCEU_LoadLuaCode(const char *filename, const char *arg=NULL);
 void FCEU_ReloadLuaCode();
 void FCEU_LuaStop();
@@ -44,10 +44,14 @@
 #include "movie.h"
 #include "driver.h"
 #include "utils/xstring.h"
+#include "utils/crc32.h"
 
 #ifndef WIN32
 #include <zlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
+#include <vector>
 
 using namespace std;
 
@@ -443,6 +447,107 @@ int FCEU_fisarchive(FCEUFILE *fp)
 	else return 1;
 }
 
+struct FileMapping {
+	uint8 *start;
+	size_t length;
+	int fd;         //the file, kept open to check it against crc
+	off_t offset;   //where start is in the file
+	uint32 crc;     //of what was in the file when it was mapped
+};
+static std::vector<FileMapping> fileMappings;
+
+uint8 *FCEU_fmap(FCEUFILE *fp, uint32 offset, uint32 size)
+{
+#ifdef WIN32
+	return 0;
+#else
+	//only plain files; archives, gzipped and patched files are in memory already
+	EMUFILE_FILE *file = dynamic_cast<EMUFILE_FILE*>(fp->stream);
+	if(!file || !size)
+		return 0;
+	int fd = fileno(file->get_fp());
+	struct stat st;
+	if(fstat(fd, &st) || !S_ISREG(st.st_mode) || (uint64)st.st_size < (uint64)offset + size)
+		return 0;
+
+	const uint32 align = offset % (uint32)sysconf(_SC_PAGESIZE);
+	FileMapping m;
+	m.length = size + align;
+	m.offset = offset - align;
+	void *start = mmap(0, m.length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, m.offset);
+	if(start == MAP_FAILED)
+		return 0;
+	m.fd = dup(fd);
+	if(m.fd < 0)
+	{
+		munmap(start, m.length);
+		return 0;
+	}
+	m.start = (uint8*)start;
+	//nothing has written to the pages yet, so this is what is in the file
+	m.crc = CalcCRC32(0, m.start, m.length);
+	fileMappings.push_back(m);
+	return m.start + align;
+#endif
+}
+
+void FCEU_ffree(uint8 *ptr)
+{
+	if(!ptr)
+		return;
+#ifndef WIN32
+	for(size_t i = 0; i < fileMappings.size(); i++)
+	{
+		const FileMapping &m = fileMappings[i];
+		if(ptr >= m.start && ptr < m.start + m.length)
+		{
+			munmap(m.start, m.length);
+			close(m.fd);
+			fileMappings.erase(fileMappings.begin() + i);
+			return;
+		}
+	}
+#endif
+	free(ptr);
+}
+
+bool FCEU_fmapped()
+{
+	return !fileMappings.empty();
+}
+
+bool FCEU_fmapCheck()
+{
+	bool same = true;
+#ifndef WIN32
+	std::vector<uint8> buf(1 << 16);
+	for(size_t i = 0; i < fileMappings.size(); i++)
+	{
+		FileMapping &m = fileMappings[i];
+		//the file is read rather than the mapping, which has the pages written to since
+		uint32 crc = 0;
+		size_t done = 0;
+		while(done < m.length)
+		{
+			const size_t chunk = m.length - done < buf.size() ? m.length - done : buf.size();
+			const ssize_t got = pread(m.fd, &buf[0], chunk, m.offset + done);
+			if(got <= 0)
+				break;
+			crc = CalcCRC32(crc, &buf[0], got);
+			done += got;
+		}
+		if(done == m.length && crc == m.crc)
+			continue;
+		//once is enough; what was read stands for the file from now on
+		m.crc = crc;
+		same = false;
+	}
+	if(!same)
+		FCEU_PrintError("The game's file was changed or cut short by another program while it was open. Parts of the game not yet read come from the new file, and missing ones will crash the emulator. Close and reopen the game.");
+#endif
+	return same;
+}
+
 std::string GetMfn() //Retrieves the movie filename from curMovieFilename (for adding to savestate and auto-save files)
 {
 	std::string movieFilenamePart;
@@ -681,6 +786,12 @@ std::string FCEU_MakeFName(int type, int id1, const char *cd1)
 			else
 				sprintf(ret,"%s" PSS "snaps" PSS "%s-%d.%s",BaseDirectory.c_str(),FileBase,id1,cd1);
 			break;
+		case FCEUMKF_FRAMEDUMP:
+			if(odirs[FCEUIOD_SNAPS])
+				sprintf(ret,"%s" PSS "%s-frame%06d.%s",odirs[FCEUIOD_SNAPS],FileBase,id1,cd1);
+			else
+				sprintf(ret,"%s" PSS "snaps" PSS "%s-frame%06d.%s",BaseDirectory.c_str(),FileBase,id1,cd1);
+			break;
 		case FCEUMKF_FDS:
 			if(odirs[FCEUIOD_NV])
 				sprintf(ret,"%s" PSS "%s.fds",odirs[FCEUIOD_NV],FileBase);
@@ -741,6 +852,8 @@ std::string FCEU_MakeFName(int type, int id1, const char *cd1)
 			strcpy(ret,FCEU_MakeIpsFilename(CurrentFileBase()).c_str());
 			break;
 		case FCEUMKF_GGROM:sprintf(ret,"%s" PSS "gg.rom",BaseDirectory.c_str());break;
+		case FCEUMKF_ROMDB:sprintf(ret,"%s" PSS "romdb.txt",BaseDirectory.c_str());break;
+		case FCEUMKF_ROMINDEX:sprintf(ret,"%s" PSS "romindex.dat",BaseDirectory.c_str());break;
 		case FCEUMKF_FDSROM:
 			if(odirs[FCEUIOD_FDSROM])
 				sprintf(ret,"%s" PSS "disksys.rom",odirs[FCEUIOD_FDSROM]);
@@ -134,6 +134,16 @@ int FCEU_read16le(uint16 *Bufo, FCEUFILE*);
 int FCEU_fgetc(FCEUFILE*);
 uint64 FCEU_fgetsize(FCEUFILE*);
 int FCEU_fisarchive(FCEUFILE*);
+//maps size bytes of a plain file, from offset on, instead of reading them. the mapping is private: the pages
+//that get written to are copied and the file is left alone, but changes to the file show through the pages
+//not yet written to; FCEU_fmapCheck looks for those. returns NULL when the file can't be mapped
+uint8 *FCEU_fmap(FCEUFILE*, uint32 offset, uint32 size);
+//frees what FCEU_fmap or FCEU_malloc returned
+void FCEU_ffree(uint8 *ptr);
+//whether anything is mapped from a file, which then must not be overwritten in place
+bool FCEU_fmapped();
+//compares the mapped files with the CRC they had when mapped, and warns when one was changed since
+bool FCEU_fmapCheck();
 
 
 
@@ -167,4 +177,7 @@ void FCEU_SplitArchiveFilename(std::string src, std::string& archive, std::strin
 #define FCEUMKF_AVI			 21
 #define FCEUMKF_TASEDITOR    22
 #define FCEUMKF_RESUMESTATE  23
+#define FCEUMKF_ROMDB        24
+#define FCEUMKF_ROMINDEX     25
+#define FCEUMKF_FRAMEDUMP    26
 #endif
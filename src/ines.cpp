@@ -37,10 +37,14 @@
 #include "cheat.h"
 #include "vsuni.h"
 #include "driver.h"
+#include "romdb.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <utility>
 
 extern SFORMAT FCEUVSUNI_STATEINFO[];
 
@@ -63,6 +67,8 @@ static int iNES_Init(int num);
 
 static int MapperNo = 0;
 
+//set only by a genuine NES 2.0 header. the external database can give an iNES 1.0 game NES 2.0 RAM
+//sizes too, which sets iNESCart.ines2 but not this: the header's other NES 2.0 fields are still junk.
 int iNES2 = 0;
 
 static DECLFR(TrainerRead) {
@@ -107,11 +113,11 @@ void iNESGI(GI h) { //bbit edited: removed static keyword
 		if (iNESCart.Close)
 			iNESCart.Close();
 		if (ROM) {
-			free(ROM);
+			FCEU_ffree(ROM);
 			ROM = NULL;
 		}
 		if (VROM) {
-			free(VROM);
+			FCEU_ffree(VROM);
 			VROM = NULL;
 		}
 		if (trainerpoo) {
@@ -129,6 +135,26 @@ void iNESGI(GI h) { //bbit edited: removed static keyword
 
 uint32 iNESGameCRC32 = 0;
 
+//The built-in tables below are kept in no particular order. They are looked up through an index sorted
+//by key, built the first time it's needed; where a key is listed more than once, the first entry wins.
+template<typename K>
+struct TableIndex {
+	std::vector<std::pair<K, int> > keys;
+	bool built;
+
+	TableIndex() : built(false) {}
+	void add(K key, int i) { keys.push_back(std::make_pair(key, i)); }
+	void build() {
+		std::sort(keys.begin(), keys.end());
+		built = true;
+	}
+	//the table entry for the key, or -1
+	int find(K key) const {
+		typename std::vector<std::pair<K, int> >::const_iterator it = std::lower_bound(keys.begin(), keys.end(), std::make_pair(key, -1));
+		return (it != keys.end() && it->first == key) ? it->second : -1;
+	}
+};
+
 struct CRCMATCH {
 	uint32 crc;
 	char *name;
@@ -214,16 +240,19 @@ static void SetInput(void) {
 		{0x67b126b9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FAMINETSYS },	// Famicom Network System
 		{0x00000000,	SI_UNSET,		SI_UNSET,		SIFC_UNSET		}
 	};
-	int x = 0;
+	static TableIndex<uint32> index;
+	int x;
 
-	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0) {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;
-		}
-		x++;
+	if (!index.built) {
+		for (x = 0; moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0; x++)
+			index.add(moo[x].crc32, x);
+		index.build();
+	}
+	x = index.find(iNESGameCRC32);
+	if (x >= 0) {
+		GameInfo->input[0] = moo[x].input1;
+		GameInfo->input[1] = moo[x].input2;
+		GameInfo->inputfc = moo[x].inputfc;
 	}
 }
 
@@ -243,14 +272,17 @@ static struct BADINF BadROMImages[] =
 };
 
 void CheckBad(uint64 md5partial) {
-	int32 x = 0;
-	while (BadROMImages[x].name) {
-		if (BadROMImages[x].md5partial == md5partial) {
-			FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", BadROMImages[x].name);
-			return;
-		}
-		x++;
+	static TableIndex<uint64> index;
+	int32 x;
+
+	if (!index.built) {
+		for (x = 0; BadROMImages[x].name; x++)
+			index.add(BadROMImages[x].md5partial, x);
+		index.build();
 	}
+	x = index.find(md5partial);
+	if (x >= 0)
+		FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", BadROMImages[x].name);
 }
 
 
@@ -275,6 +307,8 @@ static const TMasterRomInfo sMasterRomInfo[] = {
 const TMasterRomInfo* MasterRomInfo;
 TMasterRomInfoParams MasterRomInfoParams;
 
+static int romdbVidSystem = -1;	//the TV system the external database gives for the game, or -1
+
 static void CheckHInfo(void) {
 	/* ROM images that have the battery-backed bit set in the header that really
 	don't have battery-backed RAM is not that big of a problem, so I'll
@@ -324,79 +358,114 @@ static void CheckHInfo(void) {
 	{
 		#include "ines-correct.h"
 	};
+	static TableIndex<uint64> savieIndex, masterIndex;
+	static TableIndex<uint32> mooIndex;
 	int32 tofix = 0, x, mask;
 	uint64 partialmd5 = 0;
 
+	if (!mooIndex.built) {
+		for (x = 0; savie[x] != 0; x++)
+			savieIndex.add(savie[x], x);
+		savieIndex.build();
+		for (x = 0; x < ARRAY_SIZE(sMasterRomInfo); x++)
+			masterIndex.add(sMasterRomInfo[x].md5lower, x);
+		masterIndex.build();
+		x = 0;
+		do {
+			mooIndex.add(moo[x].crc32, x);
+			x++;
+		} while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
+		mooIndex.build();
+	}
+
 	for (x = 0; x < 8; x++)
 		partialmd5 |= (uint64)iNESCart.MD5[15 - x] << (x * 8);
 	CheckBad(partialmd5);
 
 	MasterRomInfo = NULL;
-	for (int i = 0; i < ARRAY_SIZE(sMasterRomInfo); i++) {
-		const TMasterRomInfo& info = sMasterRomInfo[i];
-		if (info.md5lower != partialmd5)
-			continue;
-
+	x = masterIndex.find(partialmd5);
+	if (x >= 0) {
+		const TMasterRomInfo& info = sMasterRomInfo[x];
 		MasterRomInfo = &info;
-		if (!info.params) break;
-
-		std::vector<std::string> toks = tokenize_str(info.params, ",");
-		for (int j = 0; j < (int)toks.size(); j++) {
-			std::vector<std::string> parts = tokenize_str(toks[j], "=");
-			MasterRomInfoParams[parts[0]] = parts[1];
+		if (info.params) {
+			std::vector<std::string> toks = tokenize_str(info.params, ",");
+			for (int j = 0; j < (int)toks.size(); j++) {
+				std::vector<std::string> parts = tokenize_str(toks[j], "=");
+				MasterRomInfoParams[parts[0]] = parts[1];
+			}
 		}
-		break;
 	}
 
-	x = 0;
-	do {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			if (moo[x].mapper >= 0) {
-				if (moo[x].mapper & 0x800 && VROM_size) {
-					VROM_size = 0;
-					free(VROM);
-					VROM = NULL;
-					tofix |= 8;
-				}
-				if (moo[x].mapper & 0x1000)
-					mask = 0xFFF;
-				else
-					mask = 0xFF;
-				if (MapperNo != (moo[x].mapper & mask)) {
-					tofix |= 1;
-					MapperNo = moo[x].mapper & mask;
-				}
+	x = mooIndex.find(iNESGameCRC32);
+	if (x >= 0) {
+		if (moo[x].mapper >= 0) {
+			if (moo[x].mapper & 0x800 && VROM_size) {
+				VROM_size = 0;
+				FCEU_ffree(VROM);
+				VROM = NULL;
+				tofix |= 8;
 			}
-			if (moo[x].mirror >= 0) {
-				if (moo[x].mirror == 8) {
-					if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
-						tofix |= 2;
-						Mirroring = 0;
-					}
-				} else if (Mirroring != moo[x].mirror) {
-					if (Mirroring != (moo[x].mirror & ~4))
-						if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
-														needs to be set(the iNES header can't
-														hold this information).
-														*/
-							tofix |= 2;
-					Mirroring = moo[x].mirror;
-				}
+			if (moo[x].mapper & 0x1000)
+				mask = 0xFFF;
+			else
+				mask = 0xFF;
+			if (MapperNo != (moo[x].mapper & mask)) {
+				tofix |= 1;
+				MapperNo = moo[x].mapper & mask;
 			}
-			break;
 		}
-		x++;
-	} while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
-
-	x = 0;
-	while (savie[x] != 0) {
-		if (savie[x] == partialmd5) {
-			if (!(head.ROM_type & 2)) {
-				tofix |= 4;
-				head.ROM_type |= 2;
+		if (moo[x].mirror >= 0) {
+			if (moo[x].mirror == 8) {
+				if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
+					tofix |= 2;
+					Mirroring = 0;
+				}
+			} else if (Mirroring != moo[x].mirror) {
+				if (Mirroring != (moo[x].mirror & ~4))
+					if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
+													needs to be set(the iNES header can't
+													hold this information).
+													*/
+						tofix |= 2;
+				Mirroring = moo[x].mirror;
 			}
 		}
-		x++;
+	}
+
+	if (savieIndex.find(partialmd5) >= 0) {
+		if (!(head.ROM_type & 2)) {
+			tofix |= 4;
+			head.ROM_type |= 2;
+		}
+	}
+
+	/* The external database has the last word. */
+	ROMDBENTRY db;
+	romdbVidSystem = -1;
+	if (FCEU_RomDBLookup(iNESGameCRC32, &db)) {
+		if (db.mapper >= 0 && MapperNo != db.mapper) {
+			tofix |= 1;
+			MapperNo = db.mapper;
+		}
+		if (db.submapper >= 0)
+			iNESCart.submapper = db.submapper;
+		if (db.mirror >= 0 && Mirroring != db.mirror) {
+			tofix |= 2;
+			Mirroring = db.mirror;
+		}
+		if (db.battery > 0 && !(head.ROM_type & 2)) {
+			tofix |= 4;
+			head.ROM_type |= 2;
+		} else if (db.battery == 0)
+			head.ROM_type &= ~2;
+		if (db.prgram >= 0) {
+			iNESCart.ines2 = true;
+			iNESCart.wram_size = db.prgram;
+			iNESCart.battery_wram_size = db.prgnvram;
+			iNESCart.vram_size = db.chrram;
+			iNESCart.battery_vram_size = db.chrnvram;
+		}
+		romdbVidSystem = db.tv;
 	}
 
 	/* Games that use these iNES mappers tend to have the four-screen bit set
@@ -733,6 +802,28 @@ BMAPPINGLocal bmap[] = {
 	{"",					0, NULL}
 };
 
+//uses PRG and CHR straight from the file instead of reading them, if it has them whole
+static bool MapROM(FCEUFILE *fp, uint32 offset) {
+	if ((ROM = FCEU_fmap(fp, offset, ROM_size << 14)) == NULL)
+		return false;
+	if (VROM_size && (VROM = FCEU_fmap(fp, offset + (ROM_size << 14), VROM_size << 13)) == NULL) {
+		FCEU_ffree(ROM);
+		ROM = NULL;
+		return false;
+	}
+	return true;
+}
+
+//MD5 and CRC32 together, a block at a time, so the data is only brought in once
+static uint32 HashROM(struct md5_context *md5, uint32 crc, uint8 *data, uint32 size) {
+	for (uint32 pos = 0; pos < size; pos += 0x10000) {
+		uint32 len = (size - pos < 0x10000) ? size - pos : 0x10000;
+		md5_update(md5, data + pos, len);
+		crc = CalcCRC32(crc, data + pos, len);
+	}
+	return crc;
+}
+
 int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	struct md5_context md5;
 
@@ -771,7 +862,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	else
 		ROM_size = uppow2(not_round_size);
 
-	VROM_size = uppow2(head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0));
+	int not_round_vsize = head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0);
+	VROM_size = uppow2(not_round_vsize);
 
 	int round = true;
 	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
@@ -786,17 +878,23 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		}
 	}
 
-	if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
-		return 0;
-	memset(ROM, 0xFF, ROM_size << 14);
+	//uncompressed images without padding to do are mapped, the rest is read into memory
+	bool mapped = (not_round_size == ROM_size) && (not_round_vsize == VROM_size)
+		&& MapROM(fp, 16 + ((head.ROM_type & 4) ? 512 : 0));
 
-	if (VROM_size) {
-		if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
-			free(ROM);
-			ROM = NULL;
+	if (!mapped) {
+		if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
 			return 0;
+		memset(ROM, 0xFF, ROM_size << 14);
+
+		if (VROM_size) {
+			if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
+				free(ROM);
+				ROM = NULL;
+				return 0;
+			}
+			memset(VROM, 0xFF, VROM_size << 13);
 		}
-		memset(VROM, 0xFF, VROM_size << 13);
 	}
 
 	if (head.ROM_type & 4) {	/* Trainer */
@@ -809,20 +907,17 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 
 	SetupCartPRGMapping(0, ROM, ROM_size << 14, 0);
 
-	FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
+	if (!mapped) {
+		FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
 
-	if (VROM_size)
-		FCEU_fread(VROM, 0x2000, VROM_size, fp);
+		if (VROM_size)
+			FCEU_fread(VROM, 0x2000, VROM_size, fp);
+	}
 
 	md5_starts(&md5);
-	md5_update(&md5, ROM, ROM_size << 14);
-
-	iNESGameCRC32 = CalcCRC32(0, ROM, ROM_size << 14);
-
-	if (VROM_size) {
-		iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, VROM_size << 13);
-		md5_update(&md5, VROM, VROM_size << 13);
-	}
+	iNESGameCRC32 = HashROM(&md5, 0, ROM, ROM_size << 14);
+	if (VROM_size)
+		iNESGameCRC32 = HashROM(&md5, iNESGameCRC32, VROM, VROM_size << 13);
 	md5_finish(&md5, iNESCart.MD5);
 	memcpy(&GameInfo->MD5, &iNESCart.MD5, sizeof(iNESCart.MD5));
 
@@ -910,8 +1005,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		FCEU_PrintError("CHR-RAM size < 1k is not supported.");
 		break;
 	}
-	if (ROM) free(ROM);
-	if (VROM) free(VROM);
+	if (ROM) FCEU_ffree(ROM);
+	if (VROM) FCEU_ffree(VROM);
 	if (trainerpoo) free(trainerpoo);
 	if (ExtraNTARAM) free(ExtraNTARAM);
 	ROM = NULL;
@@ -940,7 +1035,9 @@ init_ok:
 	// since apparently the iNES format doesn't store this information,
 	// guess if the settings should be PAL or NTSC from the ROM name
 	// TODO: MD5 check against a list of all known PAL games instead?
-	if (iNES2) {
+	if (romdbVidSystem >= 0 && OverwriteVidMode) {
+		FCEUI_SetVidSystem(romdbVidSystem);
+	} else if (iNES2) {
 		FCEUI_SetVidSystem(((head.TV_system & 3) == 1) ? 1 : 0);
 	} else if (OverwriteVidMode) {
 		if (strstr(name, "(E)") || strstr(name, "(e)")
@@ -976,13 +1073,19 @@ int iNesSaveAs(char* name)
 	if (GameInfo->type != GIT_CART) return 0;
 	if (GameInterface != iNESGI) return 0;
 
-	fp = fopen(name, "wb");
+	//the ROM may be mapped from the very file being saved over, so a new file takes its place instead
+	const bool replace = FCEU_fmapped();
+	std::string tmpname = std::string(name) + ".tmp";
+
+	fp = fopen(replace ? tmpname.c_str() : name, "wb");
 	if (!fp)
 		return 0;
 
 	if (fwrite(&head, 1, 16, fp) != 16)
 	{
 		fclose(fp);
+		if (replace)
+			remove(tmpname.c_str());
 		return 0;
 	}
 
@@ -998,6 +1101,11 @@ int iNesSaveAs(char* name)
 		fwrite(VROM, 0x2000, head.VROM_size, fp);
 
 	fclose(fp);
+	if (replace && rename(tmpname.c_str(), name) != 0)
+	{
+		remove(tmpname.c_str());
+		return 0;
+	}
 	return 1;
 }
 
@@ -15,6 +15,8 @@
 #include "file.h"
 #include "video.h"
 #include "debug.h"
+#include "cdlog.h"
+#include "pngdump.h"
 #include "sound.h"
 #include "drawing.h"
 #include "state.h"
@@ -93,8 +95,13 @@ extern "C"
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
+#ifdef _LUAJIT
+#include <luajit.h>
+#endif
 #ifdef WIN32
+#ifndef _LUAJIT
 #include <lstate.h>
+#endif
 	int iuplua_open(lua_State * L);
 	int iupcontrolslua_open(lua_State * L);
 	int luaopen_winapi(lua_State * L);
@@ -232,6 +239,9 @@ static int numTries;
 // number of registered memory functions (1 per hooked byte)
 static unsigned int numMemHooks;
 
+// set while a script pokes memory itself, so that a write hook writing to its own address doesn't recurse
+static int memHookSuppress = 0;
+
 // Look in fceu.h for macros named like JOY_UP to determine the order.
 static const char *button_mappings[] = {
 	"A", "B", "select", "start", "up", "down", "left", "right"
@@ -1280,7 +1290,7 @@ void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& save
 
 		if (lua_isfunction(L, -1))
 		{
-#ifdef WIN32
+#if defined(WIN32) && !defined(_LUAJIT)
 			// since the scriptdata can be very expensive to load
 			// (e.g. the registered save function returned some huge tables)
 			// check the number of parameters the registered load function expects
@@ -1428,13 +1438,19 @@ static int memory_writebyte(lua_State *L) {
 	uint8  V = luaL_checkinteger(L, 2);
 
 	if(A < 0x10000)
+	{
+		memHookSuppress++;
 		BWrite[A](A, V);
+		memHookSuppress--;
+	}
 
 	return 0;
 }
 
 static int legacymemory_writebyte(lua_State *L) {
+	memHookSuppress++;
 	FCEU_CheatSetByte(luaL_checkinteger(L,1), luaL_checkinteger(L,2));
+	memHookSuppress--;
 	return 0;
 }
 
@@ -1476,6 +1492,219 @@ static int ppu_readbyterange(lua_State *L) {
 	return 1;
 }
 
+// Byte buffers are reusable userdata blocks for bulk access.
+// A script scanning memory or the screen fills one with a single call per frame
+// and works on it in C, instead of crossing into C once per byte.
+#define LUA_BYTEBUFFER_META "FCEU ByteBuffer"
+
+struct LuaByteBuffer {
+	uint32 size;
+	uint8 data[1];
+};
+
+static LuaByteBuffer* pushbytebuffer(lua_State *L, uint32 size)
+{
+	LuaByteBuffer *buf = (LuaByteBuffer*)lua_newuserdata(L, sizeof(LuaByteBuffer) + size);
+	buf->size = size;
+	memset(buf->data, 0, size);
+	luaL_getmetatable(L, LUA_BYTEBUFFER_META);
+	lua_setmetatable(L, -2);
+	return buf;
+}
+
+static LuaByteBuffer* checkbytebuffer(lua_State *L, int idx)
+{
+	return (LuaByteBuffer*)luaL_checkudata(L, idx, LUA_BYTEBUFFER_META);
+}
+
+// returns the buffer at idx if it can hold size bytes, otherwise pushes a new one.
+// either way the buffer to fill is left on top of the stack.
+static LuaByteBuffer* reusebytebuffer(lua_State *L, int idx, uint32 size)
+{
+	if(!lua_isnoneornil(L, idx))
+	{
+		LuaByteBuffer *buf = checkbytebuffer(L, idx);
+		if(buf->size >= size)
+		{
+			lua_pushvalue(L, idx);
+			return buf;
+		}
+	}
+	return pushbytebuffer(L, size);
+}
+
+// buffer memory.newbuffer(int size)
+static int memory_newbuffer(lua_State *L)
+{
+	int size = luaL_checkinteger(L, 1);
+	if(size < 0)
+		luaL_error(L, "buffer size must not be negative");
+	pushbytebuffer(L, size);
+	return 1;
+}
+
+// buffer memory.readbuffer(int address, int size [, buffer reuse])
+// like memory.readbyterange(), but fills a buffer instead of creating a new string every call
+static int memory_readbuffer(lua_State *L)
+{
+	int range_start = luaL_checkinteger(L, 1);
+	int range_size = luaL_checkinteger(L, 2);
+	if(range_size < 0)
+		return 0;
+
+	LuaByteBuffer *buf = reusebytebuffer(L, 3, range_size);
+	for(int i = 0; i < range_size; i++)
+		buf->data[i] = GetMem((range_start + i) & 0xFFFF);
+	return 1;
+}
+
+// buffer ppu.readbuffer(int address, int size [, buffer reuse])
+static int ppu_readbuffer(lua_State *L)
+{
+	int range_start = luaL_checkinteger(L, 1);
+	int range_size = luaL_checkinteger(L, 2);
+	if(range_size < 0)
+		return 0;
+
+	LuaByteBuffer *buf = reusebytebuffer(L, 3, range_size);
+	for(int i = 0; i < range_size; i++)
+		buf->data[i] = FFCEUX_PPURead(range_start + i);
+	return 1;
+}
+
+// int buffer:get(int offset)
+// offsets are 0-based, like addresses. also reachable as buffer[offset]
+static int bytebuffer_get(lua_State *L)
+{
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	int offset = luaL_checkinteger(L, 2);
+	if(offset < 0 || (uint32)offset >= buf->size)
+		return 0;
+	lua_pushinteger(L, buf->data[offset]);
+	return 1;
+}
+
+// buffer:set(int offset, int value)
+static int bytebuffer_set(lua_State *L)
+{
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	int offset = luaL_checkinteger(L, 2);
+	if(offset < 0 || (uint32)offset >= buf->size)
+		luaL_error(L, "offset %d is outside of the buffer", offset);
+	buf->data[offset] = luaL_checkinteger(L, 3);
+	return 0;
+}
+
+static int bytebuffer_size(lua_State *L)
+{
+	lua_pushinteger(L, checkbytebuffer(L, 1)->size);
+	return 1;
+}
+
+// string buffer:tostring([int offset [, int size]])
+static int bytebuffer_tostring(lua_State *L)
+{
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	uint32 offset = std::min<uint32>(luaL_optinteger(L, 2, 0), buf->size);
+	uint32 size = std::min<uint32>(luaL_optinteger(L, 3, buf->size - offset), buf->size - offset);
+	lua_pushlstring(L, (const char*)buf->data + offset, size);
+	return 1;
+}
+
+// buffer:copy(buffer source)
+// copies as much of source as fits, so a snapshot can be kept without allocating
+static int bytebuffer_copy(lua_State *L)
+{
+	LuaByteBuffer *dst = checkbytebuffer(L, 1);
+	LuaByteBuffer *src = checkbytebuffer(L, 2);
+	memcpy(dst->data, src->data, std::min(dst->size, src->size));
+	return 0;
+}
+
+// int count, table offsets = buffer:diff(buffer other [, int maxresults])
+// compares two snapshots and returns how many bytes differ and the offsets where they do
+static int bytebuffer_diff(lua_State *L)
+{
+	LuaByteBuffer *a = checkbytebuffer(L, 1);
+	LuaByteBuffer *b = checkbytebuffer(L, 2);
+	int maxresults = luaL_optinteger(L, 3, INT_MAX);
+	uint32 size = std::min(a->size, b->size);
+
+	int count = 0;
+	lua_newtable(L);
+	for(uint32 i = 0; i < size; i++)
+	{
+		if(a->data[i] != b->data[i])
+		{
+			if(count < maxresults)
+			{
+				lua_pushinteger(L, i);
+				lua_rawseti(L, -2, count + 1);
+			}
+			count++;
+		}
+	}
+	lua_pushinteger(L, count);
+	lua_insert(L, -2);
+	return 2;
+}
+
+// int offset = buffer:find(string|buffer pattern [, int init])
+// returns the 0-based offset of the first match at or after init, or nil
+static int bytebuffer_find(lua_State *L)
+{
+	LuaByteBuffer *buf = checkbytebuffer(L, 1);
+	const uint8 *pattern;
+	size_t patternsize;
+	if(lua_type(L, 2) == LUA_TSTRING)
+		pattern = (const uint8*)lua_tolstring(L, 2, &patternsize);
+	else
+	{
+		LuaByteBuffer *p = checkbytebuffer(L, 2);
+		pattern = p->data;
+		patternsize = p->size;
+	}
+	int init = luaL_optinteger(L, 3, 0);
+	if(init < 0 || (uint32)init > buf->size)
+		return 0;
+
+	const uint8 *end = buf->data + buf->size;
+	const uint8 *begin = buf->data + init;
+	const uint8 *found = std::search(begin, end, pattern, pattern + patternsize);
+	if(found == end && patternsize)
+		return 0;
+	lua_pushinteger(L, found - buf->data);
+	return 1;
+}
+
+static int bytebuffer_index(lua_State *L)
+{
+	if(lua_type(L, 2) == LUA_TNUMBER)
+		return bytebuffer_get(L);
+	if(!luaL_getmetafield(L, 1, luaL_checkstring(L, 2)))
+		return 0;
+	return 1;
+}
+
+static int bytebuffer_newindex(lua_State *L)
+{
+	return bytebuffer_set(L);
+}
+
+static const struct luaL_reg bytebuffermeta [] = {
+	{"get", bytebuffer_get},
+	{"set", bytebuffer_set},
+	{"size", bytebuffer_size},
+	{"tostring", bytebuffer_tostring},
+	{"copy", bytebuffer_copy},
+	{"diff", bytebuffer_diff},
+	{"find", bytebuffer_find},
+	{"__index", bytebuffer_index},
+	{"__newindex", bytebuffer_newindex},
+	{"__len", bytebuffer_size},
+	{NULL,NULL}
+};
+
 static inline bool isalphaorunderscore(char c)
 {
 	return isalpha(c) || c == '_';
@@ -1911,6 +2140,83 @@ static int memory_setregister(lua_State *L)
 	return 0;
 }
 
+// memory.searchbegin([int size [, bool signed]])
+// starts a cheat search over RAM and WRAM, for values of 1 (the default), 2 or 4 bytes
+static int memory_searchbegin(lua_State *L)
+{
+	FCEUI_CheatSearchSetFormat(luaL_optinteger(L, 1, 1), lua_toboolean(L, 2) != 0);
+	FCEUI_CheatSearchBegin();
+	lua_pushinteger(L, FCEUI_CheatSearchGetCount());
+	return 1;
+}
+
+// int count = memory.searchfilter(string op, string compareto [, int value])
+// op is "==", "~=", "<", ">", "<=" or ">=". compareto is "value", "previous", "difference" (current - previous)
+// or "absdifference"; the values searched so far are kept where "current op compareto" holds
+static int memory_searchfilter(lua_State *L)
+{
+	static const char *ops [] = {"==", "~=", "<", ">", "<=", ">=", NULL};
+	static const char *operands [] = {"value", "previous", "difference", "absdifference", NULL};
+	int op = luaL_checkoption(L, 1, NULL, ops);
+	int operand = luaL_checkoption(L, 2, NULL, operands);
+	uint32 value = (uint32)luaL_optnumber(L, 3, 0);
+	FCEUI_CheatSearchFilter(op, operand, value);
+	lua_pushinteger(L, FCEUI_CheatSearchGetCount());
+	return 1;
+}
+
+// memory.searchsetprevious()
+// makes the current values the ones "previous" refers to
+static int memory_searchsetprevious(lua_State *L)
+{
+	FCEUI_CheatSearchSetCurrentAsOriginal();
+	return 0;
+}
+
+// bool memory.searchundo()
+// takes back the last memory.searchfilter()
+static int memory_searchundo(lua_State *L)
+{
+	lua_pushboolean(L, FCEUI_CheatSearchUndo());
+	return 1;
+}
+
+static int memory_searchcount(lua_State *L)
+{
+	lua_pushinteger(L, FCEUI_CheatSearchGetCount());
+	return 1;
+}
+
+static int memory_searchresultsCallB(uint32 a, uint32 last, uint32 current, void *data)
+{
+	lua_State *L = (lua_State *)data;
+	int size;
+	bool isSigned;
+	FCEUI_CheatSearchGetFormat(&size, &isSigned);
+	const int shift = 32 - size * 8;
+
+	lua_newtable(L);
+	lua_pushinteger(L, a);
+	lua_setfield(L, -2, "address");
+	lua_pushnumber(L, isSigned ? (lua_Number)((int32)(last << shift) >> shift) : (lua_Number)last);
+	lua_setfield(L, -2, "previous");
+	lua_pushnumber(L, isSigned ? (lua_Number)((int32)(current << shift) >> shift) : (lua_Number)current);
+	lua_setfield(L, -2, "current");
+	lua_rawseti(L, -2, lua_objlen(L, -2) + 1);
+	return 1;
+}
+
+// table memory.searchresults([int maxresults])
+// returns the values found, as tables with address, previous and current
+static int memory_searchresults(lua_State *L)
+{
+	int maxresults = luaL_optinteger(L, 1, INT_MAX);
+	lua_newtable(L);
+	if(maxresults > 0)
+		FCEUI_CheatSearchGetValues(0, maxresults - 1, memory_searchresultsCallB, L);
+	return 1;
+}
+
 // Forces a stack trace and returns the string
 static const char *CallLuaTraceback(lua_State *L) {
 	lua_getfield(L, LUA_GLOBALSINDEX, "debug");
@@ -1958,95 +2264,73 @@ void HandleCallbackError(lua_State* L)
 }
 
 
-// the purpose of this structure is to provide a way of
-// QUICKLY determining whether a memory address range has a hook associated with it,
+// the purpose of these bitmaps is to provide a way of
+// QUICKLY determining whether a memory address has a hook associated with it,
 // with a bias toward fast rejection because the majority of addresses will not be hooked.
 // (it must not use any part of Lua or perform any per-script operations,
 //  otherwise it would definitely be too slow.)
-// calculating the regions when a hook is added/removed may be slow,
+// rebuilding them when a hook is added/removed may be slow,
 // but this is an intentional tradeoff to obtain a high speed of checking during later execution
-struct TieredRegion
+uint32 luaMemHookBits[LUAMEMHOOK_COUNT][0x10000 >> 5];
+
+static INLINE bool IsMemHooked(unsigned int address, LuaMemHookType hookType)
 {
-	template<unsigned int maxGap>
-	struct Region
-	{
-		struct Island
-		{
-			unsigned int start;
-			unsigned int end;
-#ifdef NEED_MINGW_HACKS
-			bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-#else
-			__forceinline bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-#endif
-		};
-		std::vector<Island> islands;
+	return (luaMemHookBits[hookType][address >> 5] & (1u << (address & 31))) != 0;
+}
 
-		void Calculate(const std::vector<unsigned int>& bytes)
-		{
-			islands.clear();
+static DECLFR(LuaMemHookRead)
+{
+	uint8 value = FCEU_SpliceReadNext(SPLICE_LUA, A);
+	if(!fceuindbg && !memHookSuppress && IsMemHooked(A, LUAMEMHOOK_READ))
+		CallRegisteredLuaMemHook_LuaMatch(A, 1, value, LUAMEMHOOK_READ);
+	return value;
+}
+
+static DECLFW(LuaMemHookWrite)
+{
+	FCEU_SpliceWriteNext(SPLICE_LUA, A, V);
+	if(!fceuindbg && !memHookSuppress && IsMemHooked(A, LUAMEMHOOK_WRITE))
+		CallRegisteredLuaMemHook_LuaMatch(A, 1, V, LUAMEMHOOK_WRITE);
+}
+
+// routes every hooked address of the given type through the hook handler,
+// and takes it out of every address which is no longer hooked.
+// only the hooked addresses themselves are touched, so unhooked memory keeps its original handler.
+// the handler goes outermost, on top of any cheat or breakpoint on the same address (see FCEU_SpliceRead).
+static void SpliceMemHookHandlers(LuaMemHookType hookType)
+{
+	if(!GameInfo || (hookType != LUAMEMHOOK_READ && hookType != LUAMEMHOOK_WRITE))
+		return;
 
-			unsigned int lastEnd = ~0;
+	for(int page = 0; page < 0x100; page++)
+	{
+		bool hooked = false;
+		for(int i = 0; i < 8; i++)
+			hooked |= luaMemHookBits[hookType][(page << 3) + i] != 0;
+		if(!hooked && !FCEU_IsSplicePage(page))
+			continue;
 
-			std::vector<unsigned int>::const_iterator iter = bytes.begin();
-			std::vector<unsigned int>::const_iterator end = bytes.end();
-			for(; iter != end; ++iter)
+		for(int a = page << 8; a != (page + 1) << 8; a++)
+		{
+			if(hookType == LUAMEMHOOK_READ)
 			{
-				unsigned int addr = *iter;
-				if(addr < lastEnd || addr > lastEnd + (long long)maxGap)
-				{
-					islands.push_back(Island());
-					islands.back().start = addr;
-				}
-				islands.back().end = addr+1;
-				lastEnd = addr+1;
+				if(IsMemHooked(a, hookType) != FCEU_IsSplicedRead(SPLICE_LUA, a))
+					FCEU_SpliceRead(SPLICE_LUA, a, IsMemHooked(a, hookType) ? LuaMemHookRead : NULL);
 			}
-		}
-		bool Contains(unsigned int address, int size) const
-		{
-			for (size_t i = 0; i != islands.size(); ++i)
+			else if(hookType == LUAMEMHOOK_WRITE)
 			{
-				if (islands[i].Contains(address, size))
-					return true;
+				if(IsMemHooked(a, hookType) != FCEU_IsSplicedWrite(SPLICE_LUA, a))
+					FCEU_SpliceWrite(SPLICE_LUA, a, IsMemHooked(a, hookType) ? LuaMemHookWrite : NULL);
 			}
-			return false;
 		}
-	};
-
-	Region<0xFFFFFFFF> broad;
-	Region<0x1000> mid;
-	Region<0> narrow;
-
-	void Calculate(std::vector<unsigned int>& bytes)
-	{
-		std::sort(bytes.begin(), bytes.end());
-
-		broad.Calculate(bytes);
-		mid.Calculate(bytes);
-		narrow.Calculate(bytes);
 	}
+}
 
-	TieredRegion()
-	{
-		std::vector <unsigned int> temp;
-		Calculate(temp);
-	}
-
-	__forceinline int NotEmpty()
-	{
-		return broad.islands.size();
-	}
-
-	// note: it is illegal to call this if NotEmpty() returns 0
-	__forceinline bool Contains(unsigned int address, int size)
-	{
-		return broad.islands[0].Contains(address,size) &&
-		       mid.Contains(address,size) &&
-			   narrow.Contains(address,size);
-	}
-};
-TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
-
+void FCEU_LuaRebuildMemHooks()
+{
+	SpliceMemHookHandlers(LUAMEMHOOK_READ);
+	SpliceMemHookHandlers(LUAMEMHOOK_WRITE);
+}
 
 static void CalculateMemHookRegions(LuaMemHookType hookType)
 {
@@ -2078,10 +2362,16 @@ static void CalculateMemHookRegions(LuaMemHookType hookType)
 		}
 //		++iter;
 //	}
-	hookedRegions[hookType].Calculate(hookedBytes);
+	memset(luaMemHookBits[hookType], 0, sizeof(luaMemHookBits[hookType]));
+	for(size_t i = 0; i != hookedBytes.size(); i++)
+	{
+		if(hookedBytes[i] < 0x10000)
+			luaMemHookBits[hookType][hookedBytes[i] >> 5] |= 1u << (hookedBytes[i] & 31);
+	}
+	SpliceMemHookHandlers(hookType);
 }
 
-static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
+void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
 {
 //	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
 //	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
@@ -2132,22 +2422,6 @@ static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, un
 //		++iter;
 //	}
 }
-void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
-{
-	// performance critical! (called VERY frequently)
-	// I suggest timing a large number of calls to this function in Release if you change anything in here,
-	// before and after, because even the most innocent change can make it become 30% to 400% slower.
-	// a good amount to test is: 100000000 calls with no hook set, and another 100000000 with a hook set.
-	// (on my system that consistently took 200 ms total in the former case and 350 ms total in the latter case)
-	if(hookedRegions[hookType].NotEmpty())
-	{
-		//if((hookType <= LUAMEMHOOK_EXEC) && (address >= 0xE00000))
-		//	address |= 0xFF0000; // account for mirroring of RAM
-		if(hookedRegions[hookType].Contains(address, size))
-			CallRegisteredLuaMemHook_LuaMatch(address, size, value, hookType); // something has hooked this specific address
-	}
-}
-
 void CallRegisteredLuaFunctions(LuaCallID calltype)
 {
 	assert((unsigned int)calltype < (unsigned int)LUACALL_COUNT);
@@ -3777,6 +4051,39 @@ static int emu_getscreenpixel(lua_State *L) {
 
 }
 
+// buffer, int width, int height = emu.getscreenbuffer([int step [, bool getemuscreen [, buffer reuse]]])
+// Fills a buffer with the palette index of every pixel of the 256x240 screen, row by row.
+// With a step above 1 the screen is downsampled by taking every step-th pixel of every step-th line.
+static int emu_getscreenbuffer(lua_State *L) {
+
+	int step = luaL_optinteger(L, 1, 1);
+	bool getemuscreen = (lua_toboolean(L,2) == 1);
+	if (step < 1)
+		luaL_error(L, "step must be at least 1");
+
+	int width = (256 + step - 1) / step;
+	int height = (240 + step - 1) / step;
+	LuaByteBuffer *buf = reusebytebuffer(L, 3, width * height);
+
+	uint8* scrBuf = getemuscreen ? XBackBuf : XBuf;
+	if (!scrBuf)
+		memset(buf->data, 0, width * height);
+	else
+	{
+		uint8 *dst = buf->data;
+		for (int y = 0; y < 240; y += step)
+		{
+			const uint8 *src = scrBuf + y * 256;
+			for (int x = 0; x < 256; x += step)
+				*dst++ = src[x] & 0x3f;
+		}
+	}
+
+	lua_pushinteger(L, width);
+	lua_pushinteger(L, height);
+	return 3;
+}
+
 // gui.line(x1,y1,x2,y2,color,skipFirst)
 static int gui_line(lua_State *L) {
 
@@ -3893,6 +4200,23 @@ static int gui_savescreenshot(lua_State *L) {
 	return 1;
 }
 
+// gui.dumpframes(first [, last])
+//
+// Writes the frames first to last (as counted by emu.framecount()) to PNG files in the snapshot
+// directory as they are emulated, without messages or Lua drawings. The files are encoded in the
+// background. Without arguments, stops dumping.
+static int gui_dumpframes(lua_State *L) {
+	if (lua_isnoneornil(L,1))
+	{
+		FCEUI_EndFrameDump();
+		return 0;
+	}
+	int first = luaL_checkinteger(L,1);
+	int last = luaL_optinteger(L,2,first);
+	FCEUI_DumpFrames(first, last);
+	return 0;
+}
+
 // gui.gdscreenshot(getemuscreen)
 //
 //  Returns a screen shot as a string in gd's v1 file format.
@@ -4797,6 +5121,24 @@ static int debugger_resetinstructionscount(lua_State *L)
 	return 0;
 }
 
+// int code, int data = debugger.getcdlogbank(int bank)
+// how many bytes of a 16KB PRG bank the code/data logger has seen used as code and as data,
+// or nil past the last bank
+static int debugger_getcdlogbank(lua_State *L)
+{
+	int bank = luaL_checkinteger(L, 1);
+	if (bank < 0 || bank >= FCEUI_CDLogBankCount())
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+	uint32 code, data;
+	FCEUI_CDLogGetBank(bank, &code, &data);
+	lua_pushinteger(L, code);
+	lua_pushinteger(L, data);
+	return 2;
+}
+
 // TAS Editor functions library
 
 // bool taseditor.registerauto()
@@ -5685,6 +6027,23 @@ static void FCEU_LuaHookFunction(lua_State *L, lua_Debug *dbg) {
 
 }
 
+// LuaJIT only checks debug hooks in the interpreter, never inside compiled traces,
+// so a runaway loop could not be interrupted by the exec_count/exec_time hooks.
+// the compiler is switched off (which also flushes existing traces) for the duration of the limited call.
+static void BeginHookLimitedCall(lua_State *L)
+{
+#ifdef _LUAJIT
+	luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE|LUAJIT_MODE_OFF);
+#endif
+}
+
+static void EndHookLimitedCall(lua_State *L)
+{
+#ifdef _LUAJIT
+	luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE|LUAJIT_MODE_ON);
+#endif
+}
+
 static void emu_exec_count_hook(lua_State *L, lua_Debug *dbg) {
 	luaL_error(L, "exec_count timeout");
 }
@@ -5692,9 +6051,11 @@ static void emu_exec_count_hook(lua_State *L, lua_Debug *dbg) {
 static int emu_exec_count(lua_State *L) {
 	int count = (int)luaL_checkinteger(L,1);
 	lua_pushvalue(L, 2);
+	BeginHookLimitedCall(L);
 	lua_sethook(L, emu_exec_count_hook, LUA_MASKCOUNT, count);
 	int ret = lua_pcall(L, 0, 0, 0);
 	lua_sethook(L, NULL, 0, 0);
+	EndHookLimitedCall(L);
 	lua_settop(L,0);
 	lua_pushinteger(L, ret);
 	return 1;
@@ -5726,6 +6087,7 @@ static int emu_exec_time(lua_State *L)
 	readyEvent = CreateEvent(0,true,false,0);
 	goEvent = CreateEvent(0,true,false,0);
 	DWORD threadid;
+	BeginHookLimitedCall(L);
 	HANDLE thread = CreateThread(0,0,emu_exec_time_proc,(LPVOID)L,0,&threadid);
 	SetThreadAffinityMask(thread,1);
 	//wait for the lua thread to start
@@ -5744,6 +6106,7 @@ static int emu_exec_time(lua_State *L)
 
 	//clear the lua thread-killer
 	lua_sethook(L, NULL, 0, 0);
+	EndHookLimitedCall(L);
 
 	CloseHandle(readyEvent);
 	CloseHandle(goEvent);
@@ -5781,6 +6144,7 @@ static const struct luaL_reg emulib [] = {
 	{"addgamegenie", emu_addgamegenie},
 	{"delgamegenie", emu_delgamegenie},
 	{"getscreenpixel", emu_getscreenpixel},
+	{"getscreenbuffer", emu_getscreenbuffer},
 	{"readonly", movie_getreadonly},
 	{"setreadonly", movie_setreadonly},
 	{"getdir", emu_getdir},
@@ -5806,6 +6170,8 @@ static const struct luaL_reg memorylib [] = {
 
 	{"readbyte", memory_readbyte},
 	{"readbyterange", memory_readbyterange},
+	{"readbuffer", memory_readbuffer},
+	{"newbuffer", memory_newbuffer},
 	{"readbytesigned", memory_readbytesigned},
 	{"readbyteunsigned", memory_readbyte},	// alternate naming scheme for unsigned
 	{"readword", memory_readword},
@@ -5816,6 +6182,14 @@ static const struct luaL_reg memorylib [] = {
 	{"getregister", memory_getregister},
 	{"setregister", memory_setregister},
 
+	// cheat search
+	{"searchbegin", memory_searchbegin},
+	{"searchfilter", memory_searchfilter},
+	{"searchsetprevious", memory_searchsetprevious},
+	{"searchundo", memory_searchundo},
+	{"searchcount", memory_searchcount},
+	{"searchresults", memory_searchresults},
+
 	// memory hooks
 	{"registerwrite", memory_registerwrite},
 	//{"registerread", memory_registerread}, TODO
@@ -5832,6 +6206,7 @@ static const struct luaL_reg memorylib [] = {
 static const struct luaL_reg ppulib [] = {
 	{"readbyte", ppu_readbyte},
 	{"readbyterange", ppu_readbyterange},
+	{"readbuffer", ppu_readbuffer},
 
 	{NULL,NULL}
 };
@@ -5927,6 +6302,7 @@ static const struct luaL_reg guilib[] = {
 
 	{"savescreenshot",   gui_savescreenshot},
 	{"savescreenshotas", gui_savescreenshotas},
+	{"dumpframes",       gui_dumpframes},
 	{"gdscreenshot", gui_gdscreenshot},
 	{"gdoverlay", gui_gdoverlay},
 	{"opacity", gui_setopacity},
@@ -5962,6 +6338,7 @@ static const struct luaL_reg debuggerlib[] = {
 	{"getinstructionscount", debugger_getinstructionscount},
 	{"resetcyclescount", debugger_resetcyclescount},
 	{"resetinstructionscount", debugger_resetinstructionscount},
+	{"getcdlogbank", debugger_getcdlogbank},
 	{NULL,NULL}
 };
 
@@ -6140,6 +6517,10 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg) {
 		luaL_dostring(L, "package.preload[\"mime.core\"] = _G.tmp");
 		#endif
 
+		luaL_newmetatable(L, LUA_BYTEBUFFER_META);
+		luaL_register(L, NULL, bytebuffermeta);
+		lua_pop(L, 1);
+
 		luaL_register(L, "emu", emulib); // added for better cross-emulator compatibility
 		luaL_register(L, "FCEU", emulib); // kept for backward compatibility
 		luaL_register(L, "memory", memorylib);
@@ -6156,7 +6537,9 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg) {
 		luaL_register(L, "debugger", debuggerlib);
 		luaL_register(L, "cdlog", cdloglib);
 		luaL_register(L, "taseditor", taseditorlib);
+#ifndef _LUAJIT
 		luaL_register(L, "bit", bit_funcs); // LuaBitOp library
+#endif
 		lua_settop(L, 0);
 
 		// register a few utility functions outside of libraries (in the global namespace)
@@ -6168,9 +6551,22 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg) {
 		lua_register(L, "copytable", copytable);
 
 		// old bit operation functions
+#ifdef _LUAJIT
+		// LuaJIT has LuaBitOp built in as "bit", and the JIT compiles its functions inline,
+		// which it can't do for the ported C versions
+		lua_getglobal(L, "bit");
+		lua_getfield(L, -1, "band");
+		lua_setglobal(L, "AND");
+		lua_getfield(L, -1, "bor");
+		lua_setglobal(L, "OR");
+		lua_getfield(L, -1, "bxor");
+		lua_setglobal(L, "XOR");
+		lua_pop(L, 1);
+#else
 		lua_register(L, "AND", bit_band);
 		lua_register(L, "OR", bit_bor);
 		lua_register(L, "XOR", bit_bxor);
+#endif
 		lua_register(L, "SHIFT", bit_bshift_emulua);
 		lua_register(L, "BIT", bitbit);
 
@@ -6184,7 +6580,9 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg) {
 			lua_setglobal(L, "arg");
 		}
 
+#ifndef _LUAJIT
 		luabitop_validate(L);
+#endif
 
 		// push arrays for storing hook functions in
 		for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
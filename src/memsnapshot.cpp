@@ -0,0 +1,123 @@
+/// \file
+/// \brief Per-frame copy of the CPU address space for the memory tools
+///
+/// The RAM watch and hex editor used to read every byte they show through GetMem() on a timer,
+/// whether or not anything changed. Instead, the pages they watch are copied here once per frame,
+/// between frames, and each page remembers the serial of the last publish that changed it.
+
+#include "types.h"
+#include "fceu.h"
+#include "cart.h"
+#include "debug.h"
+#include "memsnapshot.h"
+
+#include <cstring>
+
+#define MEMSNAPSHOT_WATCH_FRAMES 60 //how long a page is kept up to date after a tool last asked for it
+
+static uint8 snapshot[0x10000];
+static uint32 pageSerial[MEMSNAPSHOT_PAGES];    //serial of the last publish that changed the page
+static uint32 watchedUntil[MEMSNAPSHOT_PAGES];  //frame after which nobody is interested in the page anymore
+static uint32 serial = 0;
+static uint32 frames = 1;
+
+//whether every byte of the page is read by the given handler
+static bool PlainPage(uint32 A, readfunc handler)
+{
+	for (int i = 0; i < MEMSNAPSHOT_PAGE_SIZE; i++)
+		if (ARead[A + i] != handler)
+			return false;
+	return true;
+}
+
+//pages of plain RAM or ROM, the common case, are copied directly
+void FCEU_MemReadPage(int page, uint8 *dst)
+{
+	const uint32 A = page << MEMSNAPSHOT_PAGE_SHIFT;
+	if (A < 0x800 && PlainPage(A, ARAML))
+		memcpy(dst, RAM + A, MEMSNAPSHOT_PAGE_SIZE);
+	else if (A >= 0x800 && A < 0x2000 && PlainPage(A, ARAMH))
+		memcpy(dst, RAM + (A & 0x7FF), MEMSNAPSHOT_PAGE_SIZE);
+	else if (A >= 0x5000 && Page[A >> 11] && PlainPage(A, CartBR))
+		memcpy(dst, Page[A >> 11] + A, MEMSNAPSHOT_PAGE_SIZE);
+	else
+		for (int i = 0; i < MEMSNAPSHOT_PAGE_SIZE; i++)
+			dst[i] = GetMem(A + i);
+}
+
+void FCEU_MemSnapshotFrame()
+{
+	uint8 buf[MEMSNAPSHOT_PAGE_SIZE];
+	bool changed = false;
+
+	frames++;
+	for (int page = 0; page < MEMSNAPSHOT_PAGES; page++)
+	{
+		if (watchedUntil[page] < frames)
+			continue;
+		uint8 *dst = snapshot + (page << MEMSNAPSHOT_PAGE_SHIFT);
+		FCEU_MemReadPage(page, buf);
+		if (!memcmp(buf, dst, MEMSNAPSHOT_PAGE_SIZE))
+			continue;
+		if (!changed)
+		{
+			serial++;
+			changed = true;
+		}
+		memcpy(dst, buf, MEMSNAPSHOT_PAGE_SIZE);
+		pageSerial[page] = serial;
+	}
+}
+
+void FCEU_MemSnapshotReset()
+{
+	memset(watchedUntil, 0, sizeof(watchedUntil));
+}
+
+void FCEUI_MemSnapshotWatch(uint16 first, uint16 last)
+{
+	if (!GameInfo)
+		return;
+
+	//pages nobody watched are stale, they are brought up to date right away
+	bool filled = false;
+	for (int page = first >> MEMSNAPSHOT_PAGE_SHIFT; page <= (last >> MEMSNAPSHOT_PAGE_SHIFT); page++)
+	{
+		if (watchedUntil[page] < frames)
+		{
+			if (!filled)
+			{
+				serial++;
+				filled = true;
+			}
+			FCEU_MemReadPage(page, snapshot + (page << MEMSNAPSHOT_PAGE_SHIFT));
+			pageSerial[page] = serial;
+		}
+		watchedUntil[page] = frames + MEMSNAPSHOT_WATCH_FRAMES;
+	}
+}
+
+const uint8 *FCEUI_MemSnapshotData()
+{
+	return snapshot;
+}
+
+uint32 FCEUI_MemSnapshotSerial()
+{
+	return serial;
+}
+
+bool FCEUI_MemSnapshotGetDirty(uint32 since, uint8 *dirty)
+{
+	bool any = false;
+	memset(dirty, 0, MEMSNAPSHOT_PAGES / 8);
+	for (int page = 0; page < MEMSNAPSHOT_PAGES; page++)
+	{
+		if (pageSerial[page] > since)
+		{
+			dirty[page >> 3] |= 1 << (page & 7);
+			any = true;
+		}
+	}
+	return any;
+}
@@ -0,0 +1,30 @@
+#ifndef _MEMSNAPSHOT_H_
+#define _MEMSNAPSHOT_H_
+
+#include "types.h"
+
+//A copy of the CPU address space for the memory tools, published once per frame along with which
+//pages changed, so that a tool can update just the rows or cells that did instead of reading back
+//everything it shows on each refresh. Only the pages some tool asked for lately are kept up to date.
+
+#define MEMSNAPSHOT_PAGE_SHIFT 8
+#define MEMSNAPSHOT_PAGE_SIZE (1 << MEMSNAPSHOT_PAGE_SHIFT)
+#define MEMSNAPSHOT_PAGES (0x10000 >> MEMSNAPSHOT_PAGE_SHIFT)
+
+//called once per frame
+void FCEU_MemSnapshotFrame();
+//called when the game is closed
+void FCEU_MemSnapshotReset();
+//reads a page of the CPU address space the way GetMem() does
+void FCEU_MemReadPage(int page, uint8 *dst);
+
+//keeps first..last up to date for the next second or so of emulation; tools call it on every refresh
+void FCEUI_MemSnapshotWatch(uint16 first, uint16 last);
+const uint8 *FCEUI_MemSnapshotData();
+//goes up whenever something in the snapshot changes
+uint32 FCEUI_MemSnapshotSerial();
+//sets the bits of the pages that changed after the given serial, in a bitmap of MEMSNAPSHOT_PAGES bits.
+//returns whether there were any
+bool FCEUI_MemSnapshotGetDirty(uint32 since, uint8 *dirty);
+
+#endif
@@ -487,6 +487,30 @@ static void CalculatePalette(void)
 	WritePalette();
 }
 
+//the colors of every pixel value under every deemphasis, as 0x00RRGGBB, for the pictures written
+//out of the core. like the blitters, the whole value is looked up without deemphasis, since the
+//GUI and lua draw with the other entries, and only the NES color with it
+void FCEU_GetRGBPalette(uint32 *dest)
+{
+	for(int x=0;x<256;x++)
+	{
+		uint8 r,g,b;
+		FCEUD_GetPalette(x,&r,&g,&b);
+		dest[x]=(r<<16)|(g<<8)|b;
+	}
+	for(int deemph=1;deemph<8;deemph++)
+		for(int x=0;x<256;x++)
+		{
+			if(palo)
+			{
+				const pal &c=palo[(deemph<<6)|(x&0x3F)];
+				dest[(deemph<<8)|x]=(c.r<<16)|(c.g<<8)|c.b;
+			}
+			else
+				dest[(deemph<<8)|x]=dest[x];
+		}
+}
+
 void FCEU_ResetPalette(void)
 {
 	if(GameInfo)
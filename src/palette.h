@@ -4,6 +4,7 @@ typedef struct {
 
 extern pal *palo;
 void FCEU_ResetPalette(void);
+void FCEU_GetRGBPalette(uint32 *dest);
 
 void FCEU_ResetPalette(void);
 void FCEU_ResetMessages();
@@ -0,0 +1,301 @@
+/// \file
+/// \brief Screenshots and frame dumps encoded to PNG by a pool of threads
+///
+/// The queue holds the pictures in the order they were queued. A thread takes the first picture
+/// nobody encodes yet, compresses it without the lock, and then writes out the pictures at the
+/// front of the queue that are done, so the files are written in order while the encoding of
+/// the next ones goes on. A picture is its palette indices, its deemphasis bits and its colors
+/// under each deemphasis: the file is an indexed PNG of the (up to 256) colors it uses, or RGB when it uses more.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "file.h"
+#include "movie.h"
+#include "video.h"
+#include "palette.h"
+#include "utils/crc32.h"
+#include "pngdump.h"
+
+#include <zlib.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#define PNGDUMP_MAX_THREADS 4
+#define PNGDUMP_PICTURES_PER_THREAD 2
+
+struct PngPicture
+{
+	std::string fn;
+	int lines;
+	std::vector<uint8> frame;   //256*lines indices, 256*lines deemphasis bits, 2048 colors, 0x00RRGGBB
+	std::vector<uint8> png;
+	bool taken, done, ok;
+};
+
+static std::mutex dumpMutex;
+static std::condition_variable dumpWake, dumpSpace;
+static std::deque<PngPicture*> dumpQueue;     //guarded by dumpMutex, as are the others
+static std::vector<PngPicture*> dumpFree;
+static bool dumpWriting = false, dumpStop = false, dumpFailed = false;
+static std::string dumpFailedFn;
+static std::vector<std::thread> dumpThreads;
+
+static int frameDumpFirst = 0, frameDumpLast = -1;
+static int frameDumpLastDone = -1;
+
+static void PutChunk(std::vector<uint8> &png, const char *type, const uint8 *data, uint32 size)
+{
+	const uint8 head[8] = { (uint8)(size >> 24), (uint8)(size >> 16), (uint8)(size >> 8), (uint8)size,
+		(uint8)type[0], (uint8)type[1], (uint8)type[2], (uint8)type[3] };
+	png.insert(png.end(), head, head + 8);
+	png.insert(png.end(), data, data + size);
+	uint32 crc = CalcCRC32(0, (uint8 *)type, 4);
+	if (size)
+		crc = CalcCRC32(crc, (uint8 *)data, size);
+	const uint8 tail[4] = { (uint8)(crc >> 24), (uint8)(crc >> 16), (uint8)(crc >> 8), (uint8)crc };
+	png.insert(png.end(), tail, tail + 4);
+}
+
+static bool EncodePng(PngPicture &p)
+{
+	const int pixels = 256 * p.lines;
+	const uint8 *index = &p.frame[0], *deemph = index + pixels;
+	const uint32 *colors = (const uint32 *)(deemph + pixels);
+
+	//the colors the picture uses, in the order they come
+	int16 slot[2048];
+	uint8 plte[256 * 3];
+	int used = 0;
+	memset(slot, -1, sizeof(slot));
+	for (int i = 0; i < pixels && used <= 256; i++)
+	{
+		const int c = (deemph[i] & 7) << 8 | index[i];
+		if (slot[c] < 0)
+		{
+			if (used < 256)
+			{
+				plte[used * 3 + 0] = colors[c] >> 16;
+				plte[used * 3 + 1] = colors[c] >> 8;
+				plte[used * 3 + 2] = colors[c];
+			}
+			slot[c] = used++;
+		}
+	}
+	const bool indexed = used <= 256;
+	const int rowbytes = indexed ? 256 : 256 * 3;
+
+	std::vector<uint8> raw((rowbytes + 1) * p.lines);
+	uint8 *dest = &raw[0];
+	for (int y = 0, i = 0; y < p.lines; y++)
+	{
+		*dest++ = 0;   //no filter
+		for (int x = 0; x < 256; x++, i++)
+		{
+			const int c = (deemph[i] & 7) << 8 | index[i];
+			if (indexed)
+				*dest++ = slot[c];
+			else
+			{
+				*dest++ = colors[c] >> 16;
+				*dest++ = colors[c] >> 8;
+				*dest++ = colors[c];
+			}
+		}
+	}
+
+	uLongf compsize = compressBound(raw.size());
+	std::vector<uint8> comp(compsize);
+	if (compress(&comp[0], &compsize, &raw[0], raw.size()) != Z_OK)
+		return false;
+
+	static const uint8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	const uint8 ihdr[13] = { 0, 0, 1, 0, 0, 0, (uint8)(p.lines >> 8), (uint8)p.lines,
+		8,                    //bit depth
+		(uint8)(indexed ? 3 : 2), //color type: indexed or RGB
+		0, 0, 0 };            //deflate, adaptive filters (none used), no interlace
+	p.png.assign(signature, signature + 8);
+	PutChunk(p.png, "IHDR", ihdr, 13);
+	if (indexed)
+		PutChunk(p.png, "PLTE", plte, used * 3);
+	PutChunk(p.png, "IDAT", &comp[0], compsize);
+	PutChunk(p.png, "IEND", NULL, 0);
+	return true;
+}
+
+static bool WritePng(const PngPicture &p)
+{
+	FILE *fp = FCEUD_UTF8fopen(p.fn, "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(&p.png[0], 1, p.png.size(), fp) == p.png.size();
+	return fclose(fp) == 0 && ok;
+}
+
+//writes the pictures at the front of the queue that are done, if no other thread is at it
+static void WriteDone(std::unique_lock<std::mutex> &lock)
+{
+	if (dumpWriting)
+		return;
+	dumpWriting = true;
+	while (!dumpQueue.empty() && dumpQueue.front()->done)
+	{
+		PngPicture *p = dumpQueue.front();
+		lock.unlock();
+		bool ok = p->ok && WritePng(*p);
+		lock.lock();
+		if (!ok && !dumpFailed)
+		{
+			dumpFailed = true;
+			dumpFailedFn = p->fn;
+		}
+		dumpQueue.pop_front();
+		dumpFree.push_back(p);
+		dumpSpace.notify_all();
+	}
+	dumpWriting = false;
+}
+
+static void DumpThreadProc()
+{
+	std::unique_lock<std::mutex> lock(dumpMutex);
+	for (;;)
+	{
+		PngPicture *p = NULL;
+		for (size_t i = 0; i < dumpQueue.size() && !p; i++)
+			if (!dumpQueue[i]->taken)
+				p = dumpQueue[i];
+		if (!p)
+		{
+			if (dumpStop)
+				return;
+			dumpWake.wait(lock);
+			continue;
+		}
+		p->taken = true;
+		lock.unlock();
+		p->ok = EncodePng(*p);
+		lock.lock();
+		p->done = true;
+		WriteDone(lock);
+	}
+}
+
+static void StartThreads()
+{
+	dumpStop = false;
+	int threads = std::min<int>(PNGDUMP_MAX_THREADS, std::max(1u, std::thread::hardware_concurrency()));
+	for (int i = 0; i < threads; i++)
+		dumpThreads.push_back(std::thread(DumpThreadProc));
+}
+
+void FCEU_PngDumpQueue(const std::string &fn)
+{
+	if (dumpThreads.empty())
+		StartThreads();
+
+	std::unique_lock<std::mutex> lock(dumpMutex);
+	while (dumpQueue.size() >= dumpThreads.size() * PNGDUMP_PICTURES_PER_THREAD)
+		dumpSpace.wait(lock);
+	PngPicture *p;
+	if (dumpFree.empty())
+		p = new PngPicture;
+	else
+	{
+		p = dumpFree.back();
+		dumpFree.pop_back();
+	}
+	lock.unlock();
+
+	p->fn = fn;
+	p->lines = FSettings.LastSLine - FSettings.FirstSLine + 1;
+	p->frame.resize(256 * p->lines * 2 + 2048 * 4);
+	const int pixels = 256 * p->lines;
+	memcpy(&p->frame[0], XBuf + FSettings.FirstSLine * 256, pixels);
+	memcpy(&p->frame[pixels], XDBuf + FSettings.FirstSLine * 256, pixels);
+	FCEU_GetRGBPalette((uint32 *)&p->frame[pixels * 2]);
+	p->taken = p->done = p->ok = false;
+
+	lock.lock();
+	dumpQueue.push_back(p);
+	dumpWake.notify_one();
+}
+
+bool FCEU_PngDumpFlush()
+{
+	std::unique_lock<std::mutex> lock(dumpMutex);
+	while (!dumpQueue.empty())
+		dumpSpace.wait(lock);
+	bool ok = !dumpFailed;
+	dumpFailed = false;
+	return ok;
+}
+
+void FCEU_PngDumpKill()
+{
+	if (dumpThreads.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(dumpMutex);
+		dumpStop = true;
+		dumpWake.notify_all();
+	}
+	//the threads encode and write everything queued before they stop
+	for (size_t i = 0; i < dumpThreads.size(); i++)
+		dumpThreads[i].join();
+	dumpThreads.clear();
+	for (size_t i = 0; i < dumpFree.size(); i++)
+		delete dumpFree[i];
+	dumpFree.clear();
+}
+
+void FCEUI_DumpFrames(int first, int last)
+{
+	frameDumpFirst = first;
+	frameDumpLast = last;
+	frameDumpLastDone = -1;
+}
+
+void FCEUI_EndFrameDump()
+{
+	FCEUI_DumpFrames(0, -1);
+}
+
+bool FCEU_FrameDumpWanted()
+{
+	const int frame = FCEUMOV_GetFrame();
+	return frame >= frameDumpFirst && frame <= frameDumpLast;
+}
+
+void FCEU_FrameDumpPicture()
+{
+	const int frame = FCEUMOV_GetFrame();
+	//a paused game draws the same frame again
+	if (frame >= frameDumpFirst && frame <= frameDumpLast && frame != frameDumpLastDone)
+	{
+		FCEU_PngDumpQueue(FCEU_MakeFName(FCEUMKF_FRAMEDUMP, frame, "png"));
+		frameDumpLastDone = frame;
+		if (frame == frameDumpLast)
+		{
+			FCEU_DispMessage("Frames %d to %d dumped.", 0, frameDumpFirst, frameDumpLast);
+			FCEUI_EndFrameDump();
+		}
+	}
+
+	std::string failed;
+	{
+		std::lock_guard<std::mutex> lock(dumpMutex);
+		if (dumpFailed)
+			failed = dumpFailedFn;
+		dumpFailed = false;
+	}
+	if (!failed.empty())
+		FCEU_DispMessage("Error saving %s.", 0, failed.c_str());
+}
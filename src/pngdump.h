@@ -0,0 +1,26 @@
+#ifndef _PNGDUMP_H_
+#define _PNGDUMP_H_
+
+#include <string>
+
+//Screenshots and frame dumps. The emulation thread only copies the palette indices of the picture;
+//a pool of threads encodes the PNG files and writes them in the order they were queued. A few
+//pictures per thread may wait to be encoded; queueing more waits for the threads.
+
+//queues the picture in XBuf to be written to fn
+void FCEU_PngDumpQueue(const std::string &fn);
+//waits until everything queued is written; false when a file couldn't be written since the last call
+bool FCEU_PngDumpFlush();
+//writes out what is queued and stops the threads
+void FCEU_PngDumpKill();
+
+//dumps the frames first to last (as counted by the movie frame counter) as they are emulated, to
+//<snaps>/<game>-frame<N>.png. the pictures are those of the game, without messages or lua drawings
+void FCEUI_DumpFrames(int first, int last);
+void FCEUI_EndFrameDump();
+//whether the frame being emulated is dumped, so it has to be drawn
+bool FCEU_FrameDumpWanted();
+//called with each drawn picture: dumps it if it's in the range, and reports the files that failed
+void FCEU_FrameDumpPicture();
+
+#endif
@@ -0,0 +1,398 @@
+/// \file
+/// \brief Reverse execution for the debugger
+///
+/// Emulation is deterministic given the state at the start of a frame and the input of that frame,
+/// so the way back to any earlier instruction is to load the nearest snapshot before it and replay.
+/// Instructions are identified by total_instructions. Breaks happen in the middle of a frame, deep
+/// inside the CPU core, where a state can't be swapped out; so a request only marks the rest of the
+/// frame to be thrown away, and the work is done at the start of the next frame, from where the
+/// target frame is replayed and the debugger stops when the target instruction comes up.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "x6502.h"
+#include "debug.h"
+#include "movie.h"
+#include "input.h"
+#include "netplay.h"
+#include "state.h"
+#include "emufile.h"
+#include "reversedebug.h"
+
+#include "zlib.h"
+
+#include <deque>
+#include <vector>
+#include <cstring>
+
+#define REVERSE_MAX_INTERVAL 8  //frames between snapshots when the memory budget is tight
+
+extern uint8 joy[4];
+
+int reverseMode = REVERSE_OFF;
+uint64 reverseTarget = 0;
+int reverseTargetBreak = BREAK_TYPE_STEP;
+
+struct ReverseFrame
+{
+	uint64 instructions;            //total_instructions when the frame started
+	int frameCounter;               //currFrameCounter during the frame
+	uint8 joy[4];                   //the input the frame was emulated with
+	int skip;                       //the frame skip it was emulated with; a skipped frame fakes the sprite 0 hit
+	MovieRecord input;              //the same, as the port devices log it for movies; this holds the zappers
+	std::vector<uint8> savestate;   //snapshot taken at the start of the frame; empty for most frames once the budget is reached
+};
+
+struct ReverseScanEntry
+{
+	uint64 instruction;
+	uint8 opcode;
+	uint8 s;
+	int breakHit;                   //breakpoint that would have stopped here, or -1
+};
+
+static bool reverseDebugging = false;
+static size_t historyBudget = 64 << 20;
+static std::deque<ReverseFrame> history;
+static uint32 historyBase = 0;      //number of history.front(), counted from when the history was started
+static int currentFrame = -1;       //index of the frame being emulated
+static size_t historyBytes = 0;
+static int snapshotInterval = 1;
+static bool loadingSnapshot = false;
+
+static int pendingOp = REVERSE_OP_NONE;
+static uint64 pendingFrom;
+static uint8 pendingS;
+
+static std::vector<ReverseScanEntry> scanEntries;
+static uint64 scanEnd;
+
+static size_t FrameBytes(const ReverseFrame &frame)
+{
+	return sizeof(ReverseFrame) + frame.savestate.size();
+}
+
+static void DropSnapshot(ReverseFrame &frame)
+{
+	historyBytes -= frame.savestate.size();
+	std::vector<uint8>().swap(frame.savestate);
+}
+
+//removes the oldest snapshot, with the frames that can't be replayed without it
+static void DropOldest()
+{
+	do
+	{
+		historyBytes -= FrameBytes(history.front());
+		history.pop_front();
+		historyBase++;
+		currentFrame--;
+	} while (!history.empty() && history.front().savestate.empty());
+}
+
+static void EnforceBudget()
+{
+	while (historyBytes > historyBudget && history.size() > 1)
+	{
+		if (snapshotInterval < REVERSE_MAX_INTERVAL)
+		{
+			//keep every other snapshot; the first one stays, nothing before it could be replayed otherwise
+			snapshotInterval *= 2;
+			for (size_t i = 1; i < history.size(); i++)
+				if ((historyBase + i) % snapshotInterval)
+					DropSnapshot(history[i]);
+		} else
+			DropOldest();
+	}
+}
+
+void FCEU_ReverseClear()
+{
+	history.clear();
+	historyBase = 0;
+	historyBytes = 0;
+	currentFrame = -1;
+	snapshotInterval = 1;
+	pendingOp = REVERSE_OP_NONE;
+	if (reverseMode != REVERSE_OFF)
+		reverseMode = REVERSE_DISCARD; //anything under way is abandoned at the next frame boundary
+}
+
+void FCEU_ReverseStateLoaded()
+{
+	//the recorded frames don't lead to a state loaded from elsewhere
+	if (!loadingSnapshot)
+		FCEU_ReverseClear();
+}
+
+//whether all of the frame's input ends up in a ReverseFrame. gamepads are in joy (the Famicom's
+//four player adapter reads pads 3 and 4 from there too), and zappers log their state like for movies;
+//the other devices keep theirs to themselves, like they do from movies, so the frames can't be replayed.
+static bool InputReplayable()
+{
+	for (int port = 0; port < 2; port++)
+	{
+		const ESI type = joyports[port].type;
+		if (type != SI_UNSET && type != SI_NONE && type != SI_GAMEPAD && type != SI_ZAPPER)
+			return false;
+	}
+	return portFC.type == SIFC_UNSET || portFC.type == SIFC_NONE || portFC.type == SIFC_4PLAYER;
+}
+
+void FCEU_ReverseRecordFrame(int skip)
+{
+	if (!reverseDebugging || !FCEUMOV_Mode(MOVIEMODE_INACTIVE) || FCEUnetplay || !InputReplayable())
+	{
+		if (!history.empty())
+			FCEU_ReverseClear();
+		return;
+	}
+
+	//after going back, the frames that followed are a future that won't happen anymore
+	while ((int)history.size() > currentFrame + 1)
+	{
+		historyBytes -= FrameBytes(history.back());
+		history.pop_back();
+	}
+
+	history.push_back(ReverseFrame());
+	ReverseFrame &frame = history.back();
+	currentFrame = history.size() - 1;
+	frame.instructions = total_instructions;
+	frame.frameCounter = currFrameCounter;
+	frame.skip = skip;
+	memcpy(frame.joy, joy, sizeof(frame.joy));
+	joyports[0].log(&frame.input);
+	joyports[1].log(&frame.input);
+	if (history.size() == 1 || (historyBase + currentFrame) % snapshotInterval == 0)
+	{
+		EMUFILE_MEMORY ms(&frame.savestate);
+		FCEUSS_SaveMS(&ms, Z_BEST_SPEED);
+		ms.trim();
+	}
+	historyBytes += FrameBytes(frame);
+
+	EnforceBudget();
+}
+
+static bool LoadSnapshot(int i)
+{
+	EMUFILE_MEMORY ms(&history[i].savestate);
+	loadingSnapshot = true;
+	const bool ok = FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+	loadingSnapshot = false;
+
+	//take the debugger's counters back along, but not past the point they were last reset
+	const uint64 deltaBase = total_instructions - delta_instructions;
+	total_instructions = history[i].instructions;
+	delta_instructions = total_instructions > deltaBase ? total_instructions - deltaBase : 0;
+	const uint64 now = timestampbase + (uint64)timestamp;
+	if (delta_cycles_base > now)
+		delta_cycles_base = now;
+	if (total_cycles_base > now)
+		total_cycles_base = now;
+	return ok;
+}
+
+static void SetupFrame(int i)
+{
+	joyports[0].load(&history[i].input);
+	joyports[1].load(&history[i].input);
+	memcpy(joy, history[i].joy, sizeof(joy));
+	currFrameCounter = history[i].frameCounter;
+	currentFrame = i;
+}
+
+//false when the frame didn't end where it did the first time
+static bool ReplayFrame(int i)
+{
+	SetupFrame(i);
+	FCEU_EmulateReplayFrame(history[i].skip);
+	return i + 1 >= (int)history.size() || total_instructions == history[i + 1].instructions;
+}
+
+//the last frame starting at or before the instruction
+static int FrameOf(uint64 instruction)
+{
+	int i = history.size() - 1;
+	while (i > 0 && history[i].instructions > instruction)
+		i--;
+	return i;
+}
+
+static int SnapshotBefore(int i)
+{
+	while (i >= 0 && history[i].savestate.empty())
+		i--;
+	return i;
+}
+
+void FCEU_ReverseScanInstruction(uint8 opcode)
+{
+	if (total_instructions >= scanEnd)
+		return;
+	ReverseScanEntry entry;
+	entry.instruction = total_instructions;
+	entry.opcode = opcode;
+	entry.s = X.S;
+	entry.breakHit = -1;
+	scanEntries.push_back(entry);
+}
+
+void FCEU_ReverseScanBreak(int bp_num)
+{
+	//only real breakpoints count; stepping and the like are requests of the user, not of the program
+	if (bp_num < 0 || scanEntries.empty())
+		return;
+	ReverseScanEntry &entry = scanEntries.back();
+	if (entry.instruction == total_instructions && entry.breakHit == -1)
+		entry.breakHit = bp_num;
+}
+
+//replays from the snapshot of frame first, collecting every instruction before end
+static bool ScanSegment(int first, uint64 end)
+{
+	scanEntries.clear();
+	scanEnd = end;
+	if (!LoadSnapshot(first))
+		return false;
+	reverseMode = REVERSE_SCAN;
+	bool ok = true;
+	for (int i = first; ok && i < (int)history.size() && total_instructions < end; i++)
+		ok = ReplayFrame(i);
+	reverseMode = REVERSE_OFF;
+	return ok;
+}
+
+//works backwards one snapshot at a time from the instruction the request was made at
+static bool FindTarget(int op, uint64 &target, int &breakType)
+{
+	bool returned = false;  //REVERSE_OP_STEPOVER: the previous instruction was a return, look for the call
+	uint64 end = pendingFrom;
+	for (int seg = SnapshotBefore(FrameOf(pendingFrom - 1)); seg >= 0; seg = SnapshotBefore(seg - 1))
+	{
+		if (!ScanSegment(seg, end))
+			return false;
+		for (int j = scanEntries.size() - 1; j >= 0; j--)
+		{
+			const ReverseScanEntry &entry = scanEntries[j];
+			if (op == REVERSE_OP_CONTINUE)
+			{
+				if (entry.breakHit != -1)
+				{
+					target = entry.instruction;
+					breakType = entry.breakHit;
+					return true;
+				}
+			} else if (entry.instruction == pendingFrom - 1)
+			{
+				//RTS and RTI: the subroutine or interrupt handler ran at a lower stack level than the caller
+				if (entry.opcode != 0x60 && entry.opcode != 0x40)
+				{
+					target = entry.instruction;
+					return true;
+				}
+				returned = true;
+			} else if (returned && entry.s >= pendingS)
+			{
+				target = entry.instruction;
+				return true;
+			}
+		}
+		end = history[seg].instructions;
+	}
+
+	//nothing found in the whole history: go back as far as possible
+	target = history.front().instructions;
+	return true;
+}
+
+//sets up the frame containing the target, for the caller to emulate
+static bool SeekTo(uint64 target, int breakType)
+{
+	const int frame = FrameOf(target);
+	const int first = SnapshotBefore(frame);
+	if (first < 0 || !LoadSnapshot(first))
+		return false;
+
+	reverseMode = REVERSE_SEEK;
+	reverseTarget = target;
+	reverseTargetBreak = breakType;
+	for (int i = first; i < frame; i++)
+		if (!ReplayFrame(i))
+			return false;
+	SetupFrame(frame);
+	return true;
+}
+
+bool FCEU_ReverseFrameBoundary(int *skip)
+{
+	if (reverseMode == REVERSE_SEEK)
+	{
+		//the replayed frame ended without reaching the target; the replay isn't faithful to what happened
+		FCEU_DispMessage("Reverse debugging lost sync, history cleared.",0);
+		FCEU_ReverseClear();
+	}
+	reverseMode = REVERSE_OFF;
+	if (pendingOp == REVERSE_OP_NONE)
+		return false;
+	const int op = pendingOp;
+	pendingOp = REVERSE_OP_NONE;
+
+	uint64 target = pendingFrom - 1;
+	int breakType = BREAK_TYPE_STEP;
+	bool ok = (op == REVERSE_OP_STEP) || FindTarget(op, target, breakType);
+	if (ok)
+	{
+		if (target < history.front().instructions)
+			target = history.front().instructions;
+		ok = SeekTo(target, breakType);
+	}
+	if (!ok)
+	{
+		reverseMode = REVERSE_OFF;
+		FCEU_DispMessage("Reverse debugging failed, history cleared.",0);
+		FCEU_ReverseClear();
+		//the state is not the one the debugger was stopped at anymore, so stop again right away
+		FCEUI_Debugger().step = true;
+		return false;
+	}
+	*skip = history[currentFrame].skip;
+	return true;
+}
+
+void FCEUI_SetReverseDebugging(bool enabled)
+{
+	reverseDebugging = enabled;
+	if (!enabled)
+		FCEU_ReverseClear();
+}
+
+void FCEUI_SetReverseDebuggingMemory(int megabytes)
+{
+	historyBudget = (size_t)megabytes << 20;
+	EnforceBudget();
+}
+
+bool FCEUI_ReverseDebuggingEnabled()
+{
+	return reverseDebugging;
+}
+
+bool FCEUI_ReverseDebuggingAvailable()
+{
+	return reverseDebugging && FCEUI_EmulationPaused() && reverseMode == REVERSE_OFF && pendingOp == REVERSE_OP_NONE
+		&& !history.empty() && total_instructions > history.front().instructions;
+}
+
+bool FCEUI_ReverseDebug(int op)
+{
+	if (!FCEUI_ReverseDebuggingAvailable())
+		return false;
+	pendingOp = op;
+	pendingFrom = total_instructions;
+	pendingS = X.S;
+	reverseMode = REVERSE_DISCARD;
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef _REVERSEDEBUG_H_
+#define _REVERSEDEBUG_H_
+
+#include "types.h"
+
+//Reverse execution for the debugger.
+//While it is enabled, a savestate is kept at the start of frames (densely at first, thinned out as
+//the memory budget fills up) along with the input of every frame. Going back restores the nearest
+//snapshot before the target instruction and replays the recorded input up to it.
+//Only gamepads and zappers are recorded, so nothing is kept while any other input device is attached.
+
+enum ERVSMODE
+{
+	REVERSE_OFF,       //normal emulation
+	REVERSE_DISCARD,   //a request is pending; the rest of the frame is thrown away
+	REVERSE_SCAN,      //replaying the history to find the target; breakpoint hits are collected, not taken
+	REVERSE_SEEK,      //replaying the history up to reverseTarget, where the debugger stops
+};
+
+enum ERVSOP
+{
+	REVERSE_OP_NONE,
+	REVERSE_OP_STEP,       //back to the previous instruction
+	REVERSE_OP_STEPOVER,   //like REVERSE_OP_STEP, but steps back over a whole subroutine when just returned from one
+	REVERSE_OP_CONTINUE,   //back to the previous breakpoint hit
+};
+
+extern int reverseMode;
+extern uint64 reverseTarget;
+extern int reverseTargetBreak;
+
+//called by the debugger for every instruction while scanning
+void FCEU_ReverseScanInstruction(uint8 opcode);
+void FCEU_ReverseScanBreak(int bp_num);
+
+//called at the start of each frame. returns true if the frame is a replayed one and its input is already set up,
+//and sets skip to what the frame was emulated with; otherwise the frame's input has to be polled, then handed
+//to FCEU_ReverseRecordFrame() with the skip the frame is emulated with
+bool FCEU_ReverseFrameBoundary(int *skip);
+void FCEU_ReverseRecordFrame(int skip);
+void FCEU_ReverseClear();
+//called when a savestate was loaded
+void FCEU_ReverseStateLoaded();
+
+void FCEUI_SetReverseDebugging(bool enabled);
+void FCEUI_SetReverseDebuggingMemory(int megabytes);
+bool FCEUI_ReverseDebuggingEnabled();
+bool FCEUI_ReverseDebuggingAvailable();
+//only valid while stopped in the debugger; the driver then resumes emulation to carry it out
+bool FCEUI_ReverseDebug(int op);
+
+#endif
@@ -0,0 +1,215 @@
+/// \file
+/// \brief External database of iNES header corrections
+///
+/// The database can list tens of thousands of games, of which one is wanted per load. So it isn't
+/// parsed: the file is mapped, one pass over it finds where each line starts, and an open addressing
+/// table keyed by CRC32 points at the lines. Only the line of the game being loaded is ever parsed.
+
+#include "types.h"
+#include "fceu.h"
+#include "file.h"
+#include "utils/memory.h"
+#include "romdb.h"
+
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+static bool dbOpened = false;
+static uint8 *dbData = NULL;        //the file, mapped or read
+static uint32 dbSize = 0;
+static std::vector<uint32> dbKeys;  //hash table: the CRC32s
+static std::vector<uint32> dbLines; //and where their lines start, plus 1; 0 for an empty slot
+static uint32 dbMask;
+
+static uint32 Slot(uint32 crc32)
+{
+	return (crc32 ^ (crc32 >> 16)) & dbMask;
+}
+
+static bool IsSpace(uint8 c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static uint32 SkipSpaces(uint32 pos, uint32 end)
+{
+	while (pos < end && IsSpace(dbData[pos]))
+		pos++;
+	return pos;
+}
+
+static uint32 LineEnd(uint32 pos)
+{
+	const uint8 *nl = (const uint8*)memchr(dbData + pos, '\n', dbSize - pos);
+	return nl ? (uint32)(nl - dbData) : dbSize;
+}
+
+//reads the CRC32 a line starts with; false for comments, blank and malformed lines
+static bool ParseKey(uint32 pos, uint32 end, uint32 *crc32)
+{
+	uint32 value = 0;
+	int digits = 0;
+	pos = SkipSpaces(pos, end);
+	for (; pos < end && digits < 9; pos++, digits++)
+	{
+		const uint8 c = dbData[pos];
+		if (c >= '0' && c <= '9')
+			value = (value << 4) | (c - '0');
+		else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+			value = (value << 4) | ((c | 0x20) - 'a' + 10);
+		else
+			break;
+	}
+	if (digits == 0 || digits > 8 || (pos < end && !IsSpace(dbData[pos])))
+		return false;
+	*crc32 = value;
+	return true;
+}
+
+static void OpenDB()
+{
+	dbOpened = true;
+
+	FCEUFILE *fp = FCEU_fopen(FCEU_MakeFName(FCEUMKF_ROMDB, 0, 0).c_str(), 0, "rb", 0);
+	if (!fp)
+		return;
+	dbSize = FCEU_fgetsize(fp);
+	if (dbSize && !(dbData = FCEU_fmap(fp, 0, dbSize)))
+	{
+		//compressed or not mappable here
+		if ((dbData = (uint8*)FCEU_malloc(dbSize)) && FCEU_fread(dbData, 1, dbSize, fp) != dbSize)
+		{
+			FCEU_ffree(dbData);
+			dbData = NULL;
+		}
+	}
+	FCEU_fclose(fp);
+	if (!dbData)
+		return;
+
+	uint32 lines = 1;
+	for (const uint8 *p = dbData; (p = (const uint8*)memchr(p, '\n', dbSize - (p - dbData))) != NULL; p++)
+		lines++;
+	uint32 tableSize = 16;
+	while (tableSize < lines * 2)
+		tableSize <<= 1;
+	dbKeys.assign(tableSize, 0);
+	dbLines.assign(tableSize, 0);
+	dbMask = tableSize - 1;
+
+	int entries = 0;
+	for (uint32 pos = 0; pos < dbSize; )
+	{
+		const uint32 end = LineEnd(pos);
+		uint32 crc32;
+		if (ParseKey(pos, end, &crc32))
+		{
+			//the first line for a game is the one that counts
+			uint32 slot = Slot(crc32);
+			while (dbLines[slot] && dbKeys[slot] != crc32)
+				slot = (slot + 1) & dbMask;
+			if (!dbLines[slot])
+			{
+				dbKeys[slot] = crc32;
+				dbLines[slot] = pos + 1;
+				entries++;
+			}
+		}
+		pos = end + 1;
+	}
+	FCEU_printf(" ROM database: %d games\n", entries);
+}
+
+void FCEU_RomDBClose()
+{
+	FCEU_ffree(dbData);
+	dbData = NULL;
+	dbSize = 0;
+	std::vector<uint32>().swap(dbKeys);
+	std::vector<uint32>().swap(dbLines);
+	dbOpened = false;
+}
+
+static int ParseNumber(const char *value)
+{
+	return strtol(value, NULL, 10);
+}
+
+static void ParseField(const char *key, const char *value, ROMDBENTRY *entry)
+{
+	if (!strcmp(key, "mapper"))
+		entry->mapper = ParseNumber(value);
+	else if (!strcmp(key, "submapper"))
+		entry->submapper = ParseNumber(value);
+	else if (!strcmp(key, "mirror"))
+	{
+		switch (value[0] | 0x20)
+		{
+			case 'h': entry->mirror = 0; break;
+			case 'v': entry->mirror = 1; break;
+			case '4': entry->mirror = 2; break;
+		}
+	}
+	else if (!strcmp(key, "battery"))
+		entry->battery = ParseNumber(value) ? 1 : 0;
+	else if (!strcmp(key, "tv"))
+		entry->tv = strcmp(value, "pal") ? 0 : 1;
+	else if (!strcmp(key, "prgram"))
+		entry->prgram = ParseNumber(value);
+	else if (!strcmp(key, "prgnvram"))
+		entry->prgnvram = ParseNumber(value);
+	else if (!strcmp(key, "chrram"))
+		entry->chrram = ParseNumber(value);
+	else if (!strcmp(key, "chrnvram"))
+		entry->chrnvram = ParseNumber(value);
+}
+
+bool FCEU_RomDBLookup(uint32 crc32, ROMDBENTRY *entry)
+{
+	if (!dbOpened)
+		OpenDB();
+	if (!dbData)
+		return false;
+
+	uint32 slot = Slot(crc32);
+	while (dbLines[slot] && dbKeys[slot] != crc32)
+		slot = (slot + 1) & dbMask;
+	if (!dbLines[slot])
+		return false;
+
+	entry->mapper = entry->submapper = entry->mirror = entry->battery = entry->tv = -1;
+	entry->prgram = entry->prgnvram = entry->chrram = entry->chrnvram = -1;
+
+	const uint32 end = LineEnd(dbLines[slot] - 1);
+	uint32 pos = SkipSpaces(dbLines[slot] - 1, end);
+	while (pos < end && !IsSpace(dbData[pos]))
+		pos++;
+	while ((pos = SkipSpaces(pos, end)) < end)
+	{
+		char field[64];
+		int len = 0;
+		while (pos < end && !IsSpace(dbData[pos]))
+		{
+			if (len < (int)sizeof(field) - 1)
+				field[len++] = dbData[pos];
+			pos++;
+		}
+		field[len] = 0;
+		char *value = strchr(field, '=');
+		if (value)
+		{
+			*value++ = 0;
+			ParseField(field, value, entry);
+		}
+	}
+
+	if (entry->prgram >= 0 || entry->prgnvram >= 0 || entry->chrram >= 0 || entry->chrnvram >= 0)
+	{
+		if (entry->prgram < 0) entry->prgram = 0;
+		if (entry->prgnvram < 0) entry->prgnvram = 0;
+		if (entry->chrram < 0) entry->chrram = 0;
+		if (entry->chrnvram < 0) entry->chrnvram = 0;
+	}
+	return true;
+}
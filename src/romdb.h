@@ -0,0 +1,26 @@
+#ifndef _ROMDB_H_
+#define _ROMDB_H_
+
+#include "types.h"
+
+//External database of iNES header corrections, romdb.txt in the base directory.
+//Games are listed by the CRC32 of their PRG and CHR ROM, one per line, in hex, followed by any of
+//  mapper=N submapper=N mirror=h|v|4 battery=0|1 tv=ntsc|pal
+//  prgram=N prgnvram=N chrram=N chrnvram=N
+//The RAM sizes are in bytes and describe the cartridge the way an NES 2.0 header does, so when any of
+//them is given, the ones left out are taken as 0. Lines starting with # are comments.
+
+struct ROMDBENTRY {
+	//-1 where the database doesn't say
+	int mapper, submapper;
+	int mirror;
+	int battery;
+	int tv;
+	int prgram, prgnvram, chrram, chrnvram;
+};
+
+//the file is mapped and indexed the first time a game is looked up
+bool FCEU_RomDBLookup(uint32 crc32, ROMDBENTRY *entry);
+void FCEU_RomDBClose();
+
+#endif
@@ -0,0 +1,725 @@
+/// \file
+/// \brief ROM library scanner and index
+///
+/// The scan is a queue of paths worked off by a pool of threads: listing a directory queues what
+/// is in it, so the walk and the hashing of large libraries are both spread over the threads.
+/// The index file lists the games sorted by path. A file whose size and modification time are
+/// the same as in the old index keeps its entries, without being opened.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "file.h"
+#include "cart.h"
+#include "ines.h"
+#include "nsf.h"
+#include "emufile.h"
+#include "utils/crc32.h"
+#include "utils/md5.h"
+#include "romscan.h"
+
+#ifdef _SYSTEM_MINIZIP
+#include <minizip/unzip.h>
+#else
+#include "utils/unzip.h"
+#endif
+#include <zlib.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#define ROMINDEX_MAGIC "FCEUXRIX"
+#define ROMINDEX_VERSION 1
+#define ROMSCAN_MAX_GAME_SIZE (64 << 20) //nothing bigger is a game
+
+struct ScanJob
+{
+	std::string path;
+	bool directory;
+	int64 mtime;
+	uint64 size;
+};
+
+static std::mutex scanMutex;
+static std::condition_variable scanWake;
+static std::deque<ScanJob> scanJobs;   //guarded by scanMutex
+static int scanBusy;                   //workers at a job; guarded by scanMutex
+static const std::vector<ROMINDEXENTRY> *scanOld;
+
+static bool EntryLess(const ROMINDEXENTRY &a, const ROMINDEXENTRY &b)
+{
+	const int c = a.path.compare(b.path);
+	return c < 0 || (c == 0 && a.member < b.member);
+}
+
+static bool EntryPathLess(const ROMINDEXENTRY &a, const std::string &path)
+{
+	return a.path < path;
+}
+
+static bool HasGameExtension(const std::string &name)
+{
+	static const char *exts[] = { ".nes", ".fds", ".nsf", ".unf", ".unif", ".nez", 0 };
+	for (int i = 0; exts[i]; i++)
+	{
+		const size_t len = strlen(exts[i]);
+		if (name.size() >= len && !strcasecmp(name.c_str() + name.size() - len, exts[i]))
+			return true;
+	}
+	return false;
+}
+
+static bool IsArchiveExtension(const std::string &name)
+{
+	return name.size() >= 4 && (!strcasecmp(name.c_str() + name.size() - 4, ".zip") || !strcasecmp(name.c_str() + name.size() - 3, ".gz"));
+}
+
+class GameHash
+{
+public:
+	GameHash() : crc(0) { md5_starts(&md5); }
+	void update(const uint8 *data, uint32 len)
+	{
+		md5_update(&md5, (uint8*)data, len);
+		crc = CalcCRC32(crc, (uint8*)data, len);
+	}
+	//what's past the end of the file, as the loader fills it
+	void fill(uint8 value, uint32 len)
+	{
+		uint8 buf[4096];
+		memset(buf, value, sizeof(buf));
+		for (; len; len -= std::min<uint32>(len, sizeof(buf)))
+			update(buf, std::min<uint32>(len, sizeof(buf)));
+	}
+	//len bytes from data + pos, padded up to size
+	void chunk(const std::vector<uint8> &data, uint32 pos, uint32 len, uint32 size, uint8 padding)
+	{
+		const uint32 have = pos >= data.size() ? 0 : std::min<uint32>(len, data.size() - pos);
+		if (have)
+			update(&data[pos], have);
+		fill(padding, size - have);
+	}
+	void finish(ROMINDEXENTRY &entry)
+	{
+		md5_finish(&md5, entry.md5.data);
+		entry.crc32 = crc;
+	}
+
+private:
+	md5_context md5;
+	uint32 crc;
+};
+
+static uint32 PowerOf2(uint32 x)
+{
+	uint32 p = 1;
+	while (p < x)
+		p <<= 1;
+	return p;
+}
+
+static bool IdentifyINES(const std::vector<uint8> &data, ROMINDEXENTRY &entry)
+{
+	iNES_HEADER header;
+	memcpy(&header, &data[0], sizeof(header));
+	header.cleanup();
+
+	const bool nes2 = (header.ROM_type2 & 0x0C) == 0x08;
+	entry.format = nes2 ? ROMFORMAT_NES2 : ROMFORMAT_INES;
+	entry.mapper = (header.ROM_type >> 4) | (header.ROM_type2 & 0xF0);
+	entry.submapper = 0;
+	uint32 prgBanks = header.ROM_size, chrBanks = header.VROM_size;
+	if (nes2)
+	{
+		entry.mapper |= (header.ROM_type3 & 0x0F) << 8;
+		entry.submapper = header.ROM_type3 >> 4;
+		prgBanks |= (header.Upper_ROM_VROM_size & 0x0F) << 8;
+		chrBanks |= (header.Upper_ROM_VROM_size & 0xF0) << 4;
+	} else if (!prgBanks)
+		prgBanks = 256;
+	entry.prgSize = prgBanks << 14;
+	entry.chrSize = chrBanks << 13;
+
+	entry.flags = 0;
+	if (header.ROM_type & 2)
+		entry.flags |= ROMINDEX_BATTERY;
+	if (header.ROM_type & 8)
+		entry.flags |= ROMINDEX_FOURSCREEN;
+	else if (header.ROM_type & 1)
+		entry.flags |= ROMINDEX_VERTICAL;
+	if (header.ROM_type & 4)
+		entry.flags |= ROMINDEX_TRAINER;
+	if (nes2 ? (header.TV_system & 3) == 1 : (header.Upper_ROM_VROM_size & 1))
+		entry.flags |= ROMINDEX_PAL;
+
+	//like the loader: both are padded to a power of 2
+	const uint32 pos = 16 + ((header.ROM_type & 4) ? 512 : 0);
+	GameHash hash;
+	hash.chunk(data, pos, entry.prgSize, PowerOf2(prgBanks) << 14, 0xFF);
+	if (chrBanks)
+		hash.chunk(data, pos + entry.prgSize, entry.chrSize, PowerOf2(chrBanks) << 13, 0xFF);
+	hash.finish(entry);
+	return true;
+}
+
+static bool IdentifyUNIF(const std::vector<uint8> &data, ROMINDEXENTRY &entry)
+{
+	uint32 chunkPos[32], chunkLen[32];
+	memset(chunkLen, 0, sizeof(chunkLen));
+	entry.format = ROMFORMAT_UNIF;
+	entry.mapper = -1;
+	entry.submapper = 0;
+	entry.prgSize = entry.chrSize = 0;
+	entry.flags = 0;
+
+	for (size_t pos = 0x20; pos + 8 <= data.size(); )
+	{
+		const uint8 *id = &data[pos];
+		const uint32 len = data[pos + 4] | (data[pos + 5] << 8) | (data[pos + 6] << 16) | (data[pos + 7] << 24);
+		pos += 8;
+		if (len > data.size() - pos)
+			break;
+		const char *text = (const char*)&data[pos];
+		if ((!memcmp(id, "PRG", 3) || !memcmp(id, "CHR", 3)) && isxdigit(id[3]))
+		{
+			const int slot = (id[0] == 'C' ? 16 : 0) + (isdigit(id[3]) ? id[3] - '0' : toupper(id[3]) - 'A' + 10);
+			chunkPos[slot] = pos;
+			chunkLen[slot] = len;
+			if (slot < 16)
+				entry.prgSize += len;
+			else
+				entry.chrSize += len;
+		} else if (!memcmp(id, "MAPR", 4))
+			entry.board.assign(text, strnlen(text, len));
+		else if (!memcmp(id, "NAME", 4))
+			entry.title.assign(text, strnlen(text, len));
+		else if (!memcmp(id, "BATR", 4))
+			entry.flags |= ROMINDEX_BATTERY;
+		else if (!memcmp(id, "MIRR", 4) && len)
+		{
+			if (data[pos] == 1)
+				entry.flags |= ROMINDEX_VERTICAL;
+			else if (data[pos] == 4)
+				entry.flags |= ROMINDEX_FOURSCREEN;
+		} else if (!memcmp(id, "TVCI", 4) && len && data[pos] == 1)
+			entry.flags |= ROMINDEX_PAL;
+		pos += len;
+	}
+
+	//the loader hashes the chunks in the order of their numbers, each padded to a power of 2
+	GameHash hash;
+	for (int slot = 0; slot < 32; slot++)
+		if (chunkLen[slot])
+			hash.chunk(data, chunkPos[slot], chunkLen[slot], std::max<uint32>(PowerOf2(chunkLen[slot]), 2048), 0xFF);
+	hash.finish(entry);
+	return true;
+}
+
+static bool IdentifyFDS(const std::vector<uint8> &data, ROMINDEXENTRY &entry)
+{
+	uint32 pos = 0, sides;
+	if (!memcmp(&data[0], "FDS\x1a", 4))
+	{
+		pos = 16;
+		sides = data[4];
+	} else
+		sides = std::max<uint32>(data.size() / 65500, 1);
+	sides = std::min<uint32>(std::max<uint32>(sides, 1), 8);
+
+	entry.format = ROMFORMAT_FDS;
+	entry.mapper = -1;
+	entry.submapper = 0;
+	entry.prgSize = sides * 65500;
+	entry.chrSize = 0;
+	entry.flags = 0;
+	GameHash hash;
+	hash.chunk(data, pos, entry.prgSize, entry.prgSize, 0);
+	hash.finish(entry);
+	return true;
+}
+
+static bool IdentifyNSF(const std::vector<uint8> &data, ROMINDEXENTRY &entry)
+{
+	//the file's header is 0x80 bytes, NSF_HEADER has some more at the end
+	if (data.size() < 0x80)
+		return false;
+	NSF_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header, &data[0], 0x80);
+
+	entry.format = ROMFORMAT_NSF;
+	entry.mapper = -1;
+	entry.submapper = 0;
+	entry.prgSize = data.size() - 0x80;
+	entry.chrSize = 0;
+	entry.flags = (header.VideoSystem & 1) ? ROMINDEX_PAL : 0;
+	entry.title.assign((const char*)header.SongName, strnlen((const char*)header.SongName, sizeof(header.SongName)));
+	GameHash hash;
+	hash.chunk(data, 0x80, entry.prgSize, entry.prgSize, 0);
+	hash.finish(entry);
+	return true;
+}
+
+//fills in everything but the file's name, size and time
+static bool IdentifyGame(const std::vector<uint8> &data, ROMINDEXENTRY &entry)
+{
+	if (data.size() < 16)
+		return false;
+	const uint8 *d = &data[0];
+	if (!memcmp(d, "NES\x1a", 4))
+		return IdentifyINES(data, entry);
+	if (!memcmp(d, "UNIF", 4))
+		return IdentifyUNIF(data, entry);
+	if (!memcmp(d, "FDS\x1a", 4) || !memcmp(d + 1, "*NINTENDO-HVC*", 14))
+		return IdentifyFDS(data, entry);
+	if (!memcmp(d, "NESM\x1a", 5))
+		return IdentifyNSF(data, entry);
+	return false;
+}
+
+static bool ReadPlainFile(const std::string &path, uint64 size, std::vector<uint8> &data)
+{
+	FILE *fp = FCEUD_UTF8fopen(path, "rb");
+	if (!fp)
+		return false;
+	data.resize((size_t)size);
+	const bool ok = !size || fread(&data[0], 1, data.size(), fp) == data.size();
+	fclose(fp);
+	return ok;
+}
+
+static bool ReadGzipFile(const std::string &path, std::vector<uint8> &data)
+{
+	gzFile gz = gzopen(path.c_str(), "rb");
+	if (!gz)
+		return false;
+	data.clear();
+	uint8 buf[65536];
+	int len;
+	while ((len = gzread(gz, buf, sizeof(buf))) > 0 && data.size() < ROMSCAN_MAX_GAME_SIZE)
+		data.insert(data.end(), buf, buf + len);
+	gzclose(gz);
+	return len == 0;
+}
+
+//every game in a zip file, where the loader only looks at the first
+static void ScanZip(const std::string &path, const ROMINDEXENTRY &file, std::vector<ROMINDEXENTRY> &out)
+{
+	unzFile zip = unzOpen(path.c_str());
+	if (!zip)
+		return;
+	std::vector<uint8> data;
+	for (int ret = unzGoToFirstFile(zip); ret == UNZ_OK; ret = unzGoToNextFile(zip))
+	{
+		char name[512];
+		unz_file_info info;
+		if (unzGetCurrentFileInfo(zip, &info, name, sizeof(name), 0, 0, 0, 0) != UNZ_OK)
+			break;
+		name[sizeof(name) - 1] = 0;
+		if (!HasGameExtension(name) || info.uncompressed_size > ROMSCAN_MAX_GAME_SIZE || unzOpenCurrentFile(zip) != UNZ_OK)
+			continue;
+		data.resize(info.uncompressed_size);
+		const bool ok = data.empty() || unzReadCurrentFile(zip, &data[0], data.size()) == (int)data.size();
+		unzCloseCurrentFile(zip);
+
+		ROMINDEXENTRY entry = file;
+		entry.member = name;
+		if (ok && IdentifyGame(data, entry))
+			out.push_back(entry);
+	}
+	unzClose(zip);
+}
+
+static void ScanFile(const ScanJob &job, std::vector<ROMINDEXENTRY> &out, int &hashed)
+{
+	//unchanged since the last scan
+	std::vector<ROMINDEXENTRY>::const_iterator old = std::lower_bound(scanOld->begin(), scanOld->end(), job.path, EntryPathLess);
+	if (old != scanOld->end() && old->path == job.path && old->mtime == job.mtime && old->size == job.size)
+	{
+		for (; old != scanOld->end() && old->path == job.path; ++old)
+			out.push_back(*old);
+		return;
+	}
+
+	hashed++;
+	const size_t count = out.size();
+	ROMINDEXENTRY entry;
+	entry.path = job.path;
+	entry.mtime = job.mtime;
+	entry.size = job.size;
+	entry.format = ROMFORMAT_NONE;
+	entry.crc32 = 0;
+	memset(entry.md5.data, 0, sizeof(entry.md5.data));
+	entry.mapper = -1;
+	entry.submapper = 0;
+	entry.prgSize = entry.chrSize = 0;
+	entry.flags = 0;
+
+	std::vector<uint8> data;
+	const char *name = job.path.c_str();
+	const size_t len = job.path.size();
+	if (len >= 4 && !strcasecmp(name + len - 4, ".zip"))
+		ScanZip(job.path, entry, out);
+	else if (len >= 3 && !strcasecmp(name + len - 3, ".gz"))
+	{
+		ROMINDEXENTRY game = entry;
+		if (ReadGzipFile(job.path, data) && IdentifyGame(data, game))
+			out.push_back(game);
+	} else if (job.size <= ROMSCAN_MAX_GAME_SIZE)
+	{
+		ROMINDEXENTRY game = entry;
+		if (ReadPlainFile(job.path, job.size, data) && IdentifyGame(data, game))
+			out.push_back(game);
+	}
+
+	if (out.size() == count)
+		out.push_back(entry);
+}
+
+static void QueueJob(const ScanJob &job)
+{
+	std::lock_guard<std::mutex> lock(scanMutex);
+	scanJobs.push_back(job);
+	scanWake.notify_one();
+}
+
+//queues a directory entry; only directories and files that may hold a game
+static void QueueEntry(const std::string &path, const std::string &name)
+{
+	if (name == "." || name == "..")
+		return;
+	struct stat st;
+#ifdef WIN32
+	if (stat(path.c_str(), &st))
+		return;
+#else
+	//links to directories are not followed, they could go round in circles
+	if (lstat(path.c_str(), &st) || (S_ISLNK(st.st_mode) && (stat(path.c_str(), &st) || !S_ISREG(st.st_mode))))
+		return;
+#endif
+	ScanJob job;
+	job.path = path;
+	job.directory = S_ISDIR(st.st_mode);
+	job.mtime = st.st_mtime;
+	job.size = st.st_size;
+	if (job.directory || (S_ISREG(st.st_mode) && (HasGameExtension(name) || IsArchiveExtension(name))))
+		QueueJob(job);
+}
+
+static void ScanDirectory(const std::string &dir)
+{
+#ifdef WIN32
+	WIN32_FIND_DATA wfd;
+	HANDLE find = FindFirstFile((dir + PSS "*").c_str(), &wfd);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+		QueueEntry(dir + PSS + wfd.cFileName, wfd.cFileName);
+	while (FindNextFile(find, &wfd));
+	FindClose(find);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (struct dirent *e = readdir(d))
+		QueueEntry(dir + PSS + e->d_name, e->d_name);
+	closedir(d);
+#endif
+}
+
+static void ScanWorker(std::vector<ROMINDEXENTRY> *out, int *files, int *hashed)
+{
+	for (;;)
+	{
+		ScanJob job;
+		{
+			std::unique_lock<std::mutex> lock(scanMutex);
+			while (scanJobs.empty() && scanBusy)
+				scanWake.wait(lock);
+			if (scanJobs.empty())
+				break;
+			job = scanJobs.front();
+			scanJobs.pop_front();
+			scanBusy++;
+		}
+
+		if (job.directory)
+			ScanDirectory(job.path);
+		else
+		{
+			(*files)++;
+			ScanFile(job, *out, *hashed);
+		}
+
+		std::lock_guard<std::mutex> lock(scanMutex);
+		//the last one done with nothing left to do wakes everybody to finish
+		if (!--scanBusy && scanJobs.empty())
+			scanWake.notify_all();
+	}
+}
+
+static void WriteString(EMUFILE *os, const std::string &s)
+{
+	os->write32le((u32)s.size());
+	os->fwrite(s.data(), s.size());
+}
+
+static bool ReadString(EMUFILE *is, std::string &s)
+{
+	u32 len;
+	if (!is->read32le(&len) || len > 65536)
+		return false;
+	s.resize(len);
+	return !len || is->fread(&s[0], len) == len;
+}
+
+static bool SaveIndex(const char *indexfn, const std::vector<ROMINDEXENTRY> &entries)
+{
+	const std::string tmp = std::string(indexfn) + ".tmp";
+	EMUFILE_FILE *os = FCEUD_UTF8_fstream(tmp, "wb");
+	if (!os)
+		return false;
+	if (!os->get_fp())
+	{
+		delete os;
+		return false;
+	}
+
+	os->fwrite(ROMINDEX_MAGIC, 8);
+	os->write32le((u32)ROMINDEX_VERSION);
+	os->write32le((u32)entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const ROMINDEXENTRY &e = entries[i];
+		WriteString(os, e.path);
+		WriteString(os, e.member);
+		os->write64le((u64)e.mtime);
+		os->write64le(e.size);
+		os->write8le(e.format);
+		os->write32le(e.crc32);
+		os->fwrite(e.md5.data, sizeof(e.md5.data));
+		os->write32le((u32)e.mapper);
+		os->write8le((u8)e.submapper);
+		os->write32le(e.prgSize);
+		os->write32le(e.chrSize);
+		os->write8le(e.flags);
+		WriteString(os, e.title);
+		WriteString(os, e.board);
+	}
+	const bool ok = !os->fail() && fflush(os->get_fp()) == 0;
+	delete os;
+	if (!ok)
+	{
+		remove(tmp.c_str());
+		return false;
+	}
+
+	//replace the old index only once the new one is complete, in one step: there is always one
+	//index or the other, even if we get killed right here
+#ifdef WIN32
+	return MoveFileEx(tmp.c_str(), indexfn, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return !rename(tmp.c_str(), indexfn);
+#endif
+}
+
+static bool LoadEntries(const char *indexfn, std::vector<ROMINDEXENTRY> &entries)
+{
+	entries.clear();
+	EMUFILE_FILE *is = FCEUD_UTF8_fstream(indexfn, "rb");
+	if (!is)
+		return false;
+	if (!is->get_fp())
+	{
+		delete is;
+		return false;
+	}
+
+	char magic[8];
+	u32 version = 0, count = 0;
+	bool ok = is->fread(magic, 8) == 8 && !memcmp(magic, ROMINDEX_MAGIC, 8)
+		&& is->read32le(&version) && version == ROMINDEX_VERSION && is->read32le(&count);
+	for (u32 i = 0; ok && i < count; i++)
+	{
+		ROMINDEXENTRY e;
+		u64 mtime;
+		u32 mapper;
+		ok = ReadString(is, e.path) && ReadString(is, e.member)
+			&& is->read64le(&mtime) && is->read64le(&e.size) && is->read8le(&e.format)
+			&& is->read32le(&e.crc32) && is->fread(e.md5.data, sizeof(e.md5.data)) == sizeof(e.md5.data)
+			&& is->read32le(&mapper);
+		if (!ok)
+			break;
+		e.mtime = (int64)mtime;
+		e.mapper = (int)mapper;
+		e.submapper = is->read8le();
+		ok = is->read32le(&e.prgSize) && is->read32le(&e.chrSize) && is->read8le(&e.flags)
+			&& ReadString(is, e.title) && ReadString(is, e.board);
+		if (ok)
+			entries.push_back(e);
+	}
+	delete is;
+
+	if (!ok)
+		entries.clear();
+	return ok;
+}
+
+//whether path is root or something below it
+static bool IsBelow(const std::string &path, const std::string &root)
+{
+	return !path.compare(0, root.size(), root) && (path.size() == root.size() || path[root.size()] == PSS[0]);
+}
+
+bool FCEUI_RomScan(const std::vector<std::string> &dirs, const char *indexfn, int threads, ROMSCANSTATS *stats)
+{
+	std::vector<ROMINDEXENTRY> old, entries;
+	LoadEntries(indexfn, old);
+	std::sort(old.begin(), old.end(), EntryLess);
+
+	std::vector<std::string> roots;
+	for (size_t i = 0; i < dirs.size(); i++)
+	{
+		std::string root = dirs[i];
+		while (root.size() > 1 && root[root.size() - 1] == PSS[0])
+			root.erase(root.size() - 1);
+		roots.push_back(root);
+	}
+	for (size_t i = 0; i < old.size(); i++)
+	{
+		bool scanned = false;
+		for (size_t j = 0; j < roots.size() && !scanned; j++)
+			scanned = IsBelow(old[i].path, roots[j]);
+		if (!scanned)
+			entries.push_back(old[i]);
+	}
+
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	scanOld = &old;
+	scanBusy = 0;
+	for (size_t i = 0; i < roots.size(); i++)
+	{
+		ScanJob job;
+		job.path = roots[i];
+		job.directory = true;
+		job.mtime = 0;
+		job.size = 0;
+		scanJobs.push_back(job);
+	}
+
+	std::vector<std::vector<ROMINDEXENTRY> > found(threads);
+	std::vector<int> files(threads, 0), hashed(threads, 0);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(ScanWorker, &found[i], &files[i], &hashed[i]));
+
+	ROMSCANSTATS s = { 0, 0, 0 };
+	for (int i = 0; i < threads; i++)
+	{
+		workers[i].join();
+		entries.insert(entries.end(), found[i].begin(), found[i].end());
+		s.files += files[i];
+		s.hashed += hashed[i];
+	}
+	scanOld = NULL;
+
+	std::sort(entries.begin(), entries.end(), EntryLess);
+	for (size_t i = 0; i < entries.size(); i++)
+		if (entries[i].format != ROMFORMAT_NONE)
+			s.games++;
+	if (stats)
+		*stats = s;
+	return SaveIndex(indexfn, entries);
+}
+
+static uint32 SlotMD5(const MD5DATA &md5)
+{
+	//the digest is as good as random already
+	return md5.data[0] | (md5.data[1] << 8) | (md5.data[2] << 16) | ((uint32)md5.data[3] << 24);
+}
+
+static uint32 SlotCRC32(uint32 crc32)
+{
+	return crc32 ^ (crc32 >> 16);
+}
+
+static bool SameMD5(const ROMINDEXENTRY &e, const MD5DATA &md5)
+{
+	return !memcmp(e.md5.data, md5.data, sizeof(md5.data));
+}
+
+static bool SameCRC32(const ROMINDEXENTRY &e, const uint32 &crc32)
+{
+	return e.crc32 == crc32;
+}
+
+//the slot holding the key, or the empty one where it would go
+template<typename K> static uint32 FindSlot(const ROMINDEX &index, const std::vector<uint32> &table, uint32 slot, const K &key, bool (*same)(const ROMINDEXENTRY&, const K&))
+{
+	slot &= index.mask;
+	while (table[slot] && !same(index.entries[table[slot] - 1], key))
+		slot = (slot + 1) & index.mask;
+	return slot;
+}
+
+bool FCEUI_RomIndexLoad(const char *indexfn, ROMINDEX &index)
+{
+	const bool ok = LoadEntries(indexfn, index.entries);
+
+	uint32 tableSize = 16;
+	while (tableSize < index.entries.size() * 2)
+		tableSize <<= 1;
+	index.byMD5.assign(tableSize, 0);
+	index.byCRC32.assign(tableSize, 0);
+	index.mask = tableSize - 1;
+	for (size_t i = 0; i < index.entries.size(); i++)
+	{
+		const ROMINDEXENTRY &e = index.entries[i];
+		if (e.format == ROMFORMAT_NONE)
+			continue;
+		//the first entry for a game is the one that's found
+		uint32 slot = FindSlot(index, index.byMD5, SlotMD5(e.md5), e.md5, SameMD5);
+		if (!index.byMD5[slot])
+			index.byMD5[slot] = i + 1;
+		slot = FindSlot(index, index.byCRC32, SlotCRC32(e.crc32), e.crc32, SameCRC32);
+		if (!index.byCRC32[slot])
+			index.byCRC32[slot] = i + 1;
+	}
+	return ok;
+}
+
+const ROMINDEXENTRY *FCEUI_RomIndexFindMD5(const ROMINDEX &index, const MD5DATA &md5)
+{
+	if (index.byMD5.empty())
+		return NULL;
+	const uint32 i = index.byMD5[FindSlot(index, index.byMD5, SlotMD5(md5), md5, SameMD5)];
+	return i ? &index.entries[i - 1] : NULL;
+}
+
+const ROMINDEXENTRY *FCEUI_RomIndexFindCRC32(const ROMINDEX &index, uint32 crc32)
+{
+	if (index.byCRC32.empty())
+		return NULL;
+	const uint32 i = index.byCRC32[FindSlot(index, index.byCRC32, SlotCRC32(crc32), crc32, SameCRC32)];
+	return i ? &index.entries[i - 1] : NULL;
+}
+
+std::string FCEUI_RomIndexGamePath(const ROMINDEXENTRY &entry)
+{
+	if (entry.member.empty())
+		return entry.path;
+	return entry.path + "|" + entry.member;
+}
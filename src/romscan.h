@@ -0,0 +1,75 @@
+#ifndef _ROMSCAN_H_
+#define _ROMSCAN_H_
+
+#include "types.h"
+#include "utils/md5.h"
+
+#include <string>
+#include <vector>
+
+//ROM library scanner. Walks directories with a pool of threads, hashes every game it finds
+//(zipped and gzipped ones too) and keeps the results in an index file. A rescan reuses the
+//entries of the files whose size and modification time didn't change.
+
+enum EROMFORMAT
+{
+	ROMFORMAT_NONE,   //a file that holds no game; kept so that rescans skip it
+	ROMFORMAT_INES,
+	ROMFORMAT_NES2,
+	ROMFORMAT_UNIF,
+	ROMFORMAT_FDS,
+	ROMFORMAT_NSF,
+};
+
+#define ROMINDEX_BATTERY    1
+#define ROMINDEX_VERTICAL   2
+#define ROMINDEX_FOURSCREEN 4
+#define ROMINDEX_PAL        8
+#define ROMINDEX_TRAINER    16
+
+struct ROMINDEXENTRY
+{
+	std::string path;     //the file on disk
+	std::string member;   //the game's name in the zip file; empty for other files
+	int64 mtime;
+	uint64 size;          //of the file on disk
+	uint8 format;
+	//of the game data without headers: PRG then CHR, disk sides for FDS, the program for NSF.
+	//they are the hashes the loader reports for the game
+	uint32 crc32;
+	MD5DATA md5;
+	int mapper;           //-1 for UNIF, FDS and NSF
+	int submapper;
+	uint32 prgSize, chrSize;
+	uint8 flags;          //ROMINDEX_*
+	std::string title;    //NSF and UNIF name
+	std::string board;    //UNIF board name
+};
+
+//a loaded index. the games are looked up through open addressing tables keyed by their hashes
+struct ROMINDEX
+{
+	std::vector<ROMINDEXENTRY> entries;
+	std::vector<uint32> byMD5, byCRC32;   //the entries of the games, plus 1; 0 for an empty slot
+	uint32 mask;
+};
+
+struct ROMSCANSTATS
+{
+	int files;     //files looked at
+	int hashed;    //files that were new or changed
+	int games;     //games in the index
+};
+
+//scans the directories and everything below them into the index file. entries of the index
+//outside of these directories are kept. threads <= 0 uses one per CPU
+bool FCEUI_RomScan(const std::vector<std::string> &dirs, const char *indexfn, int threads, ROMSCANSTATS *stats);
+
+bool FCEUI_RomIndexLoad(const char *indexfn, ROMINDEX &index);
+//where a game is in the library more than once, the first entry is found
+const ROMINDEXENTRY *FCEUI_RomIndexFindMD5(const ROMINDEX &index, const MD5DATA &md5);
+const ROMINDEXENTRY *FCEUI_RomIndexFindCRC32(const ROMINDEX &index, uint32 crc32);
+//the name to load the game by; "zipfile|member" for zipped games
+std::string FCEUI_RomIndexGamePath(const ROMINDEXENTRY &entry);
+
+#endif
@@ -0,0 +1,226 @@
+/// \file
+/// \brief Run-ahead: shows a frame from the near future to hide the game's own input lag
+///
+/// The frames ahead are emulated with the input of the real frame, so when the player doesn't change
+/// the input in the meantime the picture is exactly what would have been shown that many frames later.
+/// When the input does change the guess was wrong, and the next frame shows the corrected future.
+/// Everything the emulation keeps is restored by loading the state of the real frame, except the
+/// sound mixer, which is either held (RUNAHEAD_AUDIO_REAL) or left to play the frames ahead.
+/// Expansion sound chips can't be held; in RUNAHEAD_AUDIO_REAL only what they mixed is thrown away.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "ppu.h"
+#include "sound.h"
+#include "x6502.h"
+#include "cart.h"
+#include "cheat.h"
+#include "debug.h"
+#include "input.h"
+#include "movie.h"
+#include "netplay.h"
+#include "state.h"
+#include "emufile.h"
+#include "tracelog.h"
+#include "reversedebug.h"
+#include "shmexport.h"
+#include "pngdump.h"
+#include "runahead.h"
+
+#ifdef _S9XLUA_H
+#include "fceulua.h"
+#endif
+
+#include "zlib.h"
+
+#include <chrono>
+#include <cstring>
+
+#define RUNAHEAD_STATS_FRAMES 60  //frames shown per statistics period
+
+typedef std::chrono::steady_clock RunAheadClock;
+
+static int runAhead = 0;
+static int runAheadAudio = RUNAHEAD_AUDIO_AHEAD;
+static EMUFILE_MEMORY state;
+
+//the period being measured, in seconds
+static int periodFrames = 0;
+static double periodEmulate, periodSave, periodLoad, periodTotal, periodWorst;
+static RunAheadStats stats;
+static bool warned = false;
+
+static double Seconds(RunAheadClock::duration d)
+{
+	return std::chrono::duration<double>(d).count();
+}
+
+//the frames ahead would be seen by everything watching the emulation as if they had happened
+static bool Suspended()
+{
+	if (!GameInfo || FCEUnetplay || !FCEUMOV_Mode(MOVIEMODE_INACTIVE))
+		return true;
+	//stepping frame by frame, the frame shown should be the one emulated
+	if (EmulationPaused)
+		return true;
+	if (numWPs || break_on_cycles || break_on_instructions || FCEUI_TraceLogIsRecording() || FCEUI_ReverseDebuggingEnabled())
+		return true;
+	//frames handed on to other programs or files are the real ones, matching the memory they go with
+	if (FCEUI_ShmExportIsActive() || FCEU_FrameDumpWanted() || FCEUI_AviIsRecording())
+		return true;
+#ifdef _S9XLUA_H
+	if (FCEU_LuaRunning())
+		return true;
+#endif
+	return false;
+}
+
+static void EndFrame()
+{
+	timestampbase += timestamp;
+	timestamp = 0;
+	soundtimestamp = 0;
+}
+
+static void ResetPeriod()
+{
+	periodFrames = 0;
+	periodEmulate = periodSave = periodLoad = periodTotal = periodWorst = 0;
+}
+
+static void Account(double emulate, double save, double load, double total)
+{
+	const double budget = (double)(1 << 24) / FCEUI_GetDesiredFPS();
+
+	stats.shown++;
+	if (total > budget)
+		stats.overBudget++;
+
+	periodFrames++;
+	periodEmulate += emulate / (runAhead + 1);
+	periodSave += save;
+	periodLoad += load;
+	periodTotal += total;
+	if (total > periodWorst)
+		periodWorst = total;
+	if (periodFrames < RUNAHEAD_STATS_FRAMES)
+		return;
+
+	stats.frames = runAhead;
+	stats.emulateMs = periodEmulate / periodFrames * 1000;
+	stats.saveMs = periodSave / periodFrames * 1000;
+	stats.loadMs = periodLoad / periodFrames * 1000;
+	stats.totalMs = periodTotal / periodFrames * 1000;
+	stats.worstMs = periodWorst * 1000;
+	stats.budgetMs = budget * 1000;
+	//the rest of the frame goes to the driver: blitting, sound, the throttle
+	const double room = stats.budgetMs * 3 / 4 - stats.saveMs - stats.loadMs;
+	stats.sustainable = room > 0 && stats.emulateMs > 0 ? (int)(room / stats.emulateMs) - 1 : 0;
+	if (stats.sustainable < 0)
+		stats.sustainable = 0;
+	if (stats.sustainable > RUNAHEAD_MAX_FRAMES)
+		stats.sustainable = RUNAHEAD_MAX_FRAMES;
+	ResetPeriod();
+
+	if (!warned && stats.sustainable < runAhead)
+	{
+		FCEU_DispMessage("Run-ahead of %d frames is too slow here, %d would fit.", 0, runAhead, stats.sustainable);
+		warned = true;
+	}
+}
+
+bool FCEU_RunAheadFrame(int skip, int *ssize)
+{
+	//a skipped frame means the driver is already behind
+	if (!runAhead || skip || Suspended())
+		return false;
+
+	const bool realAudio = runAheadAudio == RUNAHEAD_AUDIO_REAL;
+	const RunAheadClock::time_point start = RunAheadClock::now();
+
+	//the real frame; its picture gets drawn over
+	FCEUPPU_Loop(0);
+	int size = FlushEmulateSound(realAudio);
+	EndFrame();
+
+	const RunAheadClock::time_point saveStart = RunAheadClock::now();
+	const char lag = lagFlag;
+	const uint64 instructions = total_instructions, deltaInstructions = delta_instructions;
+	state.fseek(0, SEEK_SET);
+	if (!FCEUSS_SaveMS(&state, Z_NO_COMPRESSION))
+	{
+		//nothing to go back to; show the real frame
+		*ssize = size;
+		return true;
+	}
+
+	const RunAheadClock::time_point aheadStart = RunAheadClock::now();
+	if (realAudio)
+		FCEUSND_HoldMixer();
+	for (int i = 0; i < runAhead; i++)
+	{
+		if (geniestage != 1) FCEU_ApplyPeriodicCheats();
+		FCEUPPU_Loop(0);
+		if (!realAudio)
+			size = FlushEmulateSound(i == runAhead - 1);
+		EndFrame();
+	}
+	if (realAudio)
+		FCEUSND_ReleaseMixer();
+
+	const RunAheadClock::time_point loadStart = RunAheadClock::now();
+	state.fseek(0, SEEK_SET);
+	//the picture on screen is the one from ahead; loading mustn't draw the real frame's
+	FCEUSS_LoadFP(&state, SSLOADPARAM_NODISPLAY);
+	lagFlag = lag;
+	total_instructions = instructions;
+	delta_instructions = deltaInstructions;
+	const RunAheadClock::time_point end = RunAheadClock::now();
+
+	*ssize = size;
+	Account(Seconds(saveStart - start) + Seconds(loadStart - aheadStart), Seconds(aheadStart - saveStart),
+		Seconds(end - loadStart), Seconds(end - start));
+	return true;
+}
+
+void FCEU_RunAheadReset()
+{
+	state.truncate(0);
+	std::vector<u8>().swap(*state.get_vec());
+	memset(&stats, 0, sizeof(stats));
+	ResetPeriod();
+	warned = false;
+}
+
+void FCEUI_SetRunAhead(int frames)
+{
+	if (frames < 0)
+		frames = 0;
+	if (frames > RUNAHEAD_MAX_FRAMES)
+		frames = RUNAHEAD_MAX_FRAMES;
+	if (frames != runAhead)
+	{
+		ResetPeriod();
+		warned = false;
+	}
+	runAhead = frames;
+	if (!runAhead)
+		FCEU_RunAheadReset();
+}
+
+int FCEUI_GetRunAhead()
+{
+	return runAhead;
+}
+
+void FCEUI_SetRunAheadAudio(int mode)
+{
+	runAheadAudio = mode == RUNAHEAD_AUDIO_REAL ? RUNAHEAD_AUDIO_REAL : RUNAHEAD_AUDIO_AHEAD;
+}
+
+void FCEUI_GetRunAheadStats(RunAheadStats *dest)
+{
+	*dest = stats;
+	dest->frames = runAhead;
+}
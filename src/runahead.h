@@ -0,0 +1,45 @@
+#ifndef _RUNAHEAD_H_
+#define _RUNAHEAD_H_
+
+#include "types.h"
+
+//Run-ahead hides the frames a game takes to react to the controller.
+//Each frame is emulated for real and its state kept in memory; then the next frames are emulated with
+//the same input, the last of them is the one shown, and the state goes back to the real frame.
+//A game that reacts a frame late reacts right away with one frame of run-ahead, at the cost of
+//emulating two frames and a save and load of the state for every frame shown.
+
+#define RUNAHEAD_MAX_FRAMES 8
+
+enum ERUNAHEADAUDIO
+{
+	RUNAHEAD_AUDIO_AHEAD,  //the sound goes with the frame shown; it skips whenever the guess at the input was wrong
+	RUNAHEAD_AUDIO_REAL,   //the sound of the real frames; the frames ahead aren't mixed at all
+};
+
+struct RunAheadStats
+{
+	int frames;             //frames of run-ahead asked for
+	uint32 shown;           //frames shown with run-ahead since the game was loaded
+	uint32 overBudget;      //how many of those took longer than a frame
+	//averaged over the last second
+	double emulateMs;       //one frame of emulation
+	double saveMs, loadMs;  //keeping and restoring the state
+	double totalMs;         //a frame shown, run-ahead and all
+	double worstMs;         //the slowest frame shown
+	double budgetMs;        //a frame at normal speed
+	int sustainable;        //the most frames of run-ahead that fit in three quarters of a frame, going by the above
+};
+
+//called by FCEUI_Emulate in place of emulating the frame; returns false when run-ahead is off or can't be used now.
+//ssize gets the size of the sound to play
+bool FCEU_RunAheadFrame(int skip, int *ssize);
+//called when the game is closed
+void FCEU_RunAheadReset();
+
+void FCEUI_SetRunAhead(int frames);
+int FCEUI_GetRunAhead();
+void FCEUI_SetRunAheadAudio(int mode);
+void FCEUI_GetRunAheadStats(RunAheadStats *stats);
+
+#endif
@@ -0,0 +1,167 @@
+/// \file
+/// \brief Shared-memory export of the picture, RAM and PPU state for other processes
+///
+/// Two slots are written in turn, each guarded by its own sequence number, so a reader has a whole
+/// frame to look at the slot it took before it's written again, and never waits for the emulator.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "movie.h"
+#include "ppu.h"
+#include "debug.h"
+#include "memsnapshot.h"
+#include "palette.h"
+#include "shmexport.h"
+
+#include <atomic>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern uint8 *XBuf, *XDBuf;
+extern uint32 TempAddr, RefreshAddr;
+extern uint8 vtoggle;
+
+static FCEUShmHeader *shmHeader = NULL;
+static FCEUShmFrame *shmSlots = NULL;
+static size_t shmSize = 0;
+static std::string shmName;
+#ifdef WIN32
+static HANDLE shmMapping = NULL;
+#endif
+
+static size_t HeaderSize()
+{
+	//the slots start at a cache line
+	return (sizeof(FCEUShmHeader) + 63) & ~(size_t)63;
+}
+
+bool FCEUI_ShmExportBegin(const char *name)
+{
+	FCEUI_ShmExportEnd();
+
+	shmSize = HeaderSize() + FCEU_SHM_SLOTS * sizeof(FCEUShmFrame);
+	void *mem;
+#ifdef WIN32
+	shmMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)shmSize, name);
+	if (!shmMapping)
+		return false;
+	mem = MapViewOfFile(shmMapping, FILE_MAP_ALL_ACCESS, 0, 0, shmSize);
+	if (!mem)
+	{
+		CloseHandle(shmMapping);
+		shmMapping = NULL;
+		return false;
+	}
+	const uint32 pid = GetCurrentProcessId();
+#else
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		return false;
+	//a region left behind by an emulator that crashed is reused
+	if (ftruncate(fd, 0) < 0 || ftruncate(fd, shmSize) < 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+	mem = mmap(NULL, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return false;
+	}
+	const uint32 pid = getpid();
+#endif
+	shmName = name;
+	shmHeader = (FCEUShmHeader *)mem;
+	shmSlots = (FCEUShmFrame *)((uint8 *)mem + HeaderSize());
+
+	memset(mem, 0, shmSize);
+	shmHeader->version = FCEU_SHM_VERSION;
+	shmHeader->headerSize = HeaderSize();
+	shmHeader->slotSize = sizeof(FCEUShmFrame);
+	shmHeader->slots = FCEU_SHM_SLOTS;
+	shmHeader->pid = pid;
+	shmHeader->latest = FCEU_SHM_SLOTS - 1;
+	//the magic goes last: a reader that sees it sees the rest
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(shmHeader->magic, FCEU_SHM_MAGIC, sizeof(shmHeader->magic));
+	return true;
+}
+
+void FCEUI_ShmExportEnd()
+{
+	if (!shmHeader)
+		return;
+	shmHeader->closed = 1;
+#ifdef WIN32
+	UnmapViewOfFile(shmHeader);
+	CloseHandle(shmMapping);
+	shmMapping = NULL;
+#else
+	munmap(shmHeader, shmSize);
+	//readers that have it mapped keep it until they let it go
+	shm_unlink(shmName.c_str());
+#endif
+	shmHeader = NULL;
+	shmSlots = NULL;
+}
+
+bool FCEUI_ShmExportIsActive()
+{
+	return shmHeader != NULL;
+}
+
+void FCEU_ShmExportFrame()
+{
+	if (!shmHeader || !GameInfo)
+		return;
+
+	const uint32 slot = (shmHeader->latest + 1) % FCEU_SHM_SLOTS;
+	FCEUShmFrame *f = &shmSlots[slot];
+
+	f->seq++;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	f->frame = FCEUMOV_GetFrame();
+	f->lagFrames = FCEUI_GetLagCount();
+	f->lag = FCEUI_GetLagged();
+	f->firstLine = FSettings.FirstSLine;
+	f->lastLine = FSettings.LastSLine;
+	f->ppuV = RefreshAddr;
+	f->ppuT = TempAddr;
+	f->ppuCtrl = PPU[0];
+	f->ppuMask = PPU[1];
+	f->ppuStatus = PPU[2];
+	f->oamAddr = PPU[3];
+	f->fineX = XOffset;
+	f->ppuW = vtoggle;
+
+	FCEU_GetRGBPalette(f->palette);
+	memcpy(f->ram, RAM, sizeof(f->ram));
+	for (int page = 0; page < (int)(sizeof(f->wram) >> MEMSNAPSHOT_PAGE_SHIFT); page++)
+		FCEU_MemReadPage((0x6000 >> MEMSNAPSHOT_PAGE_SHIFT) + page, f->wram + (page << MEMSNAPSHOT_PAGE_SHIFT));
+	memcpy(f->oam, SPRAM, sizeof(f->oam));
+	memcpy(f->palram, PALRAM, sizeof(f->palram));
+	for (int i = 0; i < 4; i++)
+		memcpy(f->nametables[i], vnapage[i], sizeof(f->nametables[i]));
+	memcpy(f->pixels, XBuf, sizeof(f->pixels));
+	memcpy(f->deemph, XDBuf, sizeof(f->deemph));
+
+	std::atomic_thread_fence(std::memory_order_release);
+	f->seq++;
+	shmHeader->latest = slot;
+	shmHeader->published++;
+}
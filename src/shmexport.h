@@ -0,0 +1,59 @@
+#ifndef _SHMEXPORT_H_
+#define _SHMEXPORT_H_
+
+#include <stdint.h>
+
+//Shared-memory export of the game state for other processes, shared with the reader library
+//(shmreader/). The region starts with a FCEUShmHeader, followed by FCEU_SHM_SLOTS FCEUShmFrames.
+//Each frame is written to the slot that wasn't written last, whose seq is odd while it's being
+//written; then latest is set to it. A reader takes the slot of latest and checks afterwards that its
+//seq didn't change and wasn't odd. The fields are in the byte order of the machine.
+
+#define FCEU_SHM_MAGIC   "FCEUSHM"
+#define FCEU_SHM_VERSION 1
+#define FCEU_SHM_SLOTS   2
+
+struct FCEUShmHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;    //offset of the first slot
+	uint32_t slotSize;      //sizeof(struct FCEUShmFrame)
+	uint32_t slots;
+	uint32_t pid;           //of the emulator
+	volatile uint32_t latest;   //slot written last
+	volatile uint32_t published;  //frames published, 0 until the first one is
+	volatile uint32_t closed;   //set when the emulator stops exporting
+};
+
+struct FCEUShmFrame
+{
+	volatile uint32_t seq;
+	uint32_t frame;         //movie frame counter (emu.framecount())
+	uint32_t lagFrames;     //lag counter (emu.lagcount())
+	uint32_t firstLine, lastLine;   //scanlines drawn by the emulator
+	uint16_t ppuV, ppuT;    //VRAM address and the temporary one ("loopy" v and t)
+	uint8_t ppuCtrl, ppuMask, ppuStatus, oamAddr;   //$2000, $2001, $2002, $2003
+	uint8_t fineX, ppuW;    //fine X scroll and the $2005/$2006 write toggle
+	uint8_t lag;            //the frame didn't read the controllers
+	uint8_t reserved;
+	uint32_t palette[2048]; //0x00RRGGBB by (deemph<<8)|pixel; the top byte isn't defined
+	uint8_t ram[0x800];
+	uint8_t wram[0x2000];   //$6000-$7FFF as the CPU sees it
+	uint8_t oam[0x100];
+	uint8_t palram[0x20];
+	uint8_t nametables[4][0x400];   //as mapped at $2000, $2400, $2800 and $2C00
+	uint8_t pixels[240][256];   //palette indices
+	uint8_t deemph[240][256];   //deemphasis bits of each pixel
+};
+
+#ifdef __cplusplus
+//starts exporting to the shared memory object name ("/fceux" for /dev/shm/fceux on Linux)
+bool FCEUI_ShmExportBegin(const char *name);
+void FCEUI_ShmExportEnd();
+bool FCEUI_ShmExportIsActive();
+//called with each picture drawn, before anything is drawn over it
+void FCEU_ShmExportFrame();
+#endif
+
+#endif
@@ -27,10 +27,12 @@
 #include "state.h"
 #include "wave.h"
 #include "debug.h"
+#include "cdlog.h"
 
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 static uint32 wlookup1[32];
 static uint32 wlookup2[203];
@@ -148,12 +150,6 @@ static uint32 ChannelBC[5];
 //savestate sync hack stuff
 int movieSyncHackOn=0,resetDMCacc=0,movieConvertOffset1,movieConvertOffset2;
 
-#ifdef WIN32
-extern volatile int datacount, undefinedcount;
-extern int debug_loggingCD;
-extern unsigned char *cdloggerdata;
-#endif
-
 static void LoadDMCPeriod(uint8 V)
 {
  if(PAL)
@@ -167,9 +163,7 @@ static void PrepDPCM()
  DMCAddress=0x4000+(DMCAddressLatch<<6);
  DMCSize=(DMCSizeLatch<<4)+1;
 
- #ifdef WIN32
  if(debug_loggingCD)LogDPCM(0x8000+DMCAddress, DMCSize);
- #endif
 
 }
 
@@ -185,6 +179,7 @@ void LogDPCM(int romaddress, int dpcmsize){
 
 			if(!(cdloggerdata[dpcmstart] & 2)){
 				datacount++;
+				FCEU_CDLogCountData(dpcmstart);
 				cdloggerdata[dpcmstart] |= 2;
 				if(!(cdloggerdata[dpcmstart] & 1))undefinedcount--;
 			}
@@ -1031,8 +1026,30 @@ void SetNESSoundMap(void)
   SetReadHandler(0x4015,0x4015,StatusRead);
 }
 
+static void SetChannelFuncs(void)
+{
+  if(!FSettings.SndRate)
+   DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=Dummyfunc;
+  else if(FSettings.soundq>=1)
+  {
+   DoNoise=RDoNoise;
+   DoTriangle=RDoTriangle;
+   DoPCM=RDoPCM;
+   DoSQ1=RDoSQ1;
+   DoSQ2=RDoSQ2;
+  }
+  else
+  {
+   DoSQ1=RDoSQLQ;
+   DoSQ2=RDoSQLQ;
+   DoTriangle=RDoTriangleNoisePCMLQ;
+   DoNoise=RDoTriangleNoisePCMLQ;
+   DoPCM=RDoTriangleNoisePCMLQ;
+  }
+}
+
 static int32 inbuf=0;
-int FlushEmulateSound(void)
+int FlushEmulateSound(bool log)
 {
   int x;
   int32 end,left;
@@ -1102,11 +1119,49 @@ int FlushEmulateSound(void)
   }
   inbuf=end;
 
-  FCEU_WriteWaveData(WaveFinal, end); /* This function will just return
+  if(log)
+   FCEU_WriteWaveData(WaveFinal, end); /* This function will just return
 				    if sound recording is off. */
   return(end);
 }
 
+//What the mixer had when it was held: the samples carried over from the last flush
+static int32 heldWave[2048+512];
+static std::vector<int32> heldWaveHi;
+static uint32 heldtsoffs;
+static bool mixerHeld=false;
+
+void FCEUSND_HoldMixer(void)
+{
+  if(mixerHeld || !FSettings.SndRate)
+   return;
+  memcpy(heldWave,Wave,sizeof(Wave));
+  heldWaveHi.assign(WaveHi,WaveHi+(FSettings.soundq>=1 ? soundtsoffs : 0));
+  heldtsoffs=soundtsoffs;
+  DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=Dummyfunc;
+  mixerHeld=true;
+}
+
+void FCEUSND_ReleaseMixer(void)
+{
+  if(!mixerHeld)
+   return;
+  mixerHeld=false;
+  //the expansion chips can't be held: bring them back in step and throw away what they mixed meanwhile
+  if(FSettings.soundq>=1)
+  {
+   if(GameExpSound.HiSync) GameExpSound.HiSync(heldtsoffs);
+  }
+  else if(GameExpSound.Fill)
+   GameExpSound.Fill(ChannelBC[0]);
+  memcpy(Wave,heldWave,sizeof(Wave));
+  if(!heldWaveHi.empty())
+   memcpy(WaveHi,&heldWaveHi[0],heldWaveHi.size()*sizeof(int32));
+  memset(WaveHi+heldWaveHi.size(),0,sizeof(WaveHi)-heldWaveHi.size()*sizeof(int32));
+  soundtsoffs=heldtsoffs;
+  SetChannelFuncs();
+}
+
 int GetSoundBuffer(int32 **W)
 {
  *W=WaveFinal;
@@ -1218,6 +1273,9 @@ void SetSoundVariables(void)
   fhinc=PAL?16626:14915;  // *2 CPU clock rate
   fhinc*=24;
 
+  mixerHeld=false;
+  SetChannelFuncs();
+
   if(FSettings.SndRate)
   {
    wlookup1[0]=0;
@@ -1232,29 +1290,9 @@ void SetSoundVariables(void)
     wlookup2[x]=(double)16*16*16*4*163.67/((double)24329/(double)x+100);
     if(!FSettings.soundq) wlookup2[x]>>=4;
    }
-   if(FSettings.soundq>=1)
-   {
-    DoNoise=RDoNoise;
-    DoTriangle=RDoTriangle;
-    DoPCM=RDoPCM;
-    DoSQ1=RDoSQ1;
-    DoSQ2=RDoSQ2;
-   }
-   else
-   {
-    DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=Dummyfunc;
-    DoSQ1=RDoSQLQ;
-    DoSQ2=RDoSQLQ;
-    DoTriangle=RDoTriangleNoisePCMLQ;
-    DoNoise=RDoTriangleNoisePCMLQ;
-    DoPCM=RDoTriangleNoisePCMLQ;
-   }
   }
   else
-  {
-   DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=Dummyfunc;
    return;
-  }
 
   MakeFilters(FSettings.SndRate);
 
@@ -45,7 +45,12 @@ extern int32 nesincsize;
 void SetSoundVariables(void);
 
 int GetSoundBuffer(int32 **W);
-int FlushEmulateSound(void);
+//log: whether the samples go to the sound log too
+int FlushEmulateSound(bool log = true);
+//Run-ahead emulates frames that are never heard. While the mixer is held the 2A03 channels
+//aren't mixed, and on release the mixer is put back the way it was, carried-over samples and all
+void FCEUSND_HoldMixer(void);
+void FCEUSND_ReleaseMixer(void);
 extern int32 Wave[2048+512];
 extern int32 WaveFinal[2048+512];
 extern int32 WaveHi[];
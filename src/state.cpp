@@ -36,6 +36,7 @@
 #include "netplay.h"
 #include "video.h"
 #include "input.h"
+#include "reversedebug.h"
 #include "zlib.h"
 #include "driver.h"
 #ifdef _S9XLUA_H
@@ -246,7 +247,7 @@ static int read_sfcpuc=0, read_snd=0;
 
 void FCEUD_BlitScreen(uint8 *XBuf); //mbg merge 7/17/06 YUCKY had to add
 void UpdateFCEUWindow(void);  //mbg merge 7/17/06 YUCKY had to add
-static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
+static bool ReadStateChunks(EMUFILE* is, int32 totalsize, bool display)
 {
 	int t;
 	uint32 size;
@@ -313,7 +314,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 				//MBG TODO - can this be moved to a better place?
 				//does it even make sense, displaying XBuf when its XBackBuf we just loaded?
 #ifdef WIN32
-				else
+				else if(display)
 				{
 					FCEUD_BlitScreen(XBuf);
 					UpdateFCEUWindow();
@@ -589,7 +590,7 @@ int FCEUSS_LoadFP_old(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	//{
 	//	scan_chunks=1;
 	//}
-	x=ReadStateChunks(is,*(uint32*)(header+4));
+	x=ReadStateChunks(is,*(uint32*)(header+4),params != SSLOADPARAM_NODISPLAY);
 	//if(params == SSLOADPARAM_DUMMY)
 	//{
 	//	scan_chunks=0;
@@ -685,7 +686,7 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 
 	FCEUMOV_PreLoad();
 
-	bool x = (ReadStateChunks(&memory_savestate, totalsize) != 0);
+	bool x = (ReadStateChunks(&memory_savestate, totalsize, params != SSLOADPARAM_NODISPLAY) != 0);
 
 	//mbg 5/24/08 - we don't support old states, so this shouldnt matter.
 	//if(read_sfcpuc && stateversion<9500)
@@ -706,6 +707,7 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 		FCEUSS_LoadFP(&msBackupSavestate,SSLOADPARAM_NOBACKUP);
 	}
 
+	FCEU_ReverseStateLoaded();
 	return x;
 }
 
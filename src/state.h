@@ -22,6 +22,7 @@ enum ENUM_SSLOADPARAMS
 {
 	SSLOADPARAM_NOBACKUP,
 	SSLOADPARAM_BACKUP,
+	SSLOADPARAM_NODISPLAY, //no backup, and the loaded picture isn't shown (run-ahead's restore)
 };
 
 void FCEUSS_Save(const char *, bool display_message=true);
@@ -0,0 +1,183 @@
+/// \file
+/// \brief Binary trace logger
+///
+/// The emulation thread only copies the state of each instruction into a ring buffer.
+/// A writer thread compresses the records in blocks and writes them to disk, so long traces
+/// don't spend the frame time on formatting text and on file I/O. Use tracedump to turn the
+/// resulting file back into a disassembled listing.
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "x6502.h"
+#include "debug.h"
+#include "movie.h"
+#include "tracelog.h"
+
+#include <zlib.h>
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#define TRACE_RING_SIZE  (1 << 18) //records; must be a power of two
+#define TRACE_BLOCK_SIZE (1 << 14) //records per compressed block; must divide TRACE_RING_SIZE
+
+bool traceLogRecording = false;
+
+static FCEUTraceRecord *traceRing = NULL;
+static std::atomic<uint32> traceHead(0); //written by the emulation thread only
+static std::atomic<uint32> traceTail(0); //written by the writer thread only
+static std::atomic<bool> traceStop(false);
+static std::mutex traceLock;                //only taken when the ring is full
+static std::condition_variable traceFreed;  //the writer made room in the ring
+static bool traceWriteFailed = false;
+static std::thread traceWriter;
+static FILE *traceFile = NULL;
+
+static bool WriteTraceBlock(const FCEUTraceRecord *records, uint32 count, std::vector<uint8> &buf)
+{
+	const uLong rawSize = count * sizeof(FCEUTraceRecord);
+	uLongf compressedSize = compressBound(rawSize);
+	buf.resize(compressedSize);
+	if (compress2(&buf[0], &compressedSize, (const Bytef*)records, rawSize, Z_BEST_SPEED) != Z_OK)
+		return false;
+
+	FCEUTraceBlock block;
+	block.records = count;
+	block.compressedSize = compressedSize;
+	return fwrite(&block, sizeof(block), 1, traceFile) == 1
+		&& fwrite(&buf[0], 1, compressedSize, traceFile) == compressedSize;
+}
+
+static void TraceWriterProc()
+{
+	std::vector<uint8> buf;
+	for (;;)
+	{
+		const uint32 tail = traceTail.load(std::memory_order_relaxed);
+		const uint32 head = traceHead.load(std::memory_order_acquire);
+		const bool stopping = traceStop.load(std::memory_order_acquire);
+
+		//only full blocks are written while recording; they compress better and never straddle the end of the ring
+		uint32 count = head - tail;
+		if (!count || (count < TRACE_BLOCK_SIZE && !stopping))
+		{
+			if (stopping)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+		if (count > TRACE_BLOCK_SIZE)
+			count = TRACE_BLOCK_SIZE;
+		const uint32 start = tail & (TRACE_RING_SIZE - 1);
+		if (count > TRACE_RING_SIZE - start)
+			count = TRACE_RING_SIZE - start;
+
+		//keep consuming after an error so that the emulation thread never waits on us
+		if (!traceWriteFailed && !WriteTraceBlock(traceRing + start, count, buf))
+			traceWriteFailed = true;
+
+		traceTail.store(tail + count, std::memory_order_release);
+		{
+			//a waiting emulation thread checks the tail under the lock, so it can't miss this
+			std::lock_guard<std::mutex> lock(traceLock);
+		}
+		traceFreed.notify_one();
+	}
+}
+
+void FCEU_TraceLogInstruction(uint8 *opcode, uint16 A, int size)
+{
+	const uint32 head = traceHead.load(std::memory_order_relaxed);
+
+	//the writer is a whole ring behind; sleep until it frees a block rather than drop instructions
+	if (head - traceTail.load(std::memory_order_acquire) >= TRACE_RING_SIZE)
+	{
+		std::unique_lock<std::mutex> lock(traceLock);
+		while (head - traceTail.load(std::memory_order_acquire) >= TRACE_RING_SIZE)
+			traceFreed.wait(lock);
+	}
+
+	FCEUTraceRecord &rec = traceRing[head & (TRACE_RING_SIZE - 1)];
+	rec.cycles = timestampbase + (uint64)timestamp;
+	rec.frame = currFrameCounter;
+	rec.pc = X.PC;
+	rec.addr = A;
+	rec.scanline = scanline;
+	rec.bank = getBank(X.PC);
+	rec.opcode[0] = opcode[0];
+	rec.opcode[1] = opcode[1];
+	rec.opcode[2] = opcode[2];
+	rec.size = size;
+	rec.a = X.A;
+	rec.x = X.X;
+	rec.y = X.Y;
+	rec.s = X.S;
+	rec.p = X.P;
+	rec.value = GetMem(A);
+	rec.reserved[0] = rec.reserved[1] = 0;
+
+	traceHead.store(head + 1, std::memory_order_release);
+}
+
+bool FCEUI_BeginTraceLog(const char *fn)
+{
+	FCEUI_EndTraceLog();
+
+	traceFile = FCEUD_UTF8fopen(fn, "wb");
+	if (!traceFile)
+		return false;
+
+	FCEUTraceHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, FCEU_TRACE_MAGIC);
+	header.version = FCEU_TRACE_VERSION;
+	header.byteOrder = FCEU_TRACE_BYTEORDER;
+	header.recordSize = sizeof(FCEUTraceRecord);
+	if (fwrite(&header, sizeof(header), 1, traceFile) != 1)
+	{
+		fclose(traceFile);
+		traceFile = NULL;
+		return false;
+	}
+
+	if (!traceRing)
+		traceRing = new FCEUTraceRecord[TRACE_RING_SIZE];
+	traceHead.store(0);
+	traceTail.store(0);
+	traceStop.store(false);
+	traceWriteFailed = false;
+	traceWriter = std::thread(TraceWriterProc);
+
+	traceLogRecording = true;
+	return true;
+}
+
+void FCEUI_EndTraceLog()
+{
+	if (!traceLogRecording)
+		return;
+	traceLogRecording = false;
+
+	//the writer drains whatever is left in the ring before it exits
+	traceStop.store(true, std::memory_order_release);
+	traceWriter.join();
+
+	if (fclose(traceFile) != 0)
+		traceWriteFailed = true;
+	traceFile = NULL;
+
+	if (traceWriteFailed)
+		FCEU_PrintError("Error writing the trace log; the file is incomplete.");
+}
+
+bool FCEUI_TraceLogIsRecording()
+{
+	return traceLogRecording;
+}
@@ -0,0 +1,53 @@
+#ifndef _TRACELOG_H_
+#define _TRACELOG_H_
+
+#include "types.h"
+
+//Binary trace log format, shared with the offline decoder (tracedump/).
+//The file starts with a FCEUTraceHeader and is followed by blocks, each made of a FCEUTraceBlock
+//and the zlib-compressed FCEUTraceRecords. Everything is stored in the byte order of the machine
+//that recorded the trace; the byteOrder field tells which one that was.
+
+#define FCEU_TRACE_MAGIC     "FCEUTRC"
+#define FCEU_TRACE_VERSION   1
+#define FCEU_TRACE_BYTEORDER 0x01020304
+
+struct FCEUTraceHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 byteOrder;
+	uint32 recordSize;
+	uint32 reserved;
+};
+
+struct FCEUTraceBlock
+{
+	uint32 records;         //number of records in the block
+	uint32 compressedSize;  //bytes of compressed data following this header
+};
+
+struct FCEUTraceRecord
+{
+	uint64 cycles;      //timestampbase + timestamp when the instruction started
+	uint32 frame;
+	uint16 pc;
+	uint16 addr;        //effective address of the memory operand, as computed by the debugger
+	int16 scanline;
+	int16 bank;         //PRG bank of pc as returned by getBank(), -1 outside of ROM
+	uint8 opcode[3];
+	uint8 size;         //instruction length, 0 for an undefined opcode
+	uint8 a, x, y, s, p;
+	uint8 value;        //byte at addr before the instruction ran
+	uint8 reserved[2];
+};
+
+extern bool traceLogRecording;
+
+void FCEU_TraceLogInstruction(uint8 *opcode, uint16 A, int size);
+
+bool FCEUI_BeginTraceLog(const char *fn);
+void FCEUI_EndTraceLog();
+bool FCEUI_TraceLogIsRecording();
+
+#endif
@@ -92,7 +92,7 @@ static void FreeUNIF(void) {
 	}
 	for (x = 0; x < 32; x++) {
 		if (malloced[x]) {
-			free(malloced[x]); malloced[x] = 0;
+			FCEU_ffree(malloced[x]); malloced[x] = 0;
 		}
 	}
 }
@@ -253,6 +253,15 @@ static int EnableBattery(FCEUFILE *fp) {
 	return(1);
 }
 
+//chunks that need no padding are used straight from the file
+static uint8 *MapChunk(FCEUFILE *fp, uint32 size) {
+	uint8 *p;
+	if (size != uchead.info || !(p = FCEU_fmap(fp, FCEU_ftell(fp), size)))
+		return 0;
+	FCEU_fseek(fp, size, SEEK_CUR);
+	return p;
+}
+
 static int LoadPRG(FCEUFILE *fp) {
 	int z, t;
 	z = uchead.ID[3] - '0';
@@ -261,17 +270,21 @@ static int LoadPRG(FCEUFILE *fp) {
 		return(0);
 	FCEU_printf(" PRG ROM %d size: %d", z, (int)uchead.info);
 	if (malloced[z])
-		free(malloced[z]);
+		FCEU_ffree(malloced[z]);
 	t = FixRomSize(uchead.info, 2048);
-	if (!(malloced[z] = (uint8*)FCEU_malloc(t)))
-		return(0);
 	mallocedsizes[z] = t;
-	memset(malloced[z] + uchead.info, 0xFF, t - uchead.info);
-	if (FCEU_fread(malloced[z], 1, uchead.info, fp) != uchead.info) {
-		FCEU_printf("Read Error!\n");
-		return(0);
-	} else
+	if ((malloced[z] = MapChunk(fp, t)))
 		FCEU_printf("\n");
+	else {
+		if (!(malloced[z] = (uint8*)FCEU_malloc(t)))
+			return(0);
+		memset(malloced[z] + uchead.info, 0xFF, t - uchead.info);
+		if (FCEU_fread(malloced[z], 1, uchead.info, fp) != uchead.info) {
+			FCEU_printf("Read Error!\n");
+			return(0);
+		} else
+			FCEU_printf("\n");
+	}
 
 	SetupCartPRGMapping(z, malloced[z], t, 0);
 	return(1);
@@ -296,17 +309,21 @@ static int LoadCHR(FCEUFILE *fp) {
 		return(0);
 	FCEU_printf(" CHR ROM %d size: %d", z, (int)uchead.info);
 	if (malloced[16 + z])
-		free(malloced[16 + z]);
+		FCEU_ffree(malloced[16 + z]);
 	t = FixRomSize(uchead.info, 8192);
-	if (!(malloced[16 + z] = (uint8*)FCEU_malloc(t)))
-		return(0);
 	mallocedsizes[16 + z] = t;
-	memset(malloced[16 + z] + uchead.info, 0xFF, t - uchead.info);
-	if (FCEU_fread(malloced[16 + z], 1, uchead.info, fp) != uchead.info) {
-		FCEU_printf("Read Error!\n");
-		return(0);
-	} else
+	if ((malloced[16 + z] = MapChunk(fp, t)))
 		FCEU_printf("\n");
+	else {
+		if (!(malloced[16 + z] = (uint8*)FCEU_malloc(t)))
+			return(0);
+		memset(malloced[16 + z] + uchead.info, 0xFF, t - uchead.info);
+		if (FCEU_fread(malloced[16 + z], 1, uchead.info, fp) != uchead.info) {
+			FCEU_printf("Read Error!\n");
+			return(0);
+		} else
+			FCEU_printf("\n");
+	}
 
 	SetupCartCHRMapping(z, malloced[16 + z], t, 0);
 	return(1);
@@ -23,7 +23,6 @@
 #include "fceu.h"
 #include "file.h"
 #include "utils/memory.h"
-#include "utils/crc32.h"
 #include "state.h"
 #include "movie.h"
 #include "palette.h"
@@ -32,7 +31,8 @@
 #include "vsuni.h"
 #include "drawing.h"
 #include "driver.h"
-#include "drivers/common/vidblit.h"
+#include "pngdump.h"
+#include "shmexport.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -55,7 +55,6 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
-#include <zlib.h>
 
 //XBuf:
 //0-63 is reserved for 7 special colours used by FCEUX (overlay, etc.)
@@ -169,13 +168,11 @@ void FCEUI_SaveSnapshotAs(void)
 	dosnapsave=2;
 }
 
+//the file is written in the background; an error shows up when the next picture is drawn
 static void ReallySnap(void)
 {
 	int x=SaveSnapshot();
-	if(!x)
-		FCEU_DispMessage("Error saving screen snapshot.",0);
-	else
-		FCEU_DispMessage("Screen snapshot %d saved.",0,x-1);
+	FCEU_DispMessage("Screen snapshot %d saved.",0,x-1);
 }
 
 static uint32 GetButtonColor(uint32 held, uint32 c, uint32 ci, int bit)
@@ -205,6 +202,10 @@ static uint32 GetButtonColor(uint32 held, uint32 c, uint32 ci, int bit)
 
 void FCEU_PutImage(void)
 {
+	//the picture of the game, before anything is drawn over it
+	FCEU_FrameDumpPicture();
+	FCEU_ShmExportFrame();
+
 	if(dosnapsave==2)	//Save screenshot as, currently only flagged & run by the Win32 build. //TODO SDL: implement this?
 	{
 		char nameo[512];
@@ -455,40 +456,6 @@ void FCEU_ResetMessages()
 }
 
 
-static int WritePNGChunk(FILE *fp, uint32 size, char *type, uint8 *data)
-{
-	uint32 crc;
-
-	uint8 tempo[4];
-
-	tempo[0]=size>>24;
-	tempo[1]=size>>16;
-	tempo[2]=size>>8;
-	tempo[3]=size;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	if(fwrite(type,4,1,fp)!=1)
-		return 0;
-
-	if(size)
-		if(fwrite(data,1,size,fp)!=size)
-			return 0;
-
-	crc=CalcCRC32(0,(uint8 *)type,4);
-	if(size)
-		crc=CalcCRC32(crc,data,size);
-
-	tempo[0]=crc>>24;
-	tempo[1]=crc>>16;
-	tempo[2]=crc>>8;
-	tempo[3]=crc;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	return 1;
-}
-
 uint32 GetScreenPixel(int x, int y, bool usebackup) {
 
 	uint8 r,g,b;
@@ -519,14 +486,8 @@ int GetScreenPixelPalette(int x, int y, bool usebackup) {
 
 int SaveSnapshot(void)
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,u,y;
 	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=(totallines*263+12)*3;
-
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
+	int u;
 
 	for (u = lastu; u < 99999; ++u)
 	{
@@ -534,179 +495,18 @@ int SaveSnapshot(void)
 		if(pp==NULL) break;
 		fclose(pp);
 	}
-	lastu = u;
-
-	if(!(pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"wb")))
-	{
-		free(compmem);
-		return 0;
-	}
-
-	{
-		static const uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
-
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
-
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
-
-		chunko[8]=8;				// 8 bits per sample(24 bits per pixel)
-		chunko[9]=2;				// Color type; RGB triplet
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
-
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
-
-	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
-
-		int bufsize = (256*3+1)*totallines;
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc(bufsize)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
-
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--)
-			{
-				u32 color = ModernDeemphColorMap(tmp,XBuf,1,1);
-				*dest++=(color>>0x10)&0xFF;
-				*dest++=(color>>0x08)&0xFF;
-				*dest++=(color>>0x00)&0xFF;
-				tmp++;
-			}
-		}
-
-		if(compress(compmem,&compmemsize,mork,bufsize)!=Z_OK)
-		{
-			if(mal) free(mal);
-			goto PNGerr;
-		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
-	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
-	fclose(pp);
+	//the file is only written later, so the next one can't go by whether it exists
+	lastu = u + 1;
 
+	FCEU_PngDumpQueue(FCEU_MakeFName(FCEUMKF_SNAP,u,"png"));
 	return u+1;
-
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
 }
 
 //overloaded SaveSnapshot for "Savesnapshot As" function
 int SaveSnapshot(char fileName[512])
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,y;
-	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=totallines*263+12;
-
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
-
-	if(!(pp=FCEUD_UTF8fopen(fileName,"wb")))
-	{
-		free(compmem);
-		return 0;
-	}
-
-	{
-		static uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
-
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
-
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
-
-		chunko[8]=8;				// bit depth
-		chunko[9]=3;				// Color type; indexed 8-bit
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
-
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
-
-	{
-		uint8 pdata[256*3];
-		for(x=0;x<256;x++)
-			FCEUD_GetPalette(x,pdata+x*3,pdata+x*3+1,pdata+x*3+2);
-		if(!WritePNGChunk(pp,256*3,"PLTE",pdata))
-			goto PNGerr;
-	}
-
-	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
-
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc((totallines<<8)+totallines)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
-
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--,tmp++,dest++)
-				*dest=*tmp;
-		}
-
-		if(compress(compmem,&compmemsize,mork,(totallines<<8)+totallines)!=Z_OK)
-		{
-			if(mal) free(mal);
-			goto PNGerr;
-		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
-	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
-	fclose(pp);
-
+	FCEU_PngDumpQueue(fileName);
 	return 0;
-
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
 }
 // called when another ROM is opened
 void ResetScreenshotsCounter()
@@ -51,12 +51,10 @@ static INLINE uint8 RdMem(unsigned int A)
 }
 
 //normal memory write
+//(lua write hooks are spliced into BWrite, see FCEU_LuaRebuildMemHooks)
 static INLINE void WrMem(unsigned int A, uint8 V)
 {
 	BWrite[A](A,V);
-	#ifdef _S9XLUA_H
-	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
-	#endif
 }
 
 static INLINE uint8 RdRAM(unsigned int A)
@@ -66,8 +64,11 @@ static INLINE uint8 RdRAM(unsigned int A)
   // return(_DB=RAM[A]);
 }
 
+//bypasses BWrite, so the lua write hooks and write breakpoints have to be checked here
 static INLINE void WrRAM(unsigned int A, uint8 V)
 {
+	if(watchpointTrapBits[1][A >> 5] & (1u << (A & 31)))
+		WatchpointRAMWrite(A, V);
 	RAM[A]=V;
 	#ifdef _S9XLUA_H
 	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
@@ -84,9 +85,6 @@ void X6502_DMW(uint32 A, uint8 V)
 {
  ADDCYC(1);
  BWrite[A](A,V);
- #ifdef _S9XLUA_H
- CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
- #endif
 }
 
 #define PUSH(V) \
@@ -406,14 +404,12 @@ void X6502_Init(void)
 	}
 }
 
-extern int StackAddrBackup;
 void X6502_Power(void)
 {
  _count=_tcount=_IRQlow=_PC=_A=_X=_Y=_P=_PI=_DB=_jammed=0;
  _S=0xFD;
  timestamp=soundtimestamp=0;
  X6502_Reset();
- StackAddrBackup = -1;
 }
 
 void X6502_Run(int32 cycles)
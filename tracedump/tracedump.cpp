@@ -0,0 +1,277 @@
+/* fceux-tracedump - decodes the binary trace logs recorded by FCEUX
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "types.h"
+#include "x6502.h"
+#include "asm.h"
+#include "tracelog.h"
+
+#include <zlib.h>
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//the disassembler reads the registers and memory of the emulated machine.
+//here they are rebuilt from each record, which is enough for the operand it annotates.
+X6502 X;
+static uint8 mem[0x10000];
+
+uint8 GetMem(uint16 A)
+{
+	return mem[A];
+}
+
+struct Range
+{
+	long first, last;
+	bool contains(long v) const { return v >= first && v <= last; }
+};
+
+static Range frames = { 0, 0x7FFFFFFF };
+static Range pcs = { 0, 0xFFFF };
+static Range scanlines = { -1, 0x7FFF };
+static int bankFilter = -2; //-2 = any bank
+static unsigned long long maxLines = 0;
+static bool showCycles = true;
+
+static bool ParseRange(const char *str, Range &r, int base)
+{
+	char *end;
+	r.first = strtol(str, &end, base);
+	if (end == str)
+		return false;
+	if (*end == '-')
+	{
+		const char *last = end + 1;
+		r.last = strtol(last, &end, base);
+		if (end == last)
+			return false;
+	} else
+		r.last = r.first;
+	return *end == 0;
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] tracefile\n\n"
+		"  -o file           write the listing to file instead of stdout\n"
+		"  --frames a[-b]    only instructions from frames a to b\n"
+		"  --pc a[-b]        only instructions with pc in $a-$b (hex)\n"
+		"  --bank n          only instructions from PRG bank n (hex)\n"
+		"  --scanlines a[-b] only instructions on scanlines a to b\n"
+		"  --count n         stop after n lines\n"
+		"  --nocycles        leave the cycle counter out\n",
+		prog);
+}
+
+//seeds the memory image so that Disassemble() resolves the operand the way the emulator did
+static void PrepareMemory(const FCEUTraceRecord &rec, const FCEUTraceRecord *next)
+{
+	const uint8 op = rec.opcode[0];
+	if (op == 0x6C && next)
+	{
+		//JMP (indirect): the target is where execution went next
+		mem[rec.addr] = next->pc & 0xFF;
+		mem[(uint16)(rec.addr + 1)] = next->pc >> 8;
+		return;
+	}
+	if ((op & 0x1F) == 0x01)
+	{
+		//(Indirect,X)
+		const uint8 ptr = rec.opcode[1] + rec.x;
+		mem[ptr] = rec.addr & 0xFF;
+		mem[(uint8)(ptr + 1)] = rec.addr >> 8;
+	} else if ((op & 0x1F) == 0x11)
+	{
+		//(Indirect),Y
+		const uint16 base = rec.addr - rec.y;
+		mem[rec.opcode[1]] = base & 0xFF;
+		mem[(uint8)(rec.opcode[1] + 1)] = base >> 8;
+	}
+	mem[rec.addr] = rec.value;
+}
+
+static void PrintRecord(FILE *out, const FCEUTraceRecord &rec, const FCEUTraceRecord *next)
+{
+	char data[16], procstatus[16], address[16];
+
+	X.A = rec.a;
+	X.X = rec.x;
+	X.Y = rec.y;
+	X.S = rec.s;
+	X.P = rec.p;
+	X.PC = rec.pc;
+	PrepareMemory(rec, next);
+
+	const char *disassembly;
+	uint8 opcode[3] = { rec.opcode[0], rec.opcode[1], rec.opcode[2] };
+	switch (rec.size)
+	{
+		case 1: sprintf(data, "%02X        ", opcode[0]); disassembly = Disassemble(rec.pc + 1, opcode); break;
+		case 2: sprintf(data, "%02X %02X     ", opcode[0], opcode[1]); disassembly = Disassemble(rec.pc + 2, opcode); break;
+		case 3: sprintf(data, "%02X %02X %02X  ", opcode[0], opcode[1], opcode[2]); disassembly = Disassemble(rec.pc + 3, opcode); break;
+		default: sprintf(data, "%02X        ", opcode[0]); disassembly = "UNDEFINED"; break;
+	}
+
+	const uint8 tmp = rec.p ^ 0xFF;
+	sprintf(procstatus, "P:%c%c%c%c%c%c%c%c",
+		'N'|(tmp&0x80)>>2,
+		'V'|(tmp&0x40)>>1,
+		'U'|(tmp&0x20),
+		'B'|(tmp&0x10)<<1,
+		'D'|(tmp&0x08)<<2,
+		'I'|(tmp&0x04)<<3,
+		'Z'|(tmp&0x02)<<4,
+		'C'|(tmp&0x01)<<5
+		);
+
+	if (rec.pc >= 0x8000)
+		sprintf(address, "$%02X:%04X:", rec.bank & 0xFF, rec.pc);
+	else
+		sprintf(address, "  $%04X:", rec.pc);
+
+	fprintf(out, "f%-6u ", rec.frame);
+	if (showCycles)
+		fprintf(out, "c%-11llu ", (unsigned long long)rec.cycles);
+	fprintf(out, "sl%-4d A:%02X X:%02X Y:%02X S:%02X %s  %s %s%s\n",
+		rec.scanline, rec.a, rec.x, rec.y, rec.s, procstatus, address, data, disassembly);
+}
+
+static bool Matches(const FCEUTraceRecord &rec)
+{
+	return frames.contains(rec.frame)
+		&& pcs.contains(rec.pc)
+		&& scanlines.contains(rec.scanline)
+		&& (bankFilter == -2 || bankFilter == rec.bank);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *inName = NULL, *outName = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *param = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = true;
+		if (!strcmp(arg, "-o") && param)
+			outName = argv[++i];
+		else if (!strcmp(arg, "--frames") && param)
+			ok = ParseRange(argv[++i], frames, 10);
+		else if (!strcmp(arg, "--pc") && param)
+			ok = ParseRange(argv[++i], pcs, 16);
+		else if (!strcmp(arg, "--scanlines") && param)
+			ok = ParseRange(argv[++i], scanlines, 10);
+		else if (!strcmp(arg, "--bank") && param)
+			bankFilter = strtol(argv[++i], NULL, 16);
+		else if (!strcmp(arg, "--count") && param)
+			maxLines = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(arg, "--nocycles"))
+			showCycles = false;
+		else if (arg[0] != '-' && !inName)
+			inName = arg;
+		else
+			ok = false;
+		if (!ok)
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!inName)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(inName, "rb");
+	if (!in)
+	{
+		fprintf(stderr, "Can't open %s\n", inName);
+		return 1;
+	}
+	FILE *out = stdout;
+	if (outName && !(out = fopen(outName, "w")))
+	{
+		fprintf(stderr, "Can't create %s\n", outName);
+		return 1;
+	}
+
+	FCEUTraceHeader header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, FCEU_TRACE_MAGIC, sizeof(FCEU_TRACE_MAGIC)))
+	{
+		fprintf(stderr, "%s is not an FCEUX trace log\n", inName);
+		return 1;
+	}
+	if (header.byteOrder != FCEU_TRACE_BYTEORDER)
+	{
+		fprintf(stderr, "%s was recorded on a machine with a different byte order\n", inName);
+		return 1;
+	}
+	if (header.version != FCEU_TRACE_VERSION || header.recordSize != sizeof(FCEUTraceRecord))
+	{
+		fprintf(stderr, "%s uses an unsupported trace format (version %u)\n", inName, header.version);
+		return 1;
+	}
+
+	std::vector<uint8> compressed;
+	std::vector<FCEUTraceRecord> records;
+	FCEUTraceRecord pending;
+	bool havePending = false;
+	unsigned long long lines = 0;
+	int result = 0;
+
+	FCEUTraceBlock block;
+	while (fread(&block, sizeof(block), 1, in) == 1)
+	{
+		compressed.resize(block.compressedSize);
+		records.resize(block.records);
+		uLongf rawSize = block.records * sizeof(FCEUTraceRecord);
+		if (!block.records || !block.compressedSize
+			|| fread(&compressed[0], 1, block.compressedSize, in) != block.compressedSize
+			|| uncompress((Bytef*)&records[0], &rawSize, &compressed[0], block.compressedSize) != Z_OK
+			|| rawSize != block.records * sizeof(FCEUTraceRecord))
+		{
+			fprintf(stderr, "%s is truncated or corrupt\n", inName);
+			result = 1;
+			break;
+		}
+
+		//records are printed one behind, so that each one can look at where execution went next
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (havePending && Matches(pending))
+			{
+				PrintRecord(out, pending, &records[i]);
+				if (maxLines && ++lines >= maxLines)
+					goto done;
+			}
+			pending = records[i];
+			havePending = true;
+		}
+	}
+	if (havePending && Matches(pending))
+		PrintRecord(out, pending, NULL);
+
+done:
+	fclose(in);
+	if (out != stdout)
+		fclose(out);
+	return result;
+}